@@ -0,0 +1,577 @@
+#define _GNU_SOURCE
+
+#include "archive.h"
+
+#include "clip.h"
+#include "common.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+
+#define TAR_BLOCK      512
+#define TAR_NAME_MAX   100
+#define TAR_PREFIX_MAX 155
+#define TAR_SIZE_MAX   077777777777ULL /// Предел поля `size` (11 восьмеричных цифр)
+#define TAR_TYPE_FILE  '0'
+#define TAR_TYPE_DIR   '5'
+#define TAR_TYPE_PAX   'x'
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+/// Заголовок ustar (POSIX.1-1988), ровно один блок.
+struct tar_header
+{
+        char name[100];
+        char mode[8];
+        char uid[8];
+        char gid[8];
+        char size[12];
+        char mtime[12];
+        char chksum[8];
+        char typeflag;
+        char linkname[100];
+        char magic[6];
+        char version[2];
+        char uname[32];
+        char gname[32];
+        char devmajor[8];
+        char devminor[8];
+        char prefix[155];
+        char pad[12];
+};
+
+_Static_assert(sizeof(struct tar_header) == TAR_BLOCK,
+               "tar header must be one block");
+
+/// Метаданные одной записи архива.
+struct tar_entry
+{
+        const char        *path;
+        unsigned long long size;
+        unsigned long long mtime;
+        unsigned int       mode;
+        unsigned int       uid;
+        unsigned int       gid;
+        char               type;
+};
+
+static const char zero_block[TAR_BLOCK];
+
+/// Записывает буфер целиком, повторяя короткие `write`.
+static int
+write_all(struct archive *ar, const void *buf, size_t len)
+{
+        const char *p = buf;
+        while (0 < len)
+        {
+                const ssize_t n = write(ar->fd, p, len);
+                if (-1 == n && EINTR == errno)
+                {
+                        continue;
+                }
+                if (-1 == n)
+                {
+                        return -1;
+                }
+                p += n;
+                len -= (size_t) n;
+                ar->bytes += (unsigned long long) n;
+        }
+        return 0;
+}
+
+/// Дополняет последний блок записи нулями до границы `TAR_BLOCK`.
+static int
+write_padding(struct archive *ar, const unsigned long long size)
+{
+        const size_t rem = (size_t) (size % TAR_BLOCK);
+        return 0 == rem ? 0 : write_all(ar, zero_block, TAR_BLOCK - rem);
+}
+
+/// Пишет `value` восьмеричными цифрами с ведущими нулями и завершающим NUL.
+/// @return 0 при успехе, -1 если значение не помещается в поле.
+static int
+put_octal(char *field, const size_t width, unsigned long long value)
+{
+        field[width - 1] = '\0';
+        for (size_t i = width - 1; 0 < i; --i)
+        {
+                field[i - 1] = (char) ('0' + (value & 7));
+                value >>= 3;
+        }
+        return 0 == value ? 0 : -1;
+}
+
+/// Пишет десятичное число в `buf` без `printf`.
+/// @return Число записанных символов.
+static size_t
+put_decimal(char *buf, unsigned long long value)
+{
+        char   tmp[24];
+        size_t n = 0;
+        do
+        {
+                tmp[n++] = (char) ('0' + value % 10);
+                value /= 10;
+        } while (0 != value);
+        for (size_t i = 0; i < n; ++i)
+        {
+                buf[i] = tmp[n - 1 - i];
+        }
+        return n;
+}
+
+static size_t
+decimal_len(unsigned long long value)
+{
+        size_t n = 1;
+        while (value >= 10)
+        {
+                value /= 10;
+                ++n;
+        }
+        return n;
+}
+
+/// Дописывает запись pax `"<len> <key>=<value>\n"` в `buf`, где `len`
+/// — длина всей записи, включая собственные цифры.
+/// @return Длина записи или 0, если она не помещается в `cap`.
+static size_t
+pax_record(char *buf, const size_t cap, const char *key, const char *value)
+{
+        const size_t base = strlen(key) + strlen(value) + 3;
+        size_t       len  = base + decimal_len(base);
+        len               = base + decimal_len(len);
+        if (len > cap)
+        {
+                return 0;
+        }
+        size_t pos = put_decimal(buf, len);
+        buf[pos++] = ' ';
+        memcpy(buf + pos, key, strlen(key));
+        pos += strlen(key);
+        buf[pos++] = '=';
+        memcpy(buf + pos, value, strlen(value));
+        pos += strlen(value);
+        buf[pos++] = '\n';
+        return pos;
+}
+
+/// Раскладывает путь по полям `prefix` и `name` заголовка ustar.
+/// @return 0, если путь поместился, иначе -1 (нужен заголовок pax).
+static int
+split_path(struct tar_header *hdr, const char *path)
+{
+        const size_t len = strlen(path);
+        if (len <= TAR_NAME_MAX)
+        {
+                memcpy(hdr->name, path, len);
+                return 0;
+        }
+        for (size_t i = len - 1; 0 < i; --i)
+        {
+                if ('/' != path[i])
+                {
+                        continue;
+                }
+                if (len - i - 1 > TAR_NAME_MAX)
+                {
+                        return -1;
+                }
+                if (i <= TAR_PREFIX_MAX && len - i - 1 > 0)
+                {
+                        memcpy(hdr->prefix, path, i);
+                        memcpy(hdr->name, path + i + 1, len - i - 1);
+                        return 0;
+                }
+        }
+        return -1;
+}
+
+/// Заполняет поля заголовка, кроме имени, и считает контрольную сумму.
+static void
+fill_header(struct tar_header *hdr, const struct tar_entry *e,
+            const unsigned long long size, const char type)
+{
+        put_octal(hdr->mode, sizeof(hdr->mode), e->mode & 07777);
+        if (-1 == put_octal(hdr->uid, sizeof(hdr->uid), e->uid))
+        {
+                put_octal(hdr->uid, sizeof(hdr->uid), 0);
+        }
+        if (-1 == put_octal(hdr->gid, sizeof(hdr->gid), e->gid))
+        {
+                put_octal(hdr->gid, sizeof(hdr->gid), 0);
+        }
+        put_octal(hdr->size, sizeof(hdr->size), size);
+        put_octal(hdr->mtime, sizeof(hdr->mtime), e->mtime);
+        hdr->typeflag = type;
+        memcpy(hdr->magic, "ustar", 6);
+        memcpy(hdr->version, "00", 2);
+        memset(hdr->chksum, ' ', sizeof(hdr->chksum));
+        const unsigned char *p   = (const unsigned char *) hdr;
+        unsigned int         sum = 0;
+        for (size_t i = 0; i < sizeof(*hdr); ++i)
+        {
+                sum += p[i];
+        }
+        put_octal(hdr->chksum, 7, sum);
+        hdr->chksum[7] = ' ';
+}
+
+/// Пишет заголовок записи. Если путь не помещается в поля ustar или размер
+/// больше `TAR_SIZE_MAX`, перед ним выводится расширенный заголовок pax.
+/// Если и запись pax не помещается, ничего не пишется: `errno` —
+/// `ENAMETOOLONG`.
+static int
+write_header(struct archive *ar, const struct tar_entry *e)
+{
+        struct tar_header hdr;
+        memset(&hdr, 0, sizeof(hdr));
+        const int long_path = -1 == split_path(&hdr, e->path);
+        const int big_size  = e->size > TAR_SIZE_MAX;
+        if (long_path || big_size)
+        {
+                char   records[PATH_MAX + 64];
+                size_t len = 0;
+                size_t n   = 1;
+                if (long_path)
+                {
+                        n = pax_record(records, sizeof(records), "path",
+                                       e->path);
+                        len += n;
+                }
+                if (big_size && 0 != n)
+                {
+                        char   digits[24];
+                        size_t d  = put_decimal(digits, e->size);
+                        digits[d] = '\0';
+                        n = pax_record(records + len, sizeof(records) - len,
+                                       "size", digits);
+                        len += n;
+                }
+                if (0 == n)
+                {
+                        errno = ENAMETOOLONG;
+                        return -1;
+                }
+                struct tar_header pax;
+                memset(&pax, 0, sizeof(pax));
+                memcpy(pax.name, "PaxHeaders/", 11);
+                const char  *base = strrchr(e->path, '/');
+                const char  *tail = NULL == base ? e->path : base + 1;
+                const size_t room = TAR_NAME_MAX - 11;
+                memcpy(pax.name + 11, tail,
+                       strlen(tail) < room ? strlen(tail) : room);
+                fill_header(&pax, e, len, TAR_TYPE_PAX);
+                if (-1 == write_all(ar, &pax, sizeof(pax)) ||
+                    -1 == write_all(ar, records, len) ||
+                    -1 == write_padding(ar, len))
+                {
+                        return -1;
+                }
+                if (long_path)
+                {
+                        memset(hdr.prefix, 0, sizeof(hdr.prefix));
+                        memcpy(hdr.name, e->path, TAR_NAME_MAX);
+                }
+        }
+        // при big_size настоящий размер задан в pax, поле ustar — нули
+        fill_header(&hdr, e, big_size ? 0 : e->size, e->type);
+        return write_all(ar, &hdr, sizeof(hdr));
+}
+
+/// Копирует буферами — если ядро не умеет `sendfile`/`splice` для этой пары.
+static int
+send_rw(struct archive *ar, const int in, off_t *off, const off_t size)
+{
+        char buf[64 * 1024];
+        while (*off < size)
+        {
+                const size_t  want = (size_t) (size - *off) < sizeof(buf)
+                                         ? (size_t) (size - *off)
+                                         : sizeof(buf);
+                const ssize_t n    = pread(in, buf, want, *off);
+                if (-1 == n && EINTR == errno)
+                {
+                        continue;
+                }
+                if (-1 == n)
+                {
+                        return -1;
+                }
+                if (0 == n || -1 == write_all(ar, buf, (size_t) n))
+                {
+                        return 0 == n ? 0 : -1;
+                }
+                *off += n;
+        }
+        return 0;
+}
+
+/// Передаёт тело файла в архив без копирования через пользовательские
+/// буферы: `splice`, если вывод — канал, иначе `sendfile`.
+///
+/// @return 0 при успехе (в `*off` — сколько передано; меньше `size`, если
+///         файл укоротился), -1 при ошибке.
+static int
+send_body(struct archive *ar, const int in, off_t *off, const off_t size)
+{
+        while (*off < size)
+        {
+                const size_t  len = (size_t) (size - *off);
+                const off_t   was = *off;
+                const ssize_t n =
+                    ar->is_pipe
+                        ? splice(in, off, ar->fd, NULL, len, SPLICE_F_MORE)
+                        : sendfile(ar->fd, in, off, len);
+                if (-1 == n && EINTR == errno)
+                {
+                        continue;
+                }
+                if (-1 == n && 0 == was && (EINVAL == errno || ENOSYS == errno))
+                {
+                        return send_rw(ar, in, off, size);
+                }
+                if (-1 == n)
+                {
+                        return -1;
+                }
+                if (0 == n)
+                {
+                        break;
+                }
+                ar->bytes += (unsigned long long) n;
+        }
+        return 0;
+}
+
+/// Добавляет записи каталогов для всех ещё не встречавшихся префиксов пути.
+/// Слишком длинный каталог — ошибка с `errno` `ENAMETOOLONG`.
+static int
+add_dirs(struct archive *ar, const char *dir, const struct tar_entry *like)
+{
+        char path[PATH_MAX];
+        const size_t len = strlen(dir);
+        if (len + 2 > sizeof(path))
+        {
+                errno = ENAMETOOLONG;
+                return -1;
+        }
+        for (size_t i = 1; i <= len; ++i)
+        {
+                if (i != len && '/' != dir[i])
+                {
+                        continue;
+                }
+                memcpy(path, dir, i);
+                path[i]     = '/';
+                path[i + 1] = '\0';
+                const int added = strset_add(&ar->dirs, path);
+                if (-1 == added)
+                {
+                        return -1;
+                }
+                if (0 == added)
+                {
+                        continue;
+                }
+                struct tar_entry e = *like;
+                e.path             = path;
+                e.size             = 0;
+                e.mode             = 0755;
+                e.type             = TAR_TYPE_DIR;
+                if (-1 == write_header(ar, &e))
+                {
+                        return -1;
+                }
+        }
+        return 0;
+}
+
+/// Открывает поток архива.
+///
+/// @param error Код ошибки (`ARCHIVE_OK`, `ARCHIVE_ERR_BAD_ARG`,
+///              `ARCHIVE_ERR_OPEN`).
+/// @param ar    Структура архива.
+/// @param path  Файл архива (создаётся или усекается) либо `"-"` для stdout.
+/// @return 0 при успехе, -1 при ошибке.
+int
+archive_open(int *error, struct archive *ar, const char *path)
+{
+        if (NULL == ar || NULL == path)
+        {
+                *error = ARCHIVE_ERR_BAD_ARG;
+                return -1;
+        }
+        memset(ar, 0, sizeof(*ar));
+        const int is_stdout = 0 == strcmp(path, "-");
+        ar->fd              = is_stdout ? STDOUT_FILENO
+                                        : open(path,
+                                               O_WRONLY | O_CREAT | O_TRUNC |
+                                                   O_CLOEXEC,
+                                               0644);
+        ar->owns_fd         = !is_stdout;
+        struct stat st;
+        if (-1 == ar->fd || -1 == fstat(ar->fd, &st) ||
+            -1 == strset_init(&ar->dirs, 0))
+        {
+                if (ar->owns_fd && -1 != ar->fd)
+                {
+                        close(ar->fd);
+                }
+                *error = ARCHIVE_ERR_OPEN;
+                return -1;
+        }
+        ar->is_pipe = S_ISFIFO(st.st_mode);
+        ar->dev     = st.st_dev;
+        ar->ino     = st.st_ino;
+        *error      = ARCHIVE_OK;
+        return 0;
+}
+
+/// Упаковывает найденный файл в архив под именем `<dir>/<name>`.
+///
+/// Раскладка внутри архива повторяет раскладку `ext → dir`: для каждого
+/// каталога назначения однажды пишется запись каталога. Исходный файл
+/// остаётся на месте. Заголовок строится по `fstat` открытого файла,
+/// тело передаётся ядром (`sendfile`/`splice`).
+///
+/// Если файл укоротился во время упаковки, тело дополняется нулями до
+/// объявленного размера (архив остаётся корректным) и возвращается
+/// `ARCHIVE_ERR_CHANGED`.
+///
+/// @param error  Код ошибки (`ARCHIVE_OK`, `ARCHIVE_ERR_BAD_ARG`,
+///               `ARCHIVE_ERR_CREATE_PATH`, `ARCHIVE_ERR_READ`,
+///               `ARCHIVE_ERR_WRITE`, `ARCHIVE_ERR_CHANGED`,
+///               `ARCHIVE_ERR_SELF`, `ARCHIVE_ERR_NAME_TOO_LONG` — путь
+///               не помещается и в заголовок pax, запись не начата).
+/// @param ar     Открытый архив.
+/// @param target Найденный файл.
+/// @return 0 при успехе, -1 при ошибке.
+int
+archive_add(int *error, struct archive *ar, const struct target *target)
+{
+        if (NULL == ar || NULL == target || NULL == target->cmd ||
+            NULL == target->cmd->dir)
+        {
+                *error = ARCHIVE_ERR_BAD_ARG;
+                return -1;
+        }
+        *error = ARCHIVE_OK;
+        if (target->dev == ar->dev && target->ino == ar->ino)
+        {
+                *error = ARCHIVE_ERR_SELF;
+                return -1;
+        }
+        // пути в архиве относительные: как и make_dir_recursive,
+        // ведущие и замыкающие '/' каталога отбрасываются
+        const char *dir = target->cmd->dir;
+        while ('/' == *dir)
+        {
+                ++dir;
+        }
+        size_t dir_len = strlen(dir);
+        while (0 < dir_len && '/' == dir[dir_len - 1])
+        {
+                --dir_len;
+        }
+        char *clean = strncopy(dir, dir_len);
+        char *path  = NULL == clean ? NULL
+                                    : concat(clean, 0 == dir_len ? "" : "/",
+                                             target->name, NULL);
+        if (NULL == path)
+        {
+                free(clean);
+                *error = ARCHIVE_ERR_CREATE_PATH;
+                return -1;
+        }
+        const int in = open(target_path(target), O_RDONLY | O_CLOEXEC);
+        struct stat st;
+        if (-1 == in || -1 == fstat(in, &st))
+        {
+                if (-1 != in)
+                {
+                        close(in);
+                }
+                free(clean);
+                free(path);
+                *error = ARCHIVE_ERR_READ;
+                return -1;
+        }
+        const struct tar_entry e = {
+            .path  = path,
+            .size  = (unsigned long long) st.st_size,
+            .mtime = st.st_mtime < 0 ? 0 : (unsigned long long) st.st_mtime,
+            .mode  = (unsigned int) st.st_mode,
+            .uid   = (unsigned int) st.st_uid,
+            .gid   = (unsigned int) st.st_gid,
+            .type  = TAR_TYPE_FILE,
+        };
+        off_t sent   = 0;
+        int   status = 0;
+        if ((0 != dir_len && -1 == add_dirs(ar, clean, &e)) ||
+            -1 == write_header(ar, &e) ||
+            -1 == send_body(ar, in, &sent, st.st_size))
+        {
+                *error = ENAMETOOLONG == errno ? ARCHIVE_ERR_NAME_TOO_LONG
+                                               : ARCHIVE_ERR_WRITE;
+                status = -1;
+        }
+        // укоротившийся файл дополняем нулями, чтобы не сломать поток
+        for (off_t left = st.st_size - sent; 0 == status && 0 < left;)
+        {
+                const size_t n = left < TAR_BLOCK ? (size_t) left : TAR_BLOCK;
+                if (-1 == write_all(ar, zero_block, n))
+                {
+                        *error = ARCHIVE_ERR_WRITE;
+                        status = -1;
+                        break;
+                }
+                left -= (off_t) n;
+                *error = ARCHIVE_ERR_CHANGED;
+        }
+        if (0 == status && -1 == write_padding(ar, e.size))
+        {
+                *error = ARCHIVE_ERR_WRITE;
+                status = -1;
+        }
+        close(in);
+        free(clean);
+        free(path);
+        return ARCHIVE_OK == *error ? status : -1;
+}
+
+/// Завершает архив двумя нулевыми блоками и закрывает файл.
+///
+/// @param error Код ошибки (`ARCHIVE_OK`, `ARCHIVE_ERR_BAD_ARG`,
+///              `ARCHIVE_ERR_WRITE`).
+/// @return 0 при успехе, -1 при ошибке.
+int
+archive_close(int *error, struct archive *ar)
+{
+        if (NULL == ar)
+        {
+                *error = ARCHIVE_ERR_BAD_ARG;
+                return -1;
+        }
+        *error = ARCHIVE_OK;
+        if (-1 == write_all(ar, zero_block, TAR_BLOCK) ||
+            -1 == write_all(ar, zero_block, TAR_BLOCK))
+        {
+                *error = ARCHIVE_ERR_WRITE;
+        }
+        if (ar->owns_fd && 0 != close(ar->fd))
+        {
+                *error = ARCHIVE_ERR_WRITE;
+        }
+        strset_free(&ar->dirs);
+        return ARCHIVE_OK == *error ? 0 : -1;
+}
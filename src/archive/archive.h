@@ -0,0 +1,41 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include "fs.h"
+#include "strset.h"
+
+#include <sys/types.h>
+
+enum archive_error
+{
+        ARCHIVE_OK,
+        ARCHIVE_ERR_BAD_ARG,
+        ARCHIVE_ERR_OPEN,
+        ARCHIVE_ERR_CREATE_PATH,
+        ARCHIVE_ERR_READ,
+        ARCHIVE_ERR_WRITE,
+        ARCHIVE_ERR_CHANGED,
+        ARCHIVE_ERR_SELF,
+        ARCHIVE_ERR_NAME_TOO_LONG,
+};
+
+/// Поток tar (ustar, при необходимости с расширенными заголовками pax).
+struct archive
+{
+        int                fd;
+        int                owns_fd; /// Закрыть `fd` в `archive_close`
+        int                is_pipe; /// Вывод — канал: тела файлов через `splice`
+        unsigned long long bytes;   /// Записано байт, включая заголовки
+        struct strset      dirs;    /// Каталоги, для которых уже есть запись
+        dev_t              dev;     /// Устройство и inode самого архива —
+        ino_t              ino;     /// чтобы не упаковать его в себя
+};
+
+int
+archive_open(int *error, struct archive *ar, const char *path);
+int
+archive_add(int *error, struct archive *ar, const struct target *target);
+int
+archive_close(int *error, struct archive *ar);
+
+#endif //ARCHIVE_H
@@ -0,0 +1,25 @@
+#include "test_archive.h"
+
+#include "unity.h"
+
+void
+setUp(void)
+{ /* инициализация, если нужна */
+}
+void
+tearDown(void)
+{ /* очистка, если нужна */
+}
+
+int
+main(void)
+{
+        UNITY_BEGIN();
+        RUN_TEST(test_archive_null_args);
+        RUN_TEST(test_archive_layout);
+        RUN_TEST(test_archive_long_path_pax);
+        RUN_TEST(test_archive_path_too_long);
+        RUN_TEST(test_archive_skips_self);
+        RUN_TEST(test_archive_pipe_splice);
+        return UNITY_END();
+}
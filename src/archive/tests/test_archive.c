@@ -0,0 +1,246 @@
+#include "test_archive.h"
+
+#include "archive.h"
+#include "clip.h"
+#include "unity.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+#define TMP_FILE    "tmp_archive_file.txt"
+#define TMP_ARCHIVE "tmp_archive.tar"
+#define BLOCK       512
+
+static void
+write_file(const char *name, const char *data)
+{
+        FILE *f = fopen(name, "wb");
+        TEST_ASSERT_NOT_NULL(f);
+        fputs(data, f);
+        fclose(f);
+}
+
+static void
+fill_target(struct target *t, char *name, struct command *cmd)
+{
+        struct stat st;
+        TEST_ASSERT_EQUAL_INT(0, stat(name, &st));
+        memset(t, 0, sizeof(*t));
+        t->name = name;
+        t->cmd  = cmd;
+        t->size = st.st_size;
+        t->dev  = st.st_dev;
+        t->ino  = st.st_ino;
+}
+
+/// Читает архив целиком; размер возвращается через `len`.
+static unsigned char *
+read_archive(const char *name, size_t *len)
+{
+        FILE *f = fopen(name, "rb");
+        TEST_ASSERT_NOT_NULL(f);
+        fseek(f, 0, SEEK_END);
+        *len = (size_t) ftell(f);
+        fseek(f, 0, SEEK_SET);
+        unsigned char *buf = malloc(*len);
+        TEST_ASSERT_NOT_NULL(buf);
+        TEST_ASSERT_EQUAL_UINT(*len, fread(buf, 1, *len, f));
+        fclose(f);
+        return buf;
+}
+
+/// Проверяет контрольную сумму заголовка, как это делает tar.
+static void
+assert_checksum(const unsigned char *hdr)
+{
+        unsigned int sum = 0;
+        for (size_t i = 0; i < BLOCK; ++i)
+        {
+                sum += (148 <= i && i < 156) ? ' ' : hdr[i];
+        }
+        TEST_ASSERT_EQUAL_UINT(sum, strtoul((const char *) hdr + 148, NULL, 8));
+}
+
+void
+test_archive_null_args(void)
+{
+        int            err = ARCHIVE_OK;
+        struct archive ar;
+        TEST_ASSERT_EQUAL_INT(-1, archive_open(&err, NULL, "-"));
+        TEST_ASSERT_EQUAL_INT(ARCHIVE_ERR_BAD_ARG, err);
+        TEST_ASSERT_EQUAL_INT(-1, archive_open(&err, &ar, NULL));
+        TEST_ASSERT_EQUAL_INT(-1, archive_add(&err, NULL, NULL));
+        TEST_ASSERT_EQUAL_INT(ARCHIVE_ERR_BAD_ARG, err);
+}
+
+void
+test_archive_layout(void)
+{
+        write_file(TMP_FILE, "hello tar");
+        struct command cmd = {.ext = "txt", .dir = "docs/text/"};
+        struct target  t;
+        fill_target(&t, TMP_FILE, &cmd);
+        int            err = ARCHIVE_OK;
+        struct archive ar;
+        TEST_ASSERT_EQUAL_INT(0, archive_open(&err, &ar, TMP_ARCHIVE));
+        TEST_ASSERT_EQUAL_INT(0, archive_add(&err, &ar, &t));
+        TEST_ASSERT_EQUAL_INT(0, archive_close(&err, &ar));
+
+        size_t         len = 0;
+        unsigned char *buf = read_archive(TMP_ARCHIVE, &len);
+        // docs/, docs/text/, заголовок файла, блок данных, два нулевых блока
+        TEST_ASSERT_EQUAL_UINT(6 * BLOCK, len);
+        TEST_ASSERT_EQUAL_STRING("docs/", (const char *) buf);
+        TEST_ASSERT_EQUAL_CHAR('5', buf[156]);
+        TEST_ASSERT_EQUAL_STRING("docs/text/", (const char *) buf + BLOCK);
+        const unsigned char *hdr = buf + 2 * BLOCK;
+        TEST_ASSERT_EQUAL_STRING("docs/text/" TMP_FILE, (const char *) hdr);
+        TEST_ASSERT_EQUAL_CHAR('0', hdr[156]);
+        TEST_ASSERT_EQUAL_MEMORY("ustar", hdr + 257, 6);
+        TEST_ASSERT_EQUAL_UINT(9, strtoul((const char *) hdr + 124, NULL, 8));
+        assert_checksum(buf);
+        assert_checksum(hdr);
+        TEST_ASSERT_EQUAL_MEMORY("hello tar", hdr + BLOCK, 9);
+        for (size_t i = 4 * BLOCK; i < len; ++i)
+        {
+                TEST_ASSERT_EQUAL_UINT8(0, buf[i]);
+        }
+        TEST_ASSERT_EQUAL_INT(0, access(TMP_FILE, F_OK));
+        free(buf);
+        remove(TMP_FILE);
+        remove(TMP_ARCHIVE);
+}
+
+void
+test_archive_long_path_pax(void)
+{
+        write_file(TMP_FILE, "x");
+        char dir[220];
+        memset(dir, 'd', sizeof(dir) - 1);
+        dir[sizeof(dir) - 1] = '\0';
+        struct command cmd   = {.ext = "txt", .dir = dir};
+        struct target  t;
+        fill_target(&t, TMP_FILE, &cmd);
+        int            err = ARCHIVE_OK;
+        struct archive ar;
+        TEST_ASSERT_EQUAL_INT(0, archive_open(&err, &ar, TMP_ARCHIVE));
+        TEST_ASSERT_EQUAL_INT(0, archive_add(&err, &ar, &t));
+        TEST_ASSERT_EQUAL_INT(0, archive_close(&err, &ar));
+
+        size_t         len = 0;
+        unsigned char *buf = read_archive(TMP_ARCHIVE, &len);
+        TEST_ASSERT_EQUAL_CHAR('x', buf[156]);
+        assert_checksum(buf);
+        const char *rec = (const char *) buf + BLOCK;
+        TEST_ASSERT_NOT_NULL(strstr(rec, " path=ddd"));
+        // длина записи pax учитывает собственные цифры
+        TEST_ASSERT_EQUAL_UINT(strchr(rec, '\n') - rec + 1,
+                               strtoul(rec, NULL, 10));
+        free(buf);
+        remove(TMP_FILE);
+        remove(TMP_ARCHIVE);
+}
+
+void
+test_archive_path_too_long(void)
+{
+        char name[105];
+        memset(name, 'n', 100);
+        memcpy(name + 100, ".txt", 5);
+        write_file(name, "x");
+        write_file(TMP_FILE, "x");
+        char *dir = malloc(PATH_MAX + 1);
+        TEST_ASSERT_NOT_NULL(dir);
+        memset(dir, 'd', PATH_MAX);
+        dir[PATH_MAX]       = '\0';
+        struct command cmd  = {.ext = "txt", .dir = dir};
+        struct command next = {.ext = "txt", .dir = "out"};
+        struct target  t;
+        struct target  u;
+        fill_target(&t, name, &cmd);
+        fill_target(&u, TMP_FILE, &next);
+        int            err = ARCHIVE_OK;
+        struct archive ar;
+        TEST_ASSERT_EQUAL_INT(0, archive_open(&err, &ar, TMP_ARCHIVE));
+        // каталог длиннее PATH_MAX
+        TEST_ASSERT_EQUAL_INT(-1, archive_add(&err, &ar, &t));
+        TEST_ASSERT_EQUAL_INT(ARCHIVE_ERR_NAME_TOO_LONG, err);
+        // запись pax каталога ещё помещается в буфер, запись файла — нет
+        dir[PATH_MAX - 8] = '\0';
+        TEST_ASSERT_EQUAL_INT(-1, archive_add(&err, &ar, &t));
+        TEST_ASSERT_EQUAL_INT(ARCHIVE_ERR_NAME_TOO_LONG, err);
+        // отказ не оставил в потоке недописанной записи
+        TEST_ASSERT_EQUAL_UINT(0, ar.bytes % BLOCK);
+        TEST_ASSERT_EQUAL_INT(0, archive_add(&err, &ar, &u));
+        TEST_ASSERT_EQUAL_INT(0, archive_close(&err, &ar));
+
+        size_t         len = 0;
+        unsigned char *buf = read_archive(TMP_ARCHIVE, &len);
+        TEST_ASSERT_EQUAL_UINT(0, len % BLOCK);
+        int found = 0;
+        for (size_t i = 0; i < len; i += BLOCK)
+        {
+                found |= 0 == strcmp("out/" TMP_FILE, (const char *) buf + i);
+        }
+        TEST_ASSERT_TRUE(found);
+        free(buf);
+        free(dir);
+        remove(name);
+        remove(TMP_FILE);
+        remove(TMP_ARCHIVE);
+}
+
+void
+test_archive_skips_self(void)
+{
+        int            err = ARCHIVE_OK;
+        struct archive ar;
+        TEST_ASSERT_EQUAL_INT(0, archive_open(&err, &ar, TMP_ARCHIVE));
+        struct command cmd = {.ext = "tar", .dir = "out"};
+        struct target  t;
+        fill_target(&t, TMP_ARCHIVE, &cmd);
+        TEST_ASSERT_EQUAL_INT(-1, archive_add(&err, &ar, &t));
+        TEST_ASSERT_EQUAL_INT(ARCHIVE_ERR_SELF, err);
+        TEST_ASSERT_EQUAL_INT(0, archive_close(&err, &ar));
+        remove(TMP_ARCHIVE);
+}
+
+void
+test_archive_pipe_splice(void)
+{
+        write_file(TMP_FILE, "through a pipe");
+        int fds[2];
+        TEST_ASSERT_EQUAL_INT(0, pipe(fds));
+        char path[64];
+        snprintf(path, sizeof(path), "/proc/self/fd/%d", fds[1]);
+        struct command cmd = {.ext = "txt", .dir = "p"};
+        struct target  t;
+        fill_target(&t, TMP_FILE, &cmd);
+        int            err = ARCHIVE_OK;
+        struct archive ar;
+        TEST_ASSERT_EQUAL_INT(0, archive_open(&err, &ar, path));
+        TEST_ASSERT_EQUAL_INT(1, ar.is_pipe);
+        TEST_ASSERT_EQUAL_INT(0, archive_add(&err, &ar, &t));
+        TEST_ASSERT_EQUAL_INT(0, archive_close(&err, &ar));
+        close(fds[1]);
+        unsigned char buf[5 * BLOCK];
+        size_t        got = 0;
+        ssize_t       n   = 0;
+        while (0 < (n = read(fds[0], buf + got, sizeof(buf) - got)))
+        {
+                got += (size_t) n;
+        }
+        close(fds[0]);
+        TEST_ASSERT_EQUAL_UINT(5 * BLOCK, got);
+        TEST_ASSERT_EQUAL_STRING("p/" TMP_FILE, (const char *) buf + BLOCK);
+        TEST_ASSERT_EQUAL_MEMORY("through a pipe", buf + 2 * BLOCK, 14);
+        remove(TMP_FILE);
+}
@@ -0,0 +1,17 @@
+#ifndef TEST_ARCHIVE_H
+#define TEST_ARCHIVE_H
+
+void
+test_archive_null_args(void);
+void
+test_archive_layout(void);
+void
+test_archive_long_path_pax(void);
+void
+test_archive_path_too_long(void);
+void
+test_archive_skips_self(void);
+void
+test_archive_pipe_splice(void);
+
+#endif //TEST_ARCHIVE_H
@@ -12,12 +12,224 @@
 #include <stdlib.h>
 #include <string.h>
 
+/// Коды длинных опций без короткого аналога.
+enum clip_long_opt
+{
+        OPT_DRY_RUN = 256,
+        OPT_DEDUPE,
+        OPT_THREADS,
+        OPT_LINK,
+        OPT_COPY,
+        OPT_ARCHIVE,
+        OPT_QUIET,
+        OPT_FORMAT,
+        OPT_STATS,
+        OPT_PROFILE,
+        OPT_TRACE,
+        OPT_METRICS,
+        OPT_METRICS_INTERVAL,
+        OPT_PROGRESS,
+        OPT_WATCH,
+        OPT_SETTLE,
+        OPT_BATCH_WINDOW,
+        OPT_BATCH_SIZE,
+        OPT_SOCKET,
+        OPT_DIR_CACHE,
+        OPT_CLAIM,
+        OPT_SHARD,
+};
+
+/// Верхняя граница `--threads`.
+#define CLIP_MAX_THREADS 1024
+/// Верхняя граница интервалов в секундах (`--metrics-interval`, `--settle`).
+#define CLIP_MAX_SECONDS 86400
+/// Верхние границы `--batch-window` (мс) и `--batch-size`.
+#define CLIP_MAX_BATCH_WINDOW 60000
+#define CLIP_MAX_BATCH_SIZE   (1024 * 1024)
+/// Верхняя граница числа долей `--shard`.
+#define CLIP_MAX_SHARDS 65536
+
+static const struct option long_options[] = {
+    {"dry-run", no_argument, NULL, OPT_DRY_RUN},
+    {"dedupe", required_argument, NULL, OPT_DEDUPE},
+    {"threads", required_argument, NULL, OPT_THREADS},
+    {"link", required_argument, NULL, OPT_LINK},
+    {"copy", no_argument, NULL, OPT_COPY},
+    {"archive", required_argument, NULL, OPT_ARCHIVE},
+    {"quiet", no_argument, NULL, OPT_QUIET},
+    {"format", required_argument, NULL, OPT_FORMAT},
+    {"stats", no_argument, NULL, OPT_STATS},
+    {"profile", no_argument, NULL, OPT_PROFILE},
+    {"trace", required_argument, NULL, OPT_TRACE},
+    {"metrics", required_argument, NULL, OPT_METRICS},
+    {"metrics-interval", required_argument, NULL, OPT_METRICS_INTERVAL},
+    {"progress", no_argument, NULL, OPT_PROGRESS},
+    {"watch", optional_argument, NULL, OPT_WATCH},
+    {"settle", required_argument, NULL, OPT_SETTLE},
+    {"batch-window", required_argument, NULL, OPT_BATCH_WINDOW},
+    {"batch-size", required_argument, NULL, OPT_BATCH_SIZE},
+    {"socket", required_argument, NULL, OPT_SOCKET},
+    {"dir-cache", required_argument, NULL, OPT_DIR_CACHE},
+    {"claim", no_argument, NULL, OPT_CLAIM},
+    {"shard", required_argument, NULL, OPT_SHARD},
+    {"help", no_argument, NULL, 'h'},
+    {NULL, 0, NULL, 0},
+};
+
+/// Параметры последнего разбора командной строки.
+static struct clip_options options;
+
+/// Разбирает значение `--dedupe=skip|link`.
+/// @return Значение `enum clip_dedupe` или -1, если значение неизвестно.
+static int
+parse_dedupe(const char *arg)
+{
+        if (0 == strcmp(arg, "skip"))
+        {
+                return CLIP_DEDUPE_SKIP;
+        }
+        if (0 == strcmp(arg, "link"))
+        {
+                return CLIP_DEDUPE_LINK;
+        }
+        return -1;
+}
+
+/// Разбирает значение `--format=text|ndjson|bin`.
+/// @return Значение `enum clip_format` или -1, если значение неизвестно.
+static int
+parse_format(const char *arg)
+{
+        if (0 == strcmp(arg, "text"))
+        {
+                return CLIP_FORMAT_TEXT;
+        }
+        if (0 == strcmp(arg, "ndjson"))
+        {
+                return CLIP_FORMAT_NDJSON;
+        }
+        if (0 == strcmp(arg, "bin"))
+        {
+                return CLIP_FORMAT_BIN;
+        }
+        return -1;
+}
+
+/// Разбирает значение `--watch[=inotify|fanotify]`; без значения — inotify.
+/// @return Значение `enum clip_watch` или -1, если значение неизвестно.
+static int
+parse_watch(const char *arg)
+{
+        if (NULL == arg || 0 == strcmp(arg, "inotify"))
+        {
+                return CLIP_WATCH_INOTIFY;
+        }
+        if (0 == strcmp(arg, "fanotify"))
+        {
+                return CLIP_WATCH_FANOTIFY;
+        }
+        return -1;
+}
+
+/// Разбирает значение `--link=hard|sym`.
+/// @return Значение `enum clip_link` или -1, если значение неизвестно.
+static int
+parse_link(const char *arg)
+{
+        if (0 == strcmp(arg, "hard"))
+        {
+                return CLIP_LINK_HARD;
+        }
+        if (0 == strcmp(arg, "sym"))
+        {
+                return CLIP_LINK_SYM;
+        }
+        return -1;
+}
+
+/// Разбирает положительное целое не больше `max`.
+/// @return 0 при успехе, -1 если строка не число или вне диапазона.
+static int
+parse_count(const char *arg, const size_t max, size_t *out)
+{
+        char                   *end   = NULL;
+        const unsigned long long value = strtoull(arg, &end, 10);
+        if ('\0' == *arg || '\0' != *end || !isdigit((unsigned char) *arg) ||
+            0 == value || value > max)
+        {
+                return -1;
+        }
+        *out = (size_t) value;
+        return 0;
+}
+
+/// Разбирает `i/N` для `--shard`: 1 <= i <= N <= `CLIP_MAX_SHARDS`.
+/// @return 0 при успехе, -1 при неверной записи.
+static int
+parse_shard(const char *arg, size_t *index, size_t *count)
+{
+        const char *slash = strchr(arg, '/');
+        char        head[16];
+        if (NULL == slash || (size_t) (slash - arg) >= sizeof(head))
+        {
+                return -1;
+        }
+        memcpy(head, arg, (size_t) (slash - arg));
+        head[slash - arg] = '\0';
+        if (-1 == parse_count(head, CLIP_MAX_SHARDS, index) ||
+            -1 == parse_count(slash + 1, CLIP_MAX_SHARDS, count) ||
+            *index > *count)
+        {
+                return -1;
+        }
+        return 0;
+}
+
 /// Разбирает аргументы командной строки и возвращает массив структур `command`.
 ///
 /// Поддерживает флаги:
 ///   - `-e <ext>` — расширение файла (валидируется через `arge`)
 ///   - `-d <dir>` — директория назначения (валидируется через `argd`)
 ///   - `-m <map>` — маппинг `ext=dir;...` (обрабатывается через `argm`)
+///   - `--dry-run` — только сканирование и оценка, без изменений на диске
+///   - `--dedupe=skip|link` — обработка файлов с одинаковым содержимым
+///   - `--threads=N` — число рабочих потоков (1..`CLIP_MAX_THREADS`)
+///   - `--link=hard|sym` — раскладка ссылками, оригиналы остаются на месте
+///   - `--copy` — копирование (reflink, где возможно), оригиналы на месте
+///   - `--archive=<file|->` — запись в tar-поток, оригиналы на месте
+///   - `--quiet` — не выводить строки об успешно обработанных файлах
+///   - `--format=text|ndjson|bin` — формат отчёта о файлах
+///   - `--stats` — время по фазам и счётчики вызовов в конце прогона
+///   - `--profile` — аппаратные счётчики `perf_event_open` по фазам
+///   - `--trace=<file>` — трасса в формате Chrome trace event (Perfetto)
+///   - `--metrics=<file>` — счётчики для textfile collector Prometheus
+///   - `--metrics-interval=N` — период записи метрик, секунды
+///     (1..`CLIP_MAX_SECONDS`)
+///   - `--progress` — строка прогресса, если stdout и stderr — терминалы
+///   - `--watch[=inotify|fanotify]` — после прогона обрабатывать новые
+///     файлы по событиям inotify или fanotify (несовместим с `--dry-run`)
+///   - `--settle=N` — пропускать файлы, открытые на запись; где аренда
+///     недоступна — изменённые менее N секунд назад
+///     (1..`CLIP_MAX_SECONDS`)
+///   - `--batch-window=MS` — сколько `--watch` ждёт догоняющих событий
+///     после первого (1..`CLIP_MAX_BATCH_WINDOW`)
+///   - `--batch-size=N` — предел имён в пачке `--watch`
+///     (1..`CLIP_MAX_BATCH_SIZE`)
+///   - `--dir-cache=<file>` — не читать каталог, если он не менялся с
+///     прогона, после которого в нём не осталось файлов для правил
+///     (несовместим с `--watch`, `--dry-run` и `daemon`)
+///   - `--claim` — захватывать файлы переименованием перед раскладкой,
+///     чтобы несколько экземпляров делили один каталог (только
+///     перемещение: несовместим с `--link`, `--copy`, `--archive`,
+///     `--dry-run` и `daemon`)
+///   - `--shard=i/N` — обрабатывать только i-ю из N долей имён каталога
+///     (1 <= i <= N <= `CLIP_MAX_SHARDS`)
+///   - `daemon --socket=<path>` — режим `tn daemon`: задания приходят
+///     через Unix-сокет; `-e`/`-d`/`-m` необязательны и задают правила
+///     по умолчанию (несовместим с `--watch`, `--dry-run`, `--progress`,
+///     `--archive` и `--format`)
+///
+/// Глобальные параметры сохраняются и доступны через `clip_get_options`.
 ///
 /// Варианты:
 ///   - Если указан `-m`, возвращает массив из `argm`
@@ -40,10 +252,13 @@ clip(int *error, const int argc, char **argv)
         optopt          = 0;
         optind          = 1;
         *error          = CLIP_OK;
-        char *extension = NULL;
-        char *directory = NULL;
-        int   opt       = 0;
-        while (-1 != (opt = getopt(argc, argv, "e:d:m:h")))
+        char                  *extension = NULL;
+        char                  *directory = NULL;
+        const struct command **mapping   = NULL;
+        int                    opt       = 0;
+        memset(&options, 0, sizeof(options));
+        while (-1 != (opt = getopt_long(argc, argv, "e:d:m:h", long_options,
+                                        NULL)))
         {
                 switch (opt)
                 {
@@ -67,14 +282,142 @@ clip(int *error, const int argc, char **argv)
                 {
                         int                    e = ARGM_OK;
                         const struct command **c = argm(&e, optarg);
-                        if (NULL == c || NULL == *c)
+                        if (NULL != mapping || NULL == c || NULL == *c)
                         {
                                 *error = e == ARGM_MEM_ERR ? CLIP_PANIC
                                                            : CLIP_ERR_BAD_M_OPT;
                                 return NULL;
                         }
-                        return c;
+                        mapping = c;
+                        break;
                 }
+                case OPT_DRY_RUN:
+                        options.dry_run = 1;
+                        break;
+                case OPT_DEDUPE:
+                        if (-1 == (options.dedupe = parse_dedupe(optarg)))
+                        {
+                                *error = CLIP_ERR_BAD_VALUE;
+                                return NULL;
+                        }
+                        break;
+                case OPT_LINK:
+                        if (-1 == (options.link = parse_link(optarg)))
+                        {
+                                *error = CLIP_ERR_BAD_VALUE;
+                                return NULL;
+                        }
+                        break;
+                case OPT_COPY:
+                        options.copy = 1;
+                        break;
+                case OPT_ARCHIVE:
+                        if (NULL != options.archive || '\0' == *optarg)
+                        {
+                                *error = CLIP_ERR_BAD_VALUE;
+                                return NULL;
+                        }
+                        options.archive = optarg;
+                        break;
+                case OPT_QUIET:
+                        options.quiet = 1;
+                        break;
+                case OPT_FORMAT:
+                        if (-1 == (options.format = parse_format(optarg)))
+                        {
+                                *error = CLIP_ERR_BAD_VALUE;
+                                return NULL;
+                        }
+                        break;
+                case OPT_STATS:
+                        options.stats = 1;
+                        break;
+                case OPT_PROFILE:
+                        options.profile = 1;
+                        break;
+                case OPT_TRACE:
+                        if (NULL != options.trace || '\0' == *optarg)
+                        {
+                                *error = CLIP_ERR_BAD_VALUE;
+                                return NULL;
+                        }
+                        options.trace = optarg;
+                        break;
+                case OPT_METRICS:
+                        if (NULL != options.metrics || '\0' == *optarg)
+                        {
+                                *error = CLIP_ERR_BAD_VALUE;
+                                return NULL;
+                        }
+                        options.metrics = optarg;
+                        break;
+                case OPT_PROGRESS:
+                        options.progress = 1;
+                        break;
+                case OPT_WATCH:
+                        if (-1 == (options.watch = parse_watch(optarg)))
+                        {
+                                *error = CLIP_ERR_BAD_VALUE;
+                                return NULL;
+                        }
+                        break;
+                case OPT_SOCKET:
+                        options.socket = optarg;
+                        break;
+                case OPT_DIR_CACHE:
+                        options.dir_cache = optarg;
+                        break;
+                case OPT_CLAIM:
+                        options.claim = 1;
+                        break;
+                case OPT_SHARD:
+                        if (-1 == parse_shard(optarg, &options.shard,
+                                              &options.shards))
+                        {
+                                *error = CLIP_ERR_BAD_VALUE;
+                                return NULL;
+                        }
+                        break;
+                case OPT_BATCH_WINDOW:
+                        if (-1 == parse_count(optarg, CLIP_MAX_BATCH_WINDOW,
+                                              &options.batch_window))
+                        {
+                                *error = CLIP_ERR_BAD_VALUE;
+                                return NULL;
+                        }
+                        break;
+                case OPT_BATCH_SIZE:
+                        if (-1 == parse_count(optarg, CLIP_MAX_BATCH_SIZE,
+                                              &options.batch_size))
+                        {
+                                *error = CLIP_ERR_BAD_VALUE;
+                                return NULL;
+                        }
+                        break;
+                case OPT_SETTLE:
+                        if (-1 == parse_count(optarg, CLIP_MAX_SECONDS,
+                                              &options.settle))
+                        {
+                                *error = CLIP_ERR_BAD_VALUE;
+                                return NULL;
+                        }
+                        break;
+                case OPT_METRICS_INTERVAL:
+                        if (-1 == parse_count(optarg, CLIP_MAX_SECONDS,
+                                              &options.metrics_interval))
+                        {
+                                *error = CLIP_ERR_BAD_VALUE;
+                                return NULL;
+                        }
+                        break;
+                case OPT_THREADS:
+                        if (-1 == parse_count(optarg, CLIP_MAX_THREADS,
+                                              &options.threads))
+                        {
+                                *error = CLIP_ERR_BAD_VALUE;
+                                return NULL;
+                        }
+                        break;
                 case 'h':
                         *error = CLIP_USAGE_OPT;
                         return NULL;
@@ -83,6 +426,48 @@ clip(int *error, const int argc, char **argv)
                         return NULL;
                 }
         }
+        for (int i = optind; i < argc; ++i)
+        {
+                if (0 != strcmp(argv[i], "daemon") || options.daemon)
+                {
+                        *error = CLIP_UNEXPECTED_OPT;
+                        return NULL;
+                }
+                options.daemon = 1;
+        }
+        // демон отвечает клиентам через сокет, а не через stdout
+        if (options.daemon != (NULL != options.socket) ||
+            (options.daemon &&
+             (options.watch || options.dry_run || options.progress ||
+              NULL != options.archive || CLIP_FORMAT_TEXT != options.format)))
+        {
+                *error = CLIP_ERR_BAD_VALUE;
+                return NULL;
+        }
+        // удаление исходного дубликата противоречит режимам, где
+        // оригиналы должны остаться на месте; ссылки, копия и архив
+        // взаимоисключаются
+        const int outputs = (CLIP_LINK_OFF != options.link) + options.copy +
+                            (NULL != options.archive);
+        // поток записей и tar-поток не могут оба занимать stdout
+        const int archive_stdout =
+            NULL != options.archive && 0 == strcmp(options.archive, "-");
+        const int records_stdout = CLIP_FORMAT_TEXT != options.format;
+        if ((CLIP_DEDUPE_LINK == options.dedupe && 0 < outputs) ||
+            1 < outputs || (records_stdout && archive_stdout) ||
+            (options.watch && options.dry_run) ||
+            (NULL != options.dir_cache &&
+             (options.watch || options.dry_run || options.daemon)) ||
+            (options.claim &&
+             (0 < outputs || options.dry_run || options.daemon)))
+        {
+                *error = CLIP_ERR_BAD_VALUE;
+                return NULL;
+        }
+        if (NULL != mapping)
+        {
+                return mapping;
+        }
         if (NULL != extension && NULL != directory)
         {
                 struct command *cmd = malloc(sizeof(struct command));
@@ -117,10 +502,41 @@ clip(int *error, const int argc, char **argv)
                 }
                 return NULL;
         }
+        if (options.daemon)
+        {
+                // правила придут с заданиями
+                const struct command **none = calloc(1, sizeof(*none));
+                if (NULL == none)
+                {
+                        *error = CLIP_PANIC;
+                }
+                return none;
+        }
         *error = CLIP_UNEXPECTED_OPT;
         return NULL;
 }
 
+/// Разбирает карту `ext=dir;...` так же, как `-m`.
+///
+/// Нужна `tn daemon`, где карта приходит с каждым заданием.
+/// \param[out] error `CLIP_ERR_BAD_M_OPT` при неверной карте,
+///                   `CLIP_PANIC` при нехватке памяти
+/// \return Массив правил, завершённый NULL, либо NULL при ошибке
+const struct command **
+clip_parse_map(int *error, const char *map)
+{
+        int                    e    = ARGM_OK;
+        const struct command **cmds = argm(&e, map);
+        *error                      = CLIP_OK;
+        if (NULL == cmds || NULL == *cmds)
+        {
+                *error = ARGM_MEM_ERR == e ? CLIP_PANIC : CLIP_ERR_BAD_M_OPT;
+                free((void *) cmds);
+                return NULL;
+        }
+        return cmds;
+}
+
 /// Копирует структуру `command`.
 ///
 /// Выделяет новую структуру и копирует поля `ext` и `dir`.
@@ -154,3 +570,13 @@ copy_command(int *error, const struct command *cmd)
         }
         return copy;
 }
+
+/// Возвращает глобальные параметры, разобранные последним вызовом `clip`.
+///
+/// \return Указатель на статическую структуру; до первого вызова `clip`
+///         все поля нулевые.
+const struct clip_options *
+clip_get_options(void)
+{
+        return &options;
+}
@@ -1,12 +1,79 @@
 #ifndef CLI_H
 #define CLI_H
 
+#include <stddef.h>
+
 struct command
 {
         const char *ext;
         const char *dir;
 };
 
+/// Что делать с файлами, содержимое которых совпадает с уже найденными.
+enum clip_dedupe
+{
+        CLIP_DEDUPE_OFF,
+        CLIP_DEDUPE_SKIP, /// Оставить дубликат на месте
+        CLIP_DEDUPE_LINK, /// Жёсткая ссылка на перемещённый оригинал
+};
+
+/// Раскладка ссылками вместо перемещения (`--link`).
+enum clip_link
+{
+        CLIP_LINK_OFF,
+        CLIP_LINK_HARD,
+        CLIP_LINK_SYM,
+};
+
+/// Формат отчёта о файлах (`--format`).
+enum clip_format
+{
+        CLIP_FORMAT_TEXT,
+        CLIP_FORMAT_NDJSON,
+        CLIP_FORMAT_BIN,
+};
+
+/// Источник событий `--watch`.
+enum clip_watch
+{
+        CLIP_WATCH_OFF,
+        CLIP_WATCH_INOTIFY,
+        CLIP_WATCH_FANOTIFY, /// При нехватке прав — inotify
+};
+
+/// Глобальные параметры запуска, не привязанные к конкретному правилу.
+struct clip_options
+{
+        int         dry_run;
+        int         dedupe;  /// Значение из `enum clip_dedupe`
+        size_t      threads; /// 0 — по числу процессоров
+        int         link;    /// Значение из `enum clip_link`
+        int         copy;    /// Копировать вместо перемещения
+        const char *archive; /// Путь tar-архива (`-` — stdout) или NULL
+        int         quiet;   /// Не выводить строки об успешных файлах
+        int         format;  /// Значение из `enum clip_format`
+        int         stats;   /// Печатать время фаз и счётчики в конце
+        int         profile; /// Печатать счётчики perf по фазам в конце
+        const char *trace;   /// Путь файла трассы Chrome trace event или NULL
+        const char *metrics; /// Путь textfile-файла Prometheus или NULL
+        size_t      metrics_interval; /// Период записи метрик, с; 0 — по
+                                      /// умолчанию
+        int         progress; /// Строка прогресса, если вывод — терминал
+        int         watch;    /// Значение из `enum clip_watch`
+        size_t      settle;   /// Пропускать недописанные файлы; период
+                              /// тишины по `mtime`, с; 0 — не проверять
+        size_t      batch_window; /// Окно сбора пачки `--watch`, мс;
+                                  /// 0 — по умолчанию
+        size_t      batch_size;   /// Предел пачки `--watch`; 0 — по
+                                  /// умолчанию
+        int         daemon;   /// Режим `tn daemon`
+        const char *socket;   /// Сокет `--socket` для `tn daemon`
+        const char *dir_cache; /// Файл штампов каталогов `--dir-cache`
+        int         claim;     /// Захватывать файлы перед раскладкой
+        size_t      shard;     /// Доля `--shard`, с единицы
+        size_t      shards;    /// Число долей; 0 — весь каталог
+};
+
 enum clip_error
 {
         CLIP_OK,
@@ -16,12 +83,17 @@ enum clip_error
         CLIP_ERR_BAD_M_OPT,
         CLIP_PANIC,
         CLIP_UNEXPECTED_OPT,
-        CLIP_USAGE_OPT
+        CLIP_USAGE_OPT,
+        CLIP_ERR_BAD_VALUE,
 };
 
 const struct command **
 clip(int *error, int argc, char **argv);
+const struct command **
+clip_parse_map(int *error, const char *map);
 struct command *
 copy_command(int *error, const struct command *);
+const struct clip_options *
+clip_get_options(void);
 
 #endif //CLI_H
@@ -72,6 +72,25 @@ main(void)
         RUN_TEST(test_copy_command_null_ext);
         RUN_TEST(test_copy_command_null_dir);
         RUN_TEST(test_copy_command_valid);
+        RUN_TEST(test_clip_dry_run_option);
+        RUN_TEST(test_clip_dedupe_option);
+        RUN_TEST(test_clip_link_option);
+        RUN_TEST(test_clip_copy_option);
+        RUN_TEST(test_clip_archive_option);
+        RUN_TEST(test_clip_quiet_option);
+        RUN_TEST(test_clip_format_option);
+        RUN_TEST(test_clip_stats_option);
+        RUN_TEST(test_clip_profile_option);
+        RUN_TEST(test_clip_trace_option);
+        RUN_TEST(test_clip_metrics_option);
+        RUN_TEST(test_clip_progress_option);
+        RUN_TEST(test_clip_watch_option);
+        RUN_TEST(test_clip_settle_option);
+        RUN_TEST(test_clip_batch_options);
+        RUN_TEST(test_clip_daemon_mode);
+        RUN_TEST(test_clip_dir_cache_option);
+        RUN_TEST(test_clip_claim_option);
+        RUN_TEST(test_clip_shard_option);
 
         return UNITY_END();
 }
@@ -136,3 +136,312 @@ test_copy_command_valid(void)
         free((void *) copy->dir);
         free(copy);
 }
+
+void
+test_clip_dry_run_option(void)
+{
+        char *argv[] = {"app", "-m", "jpg=images", "--dry-run"};
+        int   error  = 0;
+        const struct command **cmds = clip(&error, 4, argv);
+        TEST_ASSERT_NOT_NULL(cmds);
+        TEST_ASSERT_EQUAL_INT(CLIP_OK, error);
+        TEST_ASSERT_EQUAL_INT(1, clip_get_options()->dry_run);
+
+        char *argv2[] = {"app", "-e", "txt", "-d", "docs"};
+        cmds          = clip(&error, 5, argv2);
+        TEST_ASSERT_NOT_NULL(cmds);
+        TEST_ASSERT_EQUAL_INT(0, clip_get_options()->dry_run);
+}
+
+void
+test_clip_dedupe_option(void)
+{
+        char *argv[] = {"app", "-e", "jpg", "-d", "img", "--dedupe=link",
+                        "--threads=4"};
+        int   error  = 0;
+        const struct command **cmds = clip(&error, 7, argv);
+        TEST_ASSERT_NOT_NULL(cmds);
+        TEST_ASSERT_EQUAL_INT(CLIP_DEDUPE_LINK, clip_get_options()->dedupe);
+        TEST_ASSERT_EQUAL_UINT(4, clip_get_options()->threads);
+
+        char *bad[] = {"app", "-e", "jpg", "-d", "img", "--dedupe=maybe"};
+        TEST_ASSERT_NULL(clip(&error, 6, bad));
+        TEST_ASSERT_EQUAL_INT(CLIP_ERR_BAD_VALUE, error);
+
+        char *zero[] = {"app", "-e", "jpg", "-d", "img", "--threads=0"};
+        TEST_ASSERT_NULL(clip(&error, 6, zero));
+        TEST_ASSERT_EQUAL_INT(CLIP_ERR_BAD_VALUE, error);
+}
+
+void
+test_clip_link_option(void)
+{
+        char *argv[] = {"app", "-e", "jpg", "-d", "img", "--link=sym"};
+        int   error  = 0;
+        TEST_ASSERT_NOT_NULL(clip(&error, 6, argv));
+        TEST_ASSERT_EQUAL_INT(CLIP_LINK_SYM, clip_get_options()->link);
+
+        char *bad[] = {"app", "-e", "jpg", "-d", "img", "--link=soft"};
+        TEST_ASSERT_NULL(clip(&error, 6, bad));
+        TEST_ASSERT_EQUAL_INT(CLIP_ERR_BAD_VALUE, error);
+
+        char *mixed[] = {"app", "-e", "jpg", "-d", "img", "--link=hard",
+                         "--dedupe=link"};
+        TEST_ASSERT_NULL(clip(&error, 7, mixed));
+        TEST_ASSERT_EQUAL_INT(CLIP_ERR_BAD_VALUE, error);
+}
+
+void
+test_clip_copy_option(void)
+{
+        char *argv[] = {"app", "-e", "jpg", "-d", "img", "--copy"};
+        int   error  = 0;
+        TEST_ASSERT_NOT_NULL(clip(&error, 6, argv));
+        TEST_ASSERT_EQUAL_INT(1, clip_get_options()->copy);
+
+        char *mixed[] = {"app", "-e", "jpg", "-d", "img", "--copy",
+                         "--link=sym"};
+        TEST_ASSERT_NULL(clip(&error, 7, mixed));
+        TEST_ASSERT_EQUAL_INT(CLIP_ERR_BAD_VALUE, error);
+}
+
+void
+test_clip_archive_option(void)
+{
+        char *argv[] = {"app", "-e", "jpg", "-d", "img", "--archive=out.tar"};
+        int   error  = 0;
+        TEST_ASSERT_NOT_NULL(clip(&error, 6, argv));
+        TEST_ASSERT_EQUAL_STRING("out.tar", clip_get_options()->archive);
+
+        char *mixed[] = {"app", "-e", "jpg", "-d", "img", "--archive=-",
+                         "--copy"};
+        TEST_ASSERT_NULL(clip(&error, 7, mixed));
+        TEST_ASSERT_EQUAL_INT(CLIP_ERR_BAD_VALUE, error);
+
+        char *dedupe[] = {"app", "-e", "jpg", "-d", "img", "--archive=-",
+                          "--dedupe=link"};
+        TEST_ASSERT_NULL(clip(&error, 7, dedupe));
+        TEST_ASSERT_EQUAL_INT(CLIP_ERR_BAD_VALUE, error);
+}
+
+void
+test_clip_quiet_option(void)
+{
+        char *argv[] = {"app", "-e", "jpg", "-d", "img", "--quiet"};
+        int   error  = 0;
+        TEST_ASSERT_NOT_NULL(clip(&error, 6, argv));
+        TEST_ASSERT_EQUAL_INT(1, clip_get_options()->quiet);
+
+        char *plain[] = {"app", "-e", "jpg", "-d", "img"};
+        TEST_ASSERT_NOT_NULL(clip(&error, 5, plain));
+        TEST_ASSERT_EQUAL_INT(0, clip_get_options()->quiet);
+}
+
+void
+test_clip_format_option(void)
+{
+        char *argv[] = {"app", "-e", "jpg", "-d", "img", "--format=ndjson"};
+        int   error  = 0;
+        TEST_ASSERT_NOT_NULL(clip(&error, 6, argv));
+        TEST_ASSERT_EQUAL_INT(CLIP_FORMAT_NDJSON, clip_get_options()->format);
+
+        char *bad[] = {"app", "-e", "jpg", "-d", "img", "--format=xml"};
+        TEST_ASSERT_NULL(clip(&error, 6, bad));
+        TEST_ASSERT_EQUAL_INT(CLIP_ERR_BAD_VALUE, error);
+
+        char *tar[] = {"app", "-e", "jpg", "-d", "img", "--format=bin",
+                       "--archive=-"};
+        TEST_ASSERT_NULL(clip(&error, 7, tar));
+        TEST_ASSERT_EQUAL_INT(CLIP_ERR_BAD_VALUE, error);
+}
+
+void
+test_clip_stats_option(void)
+{
+        char *argv[] = {"app", "-e", "jpg", "-d", "img", "--stats"};
+        int   error  = 0;
+        TEST_ASSERT_NOT_NULL(clip(&error, 6, argv));
+        TEST_ASSERT_EQUAL_INT(1, clip_get_options()->stats);
+}
+
+void
+test_clip_profile_option(void)
+{
+        char *argv[] = {"app", "-e", "jpg", "-d", "img", "--profile"};
+        int   error  = 0;
+        TEST_ASSERT_NOT_NULL(clip(&error, 6, argv));
+        TEST_ASSERT_EQUAL_INT(1, clip_get_options()->profile);
+}
+
+void
+test_clip_trace_option(void)
+{
+        char *argv[] = {"app", "-e", "jpg", "-d", "img", "--trace=t.json"};
+        int   error  = 0;
+        TEST_ASSERT_NOT_NULL(clip(&error, 6, argv));
+        TEST_ASSERT_EQUAL_STRING("t.json", clip_get_options()->trace);
+
+        char *empty[] = {"app", "-e", "jpg", "-d", "img", "--trace="};
+        error         = 0;
+        TEST_ASSERT_NULL(clip(&error, 6, empty));
+        TEST_ASSERT_EQUAL_INT(CLIP_ERR_BAD_VALUE, error);
+}
+
+void
+test_clip_metrics_option(void)
+{
+        char *argv[] = {"app", "-e", "jpg", "-d", "img", "--metrics=tn.prom",
+                        "--metrics-interval=30"};
+        int   error  = 0;
+        TEST_ASSERT_NOT_NULL(clip(&error, 7, argv));
+        TEST_ASSERT_EQUAL_STRING("tn.prom", clip_get_options()->metrics);
+        TEST_ASSERT_EQUAL_size_t(30, clip_get_options()->metrics_interval);
+
+        char *zero[] = {"app", "-e", "jpg", "-d", "img",
+                        "--metrics-interval=0"};
+        error        = 0;
+        TEST_ASSERT_NULL(clip(&error, 6, zero));
+        TEST_ASSERT_EQUAL_INT(CLIP_ERR_BAD_VALUE, error);
+}
+
+void
+test_clip_progress_option(void)
+{
+        char *argv[] = {"app", "-e", "jpg", "-d", "img", "--progress"};
+        int   error  = 0;
+        TEST_ASSERT_NOT_NULL(clip(&error, 6, argv));
+        TEST_ASSERT_EQUAL_INT(1, clip_get_options()->progress);
+}
+
+void
+test_clip_watch_option(void)
+{
+        char *argv[] = {"app", "-e", "jpg", "-d", "img", "--watch"};
+        int   error  = 0;
+        TEST_ASSERT_NOT_NULL(clip(&error, 6, argv));
+        TEST_ASSERT_EQUAL_INT(CLIP_WATCH_INOTIFY, clip_get_options()->watch);
+
+        char *fan[] = {"app", "-e", "jpg", "-d", "img", "--watch=fanotify"};
+        error       = 0;
+        TEST_ASSERT_NOT_NULL(clip(&error, 6, fan));
+        TEST_ASSERT_EQUAL_INT(CLIP_WATCH_FANOTIFY, clip_get_options()->watch);
+
+        char *bad[] = {"app", "-e", "jpg", "-d", "img", "--watch=poll"};
+        error       = 0;
+        TEST_ASSERT_NULL(clip(&error, 6, bad));
+        TEST_ASSERT_EQUAL_INT(CLIP_ERR_BAD_VALUE, error);
+
+        char *dry[] = {"app", "-e", "jpg", "-d", "img", "--watch", "--dry-run"};
+        error       = 0;
+        TEST_ASSERT_NULL(clip(&error, 7, dry));
+        TEST_ASSERT_EQUAL_INT(CLIP_ERR_BAD_VALUE, error);
+}
+
+void
+test_clip_settle_option(void)
+{
+        char *argv[] = {"app", "-e", "jpg", "-d", "img", "--settle=5"};
+        int   error  = 0;
+        TEST_ASSERT_NOT_NULL(clip(&error, 6, argv));
+        TEST_ASSERT_EQUAL_size_t(5, clip_get_options()->settle);
+
+        char *bad[] = {"app", "-e", "jpg", "-d", "img", "--settle=x"};
+        error       = 0;
+        TEST_ASSERT_NULL(clip(&error, 6, bad));
+        TEST_ASSERT_EQUAL_INT(CLIP_ERR_BAD_VALUE, error);
+}
+
+void
+test_clip_batch_options(void)
+{
+        char *argv[] = {"app", "-e", "jpg", "-d", "img", "--watch",
+                        "--batch-window=50", "--batch-size=256"};
+        int   error  = 0;
+        TEST_ASSERT_NOT_NULL(clip(&error, 8, argv));
+        TEST_ASSERT_EQUAL_size_t(50, clip_get_options()->batch_window);
+        TEST_ASSERT_EQUAL_size_t(256, clip_get_options()->batch_size);
+
+        char *bad[] = {"app", "-e", "jpg", "-d", "img", "--batch-size=0"};
+        error       = 0;
+        TEST_ASSERT_NULL(clip(&error, 6, bad));
+        TEST_ASSERT_EQUAL_INT(CLIP_ERR_BAD_VALUE, error);
+}
+
+void
+test_clip_daemon_mode(void)
+{
+        char *argv[] = {"app", "daemon", "--socket=/tmp/tn.sock"};
+        int   error  = 0;
+        const struct command **cmds = clip(&error, 3, argv);
+        TEST_ASSERT_NOT_NULL(cmds);
+        // правила не обязательны: они приходят с заданиями
+        TEST_ASSERT_NULL(cmds[0]);
+        free((void *) cmds);
+        TEST_ASSERT_TRUE(clip_get_options()->daemon);
+        TEST_ASSERT_EQUAL_STRING("/tmp/tn.sock", clip_get_options()->socket);
+
+        char *no_socket[] = {"app", "daemon"};
+        error             = 0;
+        TEST_ASSERT_NULL(clip(&error, 2, no_socket));
+        TEST_ASSERT_EQUAL_INT(CLIP_ERR_BAD_VALUE, error);
+
+        char *watch[] = {"app", "daemon", "--socket=s", "--watch"};
+        error         = 0;
+        TEST_ASSERT_NULL(clip(&error, 4, watch));
+        TEST_ASSERT_EQUAL_INT(CLIP_ERR_BAD_VALUE, error);
+
+        int                    e   = 0;
+        const struct command **map = clip_parse_map(&e, "jpg=img");
+        TEST_ASSERT_NOT_NULL(map);
+        TEST_ASSERT_EQUAL_STRING("img", map[0]->dir);
+        free((void *) map[0]->ext);
+        free((void *) map[0]->dir);
+        free((void *) map[0]);
+        free((void *) map);
+        TEST_ASSERT_NULL(clip_parse_map(&e, "jpg"));
+        TEST_ASSERT_EQUAL_INT(CLIP_ERR_BAD_M_OPT, e);
+}
+
+void
+test_clip_dir_cache_option(void)
+{
+        char *argv[] = {"app", "-e", "jpg", "-d", "img", "--dir-cache=c"};
+        int   error  = 0;
+        TEST_ASSERT_NOT_NULL(clip(&error, 6, argv));
+        TEST_ASSERT_EQUAL_STRING("c", clip_get_options()->dir_cache);
+
+        char *watch[] = {"app", "-e", "jpg", "-d", "img", "--dir-cache=c",
+                         "--watch"};
+        error         = 0;
+        TEST_ASSERT_NULL(clip(&error, 7, watch));
+        TEST_ASSERT_EQUAL_INT(CLIP_ERR_BAD_VALUE, error);
+}
+
+void
+test_clip_claim_option(void)
+{
+        char *argv[] = {"app", "-e", "jpg", "-d", "img", "--claim"};
+        int   error  = 0;
+        TEST_ASSERT_NOT_NULL(clip(&error, 6, argv));
+        TEST_ASSERT_EQUAL_INT(1, clip_get_options()->claim);
+
+        char *copy[] = {"app", "-e", "jpg", "-d", "img", "--claim", "--copy"};
+        error        = 0;
+        TEST_ASSERT_NULL(clip(&error, 7, copy));
+        TEST_ASSERT_EQUAL_INT(CLIP_ERR_BAD_VALUE, error);
+}
+
+void
+test_clip_shard_option(void)
+{
+        char *argv[] = {"app", "-e", "jpg", "-d", "img", "--shard=2/3"};
+        int   error  = 0;
+        TEST_ASSERT_NOT_NULL(clip(&error, 6, argv));
+        TEST_ASSERT_EQUAL_UINT(2, clip_get_options()->shard);
+        TEST_ASSERT_EQUAL_UINT(3, clip_get_options()->shards);
+
+        char *bad[] = {"app", "-e", "jpg", "-d", "img", "--shard=4/3"};
+        error       = 0;
+        TEST_ASSERT_NULL(clip(&error, 6, bad));
+        TEST_ASSERT_EQUAL_INT(CLIP_ERR_BAD_VALUE, error);
+}
@@ -12,5 +12,24 @@ void test_copy_command_null_cmd(void);
 void test_copy_command_null_ext(void);
 void test_copy_command_null_dir(void);
 void test_copy_command_valid(void);
+void test_clip_dry_run_option(void);
+void test_clip_dedupe_option(void);
+void test_clip_link_option(void);
+void test_clip_copy_option(void);
+void test_clip_archive_option(void);
+void test_clip_quiet_option(void);
+void test_clip_format_option(void);
+void test_clip_stats_option(void);
+void test_clip_profile_option(void);
+void test_clip_trace_option(void);
+void test_clip_metrics_option(void);
+void test_clip_progress_option(void);
+void test_clip_watch_option(void);
+void test_clip_settle_option(void);
+void test_clip_batch_options(void);
+void test_clip_daemon_mode(void);
+void test_clip_dir_cache_option(void);
+void test_clip_claim_option(void);
+void test_clip_shard_option(void);
 
 #endif //TEST_CLIP_H
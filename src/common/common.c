@@ -1,3 +1,5 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "common.h"
 
 #include <limits.h>
@@ -7,6 +9,7 @@
 #include <unistd.h>
 #include <sys/stat.h>
 #include <stdarg.h>
+#include <time.h>
 
 #ifndef PATH_MAX
 #define PATH_MAX 4096 // fallback, POSIX минимум
@@ -343,7 +346,8 @@ strtokarr(const char *str, int delim)
                 }
                 ++i;
         }
-        char **arr = malloc(sizeof(char *) * (size + 1));
+        // `size` разделителей дают `size + 1` токен, плюс завершающий NULL
+        char **arr = malloc(sizeof(char *) * (size + 2));
         if (NULL == arr)
         {
                 return NULL;
@@ -381,3 +385,114 @@ strtokarr(const char *str, int delim)
         arr[arr_pos] = NULL;
         return arr;
 }
+
+/// Возвращает текущее значение монотонных часов в наносекундах.
+///
+/// \return
+///     Наносекунды от произвольной фиксированной точки (`CLOCK_MONOTONIC`).
+///     Пригодно только для измерения интервалов; `0` при ошибке `clock_gettime`.
+///
+/// \par Использование
+///     const uint64_t start = monotonic_ns();
+///     // ... работа ...
+///     const uint64_t elapsed = monotonic_ns() - start;
+uint64_t
+monotonic_ns(void)
+{
+        struct timespec ts;
+        if (0 != clock_gettime(CLOCK_MONOTONIC, &ts))
+        {
+                return 0;
+        }
+        return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+/// Вычисляет 64-битный хеш FNV-1a от произвольного блока байт.
+///
+/// \param data
+///     Указатель на данные. Если `len == 0`, не разыменовывается.
+/// \param len
+///     Размер данных в байтах.
+///
+/// \return
+///     Значение хеша. Результат стабилен между запусками, процессами
+///     и машинами, поэтому пригоден для разбиения работы и хеш-таблиц.
+///
+/// \note
+///     - Не криптографический хеш: не годится для защиты от подбора коллизий.
+uint64_t
+hash_bytes(const void *data, const size_t len)
+{
+        const unsigned char *p = data;
+        uint64_t             h = 14695981039346656037ULL;
+        for (size_t i = 0; i < len; ++i)
+        {
+                h ^= p[i];
+                h *= 1099511628211ULL;
+        }
+        return h;
+}
+
+/// Перемешивает биты хеша (финализатор splitmix64).
+///
+/// У FNV-1a младшие биты плохо зависят от последних байт, и у похожих
+/// имён (`f1.txt`, `f2.txt`, ...) остатки от деления на небольшое
+/// число распределяются неравномерно. После перемешивания каждый бит
+/// результата зависит от всех битов входа.
+uint64_t
+hash_mix(uint64_t h)
+{
+        h ^= h >> 30;
+        h *= 0xbf58476d1ce4e5b9ULL;
+        h ^= h >> 27;
+        h *= 0x94d049bb133111ebULL;
+        h ^= h >> 31;
+        return h;
+}
+
+/// Длина корректной последовательности UTF-8 в начале `s`: без
+/// избыточных форм, суррогатов и значений за U+10FFFF.
+/// \return Число байт или 0, если последовательность некорректна
+size_t
+utf8_len(const unsigned char *s)
+{
+        if (0x80 > s[0])
+        {
+                return 1;
+        }
+        size_t        len = 0;
+        unsigned char lo  = 0x80;
+        unsigned char hi  = 0xbf;
+        if (0xc2 <= s[0] && 0xdf >= s[0])
+        {
+                len = 2;
+        }
+        else if (0xe0 <= s[0] && 0xef >= s[0])
+        {
+                len = 3;
+                lo  = 0xe0 == s[0] ? 0xa0 : 0x80;
+                hi  = 0xed == s[0] ? 0x9f : 0xbf;
+        }
+        else if (0xf0 <= s[0] && 0xf4 >= s[0])
+        {
+                len = 4;
+                lo  = 0xf0 == s[0] ? 0x90 : 0x80;
+                hi  = 0xf4 == s[0] ? 0x8f : 0xbf;
+        }
+        else
+        {
+                return 0;
+        }
+        if (lo > s[1] || hi < s[1])
+        {
+                return 0;
+        }
+        for (size_t i = 2; i < len; ++i)
+        {
+                if (0x80 > s[i] || 0xbf < s[i])
+                {
+                        return 0;
+                }
+        }
+        return len;
+}
@@ -2,6 +2,7 @@
 #define COMMON_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 char *
 strcopy(const char *s);
@@ -17,5 +18,13 @@ char *
 concat(const char *first, ...);
 char* strtok_iso(char *str, const char* delim, char **saverptr);
 char **strtokarr(const char *str, int delim);
+uint64_t
+monotonic_ns(void);
+uint64_t
+hash_bytes(const void *data, size_t len);
+uint64_t
+hash_mix(uint64_t h);
+size_t
+utf8_len(const unsigned char *s);
 
 #endif //COMMON_H
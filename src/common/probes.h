@@ -0,0 +1,45 @@
+#ifndef PROBES_H
+#define PROBES_H
+
+/// Статические точки трассировки USDT провайдера `tn`.
+///
+/// Если при сборке доступен `<sys/sdt.h>` (пакет systemtap-sdt-dev),
+/// каждая точка компилируется в одну инструкцию `nop` и запись в секции
+/// `.note.stapsdt`; пока к ней не подключён bpftrace/perf, стоимость
+/// нулевая. Без заголовка или с `-DTN_NO_USDT` точки исчезают.
+///
+/// Список точек:
+///   - `find__entry(ext)`, `find__return(ext, count)` — `find_target`
+///   - `scan__entry()`, `scan__return(count, status)` — `scan_dir`
+///   - `match__entry(ext)`, `match__return(ext, count)` — `match_targets`
+///   - `match__decision(name, ext, matched)` — решение по каждому файлу:
+///     0 — не то расширение, 1 — подошёл, -1 — не обычный файл
+///   - `mkdir__entry(dir)`, `mkdir__return(dir, status)` —
+///     `make_dir_recursive`
+///   - `execute__start(name, dir, mode)`,
+///     `execute__done(name, dir, status, error)` — `execute_opt`
+///
+/// Пример: `bpftrace -e 'usdt:./tn:tn:execute__done { @[arg3] = count(); }'`
+#if !defined(TN_NO_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define TN_HAVE_USDT 1
+#endif
+#endif
+
+#ifdef TN_HAVE_USDT
+#define TN_PROBE0(name) DTRACE_PROBE(tn, name)
+#define TN_PROBE1(name, a) DTRACE_PROBE1(tn, name, a)
+#define TN_PROBE2(name, a, b) DTRACE_PROBE2(tn, name, a, b)
+#define TN_PROBE3(name, a, b, c) DTRACE_PROBE3(tn, name, a, b, c)
+#define TN_PROBE4(name, a, b, c, d) DTRACE_PROBE4(tn, name, a, b, c, d)
+#else
+#define TN_PROBE0(name) ((void) 0)
+#define TN_PROBE1(name, a) ((void) (a))
+#define TN_PROBE2(name, a, b) ((void) (a), (void) (b))
+#define TN_PROBE3(name, a, b, c) ((void) (a), (void) (b), (void) (c))
+#define TN_PROBE4(name, a, b, c, d)                                            \
+        ((void) (a), (void) (b), (void) (c), (void) (d))
+#endif
+
+#endif //PROBES_H
@@ -0,0 +1,159 @@
+#include "seenset.h"
+
+#include "common.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/// Битов на ключ и проверок на ключ: при 10 битах 7 проверок дают
+/// около 1% ложных совпадений.
+#define SEENSET_BITS_PER_KEY 10
+#define SEENSET_PROBES       7
+
+/// Второй независимый хеш для двойного хеширования: нечётный шаг
+/// обходит все биты степени двойки.
+static uint64_t
+seenset_step(const uint64_t key)
+{
+        return hash_mix(key) | 1;
+}
+
+static int
+seenset_test(const uint64_t *bits, const size_t mask, const uint64_t key)
+{
+        const uint64_t step = seenset_step(key);
+        uint64_t       h    = key;
+        for (int i = 0; i < SEENSET_PROBES; ++i, h += step)
+        {
+                const size_t bit = (size_t) h & mask;
+                if (0 == (bits[bit / 64] & (1ULL << (bit % 64))))
+                {
+                        return 0;
+                }
+        }
+        return 1;
+}
+
+/// Делает прошлое поколение текущим и очищает его.
+static void
+seenset_rotate(struct seenset *s)
+{
+        s->current ^= 1U;
+        memset(s->bits[s->current], 0, (s->mask + 1) / 8);
+        s->count = 0;
+        ++s->epoch;
+}
+
+/// Инициализирует пустое множество.
+///
+/// @param s      Множество для инициализации.
+/// @param limit  Ключей в поколении; определяет размер (по 10 бит на ключ
+///               в каждом из двух поколений).
+/// @param age_ns Срок поколения для `seenset_tick`; 0 — только по числу.
+/// @return 0 при успехе, -1 при ошибке выделения памяти или нулевом
+///         `limit`.
+int
+seenset_init(struct seenset *s, const size_t limit, const uint64_t age_ns)
+{
+        memset(s, 0, sizeof(*s));
+        if (0 == limit)
+        {
+                return -1;
+        }
+        size_t bits = 64;
+        while (bits < limit * SEENSET_BITS_PER_KEY)
+        {
+                bits *= 2;
+        }
+        s->bits[0] = calloc(bits / 64, sizeof(uint64_t));
+        s->bits[1] = calloc(bits / 64, sizeof(uint64_t));
+        if (NULL == s->bits[0] || NULL == s->bits[1])
+        {
+                seenset_free(s);
+                return -1;
+        }
+        s->mask    = bits - 1;
+        s->limit   = limit;
+        s->age_ns  = age_ns;
+        s->born_ns = monotonic_ns();
+        return 0;
+}
+
+/// Встречался ли ключ в текущем или прошлом поколении.
+/// @return 1 — вероятно встречался, 0 — точно нет (или `s` — NULL).
+int
+seenset_contains(const struct seenset *s, const uint64_t key)
+{
+        if (NULL == s || NULL == s->bits[0])
+        {
+                return 0;
+        }
+        return seenset_test(s->bits[0], s->mask, key) ||
+               seenset_test(s->bits[1], s->mask, key);
+}
+
+/// Добавляет ключ в текущее поколение; заполненное поколение сменяется.
+void
+seenset_add(struct seenset *s, const uint64_t key)
+{
+        if (NULL == s || NULL == s->bits[0])
+        {
+                return;
+        }
+        if (s->count == s->limit)
+        {
+                seenset_rotate(s);
+        }
+        uint64_t      *bits = s->bits[s->current];
+        const uint64_t step = seenset_step(key);
+        uint64_t       h    = key;
+        for (int i = 0; i < SEENSET_PROBES; ++i, h += step)
+        {
+                const size_t bit = (size_t) h & s->mask;
+                bits[bit / 64] |= 1ULL << (bit % 64);
+        }
+        ++s->count;
+}
+
+/// Старение по времени: сменяет поколение, прожившее `age_ns`. Если
+/// прошло два срока, забываются оба поколения.
+void
+seenset_tick(struct seenset *s, const uint64_t now_ns)
+{
+        if (NULL == s || NULL == s->bits[0] || 0 == s->age_ns ||
+            now_ns - s->born_ns < s->age_ns)
+        {
+                return;
+        }
+        seenset_rotate(s);
+        if (now_ns - s->born_ns >= 2 * s->age_ns)
+        {
+                seenset_rotate(s);
+        }
+        s->born_ns = now_ns;
+}
+
+/// Когда `seenset_tick` сменит поколение по сроку.
+/// @return Момент по `monotonic_ns` или `UINT64_MAX`, если срока нет.
+uint64_t
+seenset_due_ns(const struct seenset *s)
+{
+        if (NULL == s || NULL == s->bits[0] || 0 == s->age_ns)
+        {
+                return UINT64_MAX;
+        }
+        return s->born_ns + s->age_ns;
+}
+
+/// Освобождает оба поколения. Повторный вызов безопасен.
+void
+seenset_free(struct seenset *s)
+{
+        if (NULL == s)
+        {
+                return;
+        }
+        free(s->bits[0]);
+        free(s->bits[1]);
+        memset(s, 0, sizeof(*s));
+}
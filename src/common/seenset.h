@@ -0,0 +1,41 @@
+#ifndef SEENSET_H
+#define SEENSET_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// Вероятностное множество уже отклонённых ключей фиксированного
+/// размера: два фильтра Блума — текущее и прошлое поколения.
+/// Проверка смотрит в оба, запись идёт в текущее. Когда текущее набрало
+/// `limit` ключей или прожило `age_ns`, прошлое очищается и становится
+/// текущим. Память не растёт, ключ забывается не раньше чем через одно
+/// и не позже чем через два поколения.
+///
+/// Ложное «уже было» возможно (около 1% при заполнении до `limit`) и
+/// исчезает со сменой поколений; пропущенных «не было» не бывает.
+struct seenset
+{
+        uint64_t *bits[2];
+        size_t    mask;    /// Число битов поколения минус один
+        size_t    limit;   /// Ключей в поколении до смены
+        size_t    count;   /// Ключей в текущем поколении
+        unsigned  current; /// Индекс текущего поколения в `bits`
+        uint64_t  age_ns;  /// Срок поколения; 0 — без срока
+        uint64_t  born_ns; /// Начало текущего поколения
+        uint64_t  epoch;   /// Число смен поколения
+};
+
+int
+seenset_init(struct seenset *s, size_t limit, uint64_t age_ns);
+int
+seenset_contains(const struct seenset *s, uint64_t key);
+void
+seenset_add(struct seenset *s, uint64_t key);
+void
+seenset_tick(struct seenset *s, uint64_t now_ns);
+uint64_t
+seenset_due_ns(const struct seenset *s);
+void
+seenset_free(struct seenset *s);
+
+#endif //SEENSET_H
@@ -0,0 +1,266 @@
+#include "stats.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// Гистограмма задержек в духе HDR: значения до `2 * STATS_HIST_SUB`
+/// нс хранятся точно, дальше каждая степень двойки делится на
+/// `STATS_HIST_SUB` равных корзин, то есть относительная погрешность
+/// не больше 1/32 (~3 %) на всём диапазоне до 2^48 нс (~78 ч).
+#define STATS_HIST_SUB_BITS 5
+#define STATS_HIST_SUB      (1u << STATS_HIST_SUB_BITS)
+#define STATS_HIST_MAX_BIT  47
+#define STATS_HIST_BUCKETS                                                     \
+        ((STATS_HIST_MAX_BIT - STATS_HIST_SUB_BITS + 1) * STATS_HIST_SUB +     \
+         STATS_HIST_SUB)
+
+struct stats_hist
+{
+        uint64_t counts[STATS_HIST_BUCKETS];
+        uint64_t max;
+};
+
+/// Гистограммы одного потока. Пишет в них только владелец, без
+/// атомарных операций; читаются после завершения рабочих потоков.
+struct stats_local
+{
+        struct stats_local *next;
+        struct stats_hist   hist[STATS_PHASES];
+};
+
+int stats_on = 0;
+
+/// Накопители общие для всех потоков; обновления с `relaxed`-порядком
+/// не требуют блокировок и не упорядочивают окружающий код.
+static _Atomic uint64_t phase_ns[STATS_PHASES];
+static _Atomic uint64_t phase_calls[STATS_PHASES];
+static _Atomic uint64_t counters[STATS_COUNTERS];
+
+static _Atomic(struct stats_local *) locals;
+static _Thread_local struct stats_local *local;
+
+static const char *const phase_names[STATS_PHASES] = {
+    [STATS_READDIR] = "readdir", [STATS_MATCH] = "match",
+    [STATS_STAT] = "stat",       [STATS_MKDIR] = "mkdir",
+    [STATS_EXECUTE] = "execute", [STATS_RENAME] = "rename",
+    [STATS_LINK] = "link",       [STATS_COPY] = "copy",
+};
+
+static const char *const counter_names[STATS_COUNTERS] = {
+    [STATS_SYSCALLS]     = "Системных вызовов",
+    [STATS_ALLOCS]       = "Выделений памяти",
+    [STATS_BYTES_COPIED] = "Скопировано байт",
+};
+
+/// Номер корзины для значения: для `v < 64` — само значение, дальше
+/// старшие `STATS_HIST_SUB_BITS + 1` бит со сдвигом.
+static size_t
+hist_index(uint64_t v)
+{
+        if (v >> (STATS_HIST_MAX_BIT + 1))
+        {
+                v = (1ULL << (STATS_HIST_MAX_BIT + 1)) - 1;
+        }
+        const int bit   = 63 - __builtin_clzll(v | 1);
+        const int shift = bit > STATS_HIST_SUB_BITS ? bit - STATS_HIST_SUB_BITS
+                                                    : 0;
+        return (size_t) shift * STATS_HIST_SUB + (size_t) (v >> shift);
+}
+
+/// Наибольшее значение, попадающее в корзину `index`.
+static uint64_t
+hist_value(const size_t index)
+{
+        if (index < 2 * STATS_HIST_SUB)
+        {
+                return index;
+        }
+        const size_t shift    = index / STATS_HIST_SUB - 1;
+        const size_t mantissa = index - shift * STATS_HIST_SUB;
+        return (((uint64_t) mantissa + 1) << shift) - 1;
+}
+
+/// Гистограммы текущего потока; при первом обращении заводятся и
+/// публикуются в общем списке. NULL при нехватке памяти.
+static struct stats_local *
+local_hist(void)
+{
+        if (NULL != local)
+        {
+                return local;
+        }
+        struct stats_local *l = calloc(1, sizeof(*l));
+        if (NULL == l)
+        {
+                return NULL;
+        }
+        struct stats_local *head = atomic_load(&locals);
+        do
+        {
+                l->next = head;
+        } while (!atomic_compare_exchange_weak(&locals, &head, l));
+        local = l;
+        return l;
+}
+
+/// Включает сбор статистики; вызывается до начала работы.
+void
+stats_enable(void)
+{
+        stats_on = 1;
+}
+
+/// Обнуляет накопленное (для тестов и повторных прогонов).
+void
+stats_reset(void)
+{
+        for (int i = 0; i < STATS_PHASES; ++i)
+        {
+                atomic_store_explicit(&phase_ns[i], 0, memory_order_relaxed);
+                atomic_store_explicit(&phase_calls[i], 0, memory_order_relaxed);
+        }
+        for (int i = 0; i < STATS_COUNTERS; ++i)
+        {
+                atomic_store_explicit(&counters[i], 0, memory_order_relaxed);
+        }
+        // буферы потоков не освобождаются: потоки могут держать указатели
+        for (struct stats_local *l = atomic_load(&locals); NULL != l;
+             l                     = l->next)
+        {
+                memset(l->hist, 0, sizeof(l->hist));
+        }
+}
+
+void
+stats_phase_add(const int phase, const uint64_t ns)
+{
+        atomic_fetch_add_explicit(&phase_ns[phase], ns, memory_order_relaxed);
+        atomic_fetch_add_explicit(&phase_calls[phase], 1, memory_order_relaxed);
+        struct stats_local *l = local_hist();
+        if (NULL != l)
+        {
+                struct stats_hist *h = &l->hist[phase];
+                ++h->counts[hist_index(ns)];
+                if (ns > h->max)
+                {
+                        h->max = ns;
+                }
+        }
+}
+
+void
+stats_counter_add(const int counter, const uint64_t n)
+{
+        atomic_fetch_add_explicit(&counters[counter], n, memory_order_relaxed);
+}
+
+uint64_t
+stats_phase_ns(const int phase)
+{
+        return atomic_load_explicit(&phase_ns[phase], memory_order_relaxed);
+}
+
+uint64_t
+stats_phase_calls(const int phase)
+{
+        return atomic_load_explicit(&phase_calls[phase], memory_order_relaxed);
+}
+
+uint64_t
+stats_counter(const int counter)
+{
+        return atomic_load_explicit(&counters[counter], memory_order_relaxed);
+}
+
+/// Перцентиль `q` (0..1) времени фазы по гистограммам всех потоков,
+/// с точностью до корзины (~3 %). Вызывается после завершения рабочих
+/// потоков. 0, если вызовов не было.
+uint64_t
+stats_phase_percentile(const int phase, const double q)
+{
+        uint64_t total = 0;
+        for (const struct stats_local *l = atomic_load(&locals); NULL != l;
+             l                           = l->next)
+        {
+                for (size_t i = 0; i < STATS_HIST_BUCKETS; ++i)
+                {
+                        total += l->hist[phase].counts[i];
+                }
+        }
+        if (0 == total)
+        {
+                return 0;
+        }
+        // ранг первого значения, не меньшего q-й доли выборки
+        const double want = q * (double) total;
+        uint64_t     rank = (uint64_t) want;
+        if ((double) rank < want || 0 == rank)
+        {
+                ++rank;
+        }
+        uint64_t seen = 0;
+        for (size_t i = 0; i < STATS_HIST_BUCKETS; ++i)
+        {
+                for (const struct stats_local *l = atomic_load(&locals);
+                     NULL != l; l = l->next)
+                {
+                        seen += l->hist[phase].counts[i];
+                }
+                if (seen >= rank)
+                {
+                        const uint64_t max = stats_phase_max(phase);
+                        const uint64_t v   = hist_value(i);
+                        return v < max ? v : max;
+                }
+        }
+        return stats_phase_max(phase);
+}
+
+/// Наибольшее время одного вызова фазы (точно, не по корзине).
+uint64_t
+stats_phase_max(const int phase)
+{
+        uint64_t max = 0;
+        for (const struct stats_local *l = atomic_load(&locals); NULL != l;
+             l                           = l->next)
+        {
+                if (l->hist[phase].max > max)
+                {
+                        max = l->hist[phase].max;
+                }
+        }
+        return max;
+}
+
+/// Печатает таблицу фаз (вызовы, суммарное и среднее время, p50, p99,
+/// p99.9 и максимум одного вызова) и счётчики. Фазы без вызовов
+/// пропускаются.
+void
+stats_print(FILE *out)
+{
+        // заголовок выровнен вручную: ширина `%s` считается в байтах
+        fprintf(out, "Фаза            вызовов    всего, мс  среднее, мкс"
+                     "      p50      p99    p99.9     макс (мкс)\n");
+        for (int i = 0; i < STATS_PHASES; ++i)
+        {
+                const uint64_t calls = stats_phase_calls(i);
+                if (0 == calls)
+                {
+                        continue;
+                }
+                const uint64_t ns = stats_phase_ns(i);
+                fprintf(out, "%-10s %12llu %12.3f %12.3f %8.1f %8.1f %8.1f %8.1f\n",
+                        phase_names[i], (unsigned long long) calls,
+                        (double) ns / 1e6, (double) ns / 1e3 / (double) calls,
+                        (double) stats_phase_percentile(i, 0.5) / 1e3,
+                        (double) stats_phase_percentile(i, 0.99) / 1e3,
+                        (double) stats_phase_percentile(i, 0.999) / 1e3,
+                        (double) stats_phase_max(i) / 1e3);
+        }
+        for (int i = 0; i < STATS_COUNTERS; ++i)
+        {
+                fprintf(out, "%s: %llu\n", counter_names[i],
+                        (unsigned long long) stats_counter(i));
+        }
+}
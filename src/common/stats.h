@@ -0,0 +1,84 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include "common.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+/// Фазы прогона, время которых измеряется при `--stats`.
+enum stats_phase
+{
+        STATS_READDIR, /// Вызовы `readdir` в `find_target`
+        STATS_MATCH,   /// Сверка расширения с правилом
+        STATS_STAT,    /// `stat` совпавших по имени файлов
+        STATS_MKDIR,   /// `mkdir` в `make_dir_recursive`
+        STATS_EXECUTE, /// `execute_opt` целиком
+        STATS_RENAME,
+        STATS_LINK,
+        STATS_COPY,
+        STATS_PHASES,
+};
+
+/// Счётчики событий.
+enum stats_counter
+{
+        STATS_SYSCALLS,     /// Системные вызовы файловых операций
+        STATS_ALLOCS,       /// Выделения памяти на путях сканирования и
+                            /// исполнения
+        STATS_BYTES_COPIED, /// Байты, записанные копированием
+        STATS_COUNTERS,
+};
+
+/// Включена ли статистика. Выключенная стоит одну проверку флага
+/// на точку замера: часы не читаются, счётчики не трогаются.
+extern int stats_on;
+
+void
+stats_enable(void);
+void
+stats_reset(void);
+void
+stats_phase_add(int phase, uint64_t ns);
+void
+stats_counter_add(int counter, uint64_t n);
+uint64_t
+stats_phase_ns(int phase);
+uint64_t
+stats_phase_calls(int phase);
+uint64_t
+stats_phase_percentile(int phase, double q);
+uint64_t
+stats_phase_max(int phase);
+uint64_t
+stats_counter(int counter);
+void
+stats_print(FILE *out);
+
+/// Начало замера: метка времени или 0, если статистика выключена.
+static inline uint64_t
+stats_begin(void)
+{
+        return __builtin_expect(stats_on, 0) ? monotonic_ns() : 0;
+}
+
+/// Конец замера, начатого `stats_begin`.
+static inline void
+stats_end(const int phase, const uint64_t start)
+{
+        if (__builtin_expect(stats_on, 0))
+        {
+                stats_phase_add(phase, monotonic_ns() - start);
+        }
+}
+
+static inline void
+stats_count(const int counter, const uint64_t n)
+{
+        if (__builtin_expect(stats_on, 0))
+        {
+                stats_counter_add(counter, n);
+        }
+}
+
+#endif //STATS_H
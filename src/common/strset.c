@@ -0,0 +1,148 @@
+#include "strset.h"
+
+#include "common.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define STRSET_MIN_CAPACITY 16
+
+/// Возвращает индекс слота с ключом `key` либо первого пустого слота
+/// на пути пробирования. Ёмкость всегда степень двойки.
+static size_t
+strset_slot(char *const *slots, const size_t capacity, const char *key)
+{
+        size_t i = (size_t) hash_bytes(key, strlen(key)) & (capacity - 1);
+        while (NULL != slots[i] && 0 != strcmp(slots[i], key))
+        {
+                i = (i + 1) & (capacity - 1);
+        }
+        return i;
+}
+
+/// Увеличивает таблицу вдвое и перераспределяет ключи.
+/// @return 0 при успехе, -1 при ошибке выделения памяти.
+static int
+strset_grow(struct strset *set)
+{
+        const size_t capacity = set->capacity * 2;
+        char       **slots    = calloc(capacity, sizeof(char *));
+        if (NULL == slots)
+        {
+                return -1;
+        }
+        for (size_t i = 0; i < set->capacity; ++i)
+        {
+                if (NULL != set->slots[i])
+                {
+                        slots[strset_slot(slots, capacity, set->slots[i])] =
+                            set->slots[i];
+                }
+        }
+        free((void *) set->slots);
+        set->slots    = slots;
+        set->capacity = capacity;
+        return 0;
+}
+
+/// Инициализирует пустое множество.
+///
+/// @param set  Множество для инициализации.
+/// @param hint Ожидаемое число элементов (может быть 0).
+/// @return 0 при успехе, -1 при ошибке выделения памяти.
+int
+strset_init(struct strset *set, const size_t hint)
+{
+        size_t capacity = STRSET_MIN_CAPACITY;
+        while (capacity < hint * 2)
+        {
+                capacity *= 2;
+        }
+        set->slots    = calloc(capacity, sizeof(char *));
+        set->capacity = NULL == set->slots ? 0 : capacity;
+        set->count    = 0;
+        return NULL == set->slots ? -1 : 0;
+}
+
+/// Добавляет копию строки `key` во множество.
+///
+/// Коэффициент заполнения держится не выше 1/2, так что поиск в среднем
+/// укладывается в одно-два сравнения строк.
+///
+/// @return
+/// - `1`, если строка добавлена;
+/// - `0`, если она уже была во множестве;
+/// - `-1` при ошибке выделения памяти или `NULL` аргументах.
+int
+strset_add(struct strset *set, const char *key)
+{
+        if (NULL == set || NULL == key || NULL == set->slots)
+        {
+                return -1;
+        }
+        size_t i = strset_slot(set->slots, set->capacity, key);
+        if (NULL != set->slots[i])
+        {
+                return 0;
+        }
+        if ((set->count + 1) * 2 > set->capacity)
+        {
+                if (-1 == strset_grow(set))
+                {
+                        return -1;
+                }
+                i = strset_slot(set->slots, set->capacity, key);
+        }
+        char *copy = strcopy(key);
+        if (NULL == copy)
+        {
+                return -1;
+        }
+        set->slots[i] = copy;
+        ++set->count;
+        return 1;
+}
+
+/// Проверяет наличие строки во множестве.
+/// @return 1, если строка присутствует, иначе 0.
+int
+strset_contains(const struct strset *set, const char *key)
+{
+        if (NULL == set || NULL == key || NULL == set->slots)
+        {
+                return 0;
+        }
+        return NULL != set->slots[strset_slot(set->slots, set->capacity, key)]
+                   ? 1
+                   : 0;
+}
+
+/// Удаляет все элементы, сохраняя выделенную таблицу.
+void
+strset_clear(struct strset *set)
+{
+        if (NULL == set || NULL == set->slots)
+        {
+                return;
+        }
+        for (size_t i = 0; i < set->capacity; ++i)
+        {
+                free(set->slots[i]);
+                set->slots[i] = NULL;
+        }
+        set->count = 0;
+}
+
+/// Освобождает все ключи и саму таблицу. Повторный вызов безопасен.
+void
+strset_free(struct strset *set)
+{
+        if (NULL == set)
+        {
+                return;
+        }
+        strset_clear(set);
+        free((void *) set->slots);
+        set->slots    = NULL;
+        set->capacity = 0;
+}
@@ -0,0 +1,26 @@
+#ifndef STRSET_H
+#define STRSET_H
+
+#include <stddef.h>
+
+/// Множество строк на открытой адресации (линейное пробирование).
+/// Ключи копируются внутрь множества и освобождаются в `strset_free`.
+struct strset
+{
+        char **slots;
+        size_t capacity;
+        size_t count;
+};
+
+int
+strset_init(struct strset *set, size_t hint);
+int
+strset_add(struct strset *set, const char *key);
+int
+strset_contains(const struct strset *set, const char *key);
+void
+strset_clear(struct strset *set);
+void
+strset_free(struct strset *set);
+
+#endif //STRSET_H
@@ -1,4 +1,8 @@
 #include "test_common.h"
+#include "test_stats.h"
+#include "test_trace.h"
+#include "test_strset.h"
+#include "test_seenset.h"
 
 #include "unity.h"
 
@@ -38,6 +42,21 @@ main(void)
         RUN_TEST(test_strtokarr_null);
         RUN_TEST(test_strtokarr_empty_string);
         RUN_TEST(test_strtokarr_no_delimiter);
+        RUN_TEST(test_hash_bytes_stable);
+        RUN_TEST(test_monotonic_ns_non_decreasing);
+        RUN_TEST(test_strset_add_contains);
+        RUN_TEST(test_strset_duplicate);
+        RUN_TEST(test_strset_grow);
+        RUN_TEST(test_strset_clear);
+        RUN_TEST(test_strset_null);
+        RUN_TEST(test_seenset_add_contains);
+        RUN_TEST(test_seenset_aging);
+        RUN_TEST(test_stats_disabled_is_noop);
+        RUN_TEST(test_stats_phases_and_counters);
+        RUN_TEST(test_stats_percentiles);
+        RUN_TEST(test_trace_disabled_is_noop);
+        RUN_TEST(test_trace_write_threads);
+        RUN_TEST(test_trace_utf8);
         UNITY_END();
         return 0;
 }
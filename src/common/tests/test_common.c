@@ -220,3 +220,20 @@ void test_strtokarr_no_delimiter(void)
         free(arr[i]);
     free(arr);
 }
+
+// Тест hash_bytes - известное значение FNV-1a и стабильность
+void test_hash_bytes_stable(void)
+{
+    TEST_ASSERT_TRUE(14695981039346656037ULL == hash_bytes("", 0));
+    TEST_ASSERT_TRUE(0xaf63dc4c8601ec8cULL == hash_bytes("a", 1));
+    TEST_ASSERT_TRUE(hash_bytes("abc", 3) != hash_bytes("abd", 3));
+}
+
+// Тест monotonic_ns - время не убывает
+void test_monotonic_ns_non_decreasing(void)
+{
+    const uint64_t a = monotonic_ns();
+    const uint64_t b = monotonic_ns();
+    TEST_ASSERT_TRUE(a > 0);
+    TEST_ASSERT_TRUE(b >= a);
+}
@@ -47,5 +47,9 @@ void
 test_strtokarr_empty_string(void);
 void
 test_strtokarr_no_delimiter(void);
+void
+test_hash_bytes_stable(void);
+void
+test_monotonic_ns_non_decreasing(void);
 
 #endif //TEST_COMMON_H
@@ -0,0 +1,52 @@
+#include "test_seenset.h"
+
+#include "common.h"
+#include "seenset.h"
+#include "unity.h"
+
+void
+test_seenset_add_contains(void)
+{
+        struct seenset s;
+        TEST_ASSERT_EQUAL_INT(0, seenset_init(&s, 1000, 0));
+        for (uint64_t i = 0; i < 1000; ++i)
+        {
+                seenset_add(&s, hash_bytes(&i, sizeof(i)));
+        }
+        size_t false_hits = 0;
+        for (uint64_t i = 0; i < 1000; ++i)
+        {
+                TEST_ASSERT_EQUAL_INT(
+                    1, seenset_contains(&s, hash_bytes(&i, sizeof(i))));
+                const uint64_t other = i + 1000000;
+                false_hits += (size_t) seenset_contains(
+                    &s, hash_bytes(&other, sizeof(other)));
+        }
+        TEST_ASSERT_LESS_THAN(50, false_hits);
+        TEST_ASSERT_EQUAL_INT(0, seenset_contains(NULL, 1));
+        TEST_ASSERT_EQUAL_INT(-1, seenset_init(&s, 0, 0));
+        seenset_free(&s);
+}
+
+void
+test_seenset_aging(void)
+{
+        struct seenset s;
+        const uint64_t first = hash_bytes("first", 5);
+        TEST_ASSERT_EQUAL_INT(0, seenset_init(&s, 2, 1000));
+        seenset_add(&s, first);
+
+        // заполненное поколение сменяется, ключ живёт ещё одно поколение
+        seenset_add(&s, 2);
+        seenset_add(&s, 3);
+        TEST_ASSERT_EQUAL_INT(1, seenset_contains(&s, first));
+        seenset_add(&s, 4);
+        seenset_add(&s, 5);
+        TEST_ASSERT_EQUAL_INT(0, seenset_contains(&s, first));
+
+        // два срока без смены — забываются оба поколения
+        seenset_tick(&s, s.born_ns + 2000);
+        TEST_ASSERT_EQUAL_INT(0, seenset_contains(&s, 3));
+        TEST_ASSERT_EQUAL_INT(0, seenset_contains(&s, 5));
+        seenset_free(&s);
+}
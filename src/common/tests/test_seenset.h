@@ -0,0 +1,9 @@
+#ifndef TEST_SEENSET_H
+#define TEST_SEENSET_H
+
+void
+test_seenset_add_contains(void);
+void
+test_seenset_aging(void);
+
+#endif //TEST_SEENSET_H
@@ -0,0 +1,60 @@
+#include "test_stats.h"
+
+#include "stats.h"
+#include "unity.h"
+
+void
+test_stats_disabled_is_noop(void)
+{
+        stats_reset();
+        stats_on = 0;
+        TEST_ASSERT_EQUAL_UINT64(0, stats_begin());
+        stats_end(STATS_STAT, 0);
+        stats_count(STATS_SYSCALLS, 5);
+        TEST_ASSERT_EQUAL_UINT64(0, stats_phase_calls(STATS_STAT));
+        TEST_ASSERT_EQUAL_UINT64(0, stats_counter(STATS_SYSCALLS));
+}
+
+void
+test_stats_phases_and_counters(void)
+{
+        stats_reset();
+        stats_enable();
+        const uint64_t start = stats_begin();
+        TEST_ASSERT_TRUE(0 < start);
+        stats_end(STATS_MKDIR, start);
+        stats_end(STATS_MKDIR, stats_begin());
+        stats_count(STATS_BYTES_COPIED, 4096);
+        stats_count(STATS_BYTES_COPIED, 1);
+        TEST_ASSERT_EQUAL_UINT64(2, stats_phase_calls(STATS_MKDIR));
+        TEST_ASSERT_EQUAL_UINT64(0, stats_phase_calls(STATS_RENAME));
+        TEST_ASSERT_EQUAL_UINT64(4097, stats_counter(STATS_BYTES_COPIED));
+        stats_reset();
+        TEST_ASSERT_EQUAL_UINT64(0, stats_phase_calls(STATS_MKDIR));
+        stats_on = 0;
+}
+
+void
+test_stats_percentiles(void)
+{
+        stats_reset();
+        // 1000 вызовов по 1..1000 мкс: p50 ≈ 500, p99 ≈ 990, p99.9 ≈ 999
+        for (uint64_t i = 1; i <= 1000; ++i)
+        {
+                stats_phase_add(STATS_RENAME, i * 1000);
+        }
+        const uint64_t p50  = stats_phase_percentile(STATS_RENAME, 0.5);
+        const uint64_t p99  = stats_phase_percentile(STATS_RENAME, 0.99);
+        const uint64_t p999 = stats_phase_percentile(STATS_RENAME, 0.999);
+        // погрешность корзины не больше 1/32 сверху
+        TEST_ASSERT_TRUE(500000 <= p50 && p50 <= 500000 + 500000 / 32);
+        TEST_ASSERT_TRUE(990000 <= p99 && p99 <= 990000 + 990000 / 32);
+        TEST_ASSERT_TRUE(999000 <= p999 && p999 <= 1000000);
+        TEST_ASSERT_EQUAL_UINT64(1000000, stats_phase_max(STATS_RENAME));
+        TEST_ASSERT_EQUAL_UINT64(0, stats_phase_percentile(STATS_MKDIR, 0.5));
+        // малые значения хранятся точно
+        stats_phase_add(STATS_MKDIR, 7);
+        TEST_ASSERT_EQUAL_UINT64(7, stats_phase_percentile(STATS_MKDIR, 0.99));
+        stats_reset();
+        TEST_ASSERT_EQUAL_UINT64(0, stats_phase_max(STATS_RENAME));
+}
@@ -0,0 +1,11 @@
+#ifndef TEST_STATS_H
+#define TEST_STATS_H
+
+void
+test_stats_disabled_is_noop(void);
+void
+test_stats_phases_and_counters(void);
+void
+test_stats_percentiles(void);
+
+#endif //TEST_STATS_H
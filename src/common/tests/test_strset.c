@@ -0,0 +1,70 @@
+#include "test_strset.h"
+
+#include "strset.h"
+#include "unity.h"
+
+#include <stdio.h>
+
+void
+test_strset_add_contains(void)
+{
+        struct strset set;
+        TEST_ASSERT_EQUAL_INT(0, strset_init(&set, 0));
+        TEST_ASSERT_EQUAL_INT(1, strset_add(&set, "images"));
+        TEST_ASSERT_EQUAL_INT(1, strset_contains(&set, "images"));
+        TEST_ASSERT_EQUAL_INT(0, strset_contains(&set, "videos"));
+        strset_free(&set);
+}
+
+void
+test_strset_duplicate(void)
+{
+        struct strset set;
+        TEST_ASSERT_EQUAL_INT(0, strset_init(&set, 4));
+        TEST_ASSERT_EQUAL_INT(1, strset_add(&set, "a/b"));
+        TEST_ASSERT_EQUAL_INT(0, strset_add(&set, "a/b"));
+        TEST_ASSERT_EQUAL_UINT(1, set.count);
+        strset_free(&set);
+}
+
+void
+test_strset_grow(void)
+{
+        struct strset set;
+        char          key[32];
+        TEST_ASSERT_EQUAL_INT(0, strset_init(&set, 0));
+        for (int i = 0; i < 1000; ++i)
+        {
+                snprintf(key, sizeof(key), "dir%d", i);
+                TEST_ASSERT_EQUAL_INT(1, strset_add(&set, key));
+        }
+        TEST_ASSERT_EQUAL_UINT(1000, set.count);
+        for (int i = 0; i < 1000; ++i)
+        {
+                snprintf(key, sizeof(key), "dir%d", i);
+                TEST_ASSERT_EQUAL_INT(1, strset_contains(&set, key));
+        }
+        TEST_ASSERT_EQUAL_INT(0, strset_contains(&set, "dir1000"));
+        strset_free(&set);
+}
+
+void
+test_strset_clear(void)
+{
+        struct strset set;
+        TEST_ASSERT_EQUAL_INT(0, strset_init(&set, 0));
+        strset_add(&set, "x");
+        strset_clear(&set);
+        TEST_ASSERT_EQUAL_UINT(0, set.count);
+        TEST_ASSERT_EQUAL_INT(0, strset_contains(&set, "x"));
+        TEST_ASSERT_EQUAL_INT(1, strset_add(&set, "x"));
+        strset_free(&set);
+}
+
+void
+test_strset_null(void)
+{
+        TEST_ASSERT_EQUAL_INT(-1, strset_add(NULL, "x"));
+        TEST_ASSERT_EQUAL_INT(0, strset_contains(NULL, "x"));
+        strset_free(NULL);
+}
@@ -0,0 +1,15 @@
+#ifndef TEST_STRSET_H
+#define TEST_STRSET_H
+
+void
+test_strset_add_contains(void);
+void
+test_strset_duplicate(void);
+void
+test_strset_grow(void);
+void
+test_strset_clear(void);
+void
+test_strset_null(void);
+
+#endif //TEST_STRSET_H
@@ -0,0 +1,118 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "test_trace.h"
+
+#include "trace.h"
+#include "unity.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static char *
+read_file(const char *path)
+{
+        FILE *f = fopen(path, "r");
+        if (NULL == f)
+        {
+                return NULL;
+        }
+        static char buf[8192];
+        const size_t n = fread(buf, 1, sizeof(buf) - 1, f);
+        fclose(f);
+        buf[n] = '\0';
+        return buf;
+}
+
+static size_t
+count(const char *hay, const char *needle)
+{
+        size_t n = 0;
+        for (const char *p = strstr(hay, needle); NULL != p;
+             p             = strstr(p + 1, needle))
+        {
+                ++n;
+        }
+        return n;
+}
+
+static void *
+worker(void *arg)
+{
+        (void) arg;
+        trace_end("hash", "dedup", trace_begin(), "w");
+        return NULL;
+}
+
+void
+test_trace_disabled_is_noop(void)
+{
+        trace_free();
+        TEST_ASSERT_EQUAL_UINT64(0, trace_begin());
+        trace_end("move", "execute", 0, "a");
+        char path[] = "/tmp/tn_trace_XXXXXX";
+        const int fd = mkstemp(path);
+        TEST_ASSERT_TRUE(0 <= fd);
+        close(fd);
+        TEST_ASSERT_EQUAL_INT(0, trace_write(path));
+        const char *json = read_file(path);
+        TEST_ASSERT_NOT_NULL(json);
+        TEST_ASSERT_EQUAL_size_t(0, count(json, "\"ph\":\"X\""));
+        unlink(path);
+}
+
+void
+test_trace_write_threads(void)
+{
+        trace_free();
+        trace_enable();
+        trace_end("move", "execute", trace_begin(), "a\"b\\c\n");
+        pthread_t t;
+        TEST_ASSERT_EQUAL_INT(0, pthread_create(&t, NULL, worker, NULL));
+        pthread_join(t, NULL);
+
+        char path[] = "/tmp/tn_trace_XXXXXX";
+        const int fd = mkstemp(path);
+        TEST_ASSERT_TRUE(0 <= fd);
+        close(fd);
+        TEST_ASSERT_EQUAL_INT(0, trace_write(path));
+        const char *json = read_file(path);
+        TEST_ASSERT_NOT_NULL(json);
+        TEST_ASSERT_EQUAL_size_t(2, count(json, "\"ph\":\"X\""));
+        TEST_ASSERT_EQUAL_size_t(2, count(json, "\"thread_name\""));
+        TEST_ASSERT_NOT_NULL(strstr(json, "\"a\\\"b\\\\c\\u000a\""));
+        TEST_ASSERT_NOT_NULL(strstr(json, "\"name\":\"hash\""));
+        unlink(path);
+        trace_free();
+        TEST_ASSERT_EQUAL_INT(-1, trace_write("/nonexistent/dir/trace.json"));
+}
+
+void
+test_trace_utf8(void)
+{
+        trace_free();
+        trace_enable();
+        trace_end("move", "execute", trace_begin(), "ф\xff.jpg");
+        // обрезка до TRACE_ARG_MAX не разрывает двухбайтовый символ
+        char long_arg[2 * TRACE_ARG_MAX + 1];
+        for (size_t i = 0; i < TRACE_ARG_MAX; ++i)
+        {
+                memcpy(long_arg + 2 * i, "я", 2);
+        }
+        long_arg[2 * TRACE_ARG_MAX] = '\0';
+        trace_end("copy", "execute", trace_begin(), long_arg);
+
+        char path[] = "/tmp/tn_trace_XXXXXX";
+        const int fd = mkstemp(path);
+        TEST_ASSERT_TRUE(0 <= fd);
+        close(fd);
+        TEST_ASSERT_EQUAL_INT(0, trace_write(path));
+        const char *json = read_file(path);
+        TEST_ASSERT_NOT_NULL(json);
+        TEST_ASSERT_NOT_NULL(strstr(json, "\"ф\\u00ff.jpg\""));
+        TEST_ASSERT_EQUAL_size_t(1, count(json, "\\u00"));
+        unlink(path);
+        trace_free();
+}
@@ -0,0 +1,11 @@
+#ifndef TEST_TRACE_H
+#define TEST_TRACE_H
+
+void
+test_trace_disabled_is_noop(void);
+void
+test_trace_write_threads(void);
+void
+test_trace_utf8(void);
+
+#endif //TEST_TRACE_H
@@ -0,0 +1,36 @@
+#!/bin/sh
+# Проверяет, что в собранном tn есть запись .note.stapsdt провайдера tn
+# для каждой точки TN_PROBEn из исходников (src/common/probes.h).
+# Без <sys/sdt.h> или readelf точки проверить нечем: тест пропускается
+# с кодом 77, а не проходит молча.
+#
+# Использование: usdt_notes.sh <проверять: 0|1> <readelf> <tn> <src>
+
+if [ "$1" != 1 ]; then
+        echo "usdt_notes: нет <sys/sdt.h> или readelf, либо TN_USDT=OFF — пропуск"
+        exit 77
+fi
+readelf=$2
+binary=$3
+src=$4
+
+notes=$("$readelf" -n "$binary") || exit 1
+if ! printf '%s\n' "$notes" | grep -q 'Provider: tn$'; then
+        echo "usdt_notes: в $binary нет записей stapsdt провайдера tn"
+        exit 1
+fi
+probes=$(grep -rhoE 'TN_PROBE[0-9]\([a-z_]+' "$src" --include='*.c' |
+         sed 's/.*(//' | sort -u)
+if [ -z "$probes" ]; then
+        echo "usdt_notes: в $src не найдено ни одной точки"
+        exit 1
+fi
+status=0
+for probe in $probes; do
+        if ! printf '%s\n' "$notes" | grep -q "Name: $probe\$"; then
+                echo "usdt_notes: нет точки $probe"
+                status=1
+        fi
+done
+[ "$status" = 0 ] && echo "usdt_notes: точек найдено: $(echo $probes | wc -w)"
+exit $status
@@ -0,0 +1,246 @@
+#define _GNU_SOURCE
+
+#include "trace.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#define TRACE_CHUNK 512 /// Событий в одном блоке буфера потока
+
+struct trace_event
+{
+        const char *name;
+        const char *cat;
+        uint64_t    start;
+        uint64_t    dur;
+        char        arg[TRACE_ARG_MAX];
+};
+
+struct trace_chunk
+{
+        struct trace_chunk *next;
+        size_t              count;
+        struct trace_event  events[TRACE_CHUNK];
+};
+
+/// Буфер одного потока. Пишет в него только владелец, поэтому запись
+/// события не требует ни блокировок, ни атомарных операций; общий
+/// список буферов пополняется один раз на поток через CAS.
+struct trace_buf
+{
+        struct trace_buf   *next;
+        long                tid;
+        struct trace_chunk *head;
+        struct trace_chunk *tail;
+};
+
+int trace_on = 0;
+
+static uint64_t                    trace_origin;
+static _Atomic(struct trace_buf *) trace_bufs;
+static _Thread_local struct trace_buf *local;
+
+/// Включает запись трассы; время событий отсчитывается от этого момента.
+void
+trace_enable(void)
+{
+        trace_origin = monotonic_ns();
+        trace_on     = 1;
+}
+
+/// Заводит буфер текущего потока и публикует его в общем списке.
+static struct trace_buf *
+local_buf(void)
+{
+        if (NULL != local)
+        {
+                return local;
+        }
+        struct trace_buf *buf = calloc(1, sizeof(*buf));
+        if (NULL == buf)
+        {
+                return NULL;
+        }
+        buf->tid               = (long) syscall(SYS_gettid);
+        struct trace_buf *head = atomic_load(&trace_bufs);
+        do
+        {
+                buf->next = head;
+        } while (!atomic_compare_exchange_weak(&trace_bufs, &head, buf));
+        local = buf;
+        return buf;
+}
+
+/// Копирует аргумент, обрезая по границе символа UTF-8.
+static void
+copy_arg(char *dst, const char *src)
+{
+        size_t len = strlen(src);
+        if (len >= TRACE_ARG_MAX)
+        {
+                len = TRACE_ARG_MAX - 1;
+                while (0 < len && 0x80 == ((unsigned char) src[len] & 0xC0))
+                {
+                        --len;
+                }
+        }
+        memcpy(dst, src, len);
+        dst[len] = '\0';
+}
+
+/// Записывает завершённый отрезок в буфер текущего потока.
+/// При нехватке памяти событие теряется, прогон не прерывается.
+void
+trace_span(const char *name, const char *cat, const uint64_t start,
+           const uint64_t end, const char *arg)
+{
+        struct trace_buf *buf = local_buf();
+        if (NULL == buf)
+        {
+                return;
+        }
+        if (NULL == buf->tail || TRACE_CHUNK == buf->tail->count)
+        {
+                struct trace_chunk *chunk = malloc(sizeof(*chunk));
+                if (NULL == chunk)
+                {
+                        return;
+                }
+                chunk->next  = NULL;
+                chunk->count = 0;
+                if (NULL == buf->tail)
+                {
+                        buf->head = chunk;
+                }
+                else
+                {
+                        buf->tail->next = chunk;
+                }
+                buf->tail = chunk;
+        }
+        struct trace_event *ev = &buf->tail->events[buf->tail->count++];
+        ev->name               = name;
+        ev->cat                = cat;
+        ev->start              = start - trace_origin;
+        ev->dur                = end - start;
+        ev->arg[0]             = '\0';
+        if (NULL != arg)
+        {
+                copy_arg(ev->arg, arg);
+        }
+}
+
+/// Строка JSON в кавычках. Аргументы — имена файлов, то есть
+/// произвольные байты: корректный UTF-8 выводится как есть, каждый байт
+/// вне его — как `\u00XX`, иначе просмотрщик отверг бы всю трассу.
+static void
+write_json_string(FILE *out, const char *s)
+{
+        fputc('"', out);
+        const unsigned char *u = (const unsigned char *) s;
+        while (*u)
+        {
+                const unsigned char c   = *u;
+                const size_t        len = utf8_len(u);
+                if ('"' == c || '\\' == c)
+                {
+                        fputc('\\', out);
+                        fputc(c, out);
+                }
+                else if (0x20 > c || 0 == len)
+                {
+                        fprintf(out, "\\u%04x", c);
+                }
+                else
+                {
+                        fwrite(u, 1, len, out);
+                        u += len;
+                        continue;
+                }
+                ++u;
+        }
+        fputc('"', out);
+}
+
+/// Сохраняет трассу в формате Chrome trace event (JSON object format):
+/// отрезки `"ph":"X"` с временем в микросекундах, по дорожке на поток.
+/// Вызывается после завершения рабочих потоков.
+/// \return 0 при успехе, -1 при ошибке записи (`errno` сохранён)
+int
+trace_write(const char *path)
+{
+        FILE *out = fopen(path, "w");
+        if (NULL == out)
+        {
+                return -1;
+        }
+        const long pid   = (long) getpid();
+        int        first = 1;
+        fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", out);
+        for (const struct trace_buf *buf = atomic_load(&trace_bufs);
+             NULL != buf; buf = buf->next)
+        {
+                fprintf(out,
+                        "%s\n{\"name\":\"thread_name\",\"ph\":\"M\","
+                        "\"pid\":%ld,\"tid\":%ld,"
+                        "\"args\":{\"name\":\"%s\"}}",
+                        first ? "" : ",", pid, buf->tid,
+                        pid == buf->tid ? "main" : "worker");
+                first = 0;
+                for (const struct trace_chunk *c = buf->head; NULL != c;
+                     c                           = c->next)
+                {
+                        for (size_t i = 0; i < c->count; ++i)
+                        {
+                                const struct trace_event *ev = &c->events[i];
+                                fprintf(out,
+                                        ",\n{\"name\":\"%s\",\"cat\":\"%s\","
+                                        "\"ph\":\"X\",\"ts\":%.3f,"
+                                        "\"dur\":%.3f,\"pid\":%ld,"
+                                        "\"tid\":%ld",
+                                        ev->name, ev->cat,
+                                        (double) ev->start / 1e3,
+                                        (double) ev->dur / 1e3, pid, buf->tid);
+                                if ('\0' != ev->arg[0])
+                                {
+                                        fputs(",\"args\":{\"arg\":", out);
+                                        write_json_string(out, ev->arg);
+                                        fputc('}', out);
+                                }
+                                fputc('}', out);
+                        }
+                }
+        }
+        fputs("\n]}\n", out);
+        const int failed = ferror(out);
+        if (0 != fclose(out) || failed)
+        {
+                return -1;
+        }
+        return 0;
+}
+
+/// Освобождает буферы всех потоков и выключает трассу.
+void
+trace_free(void)
+{
+        trace_on              = 0;
+        struct trace_buf *buf = atomic_exchange(&trace_bufs, NULL);
+        while (NULL != buf)
+        {
+                struct trace_buf *next = buf->next;
+                for (struct trace_chunk *c = buf->head; NULL != c;)
+                {
+                        struct trace_chunk *n = c->next;
+                        free(c);
+                        c = n;
+                }
+                free(buf);
+                buf = next;
+        }
+        local = NULL;
+}
@@ -0,0 +1,45 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "common.h"
+
+#include <stdint.h>
+
+/// Сколько байт аргумента события (обычно имени файла) сохраняется.
+#define TRACE_ARG_MAX 64
+
+/// Включена ли запись трассы. Выключенная стоит одну проверку флага.
+extern int trace_on;
+
+void
+trace_enable(void);
+void
+trace_span(const char *name, const char *cat, uint64_t start, uint64_t end,
+           const char *arg);
+int
+trace_write(const char *path);
+void
+trace_free(void);
+
+/// Начало отрезка: метка времени или 0, если трасса выключена.
+static inline uint64_t
+trace_begin(void)
+{
+        return __builtin_expect(trace_on, 0) ? monotonic_ns() : 0;
+}
+
+/// Конец отрезка, начатого `trace_begin`.
+/// \param name, cat Статические строки: сохраняется только указатель
+/// \param arg Необязательный аргумент (копируется, не длиннее
+///            `TRACE_ARG_MAX - 1` байт) или NULL
+static inline void
+trace_end(const char *name, const char *cat, const uint64_t start,
+          const char *arg)
+{
+        if (__builtin_expect(trace_on, 0))
+        {
+                trace_span(name, cat, start, monotonic_ns(), arg);
+        }
+}
+
+#endif //TRACE_H
@@ -0,0 +1,495 @@
+#define _GNU_SOURCE
+
+#include "daemon.h"
+
+#include "common.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+/// Освобождает массив правил, полученный от `clip_parse_map`.
+static void
+free_rules(const struct command **commands)
+{
+        for (const struct command **c = commands; c && *c; ++c)
+        {
+                free((void *) (*c)->ext);
+                free((void *) (*c)->dir);
+                free((void *) *c);
+        }
+        free((void *) commands);
+}
+
+/// Правила для карты из запроса: из кеша или разобранные заново.
+/// @return Массив правил или NULL, если карта неверна.
+static const struct command **
+rules_get(struct daemon *d, const char *map)
+{
+        pthread_mutex_lock(&d->lock);
+        struct daemon_rules *r = d->rules;
+        while (NULL != r && 0 != strcmp(r->map, map))
+        {
+                r = r->next;
+        }
+        if (NULL == r)
+        {
+                int                    error    = CLIP_OK;
+                const struct command **commands = clip_parse_map(&error, map);
+                r = NULL == commands ? NULL : malloc(sizeof(*r));
+                if (NULL != r && NULL != (r->map = strcopy(map)))
+                {
+                        r->commands = commands;
+                        r->next     = d->rules;
+                        d->rules    = r;
+                }
+                else
+                {
+                        free(r);
+                        free_rules(commands);
+                        r = NULL;
+                }
+        }
+        pthread_mutex_unlock(&d->lock);
+        return NULL == r ? NULL : r->commands;
+}
+
+/// Разбирает строку запроса `<каталог>[\t<карта>]` на месте.
+///
+/// Завершающий `\r` отбрасывается. Пустая карта равносильна её
+/// отсутствию (`*map` = NULL).
+/// @return 0 при успехе, -1 если каталог не указан.
+int
+daemon_parse(char *line, char **dir, char **map)
+{
+        if (NULL == line)
+        {
+                return -1;
+        }
+        const size_t len = strlen(line);
+        if (0 < len && '\r' == line[len - 1])
+        {
+                line[len - 1] = '\0';
+        }
+        char *tab = strchr(line, '\t');
+        *map      = NULL;
+        if (NULL != tab)
+        {
+                *tab = '\0';
+                if ('\0' != tab[1])
+                {
+                        *map = tab + 1;
+                }
+        }
+        *dir = line;
+        return '\0' == *line ? -1 : 0;
+}
+
+/// Отправляет строку ответа `<status> <text>\n`. Клиент, закрывший
+/// соединение, не должен ронять демон, поэтому `MSG_NOSIGNAL`.
+static void
+send_reply(const int conn, const char *status, const char *text)
+{
+        char      buf[DAEMON_REPLY_MAX + 16];
+        const int n = snprintf(buf, sizeof(buf), "%s %s\n", status, text);
+        size_t    len =
+            (size_t) n < sizeof(buf) ? (size_t) n : sizeof(buf) - 1;
+        const char *p = buf;
+        while (0 < len)
+        {
+                const ssize_t w = send(conn, p, len, MSG_NOSIGNAL);
+                if (-1 == w && EINTR == errno)
+                {
+                        continue;
+                }
+                if (w <= 0)
+                {
+                        return;
+                }
+                p += w;
+                len -= (size_t) w;
+        }
+}
+
+/// Выполняет одно задание в каталоге из запроса.
+static void
+handle(struct daemon_worker *w, const int conn, char *line,
+       const int own_cwd)
+{
+        struct daemon *d   = w->d;
+        char          *dir = NULL;
+        char          *map = NULL;
+        if (-1 == daemon_parse(line, &dir, &map))
+        {
+                send_reply(conn, "ERR", "не указан каталог");
+                return;
+        }
+        const struct command **commands =
+            NULL == map ? d->defaults : rules_get(d, map);
+        if (NULL == commands || NULL == *commands)
+        {
+                send_reply(conn, "ERR",
+                           NULL == map ? "нет правил" : "неверная карта");
+                return;
+        }
+        const int   fd = openat(d->base_fd, dir,
+                                O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        struct stat st;
+        if (-1 == fd || -1 == fstat(fd, &st))
+        {
+                send_reply(conn, "ERR", strerror(errno));
+                if (-1 != fd)
+                {
+                        close(fd);
+                }
+                return;
+        }
+        if (!own_cwd)
+        {
+                pthread_mutex_lock(&d->cwd_lock);
+        }
+        char reply[DAEMON_REPLY_MAX] = "";
+        int  status                  = -1;
+        if (0 == fchdir(fd))
+        {
+                const struct daemon_job job = {
+                    .dir      = dir,
+                    .dev      = st.st_dev,
+                    .ino      = st.st_ino,
+                    .commands = commands,
+                    .worker   = w->index,
+                };
+                status = d->fn(d->ctx, &job, reply, sizeof(reply));
+                if (-1 == fchdir(d->base_fd))
+                {
+                        status = -1;
+                        snprintf(reply, sizeof(reply), "%s", strerror(errno));
+                }
+        }
+        else
+        {
+                snprintf(reply, sizeof(reply), "%s", strerror(errno));
+        }
+        if (!own_cwd)
+        {
+                pthread_mutex_unlock(&d->cwd_lock);
+        }
+        close(fd);
+        send_reply(conn, 0 == status ? "OK" : "ERR", reply);
+}
+
+/// Читает запросы соединения построчно, пока клиент не закроет его,
+/// не замолчит дольше `DAEMON_IDLE_MS` или демон не начнёт
+/// останавливаться. Срок отсчитывается от начала ожидания запроса, а
+/// не от последнего прочитанного байта: клиент, присылающий запрос по
+/// байту, держит поток не дольше молчащего.
+static void
+serve(struct daemon_worker *w, const int conn, const int own_cwd)
+{
+        char     line[DAEMON_LINE_MAX];
+        size_t   len      = 0;
+        uint64_t deadline = monotonic_ns() + DAEMON_IDLE_MS * 1000000ULL;
+        for (;;)
+        {
+                char *nl = memchr(line, '\n', len);
+                if (NULL != nl)
+                {
+                        *nl = '\0';
+                        handle(w, conn, line, own_cwd);
+                        const size_t used = (size_t) (nl - line) + 1;
+                        memmove(line, nl + 1, len - used);
+                        len -= used;
+                        deadline =
+                            monotonic_ns() + DAEMON_IDLE_MS * 1000000ULL;
+                        continue;
+                }
+                if (sizeof(line) == len)
+                {
+                        send_reply(conn, "ERR", "слишком длинный запрос");
+                        return;
+                }
+                const uint64_t now = monotonic_ns();
+                if (now >= deadline)
+                {
+                        return;
+                }
+                struct pollfd fds[2] = {
+                    {.fd = w->d->stop[0], .events = POLLIN},
+                    {.fd = conn, .events = POLLIN},
+                };
+                // с округлением вверх, чтобы не проснуться до срока
+                const int wait  = (int) ((deadline - now + 999999) / 1000000);
+                const int ready = poll(fds, 2, wait);
+                if (-1 == ready)
+                {
+                        if (EINTR == errno)
+                        {
+                                continue;
+                        }
+                        return;
+                }
+                if (0 == ready)
+                {
+                        continue;
+                }
+                if (fds[0].revents)
+                {
+                        return;
+                }
+                const ssize_t n = read(conn, line + len, sizeof(line) - len);
+                if (-1 == n && EINTR == errno)
+                {
+                        continue;
+                }
+                if (n <= 0)
+                {
+                        return;
+                }
+                len += (size_t) n;
+        }
+}
+
+static void *
+worker_main(void *arg)
+{
+        struct daemon_worker *w = arg;
+        struct daemon        *d = w->d;
+        // свой текущий каталог: задания соседних потоков не мешают
+        const int own_cwd = 0 == unshare(CLONE_FS);
+        for (;;)
+        {
+                struct pollfd fds[2] = {
+                    {.fd = d->stop[0], .events = POLLIN},
+                    {.fd = d->listen_fd, .events = POLLIN},
+                };
+                if (-1 == poll(fds, 2, -1))
+                {
+                        if (EINTR == errno)
+                        {
+                                continue;
+                        }
+                        break;
+                }
+                if (fds[0].revents)
+                {
+                        break;
+                }
+                // сокет неблокирующий: соединение мог забрать другой поток
+                const int conn = accept4(d->listen_fd, NULL, NULL, SOCK_CLOEXEC);
+                if (-1 == conn)
+                {
+                        continue;
+                }
+                serve(w, conn, own_cwd);
+                close(conn);
+        }
+        return NULL;
+}
+
+/// Создаёт сокет `path` и начинает слушать его.
+///
+/// Оставшийся от прошлого запуска сокет удаляется, если к нему никто
+/// не подключён; живой демон на том же пути — ошибка `EADDRINUSE`.
+/// Сокет доступен только владельцу.
+/// @return 0 при успехе, -1 при ошибке (`errno` сохранён).
+static int
+open_socket(struct daemon *d, const char *path)
+{
+        struct sockaddr_un addr = {.sun_family = AF_UNIX};
+        if (strlen(path) >= sizeof(addr.sun_path))
+        {
+                errno = ENAMETOOLONG;
+                return -1;
+        }
+        strcpy(addr.sun_path, path);
+        d->listen_fd = socket(AF_UNIX,
+                              SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+        if (-1 == d->listen_fd)
+        {
+                return -1;
+        }
+        struct stat st;
+        if (0 == lstat(path, &st) && S_ISSOCK(st.st_mode))
+        {
+                const int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+                const int alive =
+                    -1 != probe &&
+                    0 == connect(probe, (const struct sockaddr *) &addr,
+                                 sizeof(addr));
+                if (-1 != probe)
+                {
+                        close(probe);
+                }
+                if (alive)
+                {
+                        errno = EADDRINUSE;
+                        return -1;
+                }
+                unlink(path);
+        }
+        const mode_t old = umask(077);
+        const int    rc  = bind(d->listen_fd, (const struct sockaddr *) &addr,
+                                sizeof(addr));
+        umask(old);
+        if (-1 == rc)
+        {
+                return -1;
+        }
+        d->path = path;
+        return listen(d->listen_fd, SOMAXCONN);
+}
+
+/// Поднимает демон: сокет `path` и `workers` потоков (0 —
+/// `DAEMON_WORKERS`), которые сразу начинают принимать задания.
+///
+/// Блокирует `SIGINT`/`SIGTERM` до запуска потоков, так что сигналы
+/// остановки получает только `daemon_run`.
+///
+/// @return 0 при успехе, -1 при ошибке (код в `*error`, `errno` сохранён).
+int
+daemon_open(int *error, struct daemon *d, const char *path, size_t workers,
+            const struct command **defaults, const daemon_fn fn, void *ctx)
+{
+        if (NULL == d || NULL == path || NULL == fn)
+        {
+                *error = DAEMON_ERR_BAD_ARG;
+                return -1;
+        }
+        *error       = DAEMON_OK;
+        d->listen_fd = -1;
+        d->sig_fd    = -1;
+        d->stop[0]   = -1;
+        d->stop[1]   = -1;
+        d->path      = NULL;
+        d->defaults  = defaults;
+        d->fn        = fn;
+        d->ctx       = ctx;
+        d->workers   = NULL;
+        d->count     = 0;
+        d->rules     = NULL;
+        pthread_mutex_init(&d->lock, NULL);
+        pthread_mutex_init(&d->cwd_lock, NULL);
+        sigset_t mask;
+        sigemptyset(&mask);
+        sigaddset(&mask, SIGINT);
+        sigaddset(&mask, SIGTERM);
+        pthread_sigmask(SIG_BLOCK, &mask, &d->old_mask);
+        d->sig_fd  = signalfd(-1, &mask, SFD_CLOEXEC);
+        d->base_fd = open(".", O_PATH | O_DIRECTORY | O_CLOEXEC);
+        if (-1 == d->sig_fd || -1 == d->base_fd ||
+            -1 == pipe2(d->stop, O_CLOEXEC) || -1 == open_socket(d, path))
+        {
+                const int saved = errno;
+                daemon_close(d);
+                errno  = saved;
+                *error = DAEMON_ERR_SOCKET;
+                return -1;
+        }
+        workers    = 0 == workers ? DAEMON_WORKERS : workers;
+        d->workers = calloc(workers, sizeof(*d->workers));
+        if (NULL == d->workers)
+        {
+                daemon_close(d);
+                *error = DAEMON_ERR_MEM;
+                return -1;
+        }
+        for (; d->count < workers; ++d->count)
+        {
+                struct daemon_worker *w = &d->workers[d->count];
+                w->d                    = d;
+                w->index                = d->count;
+                if (0 != pthread_create(&w->thread, NULL, worker_main, w))
+                {
+                        daemon_close(d);
+                        *error = DAEMON_ERR_THREAD;
+                        return -1;
+                }
+        }
+        return 0;
+}
+
+/// Ждёт `SIGINT`/`SIGTERM`; задания тем временем выполняют рабочие
+/// потоки.
+/// @return 0 при получении сигнала, -1 при ошибке (код в `*error`).
+int
+daemon_run(int *error, struct daemon *d)
+{
+        *error = DAEMON_OK;
+        struct signalfd_siginfo info;
+        for (;;)
+        {
+                const ssize_t n = read(d->sig_fd, &info, sizeof(info));
+                if (sizeof(info) == n)
+                {
+                        return 0;
+                }
+                if (-1 == n && EINTR == errno)
+                {
+                        continue;
+                }
+                *error = DAEMON_ERR_BAD_ARG;
+                return -1;
+        }
+}
+
+/// Останавливает рабочие потоки (текущие задания доделываются),
+/// удаляет сокет и освобождает кеш правил.
+void
+daemon_close(struct daemon *d)
+{
+        if (NULL == d)
+        {
+                return;
+        }
+        if (-1 != d->stop[1])
+        {
+                // закрытие делает канал читаемым во всех потоках сразу
+                close(d->stop[1]);
+                d->stop[1] = -1;
+        }
+        for (size_t i = 0; i < d->count; ++i)
+        {
+                pthread_join(d->workers[i].thread, NULL);
+        }
+        free(d->workers);
+        d->workers = NULL;
+        d->count   = 0;
+        if (NULL != d->path)
+        {
+                unlink(d->path);
+                d->path = NULL;
+        }
+        const int fds[] = {d->listen_fd, d->sig_fd, d->base_fd, d->stop[0]};
+        for (size_t i = 0; i < sizeof(fds) / sizeof(fds[0]); ++i)
+        {
+                if (-1 != fds[i])
+                {
+                        close(fds[i]);
+                }
+        }
+        d->listen_fd = -1;
+        d->sig_fd    = -1;
+        d->base_fd   = -1;
+        d->stop[0]   = -1;
+        while (NULL != d->rules)
+        {
+                struct daemon_rules *next = d->rules->next;
+                free(d->rules->map);
+                free_rules(d->rules->commands);
+                free(d->rules);
+                d->rules = next;
+        }
+        pthread_sigmask(SIG_SETMASK, &d->old_mask, NULL);
+        pthread_mutex_destroy(&d->lock);
+        pthread_mutex_destroy(&d->cwd_lock);
+}
@@ -0,0 +1,112 @@
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include "clip.h"
+
+#include <pthread.h>
+#include <signal.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+enum daemon_error
+{
+        DAEMON_OK,
+        DAEMON_ERR_BAD_ARG,
+        DAEMON_ERR_SOCKET, /// Не удалось создать, привязать или слушать сокет
+        DAEMON_ERR_THREAD,
+        DAEMON_ERR_MEM,
+};
+
+/// Число рабочих потоков по умолчанию: столько заданий выполняется
+/// одновременно.
+#define DAEMON_WORKERS 4
+/// Предел строки запроса вместе с `\n`.
+#define DAEMON_LINE_MAX 4096
+/// Предел текста ответа обработчика.
+#define DAEMON_REPLY_MAX 512
+/// Сколько соединение может молчать, не прислав очередной запрос.
+/// Поток обслуживает одно соединение за раз, и без предела `workers`
+/// молчащих клиентов остановили бы демон.
+#define DAEMON_IDLE_MS 1000
+
+/// Задание, переданное обработчику. Текущий каталог потока на время
+/// вызова — каталог задания.
+struct daemon_job
+{
+        const char            *dir;      /// Каталог из запроса
+        dev_t                  dev;      /// Устройство каталога
+        ino_t                  ino;      /// inode каталога
+        const struct command **commands; /// Правила задания (из кеша)
+        size_t                 worker;   /// Номер рабочего потока
+};
+
+/// Обработчик задания: пишет текст ответа в `reply`.
+/// @return 0 — ответ `OK <reply>`, -1 — ответ `ERR <reply>`.
+typedef int (*daemon_fn)(void *ctx, const struct daemon_job *job,
+                         char *reply, size_t cap);
+
+/// Разобранная карта правил, сохранённая между заданиями.
+struct daemon_rules
+{
+        char                  *map;
+        const struct command **commands;
+        struct daemon_rules   *next;
+};
+
+struct daemon;
+
+/// Рабочий поток и его номер для `daemon_job.worker`.
+struct daemon_worker
+{
+        struct daemon *d;
+        size_t         index;
+        pthread_t      thread;
+};
+
+/// Долгоживущий процесс, принимающий задания через Unix-сокет.
+///
+/// Протокол построчный. Запрос — `<каталог>\t<карта>\n` (карта в
+/// формате `-m`; без `\t<карта>` действуют правила, заданные при
+/// запуске). Ответ — одна строка `OK <итоги>\n` или `ERR <причина>\n`.
+/// В одном соединении можно отправить несколько запросов подряд; если
+/// очередной запрос не пришёл целиком за `DAEMON_IDLE_MS`, демон
+/// закрывает соединение.
+///
+/// `workers` потоков ждут соединений и выполняют задания одновременно.
+/// Каждый поток при старте отделяет свой текущий каталог
+/// (`unshare(CLONE_FS)`) и на время задания переходит в его каталог
+/// (`fchdir`), поэтому код раскладки работает с относительными путями,
+/// как и в обычном запуске. Если ядро не даёт отделить каталог, задания
+/// выполняются по одному. Разобранные карты кешируются по тексту.
+///
+/// `SIGINT` и `SIGTERM` принимаются через `signalfd`, как в `--watch`.
+struct daemon
+{
+        int                    listen_fd;
+        int                    sig_fd;
+        int                    base_fd;  /// Каталог запуска: от него
+                                         /// отсчитываются относительные пути
+        int                    stop[2];  /// Канал остановки рабочих потоков
+        sigset_t               old_mask;
+        const char            *path;
+        const struct command **defaults; /// Правила без карты в запросе
+        daemon_fn              fn;
+        void                  *ctx;
+        struct daemon_worker  *workers;
+        size_t                 count;    /// Запущено рабочих потоков
+        pthread_mutex_t        lock;     /// Кеш правил
+        pthread_mutex_t        cwd_lock; /// Задания без своего каталога
+        struct daemon_rules   *rules;
+};
+
+int
+daemon_open(int *error, struct daemon *d, const char *path, size_t workers,
+            const struct command **defaults, daemon_fn fn, void *ctx);
+int
+daemon_run(int *error, struct daemon *d);
+void
+daemon_close(struct daemon *d);
+int
+daemon_parse(char *line, char **dir, char **map);
+
+#endif //DAEMON_H
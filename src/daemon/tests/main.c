@@ -0,0 +1,21 @@
+#include "test_daemon.h"
+
+#include "unity.h"
+
+void
+setUp(void)
+{ /* инициализация, если нужна */
+}
+void
+tearDown(void)
+{ /* очистка, если нужна */
+}
+
+int
+main(void)
+{
+        UNITY_BEGIN();
+        RUN_TEST(test_daemon_parse);
+        RUN_TEST(test_daemon_jobs);
+        return UNITY_END();
+}
@@ -0,0 +1,132 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "test_daemon.h"
+
+#include "daemon.h"
+#include "unity.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+void
+test_daemon_parse(void)
+{
+        char  line[] = "photos\tjpg=img;png=img\r";
+        char *dir    = NULL;
+        char *map    = NULL;
+        TEST_ASSERT_EQUAL_INT(0, daemon_parse(line, &dir, &map));
+        TEST_ASSERT_EQUAL_STRING("photos", dir);
+        TEST_ASSERT_EQUAL_STRING("jpg=img;png=img", map);
+
+        char plain[] = "photos";
+        TEST_ASSERT_EQUAL_INT(0, daemon_parse(plain, &dir, &map));
+        TEST_ASSERT_EQUAL_STRING("photos", dir);
+        TEST_ASSERT_NULL(map);
+
+        char empty[] = "\tjpg=img";
+        TEST_ASSERT_EQUAL_INT(-1, daemon_parse(empty, &dir, &map));
+}
+
+/// Отвечает именем текущего каталога и первым правилом: так видно, что
+/// задание выполнялось в своём каталоге и с правилами из запроса.
+static int
+echo_job(void *ctx, const struct daemon_job *job, char *reply,
+         const size_t cap)
+{
+        (void) ctx;
+        char cwd[256];
+        if (NULL == getcwd(cwd, sizeof(cwd)))
+        {
+                return -1;
+        }
+        const char *base = strrchr(cwd, '/');
+        snprintf(reply, cap, "%s %s=%s", NULL == base ? cwd : base + 1,
+                 job->commands[0]->ext, job->commands[0]->dir);
+        return 0;
+}
+
+/// Отправляет запрос и читает строку ответа.
+static void
+request(const char *path, const char *req, char *reply, const size_t cap)
+{
+        struct sockaddr_un addr = {.sun_family = AF_UNIX};
+        strcpy(addr.sun_path, path);
+        const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        TEST_ASSERT_TRUE(0 <= fd);
+        TEST_ASSERT_EQUAL_INT(
+            0, connect(fd, (const struct sockaddr *) &addr, sizeof(addr)));
+        TEST_ASSERT_EQUAL_INT((int) strlen(req),
+                              (int) write(fd, req, strlen(req)));
+        size_t len = 0;
+        while (len + 1 < cap)
+        {
+                const ssize_t n = read(fd, reply + len, cap - 1 - len);
+                if (n <= 0)
+                {
+                        break;
+                }
+                len += (size_t) n;
+                if ('\n' == reply[len - 1])
+                {
+                        break;
+                }
+        }
+        reply[len] = '\0';
+        close(fd);
+}
+
+void
+test_daemon_jobs(void)
+{
+        char dir[] = "/tmp/tn_daemon_XXXXXX";
+        TEST_ASSERT_NOT_NULL(mkdtemp(dir));
+        char sub[64];
+        snprintf(sub, sizeof(sub), "%s/inbox", dir);
+        TEST_ASSERT_EQUAL_INT(0, mkdir(sub, 0755));
+        char path[64];
+        snprintf(path, sizeof(path), "%s/tn.sock", dir);
+
+        int           err = DAEMON_OK;
+        struct daemon d;
+        TEST_ASSERT_EQUAL_INT(0, daemon_open(&err, &d, path, 1, NULL,
+                                             echo_job, NULL));
+        char req[128];
+        char reply[256];
+        snprintf(req, sizeof(req), "%s\tjpg=img\n", sub);
+        request(path, req, reply, sizeof(reply));
+        TEST_ASSERT_EQUAL_STRING("OK inbox jpg=img\n", reply);
+        // без карты и без правил по умолчанию заданию нечего делать
+        snprintf(req, sizeof(req), "%s\n", sub);
+        request(path, req, reply, sizeof(reply));
+        TEST_ASSERT_EQUAL_STRING("ERR нет правил\n", reply);
+        request(path, "/nonexistent\tjpg=img\n", reply, sizeof(reply));
+        TEST_ASSERT_EQUAL_INT(0, strncmp("ERR ", reply, 4));
+        // молчащее соединение закрывается по сроку и не держит
+        // единственный поток
+        struct sockaddr_un addr = {.sun_family = AF_UNIX};
+        strcpy(addr.sun_path, path);
+        const int idle = socket(AF_UNIX, SOCK_STREAM, 0);
+        TEST_ASSERT_TRUE(0 <= idle);
+        TEST_ASSERT_EQUAL_INT(
+            0, connect(idle, (const struct sockaddr *) &addr, sizeof(addr)));
+        snprintf(req, sizeof(req), "%s\tpng=pic\n", sub);
+        request(path, req, reply, sizeof(reply));
+        TEST_ASSERT_EQUAL_STRING("OK inbox png=pic\n", reply);
+        TEST_ASSERT_EQUAL_INT(0, (int) read(idle, reply, sizeof(reply)));
+        close(idle);
+        // второй демон на том же сокете не запускается
+        struct daemon other;
+        TEST_ASSERT_EQUAL_INT(-1, daemon_open(&err, &other, path, 1, NULL,
+                                              echo_job, NULL));
+        TEST_ASSERT_EQUAL_INT(DAEMON_ERR_SOCKET, err);
+        daemon_close(&d);
+        TEST_ASSERT_EQUAL_INT(-1, access(path, F_OK));
+
+        rmdir(sub);
+        rmdir(dir);
+}
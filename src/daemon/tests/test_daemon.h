@@ -0,0 +1,9 @@
+#ifndef TEST_DAEMON_H
+#define TEST_DAEMON_H
+
+void
+test_daemon_parse(void);
+void
+test_daemon_jobs(void);
+
+#endif //TEST_DAEMON_H
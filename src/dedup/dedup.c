@@ -0,0 +1,601 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "dedup.h"
+
+#include "clip.h"
+#include "common.h"
+#include "fs.h"
+#include "trace.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define DEDUP_EDGE  4096        /// Начало и конец файла для частичного хеша
+#define DEDUP_CHUNK (64 * 1024) /// Размер блока чтения при полном хешировании
+
+#define DIGEST_P1 0x9E3779B185EBCA87ULL
+#define DIGEST_P2 0xC2B2AE3D27D4EB4FULL
+
+/// 128-битный некриптографический отпечаток содержимого.
+/// Две независимые полосы делают случайное совпадение пренебрежимым,
+/// но подобрать совпадение намеренно можно, поэтому равные отпечатки
+/// только отбирают кандидатов: дубликатом файл признаёт побайтовое
+/// сравнение (`dedup_same`).
+struct digest
+{
+        uint64_t a;
+        uint64_t b;
+};
+
+/// Кандидат на дедупликацию.
+struct dedup_item
+{
+        struct target           *target;
+        size_t                   order;    /// Позиция в исходном массиве
+        struct digest            partial;  /// Хеш первых и последних
+                                           /// `DEDUP_EDGE` байт
+        struct digest            full;     /// Хеш всего содержимого
+        int                      complete; /// Частичный хеш уже покрыл
+                                           /// весь файл
+        int                      failed;   /// Файл не удалось прочитать
+        const struct dedup_item *first;    /// Оригинал группы для сверки
+        int                      differs;  /// Содержимое не совпало с
+                                           /// `first`
+};
+
+/// Этап работы пула.
+enum dedup_pass
+{
+        DEDUP_PASS_PARTIAL, /// Частичный хеш
+        DEDUP_PASS_FULL,    /// Полный хеш
+        DEDUP_PASS_VERIFY,  /// Побайтовая сверка с оригиналом группы
+};
+
+/// Задание для пула хеширования: потоки разбирают элементы по одному
+/// через общий атомарный индекс, без блокировок.
+struct dedup_job
+{
+        struct dedup_item **items;
+        size_t              count;
+        atomic_size_t       next;
+        int                 pass; /// Значение из `enum dedup_pass`
+};
+
+static uint64_t
+rotl64(const uint64_t x, const int r)
+{
+        return (x << r) | (x >> (64 - r));
+}
+
+static void
+digest_init(struct digest *d, const off_t size)
+{
+        d->a = DIGEST_P1 ^ (uint64_t) size;
+        d->b = DIGEST_P2;
+}
+
+/// Подмешивает `len` байт в отпечаток по 8 байт за шаг.
+static void
+digest_update(struct digest *d, const unsigned char *buf, const size_t len)
+{
+        size_t i = 0;
+        for (; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t))
+        {
+                uint64_t w;
+                memcpy(&w, buf + i, sizeof(w));
+                d->a = rotl64((d->a ^ w) * DIGEST_P1, 31);
+                d->b = (d->b + w) * DIGEST_P2;
+                d->b ^= d->b >> 29;
+        }
+        for (; i < len; ++i)
+        {
+                d->a = (d->a ^ buf[i]) * DIGEST_P1;
+                d->b = (d->b + buf[i]) * DIGEST_P2;
+        }
+}
+
+static int
+digest_cmp(const struct digest *x, const struct digest *y)
+{
+        if (x->a != y->a)
+        {
+                return x->a < y->a ? -1 : 1;
+        }
+        if (x->b != y->b)
+        {
+                return x->b < y->b ? -1 : 1;
+        }
+        return 0;
+}
+
+/// Читает ровно `len` байт со смещения `off`, повторяя короткие `pread`.
+/// @return Число прочитанных байт (меньше `len` только на конце файла)
+///         или -1 при ошибке.
+static ssize_t
+read_full(const int fd, unsigned char *buf, const size_t len, off_t off)
+{
+        size_t done = 0;
+        while (done < len)
+        {
+                const ssize_t n = pread(fd, buf + done, len - done, off);
+                if (-1 == n && EINTR == errno)
+                {
+                        continue;
+                }
+                if (-1 == n)
+                {
+                        return -1;
+                }
+                if (0 == n)
+                {
+                        break;
+                }
+                done += (size_t) n;
+                off += n;
+        }
+        return (ssize_t) done;
+}
+
+/// Хеширует первые и последние `DEDUP_EDGE` байт файла.
+/// Для файлов не длиннее `2 * DEDUP_EDGE` это весь файл, и полный хеш
+/// повторно не считается.
+static int
+hash_partial(struct dedup_item *item, const int fd)
+{
+        unsigned char buf[DEDUP_EDGE];
+        const off_t   size = item->target->size;
+        const size_t  head = size < DEDUP_EDGE ? (size_t) size : DEDUP_EDGE;
+        digest_init(&item->partial, size);
+        if ((ssize_t) head != read_full(fd, buf, head, 0))
+        {
+                return -1;
+        }
+        digest_update(&item->partial, buf, head);
+        const off_t rest = size - (off_t) head;
+        const size_t tail = rest < DEDUP_EDGE ? (size_t) rest : DEDUP_EDGE;
+        if (0 != tail)
+        {
+                if ((ssize_t) tail != read_full(fd, buf, tail, size - (off_t) tail))
+                {
+                        return -1;
+                }
+                digest_update(&item->partial, buf, tail);
+        }
+        item->complete = size <= 2 * DEDUP_EDGE;
+        if (item->complete)
+        {
+                item->full = item->partial;
+        }
+        return 0;
+}
+
+/// Хеширует всё содержимое файла блоками по `DEDUP_CHUNK` байт.
+static int
+hash_full(struct dedup_item *item, const int fd)
+{
+        unsigned char *buf = malloc(DEDUP_CHUNK);
+        if (NULL == buf)
+        {
+                return -1;
+        }
+        digest_init(&item->full, item->target->size);
+        off_t   off = 0;
+        ssize_t n   = 0;
+        while (0 < (n = read_full(fd, buf, DEDUP_CHUNK, off)))
+        {
+                digest_update(&item->full, buf, (size_t) n);
+                off += n;
+        }
+        free(buf);
+        return -1 == n || off != item->target->size ? -1 : 0;
+}
+
+/// Сравнивает содержимое двух файлов блоками по `DEDUP_CHUNK` байт.
+///
+/// Равенство отпечатков не доказывает равенства файлов, поэтому перед
+/// заменой ссылкой или пропуском каждый дубликат сверяется с
+/// оригиналом целиком.
+///
+/// @return 1 — содержимое совпадает, 0 — различается (в том числе по
+///         длине), -1 — файл не удалось прочитать (`errno` сохранён).
+int
+dedup_same(const struct target *a, const struct target *b)
+{
+        if (NULL == a || NULL == b)
+        {
+                errno = EINVAL;
+                return -1;
+        }
+        unsigned char *buf = malloc(2 * DEDUP_CHUNK);
+        const int      fa  = NULL == buf
+                                 ? -1
+                                 : open(target_path(a), O_RDONLY | O_CLOEXEC);
+        const int fb =
+            -1 == fa ? -1 : open(target_path(b), O_RDONLY | O_CLOEXEC);
+        int   same = -1;
+        off_t off  = 0;
+        while (-1 != fb)
+        {
+                const ssize_t na = read_full(fa, buf, DEDUP_CHUNK, off);
+                const ssize_t nb =
+                    read_full(fb, buf + DEDUP_CHUNK, DEDUP_CHUNK, off);
+                if (-1 == na || -1 == nb)
+                {
+                        break;
+                }
+                if (na != nb ||
+                    0 != memcmp(buf, buf + DEDUP_CHUNK, (size_t) na))
+                {
+                        same = 0;
+                        break;
+                }
+                if (0 == na)
+                {
+                        same = 1;
+                        break;
+                }
+                off += na;
+        }
+        const int saved = errno;
+        if (-1 != fb)
+        {
+                close(fb);
+        }
+        if (-1 != fa)
+        {
+                close(fa);
+        }
+        free(buf);
+        errno = saved;
+        return same;
+}
+
+/// Рабочий цикл потока хеширования и сверки.
+static void *
+dedup_worker(void *arg)
+{
+        struct dedup_job *job = arg;
+        size_t            i   = 0;
+        while ((i = atomic_fetch_add(&job->next, 1)) < job->count)
+        {
+                struct dedup_item *item = job->items[i];
+                const uint64_t     span = trace_begin();
+                if (DEDUP_PASS_VERIFY == job->pass)
+                {
+                        // нечитаемый файл тоже не считается дубликатом
+                        item->differs =
+                            1 != dedup_same(item->first->target, item->target);
+                        trace_end("verify", "dedup", span, item->target->name);
+                        continue;
+                }
+                const int fd =
+                    open(target_path(item->target), O_RDONLY | O_CLOEXEC);
+                if (-1 == fd)
+                {
+                        item->failed = 1;
+                        continue;
+                }
+                const int full   = DEDUP_PASS_FULL == job->pass;
+                const int status =
+                    full ? hash_full(item, fd) : hash_partial(item, fd);
+                item->failed = -1 == status;
+                close(fd);
+                trace_end(full ? "hash full" : "hash partial", "dedup",
+                          span, item->target->name);
+        }
+        return NULL;
+}
+
+/// Обрабатывает элементы задания параллельно в `threads` потоках,
+/// включая вызывающий. Если поток создать не удалось, работу доделают
+/// уже запущенные — задание завершится в любом случае.
+static void
+dedup_run(struct dedup_job *job, size_t threads)
+{
+        if (threads > job->count)
+        {
+                threads = job->count;
+        }
+        pthread_t *pool    = NULL;
+        size_t     started = 0;
+        if (threads > 1)
+        {
+                pool = malloc((threads - 1) * sizeof(pthread_t));
+        }
+        for (size_t i = 0; NULL != pool && i + 1 < threads; ++i)
+        {
+                if (0 != pthread_create(&pool[i], NULL, dedup_worker, job))
+                {
+                        break;
+                }
+                ++started;
+        }
+        dedup_worker(job);
+        for (size_t i = 0; i < started; ++i)
+        {
+                pthread_join(pool[i], NULL);
+        }
+        free(pool);
+}
+
+static int
+cmp_size(const struct dedup_item *x, const struct dedup_item *y)
+{
+        if (x->target->size != y->target->size)
+        {
+                return x->target->size < y->target->size ? -1 : 1;
+        }
+        return 0;
+}
+
+static int
+cmp_order(const struct dedup_item *x, const struct dedup_item *y)
+{
+        return x->order < y->order ? -1 : x->order > y->order ? 1 : 0;
+}
+
+static int
+by_size(const void *l, const void *r)
+{
+        const struct dedup_item *x = l;
+        const struct dedup_item *y = r;
+        const int                c = cmp_size(x, y);
+        return 0 != c ? c : cmp_order(x, y);
+}
+
+static int
+by_partial(const void *l, const void *r)
+{
+        const struct dedup_item *x = l;
+        const struct dedup_item *y = r;
+        int                      c = cmp_size(x, y);
+        if (0 == c)
+        {
+                c = digest_cmp(&x->partial, &y->partial);
+        }
+        return 0 != c ? c : cmp_order(x, y);
+}
+
+static int
+by_full(const void *l, const void *r)
+{
+        const struct dedup_item *x = l;
+        const struct dedup_item *y = r;
+        int                      c = cmp_size(x, y);
+        if (0 == c)
+        {
+                c = digest_cmp(&x->partial, &y->partial);
+        }
+        if (0 == c)
+        {
+                c = digest_cmp(&x->full, &y->full);
+        }
+        return 0 != c ? c : cmp_order(x, y);
+}
+
+/// Удаляет из массива элементы, которые не удалось прочитать.
+static size_t
+drop_failed(struct dedup_item *items, const size_t count)
+{
+        size_t kept = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+                if (0 == items[i].failed)
+                {
+                        items[kept++] = items[i];
+                }
+        }
+        return kept;
+}
+
+/// Собирает в `job` элементы групп из двух и более соседей, равных по `eq`.
+/// Когда `skip_complete` — пропускает элементы, уже хешированные целиком.
+static void
+collect_groups(struct dedup_job *job, struct dedup_item *items,
+               const size_t count, int (*eq)(const void *, const void *),
+               const int skip_complete)
+{
+        job->count = 0;
+        atomic_store(&job->next, 0);
+        size_t begin = 0;
+        while (begin < count)
+        {
+                size_t end = begin + 1;
+                while (end < count && 0 == eq(&items[begin], &items[end]))
+                {
+                        ++end;
+                }
+                for (size_t i = begin; end - begin > 1 && i < end; ++i)
+                {
+                        if (0 == skip_complete || 0 == items[i].complete)
+                        {
+                                job->items[job->count++] = &items[i];
+                        }
+                }
+                begin = end;
+        }
+}
+
+static int
+eq_size(const void *l, const void *r)
+{
+        return cmp_size(l, r);
+}
+
+static int
+eq_partial(const void *l, const void *r)
+{
+        const int c = cmp_size(l, r);
+        return 0 != c ? c
+                      : digest_cmp(&((const struct dedup_item *) l)->partial,
+                                   &((const struct dedup_item *) r)->partial);
+}
+
+/// Находит среди `targets` файлы с одинаковым содержимым.
+///
+/// Алгоритм (каждый этап читает только тех, кто прошёл предыдущий):
+/// 1. Группировка по размеру — без чтения файлов; одиночки отсеиваются.
+/// 2. Частичный хеш первых и последних 4 КиБ внутри групп одного размера.
+/// 3. Полный хеш только при совпадении частичных (файлы до 8 КиБ
+///    уже прочитаны целиком на шаге 2).
+/// 4. Побайтовая сверка каждого кандидата с оригиналом группы: хеш
+///    некриптографический, и совпадение отпечатков можно подобрать.
+/// Этапы 2–4 выполняются параллельно в `threads` потоках.
+///
+/// Оригиналом группы считается файл, встретившийся в `targets` первым;
+/// у остальных `dup_of` указывает на него. Пустые и нечитаемые файлы
+/// в дедупликации не участвуют.
+///
+/// @param error   Код ошибки (`DEDUP_OK`, `DEDUP_ERR_BAD_ARG`, `DEDUP_ERR_MEM`).
+/// @param targets NULL-терминированный массив от `find_target`.
+/// @param threads Число потоков; 0 — по числу процессоров.
+/// @return Число найденных дубликатов или -1 при ошибке.
+int
+dedup(int *error, struct target **targets, size_t threads)
+{
+        if (NULL == targets)
+        {
+                *error = DEDUP_ERR_BAD_ARG;
+                return -1;
+        }
+        *error       = DEDUP_OK;
+        size_t count = 0;
+        for (struct target **t = targets; *t; ++t)
+        {
+                (*t)->dup_of = NULL;
+                ++count;
+        }
+        if (0 == threads)
+        {
+                const long online = sysconf(_SC_NPROCESSORS_ONLN);
+                threads           = online > 0 ? (size_t) online : 1;
+        }
+        struct dedup_item *items = calloc(count + 1, sizeof(*items));
+        struct dedup_job   job   = {.items = calloc(count + 1, sizeof(void *))};
+        if (NULL == items || NULL == job.items)
+        {
+                free(items);
+                free((void *) job.items);
+                *error = DEDUP_ERR_MEM;
+                return -1;
+        }
+        size_t n = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+                if (0 < targets[i]->size)
+                {
+                        items[n].target = targets[i];
+                        items[n].order  = i;
+                        ++n;
+                }
+        }
+        qsort(items, n, sizeof(*items), by_size);
+        collect_groups(&job, items, n, eq_size, 0);
+        dedup_run(&job, threads);
+        n = drop_failed(items, n);
+
+        qsort(items, n, sizeof(*items), by_partial);
+        collect_groups(&job, items, n, eq_partial, 1);
+        job.pass = DEDUP_PASS_FULL;
+        dedup_run(&job, threads);
+        n = drop_failed(items, n);
+
+        qsort(items, n, sizeof(*items), by_full);
+        job.count = 0;
+        atomic_store(&job.next, 0);
+        size_t first = 0;
+        for (size_t i = 1; i < n; ++i)
+        {
+                // равные частичные хеши означают группу из двух и более,
+                // а значит полный хеш у обоих уже посчитан
+                if (0 == eq_partial(&items[first], &items[i]) &&
+                    0 == digest_cmp(&items[first].full, &items[i].full))
+                {
+                        items[i].first         = &items[first];
+                        job.items[job.count++] = &items[i];
+                        continue;
+                }
+                first = i;
+        }
+        job.pass = DEDUP_PASS_VERIFY;
+        dedup_run(&job, threads);
+        int dups = 0;
+        for (size_t i = 0; i < job.count; ++i)
+        {
+                if (0 == job.items[i]->differs)
+                {
+                        job.items[i]->target->dup_of =
+                            job.items[i]->first->target;
+                        ++dups;
+                }
+        }
+        free(items);
+        free((void *) job.items);
+        return dups;
+}
+
+/// Заменяет перемещение дубликата жёсткой ссылкой на перемещённый оригинал.
+///
+/// Порядок действий:
+/// 1. Проверяет, что оригинал `target->dup_of` уже лежит в своём каталоге
+///    назначения — тот же inode, что был при сканировании;
+/// 2. Создаёт `<dir>/<name>` дубликата через `linkat` на этот inode;
+///    существующий файл не перезаписывается (`EEXIST`);
+/// 3. Удаляет исходный дубликат: его данные больше не занимают место.
+///
+/// @param error Код ошибки (`DEDUP_OK`, `DEDUP_ERR_BAD_ARG`,
+///              `DEDUP_ERR_NOT_MOVED`, `DEDUP_ERR_CREATE_PATH`,
+///              `DEDUP_ERR_LINK`, `DEDUP_ERR_UNLINK`). `errno` сохраняется.
+/// @param target Дубликат с заполненным `dup_of`.
+/// @return 0 при успехе, -1 при ошибке.
+int
+dedup_link(int *error, const struct target *target)
+{
+        if (NULL == target || NULL == target->dup_of)
+        {
+                *error = DEDUP_ERR_BAD_ARG;
+                return -1;
+        }
+        const struct target *orig = target->dup_of;
+        char *src = concat(orig->cmd->dir, "/", orig->name, NULL);
+        char *dst = concat(target->cmd->dir, "/", target->name, NULL);
+        if (NULL == src || NULL == dst)
+        {
+                free(src);
+                free(dst);
+                *error = DEDUP_ERR_CREATE_PATH;
+                return -1;
+        }
+        struct stat st;
+        int         status = -1;
+        if (0 != stat(src, &st) || st.st_dev != orig->dev ||
+            st.st_ino != orig->ino)
+        {
+                *error = DEDUP_ERR_NOT_MOVED;
+        }
+        else if (-1 == linkat(AT_FDCWD, src, AT_FDCWD, dst, 0))
+        {
+                *error = DEDUP_ERR_LINK;
+        }
+        else if (-1 == unlink(target_path(target)))
+        {
+                *error = DEDUP_ERR_UNLINK;
+        }
+        else
+        {
+                *error = DEDUP_OK;
+                status = 0;
+        }
+        const int saved = errno;
+        free(src);
+        free(dst);
+        errno = saved;
+        return status;
+}
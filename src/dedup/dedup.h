@@ -0,0 +1,26 @@
+#ifndef DEDUP_H
+#define DEDUP_H
+
+#include "fs.h"
+
+#include <stddef.h>
+
+enum dedup_error
+{
+        DEDUP_OK,
+        DEDUP_ERR_BAD_ARG,
+        DEDUP_ERR_MEM,
+        DEDUP_ERR_NOT_MOVED,
+        DEDUP_ERR_CREATE_PATH,
+        DEDUP_ERR_LINK,
+        DEDUP_ERR_UNLINK,
+};
+
+int
+dedup(int *error, struct target **targets, size_t threads);
+int
+dedup_same(const struct target *a, const struct target *b);
+int
+dedup_link(int *error, const struct target *target);
+
+#endif //DEDUP_H
@@ -0,0 +1,25 @@
+#include "test_dedup.h"
+
+#include "unity.h"
+
+void
+setUp(void)
+{ /* инициализация, если нужна */
+}
+void
+tearDown(void)
+{ /* очистка, если нужна */
+}
+
+int
+main(void)
+{
+        UNITY_BEGIN();
+        RUN_TEST(test_dedup_null);
+        RUN_TEST(test_dedup_small_files);
+        RUN_TEST(test_dedup_middle_differs);
+        RUN_TEST(test_dedup_link_success);
+        RUN_TEST(test_dedup_link_not_moved);
+        RUN_TEST(test_dedup_same_collision);
+        return UNITY_END();
+}
@@ -0,0 +1,17 @@
+#ifndef TEST_DEDUP_H
+#define TEST_DEDUP_H
+
+void
+test_dedup_null(void);
+void
+test_dedup_small_files(void);
+void
+test_dedup_middle_differs(void);
+void
+test_dedup_link_success(void);
+void
+test_dedup_link_not_moved(void);
+void
+test_dedup_same_collision(void);
+
+#endif //TEST_DEDUP_H
@@ -0,0 +1,281 @@
+#define _GNU_SOURCE
+
+#include "copy.h"
+
+#include "stats.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+
+#define COPY_RW_CHUNK (128 * 1024) /// Буфер запасного копирования
+
+/// Возвращает запись кеша для устройства, заводя новую при необходимости.
+/// При нехватке памяти возвращает NULL — копирование продолжится без кеша.
+static struct copy_probe *
+copy_probe(struct copy_cache *cache, const dev_t dev)
+{
+        if (NULL == cache)
+        {
+                return NULL;
+        }
+        for (size_t i = 0; i < cache->count; ++i)
+        {
+                if (cache->probes[i].dev == dev)
+                {
+                        return &cache->probes[i];
+                }
+        }
+        struct copy_probe *probes =
+            realloc(cache->probes, (cache->count + 1) * sizeof(*probes));
+        if (NULL == probes)
+        {
+                return NULL;
+        }
+        cache->probes = probes;
+        probes[cache->count].dev    = dev;
+        probes[cache->count].method = COPY_UNKNOWN;
+        return &probes[cache->count++];
+}
+
+/// Признак того, что способ не поддерживается файловой системой или ядром,
+/// а не того, что сломался конкретный файл.
+static int
+is_unsupported(const int err)
+{
+        return EOPNOTSUPP == err || ENOTTY == err || EXDEV == err ||
+               EINVAL == err || ENOSYS == err || ENOTSUP == err;
+}
+
+/// Копирует `size` байт через `copy_file_range`. Источник, который
+/// кончился раньше (его обрезали во время копирования), — ошибка
+/// `ENODATA`: неполная копия не выдаётся за целую.
+/// @return 0 при успехе, -1 при ошибке (`errno` сохранён).
+static int
+copy_range(const int in, const int out, const off_t size)
+{
+        off_t done = 0;
+        while (done < size)
+        {
+                const ssize_t n = copy_file_range(in, NULL, out, NULL,
+                                                  (size_t) (size - done), 0);
+                stats_count(STATS_SYSCALLS, 1);
+                if (-1 == n && EINTR == errno)
+                {
+                        continue;
+                }
+                if (-1 == n)
+                {
+                        return -1;
+                }
+                if (0 == n)
+                {
+                        errno = ENODATA;
+                        return -1;
+                }
+                done += n;
+                stats_count(STATS_BYTES_COPIED, (uint64_t) n);
+        }
+        return 0;
+}
+
+/// Копирует через буфер в пользовательском пространстве до конца
+/// источника. Меньше `size` байт, как и в `copy_range`, — ошибка
+/// `ENODATA`.
+/// @return 0 при успехе, -1 при ошибке (`errno` сохранён).
+static int
+copy_rw(const int in, const int out, const off_t size)
+{
+        char *buf = malloc(COPY_RW_CHUNK);
+        if (NULL == buf)
+        {
+                errno = ENOMEM;
+                return -1;
+        }
+        int     status = 0;
+        ssize_t n      = 0;
+        off_t   done   = 0;
+        stats_count(STATS_ALLOCS, 1);
+        while (0 != (n = read(in, buf, COPY_RW_CHUNK)))
+        {
+                stats_count(STATS_SYSCALLS, 1);
+                if (-1 == n && EINTR == errno)
+                {
+                        continue;
+                }
+                if (-1 == n)
+                {
+                        status = -1;
+                        break;
+                }
+                for (ssize_t off = 0; off < n;)
+                {
+                        const ssize_t w = write(out, buf + off, (size_t) (n - off));
+                        stats_count(STATS_SYSCALLS, 1);
+                        if (-1 == w && EINTR == errno)
+                        {
+                                continue;
+                        }
+                        if (-1 == w)
+                        {
+                                status = -1;
+                                break;
+                        }
+                        off += w;
+                        stats_count(STATS_BYTES_COPIED, (uint64_t) w);
+                }
+                if (-1 == status)
+                {
+                        break;
+                }
+                done += n;
+        }
+        if (0 == status && done < size)
+        {
+                errno  = ENODATA;
+                status = -1;
+        }
+        const int saved = errno;
+        free(buf);
+        errno = saved;
+        return status;
+}
+
+/// Копирует содержимое уже открытых файлов самым дешёвым доступным способом.
+///
+/// Способы пробуются по убыванию выгоды: reflink, `copy_file_range`,
+/// `read`/`write`. Отказ «не поддерживается» понижает способ в кеше для
+/// всего устройства назначения. `EXDEV` (источник на другой файловой
+/// системе) касается только этой пары файлов и кеш не трогает.
+/// Прочие ошибки относятся только к этому файлу.
+static int
+copy_fds(const int in, const int out, const off_t size,
+         struct copy_probe *probe, int *method)
+{
+        int m      = NULL == probe ? COPY_UNKNOWN : probe->method;
+        int cached = m;
+        if (COPY_UNKNOWN == m || COPY_REFLINK == m)
+        {
+                stats_count(STATS_SYSCALLS, 1);
+                if (0 == ioctl(out, FICLONE, in))
+                {
+                        // данные не пишутся, но файл получает весь объём
+                        stats_count(STATS_BYTES_COPIED, (uint64_t) size);
+                        m      = COPY_REFLINK;
+                        cached = COPY_REFLINK;
+                        goto done;
+                }
+                if (!is_unsupported(errno))
+                {
+                        return -1;
+                }
+                cached = EXDEV == errno ? cached : COPY_RANGE;
+                m      = COPY_RANGE;
+        }
+        if (COPY_RANGE == m)
+        {
+                if (0 == copy_range(in, out, size))
+                {
+                        goto done;
+                }
+                if (!is_unsupported(errno) || 0 != lseek(out, 0, SEEK_CUR))
+                {
+                        return -1;
+                }
+                cached = EXDEV == errno ? cached : COPY_RW;
+                m      = COPY_RW;
+        }
+        if (-1 == copy_rw(in, out, size))
+        {
+                return -1;
+        }
+done:
+        if (NULL != probe)
+        {
+                probe->method = cached;
+        }
+        *method = m;
+        return 0;
+}
+
+/// Создаёт копию файла `src` по пути `dst`.
+///
+/// Файл назначения создаётся с `O_EXCL`: существующий файл не
+/// перезаписывается, а проверка и создание происходят атомарно
+/// (`errno == EEXIST`). Права копируются из исходного файла.
+/// При любой ошибке частично записанный `dst` удаляется.
+///
+/// Параметры:
+/// - `src`, `dst`: пути исходного и нового файла;
+/// - `cache`: кеш способов по устройству назначения (может быть NULL);
+/// - `method`: куда записать использованный способ (`enum copy_method`).
+///
+/// Возвращает:
+/// - `0` при успехе;
+/// - `-1` при ошибке, `errno` соответствует неудавшемуся вызову.
+int
+copy_file(const char *src, const char *dst, struct copy_cache *cache,
+          int *method)
+{
+        const int in = open(src, O_RDONLY | O_CLOEXEC);
+        if (-1 == in)
+        {
+                return -1;
+        }
+        struct stat st;
+        if (-1 == fstat(in, &st))
+        {
+                const int saved = errno;
+                close(in);
+                errno = saved;
+                return -1;
+        }
+        const int out = open(dst, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+                             st.st_mode & 0777);
+        if (-1 == out)
+        {
+                const int saved = errno;
+                close(in);
+                errno = saved;
+                return -1;
+        }
+        struct stat dst_st;
+        int         status = fstat(out, &dst_st);
+        if (0 == status)
+        {
+                status = copy_fds(in, out, st.st_size,
+                                  copy_probe(cache, dst_st.st_dev), method);
+        }
+        // open, fstat и close для обоих файлов
+        stats_count(STATS_SYSCALLS, 6);
+        int saved = errno;
+        if (0 != close(out) && 0 == status)
+        {
+                saved  = errno;
+                status = -1;
+        }
+        close(in);
+        if (-1 == status)
+        {
+                unlink(dst);
+        }
+        errno = saved;
+        return status;
+}
+
+/// Освобождает кеш способов копирования. Повторный вызов безопасен.
+void
+copy_cache_free(struct copy_cache *cache)
+{
+        if (NULL == cache)
+        {
+                return;
+        }
+        free(cache->probes);
+        cache->probes = NULL;
+        cache->count  = 0;
+}
@@ -0,0 +1,37 @@
+#ifndef COPY_H
+#define COPY_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/// Способ копирования, выбранный для устройства назначения.
+enum copy_method
+{
+        COPY_UNKNOWN, /// Устройство ещё не проверялось
+        COPY_REFLINK, /// `ioctl(FICLONE)` — общие экстенты, данные не читаются
+        COPY_RANGE,   /// `copy_file_range()` — копирование внутри ядра
+        COPY_RW,      /// `read()`/`write()` — последний запасной вариант
+};
+
+/// Известный способ копирования для одного устройства назначения.
+struct copy_probe
+{
+        dev_t dev;
+        int   method;
+};
+
+/// Кеш проверок: первая копия на устройство служит пробой, все
+/// последующие сразу используют сработавший способ.
+struct copy_cache
+{
+        struct copy_probe *probes;
+        size_t             count;
+};
+
+int
+copy_file(const char *src, const char *dst, struct copy_cache *cache,
+          int *method);
+void
+copy_cache_free(struct copy_cache *cache);
+
+#endif //COPY_H
@@ -1,11 +1,17 @@
+#define _GNU_SOURCE
+
 #include "executer.h"
 
 #include "clip.h"
 #include "common.h"
 #include "fs.h"
+#include "probes.h"
+#include "stats.h"
+#include "trace.h"
 
 #include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -14,12 +20,205 @@
 /// Выполняет перемещение целевого файла в указанную директорию,
 /// создавая путь при необходимости.
 ///
+/// Эквивалентно `execute_opt(error, target, NULL)`: режим `EXECUTE_MOVE`,
+/// без кеша каталогов.
+int
+execute(int *error, const struct target *target)
+{
+        return execute_opt(error, target, NULL);
+}
+
+/// Убеждается, что каталог назначения существует.
+///
+/// С кешем `make_dir_recursive` вызывается один раз на каталог за весь
+/// прогон: последующие файлы того же правила не тратят ни одного `mkdir`.
+/// Кеш живёт, пока жив процесс (`--watch`, `tn daemon`, libtn), и
+/// каталог могут удалить извне; такой случай ловит `recreate_dir`.
+///
+/// @return 0 при успехе, -1 если каталог создать не удалось.
+static int
+ensure_dir(const char *dir, struct strset *cache)
+{
+        if (NULL != cache && 1 == strset_contains(cache, dir))
+        {
+                return 0;
+        }
+        if (-1 == make_dir_recursive(dir))
+        {
+                return -1;
+        }
+        if (NULL != cache)
+        {
+                strset_add(cache, dir);
+        }
+        return 0;
+}
+
+/// Операция в каталоге назначения завершилась `ENOENT`: каталог мог
+/// пропасть после того, как попал в кеш `ensure_dir`. Создаёт его
+/// заново — запись кеша снова верна, — и операцию стоит повторить один
+/// раз. Если пропал исходный файл, повтор тоже вернёт `ENOENT`.
+/// @return 1, если каталог на месте и операцию можно повторить;
+///         0 иначе (`errno` сохранён).
+static int
+recreate_dir(const char *dir)
+{
+        if (ENOENT != errno)
+        {
+                return 0;
+        }
+        const int ok = -1 != make_dir_recursive(dir);
+        errno        = ENOENT;
+        return ok;
+}
+
+/// Создаёт в `dst` ссылку на `target->name` без копирования данных.
+///
+/// Обе операции атомарно отказываются перезаписывать существующий файл,
+/// поэтому отдельная проверка `access()` для них не нужна.
+///
+/// @return 0 при успехе, -1 при ошибке (код в `*error`, `errno` сохранён).
+static int
+link_target(int *error, const struct target *target, const char *dst,
+            const int mode)
+{
+        const uint64_t span   = trace_begin();
+        const uint64_t start  = stats_begin();
+        int            status = -1;
+        if (EXECUTE_LINK_HARD == mode)
+        {
+                status = linkat(AT_FDCWD, target_path(target), AT_FDCWD, dst,
+                                0);
+                stats_count(STATS_SYSCALLS, 1);
+        }
+        else
+        {
+                char *abs = realpath(target_path(target), NULL);
+                if (NULL != abs)
+                {
+                        status = symlinkat(abs, AT_FDCWD, dst);
+                        free(abs);
+                }
+                stats_count(STATS_SYSCALLS, 2);
+                stats_count(STATS_ALLOCS, 1);
+        }
+        stats_end(STATS_LINK, start);
+        trace_end("link", "execute", span, target->name);
+        if (-1 == status)
+        {
+                *error = EEXIST == errno ? EXECUTOR_ERR_FILE_EXISTS
+                                         : EXECUTOR_ERR_LINK;
+        }
+        return status;
+}
+
+/// Одна попытка разложить файл в `str` способом `mode`.
+/// @return 0 при успехе, -1 при ошибке (код в `*error`, `errno` сохранён).
+static int
+place_once(int *error, const struct target *target, const char *str,
+           const int mode, const struct execute_options *opts)
+{
+        *error     = EXECUTOR_OK;
+        int status = 0;
+        int method = COPY_UNKNOWN;
+        if (EXECUTE_COPY == mode)
+        {
+                const uint64_t span  = trace_begin();
+                const uint64_t start = stats_begin();
+                status = copy_file(target_path(target), str,
+                                   NULL == opts ? NULL : opts->copy_cache,
+                                   &method);
+                stats_end(STATS_COPY, start);
+                trace_end("copy", "execute", span, target->name);
+                if (-1 == status)
+                {
+                        *error = EEXIST == errno ? EXECUTOR_ERR_FILE_EXISTS
+                                                 : EXECUTOR_ERR_COPY;
+                }
+        }
+        else if (EXECUTE_MOVE != mode)
+        {
+                status = link_target(error, target, str, mode);
+        }
+        else
+        {
+                const uint64_t span  = trace_begin();
+                const uint64_t start = stats_begin();
+                if (access(str, F_OK) == 0)
+                {
+                        *error = EXECUTOR_ERR_FILE_EXISTS;
+                        errno  = EEXIST;
+                        status = -1;
+                }
+                else if (-1 == rename(target_path(target), str))
+                {
+                        *error = EXECUTOR_ERR_MV;
+                        status = -1;
+                }
+                stats_end(STATS_RENAME, start);
+                trace_end("move", "execute", span, target->name);
+                // access и, если файла ещё нет, rename
+                stats_count(STATS_SYSCALLS,
+                            EXECUTOR_ERR_FILE_EXISTS == *error ? 1 : 2);
+        }
+        return status;
+}
+
+/// Тело `execute_opt` без замера общего времени.
+static int
+place_target(int *error, const struct target *target,
+             const struct execute_options *opts)
+{
+        if (NULL == target)
+        {
+                *error = EXECUTOR_ERR_BAD_ARG;
+                return -1;
+        }
+        *error = EXECUTOR_OK;
+        if (NULL == target->cmd->dir)
+        {
+                *error = EXECUTOR_ERR_CREATE_PATH;
+                return -1;
+        }
+        const int      mode  = NULL == opts ? EXECUTE_MOVE : opts->mode;
+        struct strset *cache = NULL == opts ? NULL : opts->dir_cache;
+        if (-1 == ensure_dir(target->cmd->dir, cache))
+        {
+                *error = EXECUTOR_ERR_BAD_ARG;
+                return -1;
+        }
+        char *str = concat(target->cmd->dir, "/", target->name, NULL);
+        stats_count(STATS_ALLOCS, 1);
+        if (NULL == str)
+        {
+                *error = EXECUTOR_ERR_CREATE_PATH;
+                return -1;
+        }
+        int status = place_once(error, target, str, mode, opts);
+        if (-1 == status && recreate_dir(target->cmd->dir))
+        {
+                status = place_once(error, target, str, mode, opts);
+        }
+        const int saved = errno;
+        free(str);
+        errno = saved;
+        return status;
+}
+
+/// Раскладывает целевой файл в каталог назначения выбранным способом.
+///
 /// Алгоритм работы:
 /// 1. Проверяет, что передан ненулевой указатель на `target`.
-/// 2. Создаёт директорию `target->cmd->dir` и все родительские, если их нет.
+/// 2. Создаёт директорию `target->cmd->dir` и все родительские, если их нет
+///    (при наличии `opts->dir_cache` — не чаще раза на каталог).
 /// 3. Формирует полный путь назначения: `<dir>/<name>`.
-/// 4. Если файл с таким именем уже существует в целевой директории — возвращает ошибку.
-/// 5. Перемещает файл `target->name` в сформированный путь с помощью `rename()`.
+/// 4. В зависимости от `opts->mode`:
+///    - `EXECUTE_MOVE` — если файл с таким именем уже существует,
+///      возвращает ошибку, иначе перемещает файл с помощью `rename()`;
+///    - `EXECUTE_LINK_HARD` — `linkat()`, оригинал остаётся на месте;
+///    - `EXECUTE_LINK_SYM` — `symlinkat()` на абсолютный путь оригинала;
+///    - `EXECUTE_COPY` — `copy_file()`: reflink, `copy_file_range` или
+///      `read`/`write`, способ кешируется по устройству назначения.
 ///
 /// Параметры:
 /// - `error`: указатель на переменную, в которую будет записан код ошибки.
@@ -29,50 +228,203 @@
 ///              - `EXECUTOR_ERR_CREATE_PATH` — ошибка при формировании строки пути
 ///              - `EXECUTOR_ERR_FILE_EXISTS` — файл в целевой директории уже существует
 ///              - `EXECUTOR_ERR_MV` — не удалось переместить файл
+///              - `EXECUTOR_ERR_LINK` — не удалось создать ссылку
+///              - `EXECUTOR_ERR_COPY` — не удалось скопировать файл
 ///
 /// - `target`: указатель на структуру `struct target`,
 ///             содержащую имя файла и целевую директорию через `target->cmd->dir`.
+/// - `opts`: режим и кеши; `NULL` — перемещение без кешей.
 ///
 /// Возвращает:
-/// - `0`, если файл был успешно перемещён;
+/// - `0`, если файл был успешно размещён;
 /// - `-1` при любой ошибке, подробности — в `*error`.
 ///
 /// Примечания:
 /// - Все пути считаются относительными от текущей рабочей директории.
-/// - В случае ошибок освобождаются промежуточные ресурсы (строки).
+/// - В случае ошибок освобождаются промежуточные ресурсы (строки),
+///   `errno` последнего системного вызова сохраняется.
 /// - Файл `target->name` должен существовать до вызова, иначе `rename()` вернёт ошибку.
 int
-execute(int *error, const struct target *target)
+execute_opt(int *error, const struct target *target,
+            const struct execute_options *opts)
 {
-        if (NULL == target)
+        const char    *name  = NULL == target ? NULL : target->name;
+        const char    *dir   = NULL == target ? NULL : target->cmd->dir;
+        const uint64_t start = stats_begin();
+        TN_PROBE3(execute__start, name, dir,
+                  NULL == opts ? EXECUTE_MOVE : opts->mode);
+        const int status = place_target(error, target, opts);
+        TN_PROBE4(execute__done, name, dir, status, *error);
+        stats_end(STATS_EXECUTE, start);
+        return status;
+}
+
+/// Перемещает файл в каталог `dfd` под тем же именем без перезаписи.
+/// `*noreplace` сбрасывается, если ФС не поддерживает `RENAME_NOREPLACE`
+/// (`EINVAL`) или ядро не знает `renameat2` (`ENOSYS`).
+/// @return 0 при успехе, -1 при ошибке (`errno` сохранён).
+static int
+move_at(const int dfd, const struct target *t, int *noreplace)
+{
+        int status = -1;
+        if (*noreplace)
         {
-                *error = EXECUTOR_ERR_BAD_ARG;
-                return -1;
+                status = renameat2(AT_FDCWD, target_path(t), dfd, t->name,
+                                   RENAME_NOREPLACE);
+                stats_count(STATS_SYSCALLS, 1);
+                if (-1 == status && (EINVAL == errno || ENOSYS == errno))
+                {
+                        *noreplace = 0;
+                }
         }
-        *error           = EXECUTOR_OK;
-        const int status = make_dir_recursive(target->cmd->dir);
-        if (-1 == status)
+        if (!*noreplace)
         {
-                *error = EXECUTOR_ERR_BAD_ARG;
-                return -1;
+                if (0 == faccessat(dfd, t->name, F_OK, 0))
+                {
+                        errno = EEXIST;
+                }
+                else
+                {
+                        status = renameat(AT_FDCWD, target_path(t), dfd,
+                                          t->name);
+                }
+                stats_count(STATS_SYSCALLS, EEXIST == errno ? 1 : 2);
         }
-        const char *str = concat(target->cmd->dir, "/", target->name, NULL);
-        if (NULL == str)
+        return status;
+}
+
+/// Перемещает подряд идущие файлы с одним каталогом назначения через
+/// открытый дескриптор этого каталога.
+///
+/// `renameat2(RENAME_NOREPLACE)` заменяет пару `access` + `rename`
+/// одним атомарным вызовом, а путь назначения не разбирается заново для
+/// каждого файла. Если ФС или ядро не поддерживает `RENAME_NOREPLACE`,
+/// до конца группы используется `faccessat` + `renameat`. Каталог,
+/// удалённый извне после попадания в кеш, создаётся заново
+/// (`recreate_dir`), и перемещение повторяется один раз.
+///
+/// @return Число обработанных файлов (вся группа с тем же каталогом) или
+///         0, если каталог открыть не удалось — тогда вызывающий
+///         раскладывает файлы по одному.
+static size_t
+move_group(const struct target *const *targets, const size_t count,
+           const struct execute_options *opts, struct execute_result *results)
+{
+        const char *dir = targets[0]->cmd->dir;
+        if (NULL == dir || -1 == ensure_dir(dir, opts->dir_cache))
         {
-                *error = EXECUTOR_ERR_CREATE_PATH;
-                return -1;
+                return 0;
         }
-        if (access(str, F_OK) == 0)
+        int dfd = open(dir, O_PATH | O_DIRECTORY | O_CLOEXEC);
+        stats_count(STATS_SYSCALLS, 1);
+        if (-1 == dfd && recreate_dir(dir))
         {
-                *error = EXECUTOR_ERR_FILE_EXISTS;
-                free((void *) str);
-                return -1;
+                dfd = open(dir, O_PATH | O_DIRECTORY | O_CLOEXEC);
+                stats_count(STATS_SYSCALLS, 1);
         }
-        if (-1 == rename(target->name, str))
+        if (-1 == dfd)
         {
-                *error = EXECUTOR_ERR_MV;
-                free((void *) str);
+                return 0;
+        }
+        int    noreplace = 1;
+        size_t i         = 0;
+        for (; i < count && NULL != targets[i] &&
+               NULL != targets[i]->cmd->dir &&
+               0 == strcmp(dir, targets[i]->cmd->dir);
+             ++i)
+        {
+                const struct target *t     = targets[i];
+                const uint64_t       begin = monotonic_ns();
+                const uint64_t       span  = trace_begin();
+                TN_PROBE3(execute__start, t->name, dir, EXECUTE_MOVE);
+                int status = move_at(dfd, t, &noreplace);
+                if (-1 == status && recreate_dir(dir))
+                {
+                        // прежний дескриптор указывает на удалённый каталог
+                        const int fresh =
+                            open(dir, O_PATH | O_DIRECTORY | O_CLOEXEC);
+                        stats_count(STATS_SYSCALLS, 1);
+                        if (-1 != fresh)
+                        {
+                                close(dfd);
+                                dfd    = fresh;
+                                status = move_at(dfd, t, &noreplace);
+                        }
+                        else
+                        {
+                                errno = ENOENT;
+                        }
+                }
+                struct execute_result *r = &results[i];
+                r->error  = EXECUTOR_OK;
+                r->err_no = 0;
+                if (-1 == status)
+                {
+                        r->err_no = errno;
+                        r->error  = EEXIST == errno ? EXECUTOR_ERR_FILE_EXISTS
+                                                    : EXECUTOR_ERR_MV;
+                }
+                trace_end("move", "execute", span, t->name);
+                TN_PROBE4(execute__done, t->name, dir, status, r->error);
+                r->latency_ns = monotonic_ns() - begin;
+                stats_end(STATS_RENAME, begin);
+                stats_end(STATS_EXECUTE, begin);
+        }
+        close(dfd);
+        return i;
+}
+
+/// Раскладывает пачку файлов, например все совпадения правила или
+/// пачку событий `--watch`.
+///
+/// В режиме `EXECUTE_MOVE` файлы с одним каталогом назначения (они идут
+/// подряд: `match_targets` выдаёт их по правилу) перемещаются через
+/// один дескриптор каталога, см. `move_group`. Остальные режимы и
+/// случаи, когда каталог не открылся, идут через `execute_opt` по
+/// одному файлу. Итог каждого файла — в `results[i]`.
+///
+/// @return 0, если все файлы разложены; -1, если хотя бы один нет
+///         (`*error` — код первой ошибки, подробности — в `results`).
+int
+execute_batch(int *error, const struct target *const *targets,
+              const size_t count, const struct execute_options *opts,
+              struct execute_result *results)
+{
+        *error = EXECUTOR_OK;
+        if (NULL == targets || NULL == results || NULL == opts)
+        {
+                *error = EXECUTOR_ERR_BAD_ARG;
                 return -1;
         }
+        size_t i = 0;
+        while (i < count)
+        {
+                size_t done = 0;
+                if (EXECUTE_MOVE == opts->mode && NULL != targets[i])
+                {
+                        done = move_group(targets + i, count - i, opts,
+                                          results + i);
+                }
+                if (0 == done)
+                {
+                        const uint64_t begin = monotonic_ns();
+                        struct execute_result *r = &results[i];
+                        r->err_no = -1 == execute_opt(&r->error, targets[i],
+                                                      opts)
+                                        ? errno
+                                        : 0;
+                        r->latency_ns = monotonic_ns() - begin;
+                        done          = 1;
+                }
+                i += done;
+        }
+        for (i = 0; i < count; ++i)
+        {
+                if (EXECUTOR_OK != results[i].error)
+                {
+                        *error = results[i].error;
+                        return -1;
+                }
+        }
         return 0;
 }
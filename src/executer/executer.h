@@ -1,7 +1,11 @@
 #ifndef SAPPER_H
 #define SAPPER_H
 
+#include "copy.h"
 #include "fs.h"
+#include "strset.h"
+
+#include <stdint.h>
 
 enum execute_error
 {
@@ -11,9 +15,43 @@ enum execute_error
         EXECUTOR_ERR_FILE_EXISTS,
         EXECUTOR_ERR_MV,
         EXECUTOR_ERR_CREATE_PATH,
+        EXECUTOR_ERR_LINK,
+        EXECUTOR_ERR_COPY,
+        EXECUTOR_ERRORS,
+};
+
+/// Как файл попадает в каталог назначения.
+enum execute_mode
+{
+        EXECUTE_MOVE,      /// `rename()` — исходный файл исчезает
+        EXECUTE_LINK_HARD, /// `linkat()` — оригинал остаётся на месте
+        EXECUTE_LINK_SYM,  /// `symlinkat()` на абсолютный путь оригинала
+        EXECUTE_COPY,      /// Копия (reflink, если ФС умеет), оригинал на месте
+};
+
+struct execute_options
+{
+        int                mode;       /// Значение из `enum execute_mode`
+        struct strset     *dir_cache;  /// Уже созданные каталоги; NULL — без кеша
+        struct copy_cache *copy_cache; /// Способы копирования по устройствам
+};
+
+/// Итог раскладки одного файла пачки `execute_batch`.
+struct execute_result
+{
+        int      error;      /// Значение из `enum execute_error`
+        int      err_no;     /// `errno` при ошибке, иначе 0
+        uint64_t latency_ns; /// Время раскладки этого файла
 };
 
 int
 execute(int* error, const struct target *target);
+int
+execute_opt(int *error, const struct target *target,
+            const struct execute_options *opts);
+int
+execute_batch(int *error, const struct target *const *targets, size_t count,
+              const struct execute_options *opts,
+              struct execute_result *results);
 
 #endif //SAPPER_H
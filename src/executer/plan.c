@@ -0,0 +1,288 @@
+#include "plan.h"
+
+#include "clip.h"
+#include "common.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+/// Пропускная способность копирования между устройствами (байт/с),
+/// принимаемая для оценки. Реальную скорость без копирования не измерить.
+#ifndef PLAN_COPY_RATE
+#define PLAN_COPY_RATE (100ULL * 1024 * 1024)
+#endif
+
+/// Инициализирует пустой план.
+///
+/// @param error Код ошибки (`PLAN_OK`, `PLAN_ERR_BAD_ARG`, `PLAN_ERR_MEM`).
+/// @param plan  Структура для инициализации.
+/// @return 0 при успехе, -1 при ошибке.
+int
+plan_init(int *error, struct plan *plan)
+{
+        if (NULL == plan)
+        {
+                *error = PLAN_ERR_BAD_ARG;
+                return -1;
+        }
+        memset(plan, 0, sizeof(*plan));
+        if (-1 == strset_init(&plan->known_dirs, 0) ||
+            -1 == strset_init(&plan->planned, 0))
+        {
+                strset_free(&plan->known_dirs);
+                strset_free(&plan->planned);
+                *error = PLAN_ERR_MEM;
+                return -1;
+        }
+        *error = PLAN_OK;
+        return 0;
+}
+
+/// Проходит по префиксам пути `dir` так же, как `make_dir_recursive`,
+/// и считает каталоги, которых ещё нет на диске.
+///
+/// Каждый префикс проверяется не больше одного раза за весь план:
+/// общие родители разных правил (`media/images`, `media/video`) учитываются
+/// единожды. Потомки отсутствующего каталога `stat` не требуют.
+///
+/// @param dev Устройство ближайшего существующего предка (или `.`).
+/// @return 0 при успехе, -1 при ошибке выделения памяти.
+static int
+plan_walk_dir(struct plan *plan, const char *dir, dev_t *dev)
+{
+        char        cur_path[PATH_MAX] = {'\0'};
+        struct stat st;
+        int         missing = 0;
+        *dev                = 0 == stat(".", &st) ? st.st_dev : 0;
+        char      **parts   = strtokarr(dir, '/');
+        if (NULL == parts)
+        {
+                return -1;
+        }
+        int status = 0;
+        for (char **p = parts; NULL != *p; ++p)
+        {
+                if ('\0' == **p)
+                {
+                        continue;
+                }
+                if ('\0' != cur_path[0])
+                {
+                        strncat(cur_path, "/",
+                                sizeof(cur_path) - strlen(cur_path) - 1);
+                }
+                strncat(cur_path, *p, sizeof(cur_path) - strlen(cur_path) - 1);
+                if (0 == missing)
+                {
+                        if (0 == stat(cur_path, &st))
+                        {
+                                *dev = st.st_dev;
+                                strset_add(&plan->known_dirs, cur_path);
+                                continue;
+                        }
+                        missing = 1;
+                }
+                const int added = strset_add(&plan->known_dirs, cur_path);
+                if (-1 == added)
+                {
+                        status = -1;
+                        break;
+                }
+                plan->mkdirs += (size_t) added;
+        }
+        for (char **p = parts; NULL != *p; ++p)
+        {
+                free(*p);
+        }
+        free((void *) parts);
+        return status;
+}
+
+/// Находит итоги правила `ext=dir` или заводит новые.
+/// При заведении правила обходит его каталог назначения.
+static struct plan_rule *
+plan_rule(struct plan *plan, const struct command *cmd)
+{
+        for (size_t i = 0; i < plan->rules_count; ++i)
+        {
+                struct plan_rule *r = &plan->rules[i];
+                if (0 == strcmp(r->ext, cmd->ext) &&
+                    0 == strcmp(r->dir, cmd->dir))
+                {
+                        return r;
+                }
+        }
+        struct plan_rule *rules = realloc(
+            plan->rules, (plan->rules_count + 1) * sizeof(struct plan_rule));
+        if (NULL == rules)
+        {
+                return NULL;
+        }
+        plan->rules         = rules;
+        struct plan_rule *r = &rules[plan->rules_count];
+        memset(r, 0, sizeof(*r));
+        r->ext = strcopy(cmd->ext);
+        r->dir = strcopy(cmd->dir);
+        if (NULL == r->ext || NULL == r->dir ||
+            -1 == plan_walk_dir(plan, cmd->dir, &r->dev))
+        {
+                free(r->ext);
+                free(r->dir);
+                return NULL;
+        }
+        ++plan->rules_count;
+        return r;
+}
+
+/// Учитывает в плане один найденный файл, ничего не меняя на диске.
+///
+/// Для файла определяется:
+/// - правило, к которому он относится (счётчики файлов и байт);
+///   файл, уже учтённый предыдущим правилом, пропускается — как и в
+///   настоящем прогоне, где его переместит первое подходящее правило;
+/// - конфликт имён в каталоге назначения (тот же `access`, что в `execute`);
+/// - потребуется ли копирование между устройствами: `rename()` вернёт
+///   `EXDEV`, если устройство файла отличается от устройства ближайшего
+///   существующего каталога на пути назначения.
+///
+/// @param error  Код ошибки (`PLAN_OK`, `PLAN_ERR_BAD_ARG`, `PLAN_ERR_MEM`).
+/// @param plan   Инициализированный план.
+/// @param target Найденный `find_target` файл.
+/// @return 0 при успехе (в том числе если файл уже учтён), -1 при ошибке.
+int
+plan_add(int *error, struct plan *plan, const struct target *target)
+{
+        if (NULL == plan || NULL == target || NULL == target->cmd)
+        {
+                *error = PLAN_ERR_BAD_ARG;
+                return -1;
+        }
+        *error          = PLAN_OK;
+        const int fresh = strset_add(&plan->planned, target->name);
+        if (0 == fresh)
+        {
+                return 0;
+        }
+        struct plan_rule *const r = plan_rule(plan, target->cmd);
+        if (-1 == fresh || NULL == r)
+        {
+                *error = PLAN_ERR_MEM;
+                return -1;
+        }
+        ++r->files;
+        r->bytes += (unsigned long long) target->size;
+        ++plan->files;
+        plan->bytes += (unsigned long long) target->size;
+        if (target->dev != r->dev)
+        {
+                ++plan->cross_dev;
+                plan->cross_bytes += (unsigned long long) target->size;
+        }
+        const char *dst = concat(target->cmd->dir, "/", target->name, NULL);
+        if (NULL == dst)
+        {
+                *error = PLAN_ERR_MEM;
+                return -1;
+        }
+        if (0 == access(dst, F_OK))
+        {
+                ++plan->conflicts;
+        }
+        free((void *) dst);
+        return 0;
+}
+
+/// Учитывает замер чтения каталога: `entries` записей за `elapsed_ns`.
+void
+plan_scan(struct plan *plan, const uint64_t elapsed_ns, const size_t entries)
+{
+        plan->scan_ns += elapsed_ns;
+        plan->entries += entries;
+}
+
+/// Учитывает замер сопоставления правила со снимком каталога: `matched`
+/// файлов совпало за `elapsed_ns`.
+void
+plan_match(struct plan *plan, const uint64_t elapsed_ns, const size_t matched)
+{
+        plan->match_ns += elapsed_ns;
+        plan->matched += matched;
+}
+
+/// Оценивает длительность настоящего прогона по измеренным скоростям.
+///
+/// Чтение каталога стоит своё на каждую запись, совпала она или нет.
+/// Каждый совпавший файл стоил сопоставлению одного обращения к
+/// метаданным (`stat`); `rename` и `mkdir` оцениваются той же ценой.
+/// Перемещения между устройствами добавляют копирование со скоростью
+/// `PLAN_COPY_RATE`.
+///
+/// @return Оценка в наносекундах; 0, если каталог не читался.
+uint64_t
+plan_estimate_ns(const struct plan *plan)
+{
+        if (0 == plan->entries)
+        {
+                return 0;
+        }
+        const uint64_t per_entry = plan->scan_ns / plan->entries;
+        const uint64_t per_file =
+            0 == plan->matched ? 0 : plan->match_ns / plan->matched;
+        const uint64_t ops =
+            (uint64_t) (plan->matched + plan->files + plan->mkdirs);
+        return per_entry * plan->entries + per_file * ops +
+               plan->cross_bytes * 1000000000ULL / PLAN_COPY_RATE;
+}
+
+/// Печатает отчёт холостого прогона в `out`.
+void
+plan_print(const struct plan *plan, FILE *out)
+{
+        fprintf(out, "Холостой прогон: изменения на диск не вносятся\n");
+        for (size_t i = 0; i < plan->rules_count; ++i)
+        {
+                const struct plan_rule *r = &plan->rules[i];
+                fprintf(out, "  %s → %s: файлов %zu, байт %llu\n", r->ext,
+                        r->dir, r->files, r->bytes);
+        }
+        fprintf(out, "Итого: файлов %zu, байт %llu\n", plan->files,
+                plan->bytes);
+        fprintf(out, "Будет создано каталогов: %zu\n", plan->mkdirs);
+        fprintf(out, "Конфликтов имён: %zu\n", plan->conflicts);
+        fprintf(out, "Перемещений между устройствами: %zu (байт: %llu)\n",
+                plan->cross_dev, plan->cross_bytes);
+        if (0 != plan->scan_ns)
+        {
+                fprintf(out, "Скорость сканирования: %.0f записей/с\n",
+                        (double) plan->entries * 1e9 / (double) plan->scan_ns);
+        }
+        fprintf(out, "Оценка времени выполнения: %.3f с\n",
+                (double) plan_estimate_ns(plan) / 1e9);
+}
+
+/// Освобождает память плана. Повторный вызов безопасен.
+void
+plan_free(struct plan *plan)
+{
+        if (NULL == plan)
+        {
+                return;
+        }
+        for (size_t i = 0; i < plan->rules_count; ++i)
+        {
+                free(plan->rules[i].ext);
+                free(plan->rules[i].dir);
+        }
+        free(plan->rules);
+        plan->rules       = NULL;
+        plan->rules_count = 0;
+        strset_free(&plan->known_dirs);
+        strset_free(&plan->planned);
+}
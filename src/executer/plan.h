@@ -0,0 +1,61 @@
+#ifndef PLAN_H
+#define PLAN_H
+
+#include "fs.h"
+#include "strset.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+enum plan_error
+{
+        PLAN_OK,
+        PLAN_ERR_BAD_ARG,
+        PLAN_ERR_MEM,
+};
+
+/// Итоги по одному правилу `ext=dir`.
+struct plan_rule
+{
+        char              *ext;
+        char              *dir;
+        size_t             files;
+        unsigned long long bytes;
+        dev_t              dev; /// Устройство каталога назначения
+};
+
+/// Результат холостого прогона: что было бы сделано и сколько это стоит.
+struct plan
+{
+        struct plan_rule  *rules;
+        size_t             rules_count;
+        size_t             files;
+        unsigned long long bytes;
+        size_t             conflicts;   /// Файл уже есть в каталоге назначения
+        size_t             cross_dev;   /// Перемещения между устройствами
+        unsigned long long cross_bytes; /// Объём копирования между устройствами
+        size_t             mkdirs;      /// Каталоги, которые будут созданы
+        struct strset      known_dirs;  /// Уже проверенные префиксы путей
+        struct strset      planned;     /// Уже учтённые имена файлов
+        uint64_t           scan_ns;     /// Суммарное время чтения каталога
+        size_t             entries;     /// Прочитано записей каталога
+        uint64_t           match_ns;    /// Суммарное время сопоставления
+        size_t             matched;     /// Совпавших файлов (по `stat`)
+};
+
+int
+plan_init(int *error, struct plan *plan);
+int
+plan_add(int *error, struct plan *plan, const struct target *target);
+void
+plan_scan(struct plan *plan, uint64_t elapsed_ns, size_t entries);
+void
+plan_match(struct plan *plan, uint64_t elapsed_ns, size_t matched);
+uint64_t
+plan_estimate_ns(const struct plan *plan);
+void
+plan_print(const struct plan *plan, FILE *out);
+void
+plan_free(struct plan *plan);
+
+#endif //PLAN_H
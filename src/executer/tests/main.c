@@ -1,4 +1,6 @@
+#include "test_copy.h"
 #include "test_executor.h"
+#include "test_plan.h"
 
 #include "unity.h"
 
@@ -21,6 +23,23 @@ main(void)
         RUN_TEST(test_execute_file_exists);
         RUN_TEST(test_execute_rename_failure);
         RUN_TEST(test_execute_success);
+        RUN_TEST(test_execute_link_hard);
+        RUN_TEST(test_execute_link_sym);
+        RUN_TEST(test_execute_dir_cache);
+        RUN_TEST(test_execute_batch);
+        RUN_TEST(test_execute_batch_enosys);
+        RUN_TEST(test_execute_claim_workers);
+        RUN_TEST(test_execute_claim_long_name);
+        RUN_TEST(test_execute_claim_stale_own_pid);
+        RUN_TEST(test_copy_file_content);
+        RUN_TEST(test_copy_file_exists);
+        RUN_TEST(test_copy_file_missing_source);
+        RUN_TEST(test_copy_cache_per_device);
+        RUN_TEST(test_execute_copy_mode);
+        RUN_TEST(test_plan_null_args);
+        RUN_TEST(test_plan_counts_rule_and_mkdirs);
+        RUN_TEST(test_plan_conflict_and_duplicate);
+        RUN_TEST(test_plan_estimate);
 
         UNITY_END();
         return 0;
@@ -0,0 +1,123 @@
+#include "test_copy.h"
+
+#include "clip.h"
+#include "copy.h"
+#include "executer.h"
+#include "unity.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define TMP_SRC      "tmp_copy_src.txt"
+#define TMP_DST      "tmp_copy_dst.txt"
+#define TMP_DIR_NAME "tmp_copy_dir"
+#define BIG_SIZE     (300 * 1024)
+
+static void
+write_file(const char *name, const char *data, const size_t len)
+{
+        FILE *f = fopen(name, "wb");
+        TEST_ASSERT_NOT_NULL(f);
+        TEST_ASSERT_EQUAL_UINT(len, fwrite(data, 1, len, f));
+        fclose(f);
+}
+
+static void
+assert_same_content(const char *name, const char *data, const size_t len)
+{
+        char *buf = malloc(len + 1);
+        TEST_ASSERT_NOT_NULL(buf);
+        FILE *f = fopen(name, "rb");
+        TEST_ASSERT_NOT_NULL(f);
+        TEST_ASSERT_EQUAL_UINT(len, fread(buf, 1, len + 1, f));
+        fclose(f);
+        TEST_ASSERT_EQUAL_MEMORY(data, buf, len);
+        free(buf);
+}
+
+void
+test_copy_file_content(void)
+{
+        char *data = malloc(BIG_SIZE);
+        TEST_ASSERT_NOT_NULL(data);
+        for (size_t i = 0; i < BIG_SIZE; ++i)
+        {
+                data[i] = (char) (i * 31);
+        }
+        write_file(TMP_SRC, data, BIG_SIZE);
+        int method = COPY_UNKNOWN;
+        TEST_ASSERT_EQUAL_INT(0, copy_file(TMP_SRC, TMP_DST, NULL, &method));
+        TEST_ASSERT_NOT_EQUAL(COPY_UNKNOWN, method);
+        assert_same_content(TMP_DST, data, BIG_SIZE);
+        TEST_ASSERT_EQUAL_INT(0, access(TMP_SRC, F_OK));
+        remove(TMP_SRC);
+        remove(TMP_DST);
+        free(data);
+}
+
+void
+test_copy_file_exists(void)
+{
+        write_file(TMP_SRC, "new", 3);
+        write_file(TMP_DST, "old", 3);
+        int method = COPY_UNKNOWN;
+        TEST_ASSERT_EQUAL_INT(-1, copy_file(TMP_SRC, TMP_DST, NULL, &method));
+        TEST_ASSERT_EQUAL_INT(EEXIST, errno);
+        assert_same_content(TMP_DST, "old", 3);
+        remove(TMP_SRC);
+        remove(TMP_DST);
+}
+
+void
+test_copy_file_missing_source(void)
+{
+        int method = COPY_UNKNOWN;
+        TEST_ASSERT_EQUAL_INT(
+            -1, copy_file("tmp_copy_missing.txt", TMP_DST, NULL, &method));
+        TEST_ASSERT_EQUAL_INT(-1, access(TMP_DST, F_OK));
+}
+
+void
+test_copy_cache_per_device(void)
+{
+        struct copy_cache cache  = {0};
+        int               method = COPY_UNKNOWN;
+        write_file(TMP_SRC, "cached", 6);
+        TEST_ASSERT_EQUAL_INT(0, copy_file(TMP_SRC, TMP_DST, &cache, &method));
+        TEST_ASSERT_EQUAL_UINT(1, cache.count);
+        TEST_ASSERT_EQUAL_INT(method, cache.probes[0].method);
+        remove(TMP_DST);
+        // второе копирование на то же устройство не заводит новую запись
+        TEST_ASSERT_EQUAL_INT(0, copy_file(TMP_SRC, TMP_DST, &cache, &method));
+        TEST_ASSERT_EQUAL_UINT(1, cache.count);
+        TEST_ASSERT_EQUAL_INT(method, cache.probes[0].method);
+        assert_same_content(TMP_DST, "cached", 6);
+        copy_cache_free(&cache);
+        remove(TMP_SRC);
+        remove(TMP_DST);
+}
+
+void
+test_execute_copy_mode(void)
+{
+        write_file(TMP_SRC, "keep", 4);
+        struct copy_cache            cache = {0};
+        struct command               cmd   = {.ext = "txt", .dir = TMP_DIR_NAME};
+        const struct target          t     = {.name = TMP_SRC, .cmd = &cmd};
+        const struct execute_options opts  = {.mode       = EXECUTE_COPY,
+                                              .copy_cache = &cache};
+        int                          err   = 0;
+        TEST_ASSERT_EQUAL_INT(0, execute_opt(&err, &t, &opts));
+        assert_same_content(TMP_DIR_NAME "/" TMP_SRC, "keep", 4);
+        TEST_ASSERT_EQUAL_INT(0, access(TMP_SRC, F_OK));
+        TEST_ASSERT_EQUAL_INT(-1, execute_opt(&err, &t, &opts));
+        TEST_ASSERT_EQUAL_INT(EXECUTOR_ERR_FILE_EXISTS, err);
+        copy_cache_free(&cache);
+        remove(TMP_DIR_NAME "/" TMP_SRC);
+        remove(TMP_SRC);
+        rmdir(TMP_DIR_NAME);
+}
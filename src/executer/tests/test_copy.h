@@ -0,0 +1,15 @@
+#ifndef TEST_COPY_H
+#define TEST_COPY_H
+
+void
+test_copy_file_content(void);
+void
+test_copy_file_exists(void);
+void
+test_copy_file_missing_source(void);
+void
+test_copy_cache_per_device(void);
+void
+test_execute_copy_mode(void);
+
+#endif //TEST_COPY_H
@@ -1,14 +1,27 @@
+#define _XOPEN_SOURCE 700
+
 #include "test_executor.h"
 
+#include "claim.h"
 #include "clip.h"
 #include "common.h"
 #include "executer.h"
 #include "unity.h"
 
+#include <errno.h>
+#include <limits.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
+#include <sys/prctl.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <sys/xattr.h>
 
 #define TMP_FILE_NAME "tmp_test_file.txt"
 #define TMP_DIR_NAME  "tmp_test_dir"
@@ -105,3 +118,453 @@ test_execute_success(void)
         free(dst);
         rmdir(TMP_DIR_NAME);
 }
+
+void
+test_execute_link_hard(void)
+{
+        FILE *f = fopen(TMP_FILE_NAME, "w");
+        TEST_ASSERT_NOT_NULL(f);
+        fprintf(f, "linked");
+        fclose(f);
+        struct command               cmd  = {.ext = "txt", .dir = TMP_DIR_NAME};
+        const struct target          t    = {.name = TMP_FILE_NAME, .cmd = &cmd};
+        const struct execute_options opts = {.mode = EXECUTE_LINK_HARD};
+        int                          err  = 0;
+        TEST_ASSERT_EQUAL_INT(0, execute_opt(&err, &t, &opts));
+        struct stat src, dst;
+        TEST_ASSERT_EQUAL_INT(0, stat(TMP_FILE_NAME, &src));
+        TEST_ASSERT_EQUAL_INT(0, stat(TMP_DIR_NAME "/" TMP_FILE_NAME, &dst));
+        TEST_ASSERT_TRUE(src.st_ino == dst.st_ino);
+        // повторная ссылка упирается в существующий файл
+        TEST_ASSERT_EQUAL_INT(-1, execute_opt(&err, &t, &opts));
+        TEST_ASSERT_EQUAL_INT(EXECUTOR_ERR_FILE_EXISTS, err);
+        remove(TMP_DIR_NAME "/" TMP_FILE_NAME);
+        remove(TMP_FILE_NAME);
+        rmdir(TMP_DIR_NAME);
+}
+
+void
+test_execute_link_sym(void)
+{
+        FILE *f = fopen(TMP_FILE_NAME, "w");
+        TEST_ASSERT_NOT_NULL(f);
+        fprintf(f, "sym");
+        fclose(f);
+        struct command               cmd  = {.ext = "txt", .dir = TMP_DIR_NAME};
+        const struct target          t    = {.name = TMP_FILE_NAME, .cmd = &cmd};
+        const struct execute_options opts = {.mode = EXECUTE_LINK_SYM};
+        int                          err  = 0;
+        TEST_ASSERT_EQUAL_INT(0, execute_opt(&err, &t, &opts));
+        struct stat st;
+        TEST_ASSERT_EQUAL_INT(0, lstat(TMP_DIR_NAME "/" TMP_FILE_NAME, &st));
+        TEST_ASSERT_TRUE(S_ISLNK(st.st_mode));
+        TEST_ASSERT_EQUAL_INT(0, access(TMP_DIR_NAME "/" TMP_FILE_NAME, R_OK));
+        TEST_ASSERT_EQUAL_INT(0, access(TMP_FILE_NAME, F_OK));
+        remove(TMP_DIR_NAME "/" TMP_FILE_NAME);
+        remove(TMP_FILE_NAME);
+        rmdir(TMP_DIR_NAME);
+}
+
+void
+test_execute_dir_cache(void)
+{
+        struct strset cache;
+        TEST_ASSERT_EQUAL_INT(0, strset_init(&cache, 0));
+        FILE *f = fopen(TMP_FILE_NAME, "w");
+        TEST_ASSERT_NOT_NULL(f);
+        fclose(f);
+        struct command               cmd  = {.ext = "txt", .dir = TMP_DIR_NAME};
+        const struct target          t    = {.name = TMP_FILE_NAME, .cmd = &cmd};
+        const struct execute_options opts = {.mode      = EXECUTE_MOVE,
+                                             .dir_cache = &cache};
+        int                          err  = 0;
+        TEST_ASSERT_EQUAL_INT(0, execute_opt(&err, &t, &opts));
+        TEST_ASSERT_EQUAL_INT(1, strset_contains(&cache, TMP_DIR_NAME));
+        remove(TMP_DIR_NAME "/" TMP_FILE_NAME);
+        // каталог из кеша удалили извне: он создаётся заново и по одному
+        // файлу, и пачкой
+        TEST_ASSERT_EQUAL_INT(0, rmdir(TMP_DIR_NAME));
+        f = fopen(TMP_FILE_NAME, "w");
+        TEST_ASSERT_NOT_NULL(f);
+        fclose(f);
+        TEST_ASSERT_EQUAL_INT(0, execute_opt(&err, &t, &opts));
+        TEST_ASSERT_EQUAL_INT(0, access(TMP_DIR_NAME "/" TMP_FILE_NAME, F_OK));
+        remove(TMP_DIR_NAME "/" TMP_FILE_NAME);
+        TEST_ASSERT_EQUAL_INT(0, rmdir(TMP_DIR_NAME));
+        f = fopen(TMP_FILE_NAME, "w");
+        TEST_ASSERT_NOT_NULL(f);
+        fclose(f);
+        const struct target  *ts[] = {&t};
+        struct execute_result res;
+        TEST_ASSERT_EQUAL_INT(0, execute_batch(&err, ts, 1, &opts, &res));
+        TEST_ASSERT_EQUAL_INT(0, access(TMP_DIR_NAME "/" TMP_FILE_NAME, F_OK));
+        remove(TMP_DIR_NAME "/" TMP_FILE_NAME);
+        rmdir(TMP_DIR_NAME);
+        strset_free(&cache);
+}
+
+void
+test_execute_batch(void)
+{
+        const char *names[] = {"tmp_batch_a.txt", "tmp_batch_b.txt",
+                               "tmp_batch_c.txt"};
+        for (size_t i = 0; i < 3; ++i)
+        {
+                FILE *f = fopen(names[i], "w");
+                TEST_ASSERT_NOT_NULL(f);
+                fclose(f);
+        }
+        mkdir(TMP_DIR_NAME, 0755);
+        // второй файл уже есть в каталоге назначения
+        FILE *f = fopen(TMP_DIR_NAME "/tmp_batch_b.txt", "w");
+        TEST_ASSERT_NOT_NULL(f);
+        fclose(f);
+        struct command               cmd  = {.ext = "txt", .dir = TMP_DIR_NAME};
+        const struct target          a    = {.name = "tmp_batch_a.txt", .cmd = &cmd};
+        const struct target          b    = {.name = "tmp_batch_b.txt", .cmd = &cmd};
+        const struct target          c    = {.name = "tmp_batch_c.txt", .cmd = &cmd};
+        const struct target         *ts[] = {&a, &b, &c};
+        const struct execute_options opts = {.mode = EXECUTE_MOVE};
+        struct execute_result        res[3];
+        int                          err = 0;
+        TEST_ASSERT_EQUAL_INT(-1, execute_batch(&err, ts, 3, &opts, res));
+        TEST_ASSERT_EQUAL_INT(EXECUTOR_ERR_FILE_EXISTS, err);
+        TEST_ASSERT_EQUAL_INT(EXECUTOR_OK, res[0].error);
+        TEST_ASSERT_EQUAL_INT(EXECUTOR_ERR_FILE_EXISTS, res[1].error);
+        TEST_ASSERT_EQUAL_INT(EXECUTOR_OK, res[2].error);
+        TEST_ASSERT_EQUAL_INT(0, access(TMP_DIR_NAME "/tmp_batch_a.txt", F_OK));
+        TEST_ASSERT_EQUAL_INT(0, access(TMP_DIR_NAME "/tmp_batch_c.txt", F_OK));
+        // файл, который не удалось переместить, остаётся на месте
+        TEST_ASSERT_EQUAL_INT(0, access("tmp_batch_b.txt", F_OK));
+        for (size_t i = 0; i < 3; ++i)
+        {
+                char *path = concat(TMP_DIR_NAME, "/", names[i], NULL);
+                remove(path);
+                free(path);
+        }
+        remove("tmp_batch_b.txt");
+        rmdir(TMP_DIR_NAME);
+}
+
+/// Код выхода дочернего процесса, если фильтр `seccomp` недоступен.
+#define NO_SECCOMP 77
+
+/// Заставляет `renameat2` с флагами завершаться с `ENOSYS`, как на ядре
+/// без этого вызова. `renameat2` без флагов и остальные вызовы
+/// разрешены. Младшее слово `args[4]` — на little-endian. glibc
+/// превращает `ENOSYS` вызова с флагами в `EINVAL`, musl отдаёт как есть.
+/// \return 0 при успехе, -1, если фильтр не установлен
+static int
+deny_renameat2(void)
+{
+        struct sock_filter filter[] = {
+            BPF_STMT(BPF_LD | BPF_W | BPF_ABS,
+                     offsetof(struct seccomp_data, nr)),
+            BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, __NR_renameat2, 0, 3),
+            BPF_STMT(BPF_LD | BPF_W | BPF_ABS,
+                     offsetof(struct seccomp_data, args[4])),
+            BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 1, 0),
+            BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ERRNO | ENOSYS),
+            BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW),
+        };
+        const struct sock_fprog prog = {
+            .len    = (unsigned short) (sizeof(filter) / sizeof(filter[0])),
+            .filter = filter,
+        };
+        if (-1 == prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) ||
+            -1 == prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &prog))
+        {
+                return -1;
+        }
+        return 0;
+}
+
+void
+test_execute_batch_enosys(void)
+{
+        const char *names[] = {"tmp_batch_a.txt", "tmp_batch_b.txt",
+                               "tmp_batch_c.txt"};
+        for (size_t i = 0; i < 3; ++i)
+        {
+                FILE *f = fopen(names[i], "w");
+                TEST_ASSERT_NOT_NULL(f);
+                fclose(f);
+        }
+        mkdir(TMP_DIR_NAME, 0755);
+        FILE *f = fopen(TMP_DIR_NAME "/tmp_batch_b.txt", "w");
+        TEST_ASSERT_NOT_NULL(f);
+        fclose(f);
+        // фильтр нельзя снять, поэтому пачка раскладывается в дочернем
+        // процессе
+        const pid_t pid = fork();
+        TEST_ASSERT_NOT_EQUAL(-1, pid);
+        if (0 == pid)
+        {
+                if (-1 == deny_renameat2())
+                {
+                        _exit(NO_SECCOMP);
+                }
+                struct command               cmd  = {.ext = "txt",
+                                                     .dir = TMP_DIR_NAME};
+                const struct target          a    = {.name = "tmp_batch_a.txt",
+                                                     .cmd  = &cmd};
+                const struct target          b    = {.name = "tmp_batch_b.txt",
+                                                     .cmd  = &cmd};
+                const struct target          c    = {.name = "tmp_batch_c.txt",
+                                                     .cmd  = &cmd};
+                const struct target         *ts[] = {&a, &b, &c};
+                const struct execute_options opts = {.mode = EXECUTE_MOVE};
+                struct execute_result        res[3];
+                int                          err = 0;
+                execute_batch(&err, ts, 3, &opts, res);
+                // запасной путь перемещает файлы и не перезаписывает
+                // существующий
+                _exit(EXECUTOR_OK == res[0].error &&
+                              EXECUTOR_ERR_FILE_EXISTS == res[1].error &&
+                              EXECUTOR_OK == res[2].error &&
+                              0 == access(TMP_DIR_NAME "/tmp_batch_a.txt",
+                                          F_OK) &&
+                              0 == access(TMP_DIR_NAME "/tmp_batch_c.txt",
+                                          F_OK) &&
+                              0 == access("tmp_batch_b.txt", F_OK)
+                          ? 0
+                          : 1);
+        }
+        int status = 0;
+        TEST_ASSERT_EQUAL_INT(pid, waitpid(pid, &status, 0));
+        for (size_t i = 0; i < 3; ++i)
+        {
+                char *path = concat(TMP_DIR_NAME, "/", names[i], NULL);
+                remove(path);
+                free(path);
+                remove(names[i]);
+        }
+        rmdir(TMP_DIR_NAME);
+        TEST_ASSERT_TRUE(WIFEXITED(status));
+        if (NO_SECCOMP == WEXITSTATUS(status))
+        {
+                TEST_IGNORE_MESSAGE("seccomp недоступен");
+        }
+        TEST_ASSERT_EQUAL_INT(0, WEXITSTATUS(status));
+}
+
+#define CLAIM_FILES   400
+#define CLAIM_WORKERS 4
+
+/// Один экземпляр над общим каталогом: захват и перемещение, пока
+/// подходящие файлы не кончатся. Пишет в `out` число перемещённых.
+static void
+claim_worker(const int out)
+{
+        struct claimer c;
+        if (-1 == claim_init(&c))
+        {
+                _exit(2);
+        }
+        size_t                       moved  = 0;
+        int                          failed = 0;
+        const struct command         cmd    = {.ext = "txt", .dir = "out"};
+        const struct execute_options opts   = {.mode = EXECUTE_MOVE};
+        struct dir_scan              scan;
+        while (0 == scan_dir(&scan))
+        {
+                struct target **targets = match_targets(&scan, &cmd);
+                scan_free(&scan);
+                if (NULL == targets)
+                {
+                        break;
+                }
+                for (struct target **t = targets; *t; ++t)
+                {
+                        int error = 0;
+                        if (1 != claim_target(&error, &c, *t))
+                        {
+                                continue;
+                        }
+                        if (0 == execute_opt(&error, *t, &opts))
+                        {
+                                ++moved;
+                        }
+                        else
+                        {
+                                failed = 1;
+                                claim_release(&error, *t);
+                        }
+                }
+                free_targets(targets);
+        }
+        failed |= (ssize_t) sizeof(moved) != write(out, &moved, sizeof(moved));
+        _exit(failed);
+}
+
+void
+test_execute_claim_workers(void)
+{
+        TEST_ASSERT_EQUAL_INT(0, mkdir("tmp_claim", 0755));
+        TEST_ASSERT_EQUAL_INT(0, chdir("tmp_claim"));
+        char name[32];
+        for (int i = 0; i < CLAIM_FILES; ++i)
+        {
+                snprintf(name, sizeof(name), "f%03d.txt", i);
+                FILE *f = fopen(name, "w");
+                TEST_ASSERT_NOT_NULL(f);
+                fprintf(f, "%d", i);
+                fclose(f);
+        }
+        int fds[2];
+        TEST_ASSERT_EQUAL_INT(0, pipe(fds));
+        for (int i = 0; i < CLAIM_WORKERS; ++i)
+        {
+                const pid_t pid = fork();
+                TEST_ASSERT_NOT_EQUAL(-1, pid);
+                if (0 == pid)
+                {
+                        close(fds[0]);
+                        claim_worker(fds[1]);
+                }
+        }
+        close(fds[1]);
+        size_t total = 0;
+        size_t moved = 0;
+        while (sizeof(moved) == read(fds[0], &moved, sizeof(moved)))
+        {
+                total += moved;
+        }
+        close(fds[0]);
+        for (int i = 0; i < CLAIM_WORKERS; ++i)
+        {
+                int status = 0;
+                TEST_ASSERT_NOT_EQUAL(-1, wait(&status));
+                TEST_ASSERT_TRUE(WIFEXITED(status));
+                TEST_ASSERT_EQUAL_INT(0, WEXITSTATUS(status));
+        }
+        // каждый файл перемещён ровно одним экземпляром, ничего не
+        // осталось ни под исходным именем, ни под именем захвата
+        TEST_ASSERT_EQUAL_UINT(CLAIM_FILES, total);
+        struct dir_scan scan;
+        TEST_ASSERT_EQUAL_INT(0, scan_dir(&scan));
+        TEST_ASSERT_EQUAL_UINT(0, scan.count);
+        scan_free(&scan);
+        for (int i = 0; i < CLAIM_FILES; ++i)
+        {
+                snprintf(name, sizeof(name), "out/f%03d.txt", i);
+                TEST_ASSERT_EQUAL_INT(0, access(name, F_OK));
+                remove(name);
+        }
+        rmdir("out");
+        TEST_ASSERT_EQUAL_INT(0, chdir(".."));
+        rmdir("tmp_claim");
+}
+
+/// Имя в 250 байт с префиксом захвата не влезает в `NAME_MAX`: захват
+/// идёт под именем с хешем, снимается, восстанавливается после падения
+/// процесса и переносится вместе с файлом.
+void
+test_execute_claim_long_name(void)
+{
+        TEST_ASSERT_EQUAL_INT(0, mkdir("tmp_claim_long", 0755));
+        TEST_ASSERT_EQUAL_INT(0, chdir("tmp_claim_long"));
+        char name[251];
+        memset(name, 'a', sizeof(name) - 5);
+        strcpy(name + sizeof(name) - 5, ".txt");
+        FILE *f = fopen(name, "w");
+        TEST_ASSERT_NOT_NULL(f);
+        fclose(f);
+
+        struct claimer c;
+        TEST_ASSERT_EQUAL_INT(0, claim_init(&c));
+        struct command cmd   = {.ext = "txt", .dir = "out"};
+        struct target  t     = {.name = name, .cmd = &cmd};
+        int            error = 0;
+        TEST_ASSERT_EQUAL_INT(1, claim_target(&error, &c, &t));
+        TEST_ASSERT_TRUE(NAME_MAX >= strlen(t.claim));
+        TEST_ASSERT_EQUAL_INT(0, access(t.claim, F_OK));
+        TEST_ASSERT_EQUAL_INT(0, claim_release(&error, &t));
+        TEST_ASSERT_NULL(t.claim);
+        TEST_ASSERT_EQUAL_INT(0, access(name, F_OK));
+        TEST_ASSERT_EQUAL_INT(-1, getxattr(name, CLAIM_XATTR, NULL, 0));
+
+        // захват процесса, завершившегося без снятия
+        const pid_t pid = fork();
+        TEST_ASSERT_NOT_EQUAL(-1, pid);
+        if (0 == pid)
+        {
+                struct claimer child;
+                _exit(0 == claim_init(&child) &&
+                              1 == claim_target(&error, &child, &t)
+                          ? 0
+                          : 1);
+        }
+        int status = 0;
+        TEST_ASSERT_EQUAL_INT(pid, waitpid(pid, &status, 0));
+        TEST_ASSERT_EQUAL_INT(0, WEXITSTATUS(status));
+        TEST_ASSERT_EQUAL_INT(-1, access(name, F_OK));
+        TEST_ASSERT_EQUAL_UINT(1, claim_recover(&c));
+        TEST_ASSERT_EQUAL_INT(0, access(name, F_OK));
+
+        const struct execute_options opts = {.mode = EXECUTE_MOVE};
+        TEST_ASSERT_EQUAL_INT(1, claim_target(&error, &c, &t));
+        TEST_ASSERT_EQUAL_INT(0, execute_opt(&error, &t, &opts));
+        claim_moved(&t);
+        TEST_ASSERT_NULL(t.claim);
+        struct dir_scan scan;
+        TEST_ASSERT_EQUAL_INT(0, scan_dir(&scan));
+        TEST_ASSERT_EQUAL_UINT(0, scan.count);
+        scan_free(&scan);
+        TEST_ASSERT_EQUAL_INT(0, chdir("out"));
+        TEST_ASSERT_EQUAL_INT(-1, getxattr(name, CLAIM_XATTR, NULL, 0));
+        TEST_ASSERT_EQUAL_INT(0, remove(name));
+        TEST_ASSERT_EQUAL_INT(0, chdir(".."));
+        rmdir("out");
+        TEST_ASSERT_EQUAL_INT(0, chdir(".."));
+        rmdir("tmp_claim_long");
+}
+
+/// Создаёт файл с содержимым `data`.
+static void
+put_file(const char *name, const char *data)
+{
+        FILE *f = fopen(name, "w");
+        TEST_ASSERT_NOT_NULL(f);
+        fputs(data, f);
+        fclose(f);
+}
+
+/// Захват, брошенный прежним процессом с тем же pid: новый захват того
+/// же имени его не перезаписывает, а `claim_recover` при запуске
+/// возвращает файл.
+void
+test_execute_claim_stale_own_pid(void)
+{
+        TEST_ASSERT_EQUAL_INT(0, mkdir("tmp_claim_stale", 0755));
+        TEST_ASSERT_EQUAL_INT(0, chdir("tmp_claim_stale"));
+        struct claimer c;
+        TEST_ASSERT_EQUAL_INT(0, claim_init(&c));
+        char stale[96];
+        snprintf(stale, sizeof(stale), "%sx.txt", c.prefix);
+        put_file(stale, "old");
+        put_file("x.txt", "new");
+
+        struct command cmd    = {.ext = "txt", .dir = "out"};
+        char           name[] = "x.txt";
+        struct target  t      = {.name = name, .cmd = &cmd};
+        int            error  = 0;
+        TEST_ASSERT_EQUAL_INT(-1, claim_target(&error, &c, &t));
+        TEST_ASSERT_EQUAL_INT(CLAIM_ERR_RENAME, error);
+        TEST_ASSERT_NULL(t.claim);
+        TEST_ASSERT_EQUAL_INT(0, access("x.txt", F_OK));
+        TEST_ASSERT_EQUAL_INT(0, access(stale, F_OK));
+
+        TEST_ASSERT_EQUAL_INT(0, rename("x.txt", "y.txt"));
+        TEST_ASSERT_EQUAL_UINT(1, claim_recover(&c));
+        char  buf[8] = {0};
+        FILE *f      = fopen("x.txt", "r");
+        TEST_ASSERT_NOT_NULL(f);
+        TEST_ASSERT_NOT_NULL(fgets(buf, sizeof(buf), f));
+        fclose(f);
+        TEST_ASSERT_EQUAL_STRING("old", buf);
+        remove("x.txt");
+        remove("y.txt");
+        TEST_ASSERT_EQUAL_INT(0, chdir(".."));
+        rmdir("tmp_claim_stale");
+}
@@ -13,5 +13,21 @@ void
 test_execute_rename_failure(void);
 void
 test_execute_success(void);
+void
+test_execute_link_hard(void);
+void
+test_execute_link_sym(void);
+void
+test_execute_dir_cache(void);
+void
+test_execute_batch(void);
+void
+test_execute_batch_enosys(void);
+void
+test_execute_claim_workers(void);
+void
+test_execute_claim_long_name(void);
+void
+test_execute_claim_stale_own_pid(void);
 
 #endif //TEST_EXECUTOR_H
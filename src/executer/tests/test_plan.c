@@ -0,0 +1,91 @@
+#include "test_plan.h"
+
+#include "clip.h"
+#include "plan.h"
+#include "unity.h"
+
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define TMP_DIR_NAME "tmp_plan_dir"
+
+void
+test_plan_null_args(void)
+{
+        int         err = PLAN_OK;
+        struct plan plan;
+        TEST_ASSERT_EQUAL_INT(-1, plan_init(&err, NULL));
+        TEST_ASSERT_EQUAL_INT(PLAN_ERR_BAD_ARG, err);
+        TEST_ASSERT_EQUAL_INT(0, plan_init(&err, &plan));
+        TEST_ASSERT_EQUAL_INT(-1, plan_add(&err, &plan, NULL));
+        TEST_ASSERT_EQUAL_INT(PLAN_ERR_BAD_ARG, err);
+        plan_free(&plan);
+}
+
+void
+test_plan_counts_rule_and_mkdirs(void)
+{
+        struct command cmd_a = {.ext = "jpg", .dir = "tmp_plan_new/a/b"};
+        struct command cmd_b = {.ext = "png", .dir = "tmp_plan_new/a/c"};
+        struct target  t1    = {.name = "x.jpg", .cmd = &cmd_a, .size = 10};
+        struct target  t2    = {.name = "y.jpg", .cmd = &cmd_a, .size = 5};
+        struct target  t3    = {.name = "z.png", .cmd = &cmd_b, .size = 1};
+        int            err   = PLAN_OK;
+        struct plan    plan;
+        TEST_ASSERT_EQUAL_INT(0, plan_init(&err, &plan));
+        TEST_ASSERT_EQUAL_INT(0, plan_add(&err, &plan, &t1));
+        TEST_ASSERT_EQUAL_INT(0, plan_add(&err, &plan, &t2));
+        TEST_ASSERT_EQUAL_INT(0, plan_add(&err, &plan, &t3));
+        TEST_ASSERT_EQUAL_UINT(2, plan.rules_count);
+        TEST_ASSERT_EQUAL_UINT(2, plan.rules[0].files);
+        TEST_ASSERT_TRUE(15 == plan.rules[0].bytes);
+        TEST_ASSERT_EQUAL_UINT(3, plan.files);
+        // tmp_plan_new, tmp_plan_new/a, .../a/b, .../a/c
+        TEST_ASSERT_EQUAL_UINT(4, plan.mkdirs);
+        TEST_ASSERT_EQUAL_INT(-1, access("tmp_plan_new", F_OK));
+        plan_free(&plan);
+}
+
+void
+test_plan_conflict_and_duplicate(void)
+{
+        mkdir(TMP_DIR_NAME, 0755);
+        FILE *f = fopen(TMP_DIR_NAME "/dup.txt", "w");
+        TEST_ASSERT_NOT_NULL(f);
+        fclose(f);
+        struct command cmd_a = {.ext = "txt", .dir = TMP_DIR_NAME};
+        struct command cmd_b = {.ext = "txt", .dir = "tmp_plan_other"};
+        struct target  t1    = {.name = "dup.txt", .cmd = &cmd_a};
+        struct target  t2    = {.name = "dup.txt", .cmd = &cmd_b};
+        int            err   = PLAN_OK;
+        struct plan    plan;
+        TEST_ASSERT_EQUAL_INT(0, plan_init(&err, &plan));
+        TEST_ASSERT_EQUAL_INT(0, plan_add(&err, &plan, &t1));
+        TEST_ASSERT_EQUAL_INT(0, plan_add(&err, &plan, &t2));
+        TEST_ASSERT_EQUAL_UINT(1, plan.files);
+        TEST_ASSERT_EQUAL_UINT(1, plan.conflicts);
+        TEST_ASSERT_EQUAL_UINT(0, plan.mkdirs);
+        plan_free(&plan);
+        remove(TMP_DIR_NAME "/dup.txt");
+        rmdir(TMP_DIR_NAME);
+}
+
+void
+test_plan_estimate(void)
+{
+        struct command cmd = {.ext = "txt", .dir = "tmp_plan_est"};
+        struct target  t   = {.name = "a.txt", .cmd = &cmd};
+        int            err = PLAN_OK;
+        struct plan    plan;
+        TEST_ASSERT_EQUAL_INT(0, plan_init(&err, &plan));
+        TEST_ASSERT_TRUE(0 == plan_estimate_ns(&plan));
+        plan_scan(&plan, 1000, 10);
+        TEST_ASSERT_TRUE(1000 == plan_estimate_ns(&plan));
+        plan_match(&plan, 50, 1);
+        TEST_ASSERT_EQUAL_INT(0, plan_add(&err, &plan, &t));
+        // чтение 10 записей по 100 нс, stat, rename и mkdir по 50 нс:
+        // время скана делится на записи, а не на совпавшие файлы
+        TEST_ASSERT_TRUE(1150 == plan_estimate_ns(&plan));
+        plan_free(&plan);
+}
@@ -0,0 +1,13 @@
+#ifndef TEST_PLAN_H
+#define TEST_PLAN_H
+
+void
+test_plan_null_args(void);
+void
+test_plan_counts_rule_and_mkdirs(void);
+void
+test_plan_conflict_and_duplicate(void);
+void
+test_plan_estimate(void);
+
+#endif //TEST_PLAN_H
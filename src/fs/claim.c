@@ -0,0 +1,275 @@
+#define _GNU_SOURCE
+
+#include "claim.h"
+
+#include "clip.h"
+#include "common.h"
+#include "stats.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/xattr.h>
+
+#ifndef HOST_NAME_MAX
+#define HOST_NAME_MAX 255
+#endif
+
+/// `rename` без перезаписи: `renameat2(RENAME_NOREPLACE)`, а где ФС его
+/// не поддерживает — `link` + `unlink`, которые тоже не перезаписывают.
+/// Если `from` за это время забрал другой процесс, ссылка `to`
+/// удаляется: файл остаётся у того, кто его забрал, а не под двумя
+/// именами.
+static int
+rename_noreplace(const char *from, const char *to)
+{
+        if (0 == renameat2(AT_FDCWD, from, AT_FDCWD, to, RENAME_NOREPLACE))
+        {
+                return 0;
+        }
+        if (EINVAL != errno && ENOSYS != errno)
+        {
+                return -1;
+        }
+        if (-1 == link(from, to))
+        {
+                return -1;
+        }
+        if (-1 == unlink(from))
+        {
+                const int saved = errno;
+                unlink(to);
+                errno = saved;
+                return -1;
+        }
+        return 0;
+}
+
+/// Захват по хешу короче исходного имени, обычный — длиннее.
+static int
+claim_hashed(const struct target *t)
+{
+        return strlen(t->claim) < strlen(t->name);
+}
+
+/// Готовит префикс захватов этого процесса.
+/// @return 0 при успехе, -1, если имя хоста недоступно.
+int
+claim_init(struct claimer *c)
+{
+        char host[HOST_NAME_MAX + 1];
+        if (-1 == gethostname(host, sizeof(host)))
+        {
+                return -1;
+        }
+        host[HOST_NAME_MAX] = '\0';
+        c->host = (uint32_t) hash_bytes(host, strlen(host));
+        snprintf(c->prefix, sizeof(c->prefix), CLAIM_PREFIX "%08" PRIx32 "-%ld-",
+                 c->host, (long) getpid());
+        return 0;
+}
+
+/// Захватывает файл цели переименованием в каталоге.
+///
+/// @return 1 — файл захвачен (`t->claim` задано), 0 — файл уже забрал
+///         другой экземпляр или он исчез, -1 при ошибке (код в `*error`,
+///         `errno` сохранён).
+int
+claim_target(int *error, const struct claimer *c, struct target *t)
+{
+        *error = CLAIM_OK;
+        if (NULL == c || NULL == t || NULL != t->claim)
+        {
+                *error = CLAIM_ERR_BAD_ARG;
+                return -1;
+        }
+        const size_t plen   = strlen(c->prefix);
+        const size_t nlen   = strlen(t->name);
+        const int    hashed = NAME_MAX < plen + nlen;
+        char        *claim  = NULL;
+        if (hashed)
+        {
+                // `-` в конце префикса заменяется на `~`: имя захвата
+                // не совпадает ни с одним коротким
+                char tail[24];
+                snprintf(tail, sizeof(tail), "~%016" PRIx64,
+                         hash_mix(hash_bytes(t->name, nlen)));
+                claim = malloc(plen + sizeof(tail));
+                if (NULL != claim)
+                {
+                        memcpy(claim, c->prefix, plen - 1);
+                        strcpy(claim + plen - 1, tail);
+                }
+        }
+        else
+        {
+                claim = concat(c->prefix, t->name, NULL);
+        }
+        if (NULL == claim)
+        {
+                *error = CLAIM_ERR_MEM;
+                return -1;
+        }
+        stats_count(STATS_SYSCALLS, 1);
+        // имя захвата может быть занято брошенным захватом прежнего
+        // процесса с тем же pid или другим именем с тем же хешем:
+        // чужой файл не перезаписывается
+        if (-1 == rename_noreplace(t->name, claim))
+        {
+                const int saved = errno;
+                free(claim);
+                errno = saved;
+                if (ENOENT == saved)
+                {
+                        return 0;
+                }
+                *error = CLAIM_ERR_RENAME;
+                return -1;
+        }
+        if (hashed)
+        {
+                // без атрибута захват только не восстановится после сбоя
+                stats_count(STATS_SYSCALLS, 1);
+                setxattr(claim, CLAIM_XATTR, t->name, nlen, 0);
+        }
+        t->claim = claim;
+        return 1;
+}
+
+/// Возвращает захваченному файлу исходное имя, если он ещё лежит под
+/// именем захвата. Занятое за это время имя не перезаписывается.
+///
+/// @return 0 при успехе (в том числе если файл уже унесён), -1 при
+///         ошибке — файл остаётся под именем захвата.
+int
+claim_release(int *error, struct target *t)
+{
+        *error = CLAIM_OK;
+        if (NULL == t || NULL == t->claim)
+        {
+                return 0;
+        }
+        stats_count(STATS_SYSCALLS, 1);
+        if (-1 == rename_noreplace(t->claim, t->name))
+        {
+                if (ENOENT != errno)
+                {
+                        *error = CLAIM_ERR_RELEASE;
+                        return -1;
+                }
+        }
+        else if (claim_hashed(t))
+        {
+                stats_count(STATS_SYSCALLS, 1);
+                removexattr(t->name, CLAIM_XATTR);
+        }
+        free(t->claim);
+        t->claim = NULL;
+        return 0;
+}
+
+/// Снимает атрибут `CLAIM_XATTR` с файла, перемещённого под захватом по
+/// хешу: в каталоге назначения он уже не нужен. Имя захвата
+/// освобождается.
+void
+claim_moved(struct target *t)
+{
+        if (NULL == t || NULL == t->claim)
+        {
+                return;
+        }
+        if (claim_hashed(t))
+        {
+                char *dst = concat(t->cmd->dir, "/", t->name, NULL);
+                if (NULL != dst)
+                {
+                        stats_count(STATS_SYSCALLS, 1);
+                        removexattr(dst, CLAIM_XATTR);
+                        free(dst);
+                }
+        }
+        free(t->claim);
+        t->claim = NULL;
+}
+
+/// Исходное имя захвата `name`, разобранного до `<pid>` включительно:
+/// хвост имени или, для захвата по хешу, атрибут `CLAIM_XATTR`.
+/// @return Имя (в `buf` или внутри `name`) или NULL, если его не узнать.
+static const char *
+claim_origin(const char *name, const char *rest, char *buf, const size_t cap)
+{
+        if ('-' == rest[0] && '\0' != rest[1])
+        {
+                return rest + 1;
+        }
+        if ('~' != rest[0])
+        {
+                return NULL;
+        }
+        stats_count(STATS_SYSCALLS, 1);
+        const ssize_t n = getxattr(name, CLAIM_XATTR, buf, cap - 1);
+        if (n <= 0 || NULL != memchr(buf, '/', (size_t) n) ||
+            NULL != memchr(buf, '\0', (size_t) n))
+        {
+                return NULL;
+        }
+        buf[n] = '\0';
+        return buf;
+}
+
+/// Снимает захваты своего хоста, оставленные завершившимися процессами.
+///
+/// Вызывается до первого захвата: захват со своим pid тогда оставлен
+/// прежним процессом с тем же номером (в контейнерах номера
+/// повторяются) и тоже снимается.
+/// @return Сколько файлов вернулось под исходные имена.
+size_t
+claim_recover(const struct claimer *c)
+{
+        struct dir_scan scan;
+        if (NULL == c || -1 == scan_dir(&scan))
+        {
+                return 0;
+        }
+        const size_t len      = sizeof(CLAIM_PREFIX) - 1;
+        size_t       restored = 0;
+        char         origin[NAME_MAX + 1];
+        for (size_t i = 0; i < scan.count; ++i)
+        {
+                const char *name = scan.names + scan.offsets[i];
+                uint32_t    host = 0;
+                long        pid  = 0;
+                int         used = 0;
+                if (0 != strncmp(name, CLAIM_PREFIX, len) ||
+                    2 != sscanf(name + len, "%8" SCNx32 "-%ld%n", &host, &pid,
+                                &used) ||
+                    0 == used || host != c->host || pid <= 0)
+                {
+                        continue;
+                }
+                // процесс жив (или это чужой pid без прав) — захват его
+                if (pid != (long) getpid() &&
+                    (0 == kill((pid_t) pid, 0) || ESRCH != errno))
+                {
+                        continue;
+                }
+                const char *to = claim_origin(name, name + len + (size_t) used,
+                                              origin, sizeof(origin));
+                if (NULL != to && 0 == rename_noreplace(name, to))
+                {
+                        ++restored;
+                        if (to == origin)
+                        {
+                                removexattr(to, CLAIM_XATTR);
+                        }
+                }
+        }
+        scan_free(&scan);
+        return restored;
+}
@@ -0,0 +1,59 @@
+#ifndef CLAIM_H
+#define CLAIM_H
+
+#include "fs.h"
+
+#include <stdint.h>
+#include <sys/types.h>
+
+enum claim_error
+{
+        CLAIM_OK,
+        CLAIM_ERR_BAD_ARG,
+        CLAIM_ERR_MEM,
+        CLAIM_ERR_RENAME,  /// Захват не удался не из-за конкурента
+        CLAIM_ERR_RELEASE, /// Имя файла занято, захват не снят
+};
+
+/// Захват файлов `--claim` для нескольких экземпляров `tn` над общим
+/// каталогом, в том числе с разных машин через общую ФС.
+///
+/// Перед раскладкой файл переименовывается в
+/// `CLAIM_PREFIX<хост>-<pid>-<имя>` без перезаписи существующего имени
+/// захвата. Из двух `rename` одного имени
+/// удаётся ровно один, проигравший получает `ENOENT` и молча пропускает
+/// файл — блокировки и проверка `access` не нужны. Перемещение уносит
+/// захват вместе с файлом; если файл остался на месте, захват снимается
+/// обратным переименованием.
+///
+/// Если такое имя длиннее `NAME_MAX`, захват называется
+/// `CLAIM_PREFIX<хост>-<pid>~<хеш имени>`, а исходное имя процесс
+/// держит в `t->name` и дополнительно записывает в атрибут
+/// `CLAIM_XATTR` файла — для `claim_recover`. Атрибут снимается вместе
+/// с захватом, а у перемещённого файла — `claim_moved`.
+///
+/// Захваты процессов, завершившихся без снятия, возвращает
+/// `claim_recover` — только для своего хоста: живость чужих процессов
+/// проверить нельзя. Длинный захват без атрибута (ФС без `user.*` или
+/// сбой между `rename` и `setxattr`) остаётся как есть.
+/// Расширенный атрибут с исходным именем длинного захвата.
+#define CLAIM_XATTR "user.tn.claim"
+
+struct claimer
+{
+        char     prefix[48]; /// `CLAIM_PREFIX<хост>-<pid>-`
+        uint32_t host;       /// Хеш имени хоста
+};
+
+int
+claim_init(struct claimer *c);
+int
+claim_target(int *error, const struct claimer *c, struct target *t);
+int
+claim_release(int *error, struct target *t);
+void
+claim_moved(struct target *t);
+size_t
+claim_recover(const struct claimer *c);
+
+#endif //CLAIM_H
@@ -0,0 +1,244 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "dirstamp.h"
+
+#include "common.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static uint64_t
+stamp_ns(const struct timespec *ts)
+{
+        return (uint64_t) ts->tv_sec * 1000000000ULL + (uint64_t) ts->tv_nsec;
+}
+
+static struct dirstamp_entry *
+find_entry(const struct dirstamp *c, const struct stat *st)
+{
+        for (size_t i = 0; i < c->count; ++i)
+        {
+                if (c->entries[i].dev == (uint64_t) st->st_dev &&
+                    c->entries[i].ino == (uint64_t) st->st_ino)
+                {
+                        return &c->entries[i];
+                }
+        }
+        return NULL;
+}
+
+static int
+push_entry(struct dirstamp *c, const struct dirstamp_entry *e)
+{
+        if (c->count == c->cap)
+        {
+                const size_t           cap  = 0 == c->cap ? 16 : c->cap * 2;
+                struct dirstamp_entry *grow =
+                    realloc(c->entries, cap * sizeof(*grow));
+                if (NULL == grow)
+                {
+                        return -1;
+                }
+                c->entries = grow;
+                c->cap     = cap;
+        }
+        c->entries[c->count++] = *e;
+        return 0;
+}
+
+/// Загружает кеш из `path`. Отсутствующий файл, чужой формат или
+/// повреждённые строки дают пустой (или частичный) кеш, а не ошибку:
+/// в худшем случае каталог будет прочитан лишний раз.
+///
+/// @return 0 при успехе, -1 при ошибке (код в `*error`).
+int
+dirstamp_load(int *error, struct dirstamp *c, const char *path)
+{
+        if (NULL == c || NULL == path)
+        {
+                *error = DIRSTAMP_ERR_BAD_ARG;
+                return -1;
+        }
+        *error = DIRSTAMP_OK;
+        memset(c, 0, sizeof(*c));
+        c->racy_ns = DIRSTAMP_RACY_NS;
+        c->path    = strcopy(path);
+        if (NULL == c->path)
+        {
+                *error = DIRSTAMP_ERR_MEM;
+                return -1;
+        }
+        FILE *in = fopen(path, "r");
+        if (NULL == in)
+        {
+                if (ENOENT == errno)
+                {
+                        return 0;
+                }
+                *error = DIRSTAMP_ERR_READ;
+                return -1;
+        }
+        char line[256];
+        if (NULL == fgets(line, sizeof(line), in) ||
+            0 != strcmp(line, DIRSTAMP_MAGIC "\n"))
+        {
+                fclose(in);
+                return 0;
+        }
+        struct dirstamp_entry e;
+        while (5 == fscanf(in,
+                           "%" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64
+                           " %" SCNu64,
+                           &e.dev, &e.ino, &e.mtime_ns, &e.ctime_ns,
+                           &e.rules))
+        {
+                if (-1 == push_entry(c, &e))
+                {
+                        fclose(in);
+                        *error = DIRSTAMP_ERR_MEM;
+                        return -1;
+                }
+        }
+        fclose(in);
+        return 0;
+}
+
+/// Отпечаток набора правил. Файлы находятся только по расширению, поэтому
+/// учитываются расширения без порядка, а каталоги назначения — нет.
+uint64_t
+dirstamp_rules(const struct command **commands)
+{
+        uint64_t sum = 0;
+        for (const struct command **c = commands; c && *c; ++c)
+        {
+                sum += hash_bytes((*c)->ext, strlen((*c)->ext));
+        }
+        return sum;
+}
+
+/// Не менялся ли каталог `st` с сохранённого штампа при тех же правилах.
+/// @return 1 — каталог можно не читать, 0 — нужно.
+int
+dirstamp_fresh(const struct dirstamp *c, const struct stat *st,
+               const uint64_t rules)
+{
+        const struct dirstamp_entry *e = find_entry(c, st);
+        return NULL != e && e->mtime_ns == stamp_ns(&st->st_mtim) &&
+               e->ctime_ns == stamp_ns(&st->st_ctim) && e->rules == rules;
+}
+
+/// Запоминает штамп каталога `st`. Вызывать, только если после `stat`
+/// в каталоге не нашлось файлов для правил.
+///
+/// Штамп, чьи `mtime` или `ctime` ближе `c->racy_ns` к текущему времени
+/// (или в будущем — чужие часы NFS), не запоминается: изменение в тот
+/// же тик его бы не сдвинуло. Такой каталог будет прочитан в следующий
+/// раз и запомнен, когда отметки устареют.
+///
+/// @return 1 — штамп запомнен, 0 — слишком свежий, -1 при нехватке
+///         памяти.
+int
+dirstamp_update(int *error, struct dirstamp *c, const struct stat *st,
+                const uint64_t rules)
+{
+        *error = DIRSTAMP_OK;
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        const uint64_t now_ns = stamp_ns(&now);
+        const uint64_t mtime  = stamp_ns(&st->st_mtim);
+        const uint64_t ctime  = stamp_ns(&st->st_ctim);
+        const uint64_t newest = mtime > ctime ? mtime : ctime;
+        if (newest > now_ns || now_ns - newest < c->racy_ns)
+        {
+                return 0;
+        }
+        const struct dirstamp_entry e = {
+            .dev      = (uint64_t) st->st_dev,
+            .ino      = (uint64_t) st->st_ino,
+            .mtime_ns = mtime,
+            .ctime_ns = ctime,
+            .rules    = rules,
+        };
+        struct dirstamp_entry *old = find_entry(c, st);
+        if (NULL != old)
+        {
+                *old = e;
+                return 1;
+        }
+        if (-1 == push_entry(c, &e))
+        {
+                *error = DIRSTAMP_ERR_MEM;
+                return -1;
+        }
+        return 1;
+}
+
+/// Атомарно записывает кеш: `<path>.tmp`, затем `rename`.
+/// @return 0 при успехе, -1 при ошибке (`DIRSTAMP_ERR_WRITE`, `errno`
+///         сохранён; временный файл удаляется).
+int
+dirstamp_save(int *error, const struct dirstamp *c)
+{
+        *error    = DIRSTAMP_OK;
+        char *tmp = concat(c->path, ".tmp", NULL);
+        if (NULL == tmp)
+        {
+                *error = DIRSTAMP_ERR_MEM;
+                return -1;
+        }
+        const int fd =
+            open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        FILE *out = -1 == fd ? NULL : fdopen(fd, "w");
+        if (NULL == out)
+        {
+                const int saved = errno;
+                if (-1 != fd)
+                {
+                        close(fd);
+                        unlink(tmp);
+                }
+                free(tmp);
+                errno  = saved;
+                *error = DIRSTAMP_ERR_WRITE;
+                return -1;
+        }
+        fputs(DIRSTAMP_MAGIC "\n", out);
+        for (size_t i = 0; i < c->count; ++i)
+        {
+                const struct dirstamp_entry *e = &c->entries[i];
+                fprintf(out,
+                        "%" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64
+                        " %" PRIu64 "\n",
+                        e->dev, e->ino, e->mtime_ns, e->ctime_ns, e->rules);
+        }
+        const int failed = ferror(out);
+        int       status = 0;
+        if (0 != fclose(out) || failed || -1 == rename(tmp, c->path))
+        {
+                const int saved = errno;
+                unlink(tmp);
+                errno  = saved;
+                *error = DIRSTAMP_ERR_WRITE;
+                status = -1;
+        }
+        free(tmp);
+        return status;
+}
+
+void
+dirstamp_free(struct dirstamp *c)
+{
+        if (NULL == c)
+        {
+                return;
+        }
+        free(c->entries);
+        free(c->path);
+        memset(c, 0, sizeof(*c));
+}
@@ -0,0 +1,76 @@
+#ifndef DIRSTAMP_H
+#define DIRSTAMP_H
+
+#include "clip.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+enum dirstamp_error
+{
+        DIRSTAMP_OK,
+        DIRSTAMP_ERR_BAD_ARG,
+        DIRSTAMP_ERR_MEM,
+        DIRSTAMP_ERR_READ,
+        DIRSTAMP_ERR_WRITE,
+};
+
+/// Сигнатура и версия файла кеша.
+#define DIRSTAMP_MAGIC "tn-dirstamp 1"
+
+/// Штамп моложе этого не запоминается, по правилу «racy timestamp» git:
+/// где отметки времени каталога грубые (тик ядра, ФС без многозернистых
+/// отметок, NFS с секундной точностью), файл, созданный в тот же тик,
+/// что и штамп, не меняет ни `mtime`, ни `ctime`.
+#define DIRSTAMP_RACY_NS 2000000000ULL
+
+/// Состояние каталога после прогона, в котором не осталось файлов для
+/// правил.
+struct dirstamp_entry
+{
+        uint64_t dev;
+        uint64_t ino;
+        uint64_t mtime_ns;
+        uint64_t ctime_ns;
+        uint64_t rules; /// `dirstamp_rules` набора правил
+};
+
+/// Кеш `--dir-cache`: штампы каталогов по (dev, inode), сохраняемые
+/// между запусками.
+///
+/// Добавление, удаление и переименование записей меняют `mtime`
+/// каталога, смена прав и владельца — `ctime`. Если оба совпадают со
+/// штампом, а набор расширений тот же, каталог с прошлого прогона не
+/// менялся и файлов для правил в нём нет — его можно не читать.
+///
+/// Файл текстовый: строка `DIRSTAMP_MAGIC`, затем по строке на каталог.
+/// Сохраняется атомарно (временный файл и `rename`); повреждённый или
+/// отсутствующий файл равносилен пустому кешу.
+struct dirstamp
+{
+        struct dirstamp_entry *entries;
+        size_t                 count;
+        size_t                 cap;
+        char                  *path;
+        uint64_t               racy_ns; /// Запас «racy timestamp»;
+                                        /// `dirstamp_load` ставит
+                                        /// `DIRSTAMP_RACY_NS`
+};
+
+int
+dirstamp_load(int *error, struct dirstamp *c, const char *path);
+uint64_t
+dirstamp_rules(const struct command **commands);
+int
+dirstamp_fresh(const struct dirstamp *c, const struct stat *st,
+               uint64_t rules);
+int
+dirstamp_update(int *error, struct dirstamp *c, const struct stat *st,
+                uint64_t rules);
+int
+dirstamp_save(int *error, const struct dirstamp *c);
+void
+dirstamp_free(struct dirstamp *c);
+
+#endif //DIRSTAMP_H
@@ -1,3 +1,5 @@
+#define _DEFAULT_SOURCE
+
 #include "fs.h"
 
 #include <dirent.h>
@@ -10,6 +12,9 @@
 
 #include "clip.h"
 #include "common.h"
+#include "probes.h"
+#include "stats.h"
+#include "trace.h"
 
 #ifndef MAX_DEPTH
 #define MAX_DEPTH 256
@@ -19,6 +24,9 @@
 #define PATH_MAX 4096
 #endif
 
+/// Сколько записей каталога попадает в один отрезок трассы `readdir batch`.
+#define SCAN_TRACE_BATCH 1024
+
 /// Проверяет, является ли файл целевым (по расширению и типу).
 ///
 /// Условия:
@@ -58,47 +66,239 @@ is_target(const char *filename, const char *target)
         return 0;
 }
 
-/// Ищет все файлы с заданным расширением в текущей директории.
+/// Сравнивает расширение имени файла с `ext` без выделения памяти.
+///
+/// Правила совпадают с `find_ext_suffix`: расширение — всё после последней
+/// точки, точка в начале имени расширением не считается. Захваченные
+/// файлы (`CLAIM_PREFIX`) не совпадают ни с одним правилом.
+///
+/// @return 0, если расширение совпадает, иначе -1.
+static int
+match_ext(const char *name, const char *ext)
+{
+        const char *dot = strrchr(name, '.');
+        if (NULL == dot || dot == name ||
+            0 == strncmp(name, CLAIM_PREFIX, sizeof(CLAIM_PREFIX) - 1))
+        {
+                return -1;
+        }
+        return 0 == strcmp(dot + 1, ext) ? 0 : -1;
+}
+
+/// Добавляет имя в снимок каталога (в том числе в пачку имён из
+/// событий `--watch`).
+/// @return 0 при успехе, -1 при ошибке выделения памяти.
+int
+scan_push(struct dir_scan *scan, const char *name)
+{
+        const size_t len = strlen(name) + 1;
+        if (scan->names_len + len > scan->names_cap)
+        {
+                size_t cap = 0 == scan->names_cap ? 4096 : scan->names_cap;
+                while (cap < scan->names_len + len)
+                {
+                        cap *= 2;
+                }
+                char *names = realloc(scan->names, cap);
+                if (NULL == names)
+                {
+                        return -1;
+                }
+                scan->names     = names;
+                scan->names_cap = cap;
+                stats_count(STATS_ALLOCS, 1);
+        }
+        if (scan->count == scan->cap)
+        {
+                const size_t cap     = 0 == scan->cap ? 256 : scan->cap * 2;
+                size_t      *offsets = realloc(scan->offsets,
+                                               cap * sizeof(*offsets));
+                if (NULL == offsets)
+                {
+                        return -1;
+                }
+                scan->offsets = offsets;
+                scan->cap     = cap;
+                stats_count(STATS_ALLOCS, 1);
+        }
+        memcpy(scan->names + scan->names_len, name, len);
+        scan->offsets[scan->count++] = scan->names_len;
+        scan->names_len += len;
+        return 0;
+}
+
+/// Читает текущую директорию за один проход.
+///
+/// Имена складываются подряд в один буфер, так что несколько правил
+/// (`-m`) сопоставляются с одним снимком, а не перечитывают каталог.
+/// Записи, про которые `readdir` уже знает, что это не файл и не
+/// ссылка (каталоги, сокеты и т.п.), отбрасываются сразу.
+///
+/// @return 0 при успехе, -1 при ошибке (`errno` сохранён).
+int
+scan_dir(struct dir_scan *scan)
+{
+        memset(scan, 0, sizeof(*scan));
+        TN_PROBE0(scan__entry);
+        DIR *current_dir = opendir(".");
+        if (NULL == current_dir)
+        {
+                TN_PROBE2(scan__return, (size_t) 0, -1);
+                return -1;
+        }
+        stats_count(STATS_SYSCALLS, 1);
+        int      status = 0;
+        size_t   seen   = 0;
+        uint64_t batch  = trace_begin();
+        for (;;)
+        {
+                const uint64_t       start = stats_begin();
+                const struct dirent *entry = readdir(current_dir);
+                stats_end(STATS_READDIR, start);
+                if (NULL == entry)
+                {
+                        break;
+                }
+                if (0 == ++seen % SCAN_TRACE_BATCH)
+                {
+                        trace_end("readdir batch", "scan", batch, NULL);
+                        batch = trace_begin();
+                }
+                if (DT_REG != entry->d_type && DT_LNK != entry->d_type &&
+                    DT_UNKNOWN != entry->d_type)
+                {
+                        continue;
+                }
+                if (-1 == scan_push(scan, entry->d_name))
+                {
+                        status = -1;
+                        break;
+                }
+        }
+        trace_end("readdir batch", "scan", batch, NULL);
+        const int saved = errno;
+        closedir(current_dir);
+        if (-1 == status)
+        {
+                scan_free(scan);
+        }
+        TN_PROBE2(scan__return, scan->count, status);
+        errno = saved;
+        return status;
+}
+
+/// Освобождает снимок каталога.
+void
+scan_free(struct dir_scan *scan)
+{
+        free(scan->names);
+        free(scan->offsets);
+        memset(scan, 0, sizeof(*scan));
+}
+
+/// Очищает снимок, сохраняя выделенную память для следующей пачки.
+void
+scan_clear(struct dir_scan *scan)
+{
+        scan->names_len = 0;
+        scan->count     = 0;
+}
+
+/// Попадает ли имя в долю `shard`. NULL — без деления.
+/// @return 1 — имя этого экземпляра, 0 — чужое.
+int
+shard_keep(const struct shard *shard, const char *name)
+{
+        if (NULL == shard || shard->count < 2)
+        {
+                return 1;
+        }
+        return hash_mix(hash_bytes(name, strlen(name))) % shard->count ==
+               shard->index;
+}
+
+/// Оставляет в снимке только имена доли `shard`, до сверки с правилами
+/// и без `stat`. Сжимаются только смещения: байты чужих имён остаются
+/// в буфере до `scan_clear`/`scan_free`.
+void
+scan_shard(struct dir_scan *scan, const struct shard *shard)
+{
+        if (NULL == shard || shard->count < 2)
+        {
+                return;
+        }
+        size_t kept = 0;
+        for (size_t i = 0; i < scan->count; ++i)
+        {
+                if (shard_keep(shard, scan->names + scan->offsets[i]))
+                {
+                        scan->offsets[kept++] = scan->offsets[i];
+                }
+        }
+        scan->count = kept;
+}
+
+/// Считает имена снимка с расширением правила, без `stat`: быстрая
+/// оценка объёма работы (например, для оставшегося времени в прогрессе).
+size_t
+scan_count_matches(const struct dir_scan *scan, const struct command *cmd)
+{
+        size_t count = 0;
+        for (size_t i = 0; i < scan->count; ++i)
+        {
+                if (0 == match_ext(scan->names + scan->offsets[i], cmd->ext))
+                {
+                        ++count;
+                }
+        }
+        return count;
+}
+
+/// Отбирает из снимка каталога файлы с расширением правила.
 ///
 /// Алгоритм:
-/// - Открывает текущую директорию;
-/// - Проверяет каждый файл через `is_target`;
-/// - Для подходящих:
+/// - Сначала сверяет расширение по имени (без системных вызовов),
+///   и только для совпавших выполняет один `stat`;
+/// - Для подходящих обычных файлов:
 ///     - создаёт структуру `target`;
 ///     - копирует `name` и дублирует команду `cmd`;
+///     - сохраняет размер, устройство, inode и `mtime` из того же `stat`;
 /// - Возвращает NULL-терминированный массив указателей на `target`.
 ///
-/// Параметры:
-/// - `cmd`: команда, содержащая фильтрующее расширение (`cmd->ext`);
-///
 /// Возвращает:
-/// - NULL, если ни один файл не подошёл или произошла ошибка;
+/// - NULL, если ни один файл не подошёл;
 /// - Указатель на массив `struct target*`, последний элемент — `NULL`.
 ///
 /// Примечания:
-/// - Использует `exit(EXIT_FAILURE)` при фатальной ошибке;
+/// - Использует `exit(EXIT_FAILURE)` при нехватке памяти;
 /// - Возвращаемый массив и все структуры внутри требуют явного освобождения.
-///
-/// Требует:
-/// - Реализации `copy_command()`;
-/// - Правильного `cmd->ext` (например, `"txt"`).
 __attribute__((malloc))
 struct target **
-find_target(const struct command *cmd)
+match_targets(const struct dir_scan *scan, const struct command *cmd)
 {
-        DIR *current_dir = opendir(".");
-        if (NULL == current_dir)
-        {
-                // open_dir_error(".");
-                exit(EXIT_FAILURE);
-        }
-        size_t               count    = 0;
-        size_t               capacity = 1;
-        struct target **        entries  = NULL;
-        const struct dirent *entry    = NULL;
-        while (NULL != (entry = readdir(current_dir)))
+        size_t          count    = 0;
+        size_t          capacity = 1;
+        struct target **entries  = NULL;
+        struct stat     st;
+        TN_PROBE1(match__entry, cmd->ext);
+        for (size_t i = 0; i < scan->count; ++i)
         {
-                if (-1 == is_target(entry->d_name, cmd->ext))
+                const char *name  = scan->names + scan->offsets[i];
+                uint64_t    start = stats_begin();
+                const int matched = 0 == match_ext(name, cmd->ext);
+                stats_end(STATS_MATCH, start);
+                if (!matched)
+                {
+                        TN_PROBE3(match__decision, name, cmd->ext, 0);
+                        continue;
+                }
+                start             = stats_begin();
+                const int regular = 0 == stat(name, &st) &&
+                                    S_ISREG(st.st_mode);
+                stats_end(STATS_STAT, start);
+                stats_count(STATS_SYSCALLS, 1);
+                TN_PROBE3(match__decision, name, cmd->ext, regular ? 1 : -1);
+                if (!regular)
                 {
                         continue;
                 }
@@ -114,6 +314,7 @@ find_target(const struct command *cmd)
                                 exit(EXIT_FAILURE);
                         }
                         entries = new_entries;
+                        stats_count(STATS_ALLOCS, 1);
                 }
                 struct target *target = malloc(sizeof(struct target));
                 if (NULL == target)
@@ -121,7 +322,7 @@ find_target(const struct command *cmd)
                         // memory_error();
                         exit(EXIT_FAILURE);
                 }
-                target->name = strcopy(entry->d_name);
+                target->name = strcopy(name);
                 int error = 0;
                 target->cmd  = copy_command(&error, cmd);
                 if (NULL == target->cmd || NULL == target->name)
@@ -129,13 +330,22 @@ find_target(const struct command *cmd)
                         // memory_error();
                         exit(EXIT_FAILURE);
                 }
+                // target, имя и копия команды (структура, ext, dir)
+                stats_count(STATS_ALLOCS, 5);
+                target->size   = st.st_size;
+                target->dev    = st.st_dev;
+                target->ino    = st.st_ino;
+                target->mtime  = st.st_mtime;
+                target->dup_of = NULL;
+                target->claim  = NULL;
                 entries[count] = target;
                 ++count;
-
         }
         if (NULL == entries || 0 == count)
         {
                 // no_matching_files_error(cmd->ext);
+                free((void *) entries);
+                TN_PROBE2(match__return, cmd->ext, (size_t) 0);
                 return NULL;
         }
         struct target **new_entries = (struct target **) realloc((void *) entries,
@@ -147,9 +357,85 @@ find_target(const struct command *cmd)
         }
         entries        = new_entries;
         entries[count] = NULL;
+        TN_PROBE2(match__return, cmd->ext, count);
         return entries;
 }
 
+/// Путь, по которому файл цели лежит сейчас: имя захвата, если файл
+/// захвачен, иначе исходное имя. Каталог назначения и отчёты всегда
+/// используют `name`.
+const char *
+target_path(const struct target *t)
+{
+        return NULL != t->claim ? t->claim : t->name;
+}
+
+/// Освобождает цель из `match_targets` вместе с её копией команды.
+void
+free_target(struct target *t)
+{
+        free(t->claim);
+        free((void *) t->name);
+        free((void *) t->cmd->ext);
+        free((void *) t->cmd->dir);
+        free((void *) t->cmd);
+        free(t);
+}
+
+/// Освобождает массив из `match_targets`/`find_target`. NULL допустим.
+void
+free_targets(struct target **targets)
+{
+        if (NULL == targets)
+        {
+                return;
+        }
+        for (struct target **t = targets; *t; ++t)
+        {
+                free_target(*t);
+        }
+        free((void *) targets);
+}
+
+/// Ищет все файлы с заданным расширением в текущей директории.
+///
+/// Эквивалентно `scan_dir` и `match_targets` для одного правила.
+/// Для нескольких правил выгоднее один раз вызвать `scan_dir`.
+///
+/// Параметры:
+/// - `cmd`: команда, содержащая фильтрующее расширение (`cmd->ext`);
+/// - `shard`: доля каталога `--shard` или NULL — весь каталог;
+///
+/// Возвращает:
+/// - NULL, если ни один файл не подошёл;
+/// - Указатель на массив `struct target*`, последний элемент — `NULL`.
+///
+/// Примечания:
+/// - Использует `exit(EXIT_FAILURE)` при фатальной ошибке;
+/// - Возвращаемый массив и все структуры внутри требуют явного освобождения.
+__attribute__((malloc))
+struct target **
+find_target(const struct command *cmd, const struct shard *shard)
+{
+        TN_PROBE1(find__entry, cmd->ext);
+        struct dir_scan scan;
+        if (-1 == scan_dir(&scan))
+        {
+                // open_dir_error(".");
+                exit(EXIT_FAILURE);
+        }
+        scan_shard(&scan, shard);
+        struct target **targets = match_targets(&scan, cmd);
+        scan_free(&scan);
+        size_t count = 0;
+        while (NULL != targets && NULL != targets[count])
+        {
+                ++count;
+        }
+        TN_PROBE2(find__return, cmd->ext, count);
+        return targets;
+}
+
 /// Создаёт директорию, если она ещё не существует.
 ///
 /// Параметры:
@@ -170,32 +456,17 @@ mk_dir(const char *dir)
         return -1 == status ? 1 : 0;
 }
 
-/// Рекурсивно создаёт вложенные директории (относительно текущей папки).
-///
-/// Алгоритм:
-/// - Разбивает путь по `/`;
-/// - Поэтапно наращивает путь и вызывает `mk_dir`;
-/// - В случае ошибки — удаляет все ранее созданные директории.
-///
-/// Параметры:
-/// - `dir`: путь вида `a/b/c`, где `a`, `b` и `c` будут созданы по порядку.
-///
-/// Возвращает:
-/// - `0`, если создан хотя бы один каталог;
-/// - `1`, если все каталоги уже существовали;
-/// - `-1`, если произошла ошибка и выполнен откат.
-///
-/// Примечания:
-/// - Не поддерживает абсолютные пути (начинающиеся с `/`);
-/// - Память освобождается автоматически.
-/// - Максимальная вложенность ограничена `MAX_DEPTH`.
-int
-make_dir_recursive(const char *dir)
+/// Тело `make_dir_recursive` без точек трассировки.
+static int
+make_dirs(const char *dir)
 {
         char *  copy      = strcopy(dir);
         // FIXME: все пути как оносительно текущей директории поэтому для тупи
         // /abc что означает от корня мы создаим не от корня и это нормально
-        const char *  part_path = strtok(copy, "/");
+        // `strtok_r`: каталоги создают одновременно рабочие потоки
+        // `tn daemon` и `libtn`, скрытое состояние `strtok` они бы делили
+        char *        save      = NULL;
+        const char *  part_path = strtok_r(copy, "/", &save);
         char    cur_path[PATH_MAX] = {'\0'};
         char *  stack_created_paths[MAX_DEPTH] = {NULL};
         ssize_t stack_top = 0;
@@ -209,7 +480,12 @@ make_dir_recursive(const char *dir)
                         strcat(cur_path, "/");
                 }
                 strcat(cur_path, part_path);
+                const uint64_t span  = trace_begin();
+                const uint64_t start = stats_begin();
                 const int stat = mk_dir(cur_path);
+                stats_end(STATS_MKDIR, start);
+                trace_end("mkdir", "fs", span, cur_path);
+                stats_count(STATS_SYSCALLS, 1);
                 if (-1 == stat)
                 {
                         while (--stack_top >= 0)
@@ -224,7 +500,7 @@ make_dir_recursive(const char *dir)
                 {
                         stack_created_paths[stack_top++] = strcopy(cur_path);
                 }
-                part_path = strtok(NULL, "/");
+                part_path = strtok_r(NULL, "/", &save);
         }
         free(copy);
         if (0 == stack_top)
@@ -237,3 +513,31 @@ make_dir_recursive(const char *dir)
         }
         return 0;
 }
+
+/// Рекурсивно создаёт вложенные директории (относительно текущей папки).
+///
+/// Алгоритм:
+/// - Разбивает путь по `/`;
+/// - Поэтапно наращивает путь и вызывает `mk_dir`;
+/// - В случае ошибки — удаляет все ранее созданные директории.
+///
+/// Параметры:
+/// - `dir`: путь вида `a/b/c`, где `a`, `b` и `c` будут созданы по порядку.
+///
+/// Возвращает:
+/// - `0`, если создан хотя бы один каталог;
+/// - `1`, если все каталоги уже существовали;
+/// - `-1`, если произошла ошибка и выполнен откат.
+///
+/// Примечания:
+/// - Не поддерживает абсолютные пути (начинающиеся с `/`);
+/// - Память освобождается автоматически.
+/// - Максимальная вложенность ограничена `MAX_DEPTH`.
+int
+make_dir_recursive(const char *dir)
+{
+        TN_PROBE1(mkdir__entry, dir);
+        const int status = make_dirs(dir);
+        TN_PROBE2(mkdir__return, dir, status);
+        return status;
+}
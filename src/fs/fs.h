@@ -1,14 +1,73 @@
 #ifndef FS_H
 #define FS_H
 
+#include <stddef.h>
+#include <sys/types.h>
+#include <time.h>
+
 struct target
 {
         char           *name;
         struct command *cmd;
+        off_t           size;  /// Размер файла на момент сканирования
+        dev_t           dev;   /// Устройство, на котором лежит файл
+        ino_t           ino;   /// Номер inode файла
+        time_t          mtime; /// Время последней модификации
+        struct target  *dup_of; /// Оригинал с тем же содержимым или NULL
+        char           *claim;  /// Имя, под которым файл захвачен
+                                /// `--claim`, или NULL
+};
+
+/// Начало имён захваченных файлов, см. `claim.h`. Такие файлы не
+/// подходят ни под одно правило.
+#define CLAIM_PREFIX ".tn-claim-"
+
+/// Имена записей каталога, прочитанные одним проходом `scan_dir`.
+struct dir_scan
+{
+        char   *names;     /// Имена подряд, каждое с завершающим нулём
+        size_t  names_len;
+        size_t  names_cap;
+        size_t *offsets;   /// Смещение каждого имени в `names`
+        size_t  count;
+        size_t  cap;
+};
+
+/// Доля каталога `--shard`: экземпляр `index` из `count` берёт только
+/// имена, хеш которых (`hash_mix` от `hash_bytes`) по модулю `count`
+/// равен `index`. Хеш зависит лишь
+/// от байтов имени, поэтому доли на разных машинах не пересекаются, а
+/// вместе покрывают весь каталог. `count` 0 или 1 — весь каталог.
+struct shard
+{
+        size_t index; /// С нуля, меньше `count`
+        size_t count;
 };
 
+int
+scan_dir(struct dir_scan *scan);
+void
+scan_free(struct dir_scan *scan);
+int
+scan_push(struct dir_scan *scan, const char *name);
+void
+scan_clear(struct dir_scan *scan);
+int
+shard_keep(const struct shard *shard, const char *name);
+void
+scan_shard(struct dir_scan *scan, const struct shard *shard);
+size_t
+scan_count_matches(const struct dir_scan *scan, const struct command *cmd);
+struct target **
+match_targets(const struct dir_scan *scan, const struct command *cmd);
 struct target **
-find_target(const struct command *cmd);
+find_target(const struct command *cmd, const struct shard *shard);
+const char *
+target_path(const struct target *t);
+void
+free_target(struct target *t);
+void
+free_targets(struct target **targets);
 int
 mk_dir(const char *dir);
 int
@@ -0,0 +1,62 @@
+#define _GNU_SOURCE
+
+#include "rejected.h"
+
+#include "clip.h"
+#include "common.h"
+#include "stats.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/// Различает ключи пропущенных дубликатов и занятых имён.
+#define REJECTED_SKIP_SALT 0x736b69702d647570ULL
+
+static uint64_t
+rejected_key(const struct target *t)
+{
+        const uint64_t key[4] = {(uint64_t) t->dev, (uint64_t) t->ino,
+                                 (uint64_t) t->mtime, (uint64_t) t->size};
+        return hash_bytes(key, sizeof(key));
+}
+
+/// Запоминает файл, имя которого в каталоге назначения занято.
+void
+rejected_note_taken(struct seenset *s, const struct target *t)
+{
+        seenset_add(s, rejected_key(t));
+}
+
+/// Запоминает дубликат, оставленный на месте `--dedupe=skip`.
+void
+rejected_note_skipped(struct seenset *s, const struct target *t)
+{
+        seenset_add(s, hash_mix(rejected_key(t) ^ REJECTED_SKIP_SALT));
+}
+
+/// Сверяет файл с фильтром и подтверждает попадание.
+/// @return Значение `enum rejected_state`.
+int
+rejected_check(const struct seenset *s, const struct target *t)
+{
+        const uint64_t key = rejected_key(t);
+        if (seenset_contains(s, key))
+        {
+                char *dst = concat(t->cmd->dir, "/", t->name, NULL);
+                stats_count(STATS_SYSCALLS, 1);
+                const int taken =
+                    NULL != dst && 0 == faccessat(AT_FDCWD, dst, F_OK,
+                                                  AT_SYMLINK_NOFOLLOW);
+                free(dst);
+                if (taken)
+                {
+                        return REJECTED_TAKEN;
+                }
+        }
+        if (seenset_contains(s, hash_mix(key ^ REJECTED_SKIP_SALT)))
+        {
+                return REJECTED_PARKED;
+        }
+        return REJECTED_NEW;
+}
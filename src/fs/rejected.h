@@ -0,0 +1,34 @@
+#ifndef REJECTED_H
+#define REJECTED_H
+
+#include "fs.h"
+#include "seenset.h"
+
+/// Итог сверки файла с фильтром отклонённых.
+enum rejected_state
+{
+        REJECTED_NEW,    /// Файла в фильтре нет: обрабатывать
+        REJECTED_TAKEN,  /// Имя в каталоге назначения всё ещё занято
+        REJECTED_PARKED, /// Пропущенный дубликат или ложное срабатывание:
+                         /// повторить после смены поколения фильтра
+};
+
+/// Фильтр отклонённых файлов `--watch` поверх `seenset`.
+///
+/// Ключ — (dev, inode, `mtime`, размер): запись в файл возвращает его к
+/// проверке. Отказ из-за занятого имени и пропуск дубликата
+/// `--dedupe=skip` записываются разными ключами, потому что фильтр
+/// отвечает «вероятно было» и каждое попадание подтверждается по-своему:
+/// - занятое имя — одним `faccessat` в каталоге назначения; если имя
+///   свободно, файл обрабатывается сразу;
+/// - пропуск дубликата дёшево не подтвердить, такой файл откладывается
+///   до смены поколения фильтра.
+/// Ложное срабатывание стоит новому файлу задержки, но не теряет его.
+void
+rejected_note_taken(struct seenset *s, const struct target *t);
+void
+rejected_note_skipped(struct seenset *s, const struct target *t);
+int
+rejected_check(const struct seenset *s, const struct target *t);
+
+#endif //REJECTED_H
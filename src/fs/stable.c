@@ -0,0 +1,92 @@
+#define _GNU_SOURCE
+
+#include "stable.h"
+
+#include "stats.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+void
+stable_init(struct stable_gate *g, const unsigned settle_s)
+{
+        g->settle_ns = (uint64_t) settle_s * 1000000000ULL;
+}
+
+/// Прошло ли с `mtime` не меньше периода тишины.
+static int
+settled(const struct stable_gate *g, const struct stat *st)
+{
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        const int64_t age_ns =
+            ((int64_t) now.tv_sec - (int64_t) st->st_mtim.tv_sec) *
+                1000000000LL +
+            ((int64_t) now.tv_nsec - (int64_t) st->st_mtim.tv_nsec);
+        return 0 <= age_ns && (uint64_t) age_ns >= g->settle_ns;
+}
+
+/// Проверяет, что файл `t` дописан и его можно забирать.
+///
+/// Никогда не ждёт: одно `open`, `fstat`, пробная аренда и `close`.
+/// Недописанные файлы вызывающий пропускает (в режиме `--watch` —
+/// откладывает до следующей попытки).
+///
+/// @return Значение `enum stable_state`.
+int
+stable_check(const struct stable_gate *g, const struct target *t)
+{
+        const int fd =
+            open(target_path(t), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        stats_count(STATS_SYSCALLS, 1);
+        if (-1 == fd)
+        {
+                return EWOULDBLOCK == errno ? STABLE_BUSY : STABLE_GONE;
+        }
+        struct stat st;
+        int         state = STABLE_OK;
+        if (-1 == fstat(fd, &st))
+        {
+                state = STABLE_GONE;
+        }
+        else if (st.st_size != t->size || st.st_mtime != t->mtime)
+        {
+                state = STABLE_CHANGED;
+        }
+        else if (0 == fcntl(fd, F_SETLEASE, F_RDLCK))
+        {
+                fcntl(fd, F_SETLEASE, F_UNLCK);
+        }
+        else if (EAGAIN == errno)
+        {
+                state = STABLE_BUSY;
+        }
+        else if (!settled(g, &st))
+        {
+                state = STABLE_RECENT;
+        }
+        stats_count(STATS_SYSCALLS, STABLE_OK == state ? 4 : 3);
+        close(fd);
+        return state;
+}
+
+const char *
+stable_state_text(const int state)
+{
+        switch (state)
+        {
+        case STABLE_BUSY:
+                return "файл открыт на запись";
+        case STABLE_CHANGED:
+                return "файл изменился после сканирования";
+        case STABLE_RECENT:
+                return "файл менялся недавно";
+        case STABLE_GONE:
+                return "файл исчез";
+        default:
+                return "файл готов";
+        }
+}
@@ -0,0 +1,38 @@
+#ifndef STABLE_H
+#define STABLE_H
+
+#include "fs.h"
+
+#include <stdint.h>
+
+/// Итог проверки, дописан ли файл.
+enum stable_state
+{
+        STABLE_OK,      /// Файл никто не пишет, можно забирать
+        STABLE_BUSY,    /// Файл открыт на запись (аренда не выдана)
+        STABLE_CHANGED, /// Размер или `mtime` изменились после сканирования
+        STABLE_RECENT,  /// Аренда недоступна, а файл менялся недавно
+        STABLE_GONE,    /// Файл исчез или не открывается
+};
+
+/// Проверка «файл дописан» перед раскладкой.
+///
+/// Основной способ — пробная аренда на чтение (`F_SETLEASE`,
+/// `F_RDLCK`): ядро отказывает в ней, пока файл у кого-то открыт на
+/// запись. Где аренда недоступна (чужой владелец без `CAP_LEASE`, NFS и
+/// другие ФС без аренды), файл считается дописанным, если он не
+/// менялся `settle_ns`. В обоих случаях размер и `mtime` сверяются со
+/// снимком из `match_targets` — это вторая выборка без ожидания.
+struct stable_gate
+{
+        uint64_t settle_ns; /// Период тишины для проверки по `mtime`
+};
+
+void
+stable_init(struct stable_gate *g, unsigned settle_s);
+int
+stable_check(const struct stable_gate *g, const struct target *t);
+const char *
+stable_state_text(int state);
+
+#endif //STABLE_H
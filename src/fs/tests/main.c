@@ -1,4 +1,7 @@
 #include "test_fs.h"
+#include "test_dirstamp.h"
+#include "test_rejected.h"
+#include "test_stable.h"
 #include "unity.h"
 
 void
@@ -23,6 +26,13 @@ main(void)
         RUN_TEST(test_make_dir_recursive_create);
         RUN_TEST(test_make_dir_recursive_existing);
         RUN_TEST(test_make_dir_recursive_invalid);
+        RUN_TEST(test_scan_dir_match_targets);
+        RUN_TEST(test_scan_shard_partition);
+        RUN_TEST(test_stable_check);
+        RUN_TEST(test_dirstamp_roundtrip);
+        RUN_TEST(test_dirstamp_racy);
+        RUN_TEST(test_rejected_taken_confirmed);
+        RUN_TEST(test_rejected_false_positive);
         UNITY_END();
         return 0;
 }
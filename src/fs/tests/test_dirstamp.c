@@ -0,0 +1,111 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "test_dirstamp.h"
+
+#include "dirstamp.h"
+#include "unity.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+void
+test_dirstamp_roundtrip(void)
+{
+        char dir[] = "/tmp/tn_dirstamp_XXXXXX";
+        TEST_ASSERT_NOT_NULL(mkdtemp(dir));
+        char path[64];
+        snprintf(path, sizeof(path), "%s/cache", dir);
+        char sub[64];
+        snprintf(sub, sizeof(sub), "%s/watched", dir);
+        TEST_ASSERT_EQUAL_INT(0, mkdir(sub, 0755));
+
+        struct command        jpg     = {.ext = "jpg", .dir = "img"};
+        struct command        png     = {.ext = "png", .dir = "img"};
+        const struct command *one[]   = {&jpg, NULL};
+        const struct command *two[]   = {&jpg, &png, NULL};
+        const struct command *swap[]  = {&png, &jpg, NULL};
+        const uint64_t        rules   = dirstamp_rules(two);
+        TEST_ASSERT_EQUAL_UINT64(rules, dirstamp_rules(swap));
+        TEST_ASSERT_NOT_EQUAL(rules, dirstamp_rules(one));
+
+        int             err = DIRSTAMP_OK;
+        struct dirstamp c;
+        // файла ещё нет — пустой кеш
+        TEST_ASSERT_EQUAL_INT(0, dirstamp_load(&err, &c, path));
+        // каталог только что создан: без запаса его штамп был бы «racy»
+        c.racy_ns = 0;
+        struct stat st;
+        TEST_ASSERT_EQUAL_INT(0, stat(sub, &st));
+        TEST_ASSERT_EQUAL_INT(0, dirstamp_fresh(&c, &st, rules));
+        TEST_ASSERT_EQUAL_INT(1, dirstamp_update(&err, &c, &st, rules));
+        TEST_ASSERT_EQUAL_INT(0, dirstamp_save(&err, &c));
+        dirstamp_free(&c);
+
+        TEST_ASSERT_EQUAL_INT(0, dirstamp_load(&err, &c, path));
+        TEST_ASSERT_EQUAL_size_t(1, c.count);
+        TEST_ASSERT_EQUAL_INT(1, dirstamp_fresh(&c, &st, rules));
+        TEST_ASSERT_EQUAL_INT(0, dirstamp_fresh(&c, &st, dirstamp_rules(one)));
+        // новый файл меняет mtime каталога
+        char file[96];
+        snprintf(file, sizeof(file), "%s/a.jpg", sub);
+        FILE *f = fopen(file, "w");
+        TEST_ASSERT_NOT_NULL(f);
+        fclose(f);
+        TEST_ASSERT_EQUAL_INT(0, stat(sub, &st));
+        TEST_ASSERT_EQUAL_INT(0, dirstamp_fresh(&c, &st, rules));
+        dirstamp_free(&c);
+
+        // чужой файл — пустой кеш, а не ошибка
+        f = fopen(path, "w");
+        TEST_ASSERT_NOT_NULL(f);
+        fputs("garbage\n", f);
+        fclose(f);
+        TEST_ASSERT_EQUAL_INT(0, dirstamp_load(&err, &c, path));
+        TEST_ASSERT_EQUAL_size_t(0, c.count);
+        dirstamp_free(&c);
+
+        unlink(file);
+        unlink(path);
+        rmdir(sub);
+        rmdir(dir);
+}
+
+void
+test_dirstamp_racy(void)
+{
+        char dir[] = "/tmp/tn_dirstamp_XXXXXX";
+        TEST_ASSERT_NOT_NULL(mkdtemp(dir));
+        char path[64];
+        snprintf(path, sizeof(path), "%s/cache", dir);
+        struct command        jpg     = {.ext = "jpg", .dir = "img"};
+        const struct command *rules[] = {&jpg, NULL};
+
+        int             err = DIRSTAMP_OK;
+        struct dirstamp c;
+        TEST_ASSERT_EQUAL_INT(0, dirstamp_load(&err, &c, path));
+        struct stat before;
+        TEST_ASSERT_EQUAL_INT(0, stat(dir, &before));
+        // отметки каталога моложе запаса — штамп не запоминается
+        TEST_ASSERT_EQUAL_INT(
+            0, dirstamp_update(&err, &c, &before, dirstamp_rules(rules)));
+        TEST_ASSERT_EQUAL_size_t(0, c.count);
+
+        // файл в тот же тик: при грубых отметках времени stat каталога
+        // не меняется, и каталог всё равно должен быть прочитан
+        char file[96];
+        snprintf(file, sizeof(file), "%s/a.jpg", dir);
+        FILE *f = fopen(file, "w");
+        TEST_ASSERT_NOT_NULL(f);
+        fclose(f);
+        struct stat after;
+        TEST_ASSERT_EQUAL_INT(0, stat(dir, &after));
+        after.st_mtim = before.st_mtim;
+        after.st_ctim = before.st_ctim;
+        TEST_ASSERT_EQUAL_INT(
+            0, dirstamp_fresh(&c, &after, dirstamp_rules(rules)));
+        dirstamp_free(&c);
+
+        unlink(file);
+        rmdir(dir);
+}
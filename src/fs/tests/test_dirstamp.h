@@ -0,0 +1,9 @@
+#ifndef TEST_DIRSTAMP_H
+#define TEST_DIRSTAMP_H
+
+void
+test_dirstamp_roundtrip(void);
+void
+test_dirstamp_racy(void);
+
+#endif //TEST_DIRSTAMP_H
@@ -1,6 +1,7 @@
 #include "test_fs.h"
 
 #include "unity.h"
+#include "clip.h"
 #include "fs.h"
 
 #include <stdio.h>
@@ -101,3 +102,86 @@ test_make_dir_recursive_invalid(void)
         // Например, пустая строка
         TEST_ASSERT_EQUAL(-1, make_dir_recursive(""));
 }
+
+void
+test_scan_dir_match_targets(void)
+{
+        TEST_ASSERT_EQUAL_INT(0, mkdir(TMP_DIR_NAME, 0755));
+        TEST_ASSERT_EQUAL_INT(0, chdir(TMP_DIR_NAME));
+        FILE *f = fopen("a.txt", "w");
+        TEST_ASSERT_NOT_NULL(f);
+        fclose(f);
+        f = fopen("b.log", "w");
+        TEST_ASSERT_NOT_NULL(f);
+        fclose(f);
+        TEST_ASSERT_EQUAL_INT(0, mkdir("dir.txt", 0755));
+
+        struct dir_scan scan;
+        TEST_ASSERT_EQUAL_INT(0, scan_dir(&scan));
+        // каталог отброшен уже при чтении по d_type
+        TEST_ASSERT_EQUAL_UINT(2, scan.count);
+        struct command  txt     = {.ext = "txt", .dir = "out"};
+        struct target **targets = match_targets(&scan, &txt);
+        TEST_ASSERT_NOT_NULL(targets);
+        TEST_ASSERT_EQUAL_STRING("a.txt", targets[0]->name);
+        TEST_ASSERT_NULL(targets[1]);
+        struct command md = {.ext = "md", .dir = "out"};
+        TEST_ASSERT_NULL(match_targets(&scan, &md));
+        TEST_ASSERT_EQUAL_size_t(1, scan_count_matches(&scan, &txt));
+        TEST_ASSERT_EQUAL_size_t(0, scan_count_matches(&scan, &md));
+        scan_free(&scan);
+
+        free((void *) targets[0]->cmd->ext);
+        free((void *) targets[0]->cmd->dir);
+        free(targets[0]->cmd);
+        free(targets[0]->name);
+        free(targets[0]);
+        free((void *) targets);
+        remove("a.txt");
+        remove("b.log");
+        rmdir("dir.txt");
+        TEST_ASSERT_EQUAL_INT(0, chdir(".."));
+        rmdir(TMP_DIR_NAME);
+}
+
+void
+test_scan_shard_partition(void)
+{
+        struct dir_scan all;
+        char            name[32];
+        memset(&all, 0, sizeof(all));
+        for (int i = 0; i < 1000; ++i)
+        {
+                snprintf(name, sizeof(name), "file%d.jpg", i);
+                TEST_ASSERT_EQUAL_INT(0, scan_push(&all, name));
+        }
+        // каждое имя попадает ровно в одну из трёх долей
+        size_t owners[1000] = {0};
+        for (size_t s = 0; s < 3; ++s)
+        {
+                struct dir_scan    part;
+                const struct shard shard = {.index = s, .count = 3};
+                memset(&part, 0, sizeof(part));
+                for (size_t i = 0; i < all.count; ++i)
+                {
+                        scan_push(&part, all.names + all.offsets[i]);
+                }
+                scan_shard(&part, &shard);
+                TEST_ASSERT_GREATER_THAN(200, part.count);
+                for (size_t i = 0; i < part.count; ++i)
+                {
+                        int n = -1;
+                        sscanf(part.names + part.offsets[i], "file%d", &n);
+                        TEST_ASSERT_TRUE(n >= 0 && n < 1000);
+                        ++owners[n];
+                }
+                scan_free(&part);
+        }
+        for (size_t i = 0; i < 1000; ++i)
+        {
+                TEST_ASSERT_EQUAL_size_t(1, owners[i]);
+        }
+        scan_shard(&all, NULL);
+        TEST_ASSERT_EQUAL_size_t(1000, all.count);
+        scan_free(&all);
+}
@@ -10,5 +10,7 @@ void test_mk_dir_existing(void);
 void test_make_dir_recursive_create(void);
 void test_make_dir_recursive_existing(void);
 void test_make_dir_recursive_invalid(void);
+void test_scan_dir_match_targets(void);
+void test_scan_shard_partition(void);
 
 #endif // TEST_FS_H
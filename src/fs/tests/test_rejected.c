@@ -0,0 +1,86 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "test_rejected.h"
+
+#include "clip.h"
+#include "rejected.h"
+#include "unity.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define REJECTED_DIR "tmp_rejected_out"
+
+static struct command cmd = {.ext = "txt", .dir = REJECTED_DIR};
+
+static void
+fake_target(struct target *t, char *name, const time_t mtime)
+{
+        memset(t, 0, sizeof(*t));
+        t->name  = name;
+        t->cmd   = &cmd;
+        t->dev   = 1;
+        t->ino   = 2;
+        t->size  = 3;
+        t->mtime = mtime;
+}
+
+void
+test_rejected_taken_confirmed(void)
+{
+        struct seenset s;
+        TEST_ASSERT_EQUAL_INT(0, seenset_init(&s, 1024, 0));
+        TEST_ASSERT_EQUAL_INT(0, mkdir(REJECTED_DIR, 0755));
+        char          name[] = "a.txt";
+        struct target t;
+        fake_target(&t, name, 1);
+        TEST_ASSERT_EQUAL_INT(REJECTED_NEW, rejected_check(&s, &t));
+        FILE *f = fopen(REJECTED_DIR "/a.txt", "w");
+        TEST_ASSERT_NOT_NULL(f);
+        fclose(f);
+        rejected_note_taken(&s, &t);
+        TEST_ASSERT_EQUAL_INT(REJECTED_TAKEN, rejected_check(&s, &t));
+        // имя освободилось — файл снова обрабатывается
+        TEST_ASSERT_EQUAL_INT(0, remove(REJECTED_DIR "/a.txt"));
+        TEST_ASSERT_EQUAL_INT(REJECTED_NEW, rejected_check(&s, &t));
+        rejected_note_skipped(&s, &t);
+        TEST_ASSERT_EQUAL_INT(REJECTED_PARKED, rejected_check(&s, &t));
+        rmdir(REJECTED_DIR);
+        seenset_free(&s);
+}
+
+/// Фильтр на 64 бита заполнен так, что ложные срабатывания часты.
+/// Новый файл, на котором фильтр ошибся, не отбрасывается молча: имя
+/// в каталоге назначения свободно, поэтому он либо обрабатывается
+/// сразу, либо откладывается до смены поколения и после неё проходит.
+void
+test_rejected_false_positive(void)
+{
+        struct seenset s;
+        TEST_ASSERT_EQUAL_INT(0, seenset_init(&s, 6, 1));
+        char          name[] = "new.txt";
+        struct target t;
+        for (time_t i = 1; i <= 5; ++i)
+        {
+                fake_target(&t, name, -i);
+                rejected_note_taken(&s, &t);
+                rejected_note_skipped(&s, &t);
+        }
+        time_t parked = 0;
+        for (time_t i = 1; i < 100000 && 0 == parked; ++i)
+        {
+                fake_target(&t, name, i);
+                const int state = rejected_check(&s, &t);
+                TEST_ASSERT_NOT_EQUAL(REJECTED_TAKEN, state);
+                parked = REJECTED_PARKED == state ? i : 0;
+        }
+        TEST_ASSERT_NOT_EQUAL(0, parked);
+        const uint64_t epoch = s.epoch;
+        seenset_tick(&s, seenset_due_ns(&s) + 1);
+        TEST_ASSERT_NOT_EQUAL(epoch, s.epoch);
+        fake_target(&t, name, parked);
+        TEST_ASSERT_EQUAL_INT(REJECTED_NEW, rejected_check(&s, &t));
+        seenset_free(&s);
+}
@@ -0,0 +1,9 @@
+#ifndef TEST_REJECTED_H
+#define TEST_REJECTED_H
+
+void
+test_rejected_taken_confirmed(void);
+void
+test_rejected_false_positive(void);
+
+#endif //TEST_REJECTED_H
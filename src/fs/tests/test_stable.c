@@ -0,0 +1,52 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "test_stable.h"
+
+#include "stable.h"
+#include "unity.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define STABLE_FILE "tmp_stable.bin"
+
+static void
+snapshot(struct target *t)
+{
+        struct stat st;
+        TEST_ASSERT_EQUAL_INT(0, stat(STABLE_FILE, &st));
+        memset(t, 0, sizeof(*t));
+        t->name  = STABLE_FILE;
+        t->size  = st.st_size;
+        t->mtime = st.st_mtime;
+}
+
+void
+test_stable_check(void)
+{
+        struct stable_gate g;
+        stable_init(&g, 0);
+        int fd = open(STABLE_FILE, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        TEST_ASSERT_TRUE(0 <= fd);
+        TEST_ASSERT_EQUAL_INT(3, (int) write(fd, "abc", 3));
+        struct target t;
+        snapshot(&t);
+        // писатель ещё держит файл: аренда не выдаётся (если ФС умеет
+        // аренды) или, при settle = 0, файл считается дописанным
+        const int open_state = stable_check(&g, &t);
+        TEST_ASSERT_TRUE(STABLE_BUSY == open_state || STABLE_OK == open_state);
+        close(fd);
+        TEST_ASSERT_EQUAL_INT(STABLE_OK, stable_check(&g, &t));
+
+        // размер изменился после снимка
+        fd = open(STABLE_FILE, O_WRONLY | O_APPEND);
+        TEST_ASSERT_TRUE(0 <= fd);
+        TEST_ASSERT_EQUAL_INT(1, (int) write(fd, "d", 1));
+        close(fd);
+        TEST_ASSERT_EQUAL_INT(STABLE_CHANGED, stable_check(&g, &t));
+
+        unlink(STABLE_FILE);
+        TEST_ASSERT_EQUAL_INT(STABLE_GONE, stable_check(&g, &t));
+}
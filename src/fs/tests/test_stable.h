@@ -0,0 +1,7 @@
+#ifndef TEST_STABLE_H
+#define TEST_STABLE_H
+
+void
+test_stable_check(void);
+
+#endif //TEST_STABLE_H
@@ -0,0 +1,23 @@
+#include "test_libtn.h"
+
+#include "unity.h"
+
+void
+setUp(void)
+{ /* инициализация, если нужна */
+}
+void
+tearDown(void)
+{ /* очистка, если нужна */
+}
+
+int
+main(void)
+{
+        UNITY_BEGIN();
+        RUN_TEST(test_libtn_bad_args);
+        RUN_TEST(test_libtn_sort_reuses_ctx);
+        RUN_TEST(test_libtn_failure_codes);
+        RUN_TEST(test_libtn_parallel_sort);
+        return UNITY_END();
+}
@@ -0,0 +1,228 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "test_libtn.h"
+
+#include "tn.h"
+#include "unity.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+void
+test_libtn_bad_args(void)
+{
+        int err = TN_OK;
+        TEST_ASSERT_NULL(tn_open(&err, NULL, NULL));
+        TEST_ASSERT_EQUAL_INT(TN_ERR_BAD_ARG, err);
+        TEST_ASSERT_NULL(tn_open(&err, "jpg", NULL));
+        TEST_ASSERT_EQUAL_INT(TN_ERR_MAP, err);
+        // ссылка на оригинал возможна только при перемещении
+        const struct tn_options opts = {.mode   = TN_COPY,
+                                        .dedupe = TN_DEDUPE_LINK};
+        TEST_ASSERT_NULL(tn_open(&err, "jpg=img", &opts));
+        TEST_ASSERT_EQUAL_INT(TN_ERR_BAD_ARG, err);
+        tn_close(NULL);
+}
+
+static void
+put(const char *dir, const char *name)
+{
+        char path[128];
+        snprintf(path, sizeof(path), "%s/%s", dir, name);
+        FILE *f = fopen(path, "w");
+        TEST_ASSERT_NOT_NULL(f);
+        fputs(name, f);
+        fclose(f);
+}
+
+static void
+count_result(void *user, const struct tn_result *r)
+{
+        if (TN_MOVED == r->outcome)
+        {
+                ++*(int *) user;
+        }
+}
+
+void
+test_libtn_sort_reuses_ctx(void)
+{
+        char root[] = "/tmp/tn_libtn_XXXXXX";
+        TEST_ASSERT_NOT_NULL(mkdtemp(root));
+        char a[64];
+        char b[64];
+        snprintf(a, sizeof(a), "%s/a", root);
+        snprintf(b, sizeof(b), "%s/b", root);
+        TEST_ASSERT_EQUAL_INT(0, mkdir(a, 0755));
+        TEST_ASSERT_EQUAL_INT(0, mkdir(b, 0755));
+        put(a, "1.jpg");
+        put(a, "2.jpg");
+        put(a, "note.txt");
+        put(b, "3.jpg");
+        char before[256];
+        TEST_ASSERT_NOT_NULL(getcwd(before, sizeof(before)));
+
+        int                     moved = 0;
+        const struct tn_options opts  = {.on_result = count_result,
+                                         .user      = &moved};
+        int                     err   = TN_OK;
+        struct tn_ctx          *ctx   = tn_open(&err, "jpg=img", &opts);
+        TEST_ASSERT_NOT_NULL(ctx);
+        struct tn_summary sum;
+        TEST_ASSERT_EQUAL_INT(0, tn_sort(&err, ctx, a, &sum));
+        TEST_ASSERT_EQUAL_UINT64(2, sum.files[TN_MOVED]);
+        TEST_ASSERT_EQUAL_INT(0, tn_sort(&err, ctx, b, &sum));
+        TEST_ASSERT_EQUAL_UINT64(1, sum.files[TN_MOVED]);
+        TEST_ASSERT_EQUAL_INT(3, moved);
+        TEST_ASSERT_EQUAL_INT(-1, tn_sort(&err, ctx, "/nonexistent", NULL));
+        TEST_ASSERT_EQUAL_INT(TN_ERR_DIR, err);
+        tn_close(ctx);
+
+        // текущий каталог приложения не меняется
+        char after[256];
+        TEST_ASSERT_NOT_NULL(getcwd(after, sizeof(after)));
+        TEST_ASSERT_EQUAL_STRING(before, after);
+        char path[128];
+        snprintf(path, sizeof(path), "%s/img/2.jpg", a);
+        TEST_ASSERT_EQUAL_INT(0, access(path, F_OK));
+        TEST_ASSERT_EQUAL_INT(0, remove(path));
+        snprintf(path, sizeof(path), "%s/img/1.jpg", a);
+        remove(path);
+        snprintf(path, sizeof(path), "%s/img/3.jpg", b);
+        remove(path);
+        snprintf(path, sizeof(path), "%s/note.txt", a);
+        remove(path);
+        snprintf(path, sizeof(path), "%s/img", a);
+        rmdir(path);
+        snprintf(path, sizeof(path), "%s/img", b);
+        rmdir(path);
+        rmdir(a);
+        rmdir(b);
+        rmdir(root);
+}
+
+static void
+note_failure(void *user, const struct tn_result *r)
+{
+        if (TN_FAILED == r->outcome)
+        {
+                *(int *) user = r->error;
+        }
+}
+
+void
+test_libtn_failure_codes(void)
+{
+        char root[] = "/tmp/tn_libtn_XXXXXX";
+        TEST_ASSERT_NOT_NULL(mkdtemp(root));
+        char img[64];
+        snprintf(img, sizeof(img), "%s/img", root);
+        TEST_ASSERT_EQUAL_INT(0, mkdir(img, 0755));
+        put(root, "1.jpg");
+        put(img, "1.jpg");
+
+        int                     failure = TN_FAIL_NONE;
+        const struct tn_options opts    = {.on_result = note_failure,
+                                           .user      = &failure};
+        int                     err     = TN_OK;
+        struct tn_ctx          *ctx     = tn_open(&err, "jpg=img", &opts);
+        TEST_ASSERT_NOT_NULL(ctx);
+        struct tn_summary sum;
+        TEST_ASSERT_EQUAL_INT(0, tn_sort(&err, ctx, root, &sum));
+        TEST_ASSERT_EQUAL_UINT64(1, sum.files[TN_FAILED]);
+        TEST_ASSERT_EQUAL_INT(TN_FAIL_EXISTS, failure);
+        tn_close(ctx);
+
+        char path[128];
+        snprintf(path, sizeof(path), "%s/1.jpg", root);
+        remove(path);
+        snprintf(path, sizeof(path), "%s/1.jpg", img);
+        remove(path);
+        rmdir(img);
+        rmdir(root);
+}
+
+#define PARALLEL_JOBS  4
+#define PARALLEL_FILES 50
+
+struct parallel_job
+{
+        struct tn_ctx    *ctx;
+        char              dir[64];
+        struct tn_summary sum;
+        int               status;
+};
+
+static void *
+parallel_sort(void *arg)
+{
+        struct parallel_job *job = arg;
+        int                  err = TN_OK;
+        job->status              = tn_sort(&err, job->ctx, job->dir, &job->sum);
+        return NULL;
+}
+
+void
+test_libtn_parallel_sort(void)
+{
+        char root[] = "/tmp/tn_libtn_XXXXXX";
+        TEST_ASSERT_NOT_NULL(mkdtemp(root));
+        const struct tn_options opts = {.workers = PARALLEL_JOBS};
+        int                     err  = TN_OK;
+        // вложенные каталоги назначения создаются всеми потоками сразу
+        struct tn_ctx *ctx =
+            tn_open(&err, "jpg=deep/er/img;png=deep/er/pic", &opts);
+        TEST_ASSERT_NOT_NULL(ctx);
+        struct parallel_job jobs[PARALLEL_JOBS];
+        pthread_t           threads[PARALLEL_JOBS];
+        char                name[32];
+        for (int j = 0; j < PARALLEL_JOBS; ++j)
+        {
+                jobs[j].ctx = ctx;
+                snprintf(jobs[j].dir, sizeof(jobs[j].dir), "%s/%d", root, j);
+                TEST_ASSERT_EQUAL_INT(0, mkdir(jobs[j].dir, 0755));
+                for (int i = 0; i < PARALLEL_FILES; ++i)
+                {
+                        snprintf(name, sizeof(name), "%d.%s", i,
+                                 i % 2 ? "jpg" : "png");
+                        put(jobs[j].dir, name);
+                }
+        }
+        for (int j = 0; j < PARALLEL_JOBS; ++j)
+        {
+                TEST_ASSERT_EQUAL_INT(0, pthread_create(&threads[j], NULL,
+                                                        parallel_sort, &jobs[j]));
+        }
+        for (int j = 0; j < PARALLEL_JOBS; ++j)
+        {
+                pthread_join(threads[j], NULL);
+                TEST_ASSERT_EQUAL_INT(0, jobs[j].status);
+                TEST_ASSERT_EQUAL_UINT64(PARALLEL_FILES,
+                                         jobs[j].sum.files[TN_MOVED]);
+        }
+        tn_close(ctx);
+        char path[160];
+        for (int j = 0; j < PARALLEL_JOBS; ++j)
+        {
+                for (int i = 0; i < PARALLEL_FILES; ++i)
+                {
+                        snprintf(path, sizeof(path), "%s/deep/er/%s/%d.%s",
+                                 jobs[j].dir, i % 2 ? "img" : "pic", i,
+                                 i % 2 ? "jpg" : "png");
+                        TEST_ASSERT_EQUAL_INT(0, remove(path));
+                }
+                const char *dirs[] = {"deep/er/img", "deep/er/pic", "deep/er",
+                                      "deep", ""};
+                for (size_t d = 0; d < sizeof(dirs) / sizeof(*dirs); ++d)
+                {
+                        snprintf(path, sizeof(path), "%s/%s", jobs[j].dir,
+                                 dirs[d]);
+                        TEST_ASSERT_EQUAL_INT(0, rmdir(path));
+                }
+        }
+        rmdir(root);
+}
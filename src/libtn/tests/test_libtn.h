@@ -0,0 +1,13 @@
+#ifndef TEST_LIBTN_H
+#define TEST_LIBTN_H
+
+void
+test_libtn_bad_args(void);
+void
+test_libtn_sort_reuses_ctx(void);
+void
+test_libtn_failure_codes(void);
+void
+test_libtn_parallel_sort(void);
+
+#endif //TEST_LIBTN_H
@@ -0,0 +1,463 @@
+#define _GNU_SOURCE
+
+#include "tn.h"
+
+#include "clip.h"
+#include "common.h"
+#include "dedup.h"
+#include "executer.h"
+#include "fs.h"
+#include "record.h"
+#include "strset.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+_Static_assert((int) TN_OUTCOMES == (int) RECORD_OUTCOMES,
+               "enum tn_outcome must mirror enum record_outcome");
+_Static_assert((int) TN_LINK_SYM == (int) EXECUTE_LINK_SYM &&
+                   (int) TN_COPY == (int) EXECUTE_COPY,
+               "enum tn_mode must mirror enum execute_mode");
+_Static_assert((int) TN_DEDUPE_LINK == (int) CLIP_DEDUPE_LINK,
+               "enum tn_dedupe must mirror enum clip_dedupe");
+
+/// Коды `enum execute_error` в публичном `enum tn_failure`.
+static const int exec_failures[EXECUTOR_ERRORS] = {
+    [EXECUTOR_OK]              = TN_FAIL_NONE,
+    [EXECUTOR_ERR_BAD_ARG]     = TN_FAIL_OTHER,
+    [EXECUTOR_ERR_MKDIR]       = TN_FAIL_MKDIR,
+    [EXECUTOR_ERR_FILE_EXISTS] = TN_FAIL_EXISTS,
+    [EXECUTOR_ERR_MV]          = TN_FAIL_MOVE,
+    [EXECUTOR_ERR_CREATE_PATH] = TN_FAIL_OTHER,
+    [EXECUTOR_ERR_LINK]        = TN_FAIL_LINK,
+    [EXECUTOR_ERR_COPY]        = TN_FAIL_COPY,
+};
+
+/// Код `enum dedup_error` из `dedup_link` в публичном `enum tn_failure`.
+static int
+dedup_failure(const int error, const int err_no)
+{
+        switch (error)
+        {
+        case DEDUP_OK:
+                return TN_FAIL_NONE;
+        case DEDUP_ERR_NOT_MOVED:
+                return TN_FAIL_NOT_MOVED;
+        case DEDUP_ERR_LINK:
+                return EEXIST == err_no ? TN_FAIL_EXISTS : TN_FAIL_LINK;
+        case DEDUP_ERR_UNLINK:
+                return TN_FAIL_UNLINK;
+        default:
+                return TN_FAIL_OTHER;
+        }
+}
+
+/// Задание `tn_sort`, ждущее свободный рабочий поток.
+struct tn_job
+{
+        const char        *dir;
+        struct tn_summary *summary;
+        int                error; /// Значение из `enum tn_error`
+        int                done;
+        struct tn_job     *next;
+};
+
+/// Рабочий поток со своим текущим каталогом и кешами, которые живут
+/// между заданиями.
+struct tn_worker
+{
+        struct tn_ctx    *ctx;
+        pthread_t         thread;
+        struct strset     dir_cache;  /// Созданные каталоги назначения
+        struct copy_cache copy_cache; /// Способы копирования по устройствам
+        dev_t             dev;        /// Каталог, к которому относится
+        ino_t             ino;        /// `dir_cache`
+};
+
+/// Контекст: разобранные правила, параметры и пул рабочих потоков.
+///
+/// Код раскладки работает с путями относительно текущего каталога,
+/// поэтому задания выполняются не в потоке вызывающего, а в рабочих
+/// потоках контекста: каждый отделяет свой текущий каталог
+/// (`unshare(CLONE_FS)`) и переходит в каталог задания, не трогая
+/// текущий каталог приложения.
+struct tn_ctx
+{
+        const struct command **commands;
+        struct tn_options      opts;
+        int                    base_fd; /// Относительные пути заданий
+                                        /// отсчитываются от него
+        pthread_mutex_t        lock;
+        pthread_cond_t         wake;    /// Появилось задание или остановка
+        pthread_cond_t         done;    /// Задание выполнено или поток
+                                        /// запустился
+        struct tn_job         *head;
+        struct tn_job         *tail;
+        int                    stopping;
+        int                    failed;  /// Поток не смог отделить каталог
+        size_t                 started;
+        struct tn_worker      *workers;
+        size_t                 count;
+};
+
+/// Сообщает об итоге файла и учитывает его в сводке.
+static void
+emit(const struct tn_ctx *ctx, struct tn_summary *summary,
+     const struct target *t, const int outcome, const int failure,
+     const int err_no, const uint64_t latency_ns)
+{
+        ++summary->files[outcome];
+        if (NULL == ctx->opts.on_result)
+        {
+                return;
+        }
+        const struct tn_result r = {
+            .name       = t->name,
+            .dir        = t->cmd->dir,
+            .outcome    = outcome,
+            .error      = failure,
+            .err_no     = err_no,
+            .bytes      = (unsigned long long) t->size,
+            .latency_ns = latency_ns,
+        };
+        ctx->opts.on_result(ctx->opts.user, &r);
+}
+
+/// Раскладывает совпадения одного правила: оригиналы — одной пачкой
+/// `execute_batch`, затем дубликаты.
+/// @return 0 при успехе, -1 при нехватке памяти.
+static int
+place(struct tn_worker *w, struct target **targets,
+      struct tn_summary *summary)
+{
+        const struct tn_ctx *ctx = w->ctx;
+        if (TN_DEDUPE_OFF != ctx->opts.dedupe)
+        {
+                int error = DEDUP_OK;
+                // без хешей дубликаты просто не найдены — файлы
+                // раскладываются как есть
+                dedup(&error, targets, ctx->opts.threads);
+        }
+        size_t count = 0;
+        for (struct target **t = targets; *t; ++t)
+        {
+                count += NULL == (*t)->dup_of;
+        }
+        const struct target  **batch   = malloc((count + 1) * sizeof(*batch));
+        struct execute_result *results = malloc((count + 1) * sizeof(*results));
+        if (NULL == batch || NULL == results)
+        {
+                free((void *) batch);
+                free(results);
+                return -1;
+        }
+        size_t n = 0;
+        for (struct target **t = targets; *t; ++t)
+        {
+                if (NULL == (*t)->dup_of)
+                {
+                        batch[n++] = *t;
+                }
+        }
+        const struct execute_options exec = {
+            .mode       = ctx->opts.mode,
+            .dir_cache  = &w->dir_cache,
+            .copy_cache = &w->copy_cache,
+        };
+        int error = EXECUTOR_OK;
+        execute_batch(&error, batch, count, &exec, results);
+        static const int placed[] = {
+            [TN_MOVE]      = TN_MOVED,
+            [TN_LINK_HARD] = TN_LINKED,
+            [TN_LINK_SYM]  = TN_LINKED,
+            [TN_COPY]      = TN_COPIED,
+        };
+        for (size_t i = 0; i < count; ++i)
+        {
+                const struct execute_result *r = &results[i];
+                emit(ctx, summary, batch[i],
+                     EXECUTOR_OK == r->error ? placed[ctx->opts.mode]
+                                             : TN_FAILED,
+                     exec_failures[r->error], r->err_no, r->latency_ns);
+        }
+        free((void *) batch);
+        free(results);
+        for (struct target **t = targets; *t; ++t)
+        {
+                if (NULL == (*t)->dup_of)
+                {
+                        continue;
+                }
+                const uint64_t start   = monotonic_ns();
+                int            outcome = TN_SKIPPED;
+                int            err_no  = 0;
+                error                  = DEDUP_OK;
+                if (TN_DEDUPE_LINK == ctx->opts.dedupe)
+                {
+                        outcome = -1 == dedup_link(&error, *t) ? TN_FAILED
+                                                               : TN_DEDUPED;
+                        err_no  = TN_FAILED == outcome &&
+                                         DEDUP_ERR_NOT_MOVED != error
+                                      ? errno
+                                      : 0;
+                }
+                emit(ctx, summary, *t, outcome, dedup_failure(error, err_no),
+                     err_no, monotonic_ns() - start);
+        }
+        return 0;
+}
+
+/// Выполняет задание в текущем потоке: переходит в каталог задания,
+/// читает его один раз и сопоставляет снимок со всеми правилами.
+static int
+run_job(struct tn_worker *w, const struct tn_job *job)
+{
+        struct tn_ctx *ctx = w->ctx;
+        const int      fd  = openat(ctx->base_fd, job->dir,
+                                    O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        struct stat    st;
+        if (-1 == fd || -1 == fstat(fd, &st) || -1 == fchdir(fd))
+        {
+                if (-1 != fd)
+                {
+                        close(fd);
+                }
+                return TN_ERR_DIR;
+        }
+        close(fd);
+        // созданные каталоги относительны каталогу задания
+        if (w->dev != st.st_dev || w->ino != st.st_ino)
+        {
+                strset_clear(&w->dir_cache);
+                w->dev = st.st_dev;
+                w->ino = st.st_ino;
+        }
+        struct dir_scan scan;
+        if (-1 == scan_dir(&scan))
+        {
+                return TN_ERR_DIR;
+        }
+        int status = TN_OK;
+        for (const struct command **cmd = ctx->commands;
+             TN_OK == status && *cmd; ++cmd)
+        {
+                struct target **targets = match_targets(&scan, *cmd);
+                if (NULL != targets &&
+                    -1 == place(w, targets, job->summary))
+                {
+                        status = TN_ERR_MEM;
+                }
+                free_targets(targets);
+        }
+        scan_free(&scan);
+        return status;
+}
+
+static void *
+worker_main(void *arg)
+{
+        struct tn_worker *w   = arg;
+        struct tn_ctx    *ctx = w->ctx;
+        const int         own = 0 == unshare(CLONE_FS);
+        pthread_mutex_lock(&ctx->lock);
+        ++ctx->started;
+        ctx->failed |= !own;
+        pthread_cond_broadcast(&ctx->done);
+        for (;;)
+        {
+                while (NULL == ctx->head && !ctx->stopping)
+                {
+                        pthread_cond_wait(&ctx->wake, &ctx->lock);
+                }
+                // без своего текущего каталога задания менять его нельзя:
+                // он общий с приложением
+                if (ctx->stopping || !own)
+                {
+                        break;
+                }
+                struct tn_job *job = ctx->head;
+                ctx->head          = job->next;
+                if (NULL == ctx->head)
+                {
+                        ctx->tail = NULL;
+                }
+                pthread_mutex_unlock(&ctx->lock);
+                const int error = run_job(w, job);
+                pthread_mutex_lock(&ctx->lock);
+                job->error = error;
+                job->done  = 1;
+                pthread_cond_broadcast(&ctx->done);
+        }
+        pthread_mutex_unlock(&ctx->lock);
+        return NULL;
+}
+
+/// Создаёт контекст: разбирает карту `ext=dir;...` (как `-m`) и
+/// запускает рабочие потоки. Дальше `tn_sort` можно вызывать сколько
+/// угодно раз и из разных потоков без затрат на запуск.
+///
+/// @param opts Параметры или NULL — значения по умолчанию.
+/// @return Контекст или NULL при ошибке (код в `*error`).
+struct tn_ctx *
+tn_open(int *error, const char *map, const struct tn_options *opts)
+{
+        *error = TN_OK;
+        if (NULL == map ||
+            (NULL != opts &&
+             ((unsigned) opts->mode > TN_COPY ||
+              (unsigned) opts->dedupe > TN_DEDUPE_LINK ||
+              (TN_DEDUPE_LINK == opts->dedupe && TN_MOVE != opts->mode))))
+        {
+                *error = TN_ERR_BAD_ARG;
+                return NULL;
+        }
+        struct tn_ctx *ctx = calloc(1, sizeof(*ctx));
+        if (NULL == ctx)
+        {
+                *error = TN_ERR_MEM;
+                return NULL;
+        }
+        if (NULL != opts)
+        {
+                ctx->opts = *opts;
+        }
+        if (0 == ctx->opts.workers)
+        {
+                ctx->opts.workers = TN_WORKERS;
+        }
+        pthread_mutex_init(&ctx->lock, NULL);
+        pthread_cond_init(&ctx->wake, NULL);
+        pthread_cond_init(&ctx->done, NULL);
+        int clip_error = CLIP_OK;
+        ctx->commands  = clip_parse_map(&clip_error, map);
+        ctx->base_fd   = open(".", O_PATH | O_DIRECTORY | O_CLOEXEC);
+        ctx->workers   = calloc(ctx->opts.workers, sizeof(*ctx->workers));
+        if (NULL == ctx->commands || -1 == ctx->base_fd ||
+            NULL == ctx->workers)
+        {
+                *error = CLIP_ERR_BAD_M_OPT == clip_error ? TN_ERR_MAP
+                         : -1 == ctx->base_fd             ? TN_ERR_DIR
+                                                          : TN_ERR_MEM;
+                tn_close(ctx);
+                return NULL;
+        }
+        for (; ctx->count < ctx->opts.workers; ++ctx->count)
+        {
+                struct tn_worker *w = &ctx->workers[ctx->count];
+                w->ctx              = ctx;
+                if (-1 == strset_init(&w->dir_cache, 0))
+                {
+                        *error = TN_ERR_MEM;
+                        break;
+                }
+                if (0 != pthread_create(&w->thread, NULL, worker_main, w))
+                {
+                        strset_free(&w->dir_cache);
+                        *error = TN_ERR_THREAD;
+                        break;
+                }
+        }
+        pthread_mutex_lock(&ctx->lock);
+        while (ctx->started < ctx->count)
+        {
+                pthread_cond_wait(&ctx->done, &ctx->lock);
+        }
+        pthread_mutex_unlock(&ctx->lock);
+        if (TN_OK == *error && ctx->failed)
+        {
+                *error = TN_ERR_THREAD;
+        }
+        if (TN_OK != *error)
+        {
+                tn_close(ctx);
+                return NULL;
+        }
+        return ctx;
+}
+
+/// Раскладывает каталог `dir` (относительный путь — от текущего
+/// каталога на момент `tn_open`) по правилам контекста и ждёт
+/// завершения. Текущий каталог приложения не меняется.
+///
+/// @param summary Итоги по файлам или NULL.
+/// @return 0 при успехе, -1 при ошибке (код в `*error`). Отказы
+///         отдельных файлов ошибкой задания не считаются — они в
+///         `summary` и `on_result`.
+int
+tn_sort(int *error, struct tn_ctx *ctx, const char *dir,
+        struct tn_summary *summary)
+{
+        *error = TN_OK;
+        if (NULL == ctx || NULL == dir)
+        {
+                *error = TN_ERR_BAD_ARG;
+                return -1;
+        }
+        struct tn_summary local;
+        struct tn_job     job = {
+                .dir     = dir,
+                .summary = NULL == summary ? &local : summary,
+        };
+        memset(job.summary, 0, sizeof(*job.summary));
+        pthread_mutex_lock(&ctx->lock);
+        if (NULL == ctx->tail)
+        {
+                ctx->head = &job;
+        }
+        else
+        {
+                ctx->tail->next = &job;
+        }
+        ctx->tail = &job;
+        pthread_cond_signal(&ctx->wake);
+        while (!job.done)
+        {
+                pthread_cond_wait(&ctx->done, &ctx->lock);
+        }
+        pthread_mutex_unlock(&ctx->lock);
+        *error = job.error;
+        return TN_OK == job.error ? 0 : -1;
+}
+
+/// Останавливает рабочие потоки и освобождает контекст. Вызывать после
+/// того, как все `tn_sort` вернулись. NULL допустим.
+void
+tn_close(struct tn_ctx *ctx)
+{
+        if (NULL == ctx)
+        {
+                return;
+        }
+        pthread_mutex_lock(&ctx->lock);
+        ctx->stopping = 1;
+        pthread_cond_broadcast(&ctx->wake);
+        pthread_mutex_unlock(&ctx->lock);
+        for (size_t i = 0; i < ctx->count; ++i)
+        {
+                pthread_join(ctx->workers[i].thread, NULL);
+                strset_free(&ctx->workers[i].dir_cache);
+                copy_cache_free(&ctx->workers[i].copy_cache);
+        }
+        free(ctx->workers);
+        for (const struct command **c = ctx->commands; c && *c; ++c)
+        {
+                free((void *) (*c)->ext);
+                free((void *) (*c)->dir);
+                free((void *) *c);
+        }
+        free((void *) ctx->commands);
+        if (-1 != ctx->base_fd)
+        {
+                close(ctx->base_fd);
+        }
+        pthread_cond_destroy(&ctx->wake);
+        pthread_cond_destroy(&ctx->done);
+        pthread_mutex_destroy(&ctx->lock);
+        free(ctx);
+}
@@ -0,0 +1,122 @@
+#ifndef TN_H
+#define TN_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Встраиваемый интерфейс `tn`: раскладка каталогов без запуска
+/// процесса. Заголовок не зависит от внутренних модулей, его можно
+/// подключать из C и C++.
+
+enum tn_error
+{
+        TN_OK,
+        TN_ERR_BAD_ARG,
+        TN_ERR_MAP,    /// Неверная карта правил
+        TN_ERR_MEM,
+        TN_ERR_THREAD, /// Не удалось запустить рабочий поток
+        TN_ERR_DIR,    /// Каталог задания не открывается или не читается
+};
+
+/// Способ раскладки, как `--link`/`--copy` у `tn`.
+enum tn_mode
+{
+        TN_MOVE,
+        TN_LINK_HARD,
+        TN_LINK_SYM,
+        TN_COPY,
+};
+
+/// Обработка дубликатов, как `--dedupe`.
+enum tn_dedupe
+{
+        TN_DEDUPE_OFF,
+        TN_DEDUPE_SKIP,
+        TN_DEDUPE_LINK,
+};
+
+/// Итог файла; значения совпадают с полем `outcome` потока `--format`.
+enum tn_outcome
+{
+        TN_MOVED,
+        TN_LINKED,
+        TN_COPIED,
+        TN_ARCHIVED, /// Не используется библиотекой
+        TN_DEDUPED,
+        TN_SKIPPED,
+        TN_FAILED,
+        TN_BUSY,     /// Не используется библиотекой
+        TN_OUTCOMES,
+};
+
+/// Причина отказа `TN_FAILED`: одно пространство кодов для раскладки
+/// оригиналов и для ссылок на них у дубликатов.
+enum tn_failure
+{
+        TN_FAIL_NONE,
+        TN_FAIL_EXISTS,    /// Имя в каталоге назначения занято
+        TN_FAIL_MKDIR,     /// Не создан каталог назначения
+        TN_FAIL_MOVE,
+        TN_FAIL_LINK,
+        TN_FAIL_COPY,
+        TN_FAIL_UNLINK,    /// Дубликат связан, но не удалён с места
+        TN_FAIL_NOT_MOVED, /// Оригинал дубликата не разложен
+        TN_FAIL_OTHER,     /// Неверный путь или нехватка памяти
+};
+
+/// Результат одного файла, передаётся в `tn_options.on_result`.
+/// Строки действительны только во время вызова.
+struct tn_result
+{
+        const char        *name;   /// Имя файла в каталоге задания
+        const char        *dir;    /// Каталог назначения
+        int                outcome; /// Значение из `enum tn_outcome`
+        int                error;  /// Значение из `enum tn_failure`
+        int                err_no; /// `errno` при ошибке, иначе 0
+        unsigned long long bytes;
+        unsigned long long latency_ns;
+};
+
+/// Вызывается из рабочего потока контекста для каждого файла.
+typedef void (*tn_result_fn)(void *user, const struct tn_result *result);
+
+/// Параметры контекста. Нулевая структура (или NULL) — перемещение без
+/// дедупликации, `TN_WORKERS` рабочих потоков, без обратного вызова.
+struct tn_options
+{
+        int          mode;      /// Значение из `enum tn_mode`
+        int          dedupe;    /// Значение из `enum tn_dedupe`
+        size_t       workers;   /// Заданий одновременно; 0 — `TN_WORKERS`
+        size_t       threads;   /// Потоки хеширования дубликатов; 0 — по
+                                /// числу процессоров
+        tn_result_fn on_result; /// NULL — только итоги в `tn_summary`
+        void        *user;      /// Первый аргумент `on_result`
+};
+
+/// Число рабочих потоков контекста по умолчанию.
+#define TN_WORKERS 2
+
+/// Итоги одного задания.
+struct tn_summary
+{
+        unsigned long long files[TN_OUTCOMES]; /// Число файлов по итогам
+};
+
+struct tn_ctx;
+
+struct tn_ctx *
+tn_open(int *error, const char *map, const struct tn_options *opts);
+int
+tn_sort(int *error, struct tn_ctx *ctx, const char *dir,
+        struct tn_summary *summary);
+void
+tn_close(struct tn_ctx *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //TN_H
@@ -1,14 +1,176 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "archive.h"
+#include "claim.h"
 #include "clip.h"
+#include "common.h"
+#include "daemon.h"
+#include "dedup.h"
+#include "dirstamp.h"
+#include "errsum.h"
 #include "executer.h"
 #include "fs.h"
+#include "metrics.h"
+#include "plan.h"
+#include "profile.h"
+#include "progress.h"
+#include "record.h"
+#include "report.h"
+#include "rejected.h"
+#include "seenset.h"
+#include "stable.h"
+#include "stats.h"
+#include "trace.h"
+#include "watch.h"
 
 #include <ctype.h>
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 void
 usage(const char *prog_name);
+void
+free_commands(const struct command **commands);
+int
+dry_run(const struct command **commands);
+/// Куда и в каком виде сообщать о результатах обработки файлов.
+struct output
+{
+        struct reporter *info;    /// Строки об успехе; NULL — молчать
+        struct reporter *err;     /// Сообщения об ошибках
+        struct reporter *records; /// Поток записей `--format`; NULL — нет
+        int              format;  /// Значение из `enum record_format`
+        struct errsum   *errors;  /// Сводка ошибок, печатается в конце
+        struct metrics  *metrics; /// Счётчики `--metrics`; NULL — нет
+};
+
+int
+handle_duplicate(const struct output *o, const struct target *t, int mode,
+                 int *error);
+int
+archive_target(const struct output *o, struct archive *ar,
+               const struct target *t, int *error);
+int
+execute_target(const struct output *o, const struct target *t,
+               const struct execute_options *opts, int *error);
+int
+report_placed(const struct output *o, const struct target *t,
+              const struct execute_options *opts,
+              const struct execute_result *r, int *error);
+void
+report_failure(const struct output *o, const struct target *t,
+               const char *what, int code, int err_no);
+const char *
+exec_error_text(int error);
+const char *
+archive_error_text(int error);
+const char *
+dedup_error_text(int error);
+int
+execute_mode(const struct clip_options *opts);
+int
+record_format(int format);
+void
+print_stats(void);
+int
+save_trace(void);
+
+/// Всё, что нужно для обработки снимка каталога или пачки имён.
+struct run
+{
+        const struct output          *o;
+        const struct execute_options *exec;
+        struct archive               *ar;       /// `--archive` или NULL
+        struct profile               *profile;  /// `--profile` или NULL
+        struct progress              *progress; /// `--progress` или NULL
+        const struct stable_gate     *gate;     /// `--settle` или NULL
+        struct dir_scan              *deferred; /// Отложенные до следующей
+                                                /// пачки `--watch` или NULL
+        struct dir_scan              *busy;     /// Уже объявленные занятыми
+                                                /// `--watch` или NULL
+        uint64_t                     *counts;   /// Итоги по `enum
+                                                /// record_outcome` или NULL
+        struct seenset               *rejected; /// Отклонённые файлы
+                                                /// `--watch` или NULL
+        struct dir_scan              *parked;   /// Отложенные до смены
+                                                /// поколения `rejected`
+        const struct claimer         *claimer;  /// `--claim` или NULL
+};
+
+/// Ключей в поколении фильтра отклонённых файлов `--watch` (два
+/// поколения по 10 бит на ключ — 160 КиБ) и срок поколения, с.
+#define WATCH_REJECTED_KEYS  65536
+#define WATCH_REJECTED_AGE_S 300
+/// Период сводки ошибок `--watch`, с: наблюдение может идти днями, и
+/// сводка в конце прогона пришла бы только с `SIGTERM`.
+#define WATCH_ERRSUM_S 60
+
+void
+note_outcome(const struct run *run, const struct record *rec);
+void
+hold_unstable(const struct run *run, struct target **targets);
+int
+scan_contains(const struct dir_scan *scan, const char *name);
+void
+park_name(struct dir_scan *parked, const char *name);
+int
+drop_rejected(const struct run *run, struct target **targets);
+void
+note_rejected(const struct run *run, const struct target *t,
+              const struct record *rec);
+int
+claim_targets(const struct run *run, struct target **targets);
+void
+release_claim(const struct run *run, struct target *t, int outcome);
+void
+merge_deferred(struct dir_scan *batch, struct dir_scan *deferred);
+void
+remember_busy(struct dir_scan *busy, const struct dir_scan *deferred);
+int
+watch_timeout(const struct run *run, uint64_t due_ns);
+struct execute_result *
+place_originals(const struct run *run, struct target **targets);
+void
+process_scan(const struct run *run, const struct dir_scan *scan,
+             const struct command **commands, int report_empty);
+int
+watch_loop(const struct run *run, struct watcher *w,
+           const struct command **commands);
+
+/// Кеши одного рабочего потока `tn daemon`: живут между заданиями.
+struct daemon_local
+{
+        struct strset     dir_cache;  /// Созданные каталоги назначения
+        struct copy_cache copy_cache;
+        dev_t             dev;        /// Каталог, к которому относится
+        ino_t             ino;        /// `dir_cache`
+};
+
+/// Общее состояние заданий `tn daemon`.
+struct daemon_state
+{
+        struct reporter          *err;
+        struct metrics           *metrics; /// `--metrics` или NULL
+        const struct stable_gate *gate;    /// `--settle` или NULL
+        struct daemon_local      *locals;  /// По одному на рабочий поток
+};
+
+int
+run_daemon(const struct command **commands);
+struct shard
+shard_option(void);
+uint64_t
+stamp_rules(const struct command **commands);
+int
+dir_unchanged(const char *path, const struct command **commands);
+int
+stamp_dir(const char *path, const struct command **commands);
+int
+daemon_job(void *ctx, const struct daemon_job *job, char *reply, size_t cap);
 
 int
 main(const int argc, char **argv)
@@ -26,72 +188,1361 @@ main(const int argc, char **argv)
                 usage(argv[0]);
                 return EXIT_FAILURE;
         }
-        for (const struct command **cmd = commands; cmd && *cmd; ++cmd)
+        if (clip_get_options()->stats)
+        {
+                stats_enable();
+        }
+        if (NULL != clip_get_options()->trace)
+        {
+                trace_enable();
+        }
+        if (clip_get_options()->dry_run)
+        {
+                int status = dry_run(commands);
+                free_commands(commands);
+                print_stats();
+                if (-1 == save_trace())
+                {
+                        status = EXIT_FAILURE;
+                }
+                return status;
+        }
+        if (clip_get_options()->daemon)
+        {
+                const int status = run_daemon(commands);
+                free_commands(commands);
+                return status;
+        }
+        const char *stamp_path = clip_get_options()->dir_cache;
+        if (NULL != stamp_path && dir_unchanged(stamp_path, commands))
+        {
+                if (!clip_get_options()->quiet)
+                {
+                        fprintf(stderr, "Каталог не менялся с прошлого "
+                                        "прогона\n");
+                }
+                free_commands(commands);
+                return EXIT_SUCCESS;
+        }
+        // захваты, брошенные упавшими экземплярами этого хоста,
+        // возвращаются до сканирования
+        struct claimer claimer;
+        const int      claiming = clip_get_options()->claim;
+        if (claiming)
+        {
+                if (-1 == claim_init(&claimer))
+                {
+                        perror("Не удалось подготовить захват файлов");
+                        free_commands(commands);
+                        return EXIT_FAILURE;
+                }
+                const size_t restored = claim_recover(&claimer);
+                if (0 != restored && !clip_get_options()->quiet)
+                {
+                        fprintf(stderr,
+                                "Возвращено из брошенных захватов: %zu\n",
+                                restored);
+                }
+        }
+        struct profile  prof;
+        struct profile *profile = NULL;
+        if (clip_get_options()->profile)
+        {
+                int prof_error = PROFILE_OK;
+                if (-1 == profile_open(&prof_error, &prof))
+                {
+                        fprintf(stderr, "Счётчики perf недоступны, "
+                                        "будет показано только время\n");
+                }
+                profile = &prof;
+        }
+        // наблюдение начинается до сканирования, чтобы не потерять файлы,
+        // появившиеся между ними
+        struct watcher  watch;
+        struct watcher *watcher = NULL;
+        if (clip_get_options()->watch)
+        {
+                int w_error = WATCH_OK;
+                const int backend =
+                    CLIP_WATCH_FANOTIFY == clip_get_options()->watch
+                        ? WATCH_FANOTIFY
+                        : WATCH_INOTIFY;
+                if (-1 == watch_open(&w_error, &watch, ".", backend))
+                {
+                        perror("Не удалось начать наблюдение за каталогом");
+                        profile_close(profile);
+                        free_commands(commands);
+                        return EXIT_FAILURE;
+                }
+                watcher = &watch;
+                if (0 != clip_get_options()->batch_window)
+                {
+                        watch.window_ms =
+                            (unsigned) clip_get_options()->batch_window;
+                }
+                if (0 != clip_get_options()->batch_size)
+                {
+                        watch.batch_max = clip_get_options()->batch_size;
+                }
+                if (backend != watch.backend)
+                {
+                        fprintf(stderr, "fanotify недоступен (нужны права "
+                                        "CAP_SYS_ADMIN), используется "
+                                        "inotify\n");
+                }
+        }
+        // каталог читается один раз, правила сопоставляются со снимком
+        struct dir_scan scan;
+        profile_begin(profile, PROFILE_SCAN);
+        const int scanned = scan_dir(&scan);
+        const struct shard shard = shard_option();
+        if (0 == scanned)
+        {
+                scan_shard(&scan, &shard);
+        }
+        profile_end(profile);
+        struct strset dir_cache;
+        if (-1 == scanned || -1 == strset_init(&dir_cache, 0))
+        {
+                fprintf(stderr, -1 == scanned
+                                    ? "Не удалось прочитать текущий каталог\n"
+                                    : "Недостаточно памяти\n");
+                if (-1 != scanned)
+                {
+                        scan_free(&scan);
+                }
+                watch_close(watcher);
+                profile_close(profile);
+                free_commands(commands);
+                return EXIT_FAILURE;
+        }
+        struct copy_cache            copy_cache = {0};
+        const struct execute_options exec_opts  = {
+            .mode       = execute_mode(clip_get_options()),
+            .dir_cache  = &dir_cache,
+            .copy_cache = &copy_cache,
+        };
+        // построчный вывод на каждый файл обходится дороже самих
+        // перемещений, поэтому отчёт копится и уходит крупными блоками
+        struct reporter out;
+        struct reporter err;
+        int             report_error = REPORT_OK;
+        if (-1 == reporter_init(&report_error, &out, STDOUT_FILENO, 0) ||
+            -1 == reporter_init(&report_error, &err, STDERR_FILENO, 0))
+        {
+                fprintf(stderr, "Недостаточно памяти\n");
+                reporter_free(&out);
+                strset_free(&dir_cache);
+                scan_free(&scan);
+                watch_close(watcher);
+                profile_close(profile);
+                free_commands(commands);
+                return EXIT_FAILURE;
+        }
+        // stdout занят либо строками, либо потоком записей, либо
+        // tar-потоком; во втором и третьем случае строки не смешиваются
+        // при массовых отказах (например, каталог только для чтения)
+        // сразу выводятся первые ошибки, остальные — сводкой в конце
+        struct errsum errors;
+        errsum_init(&errors, ERRSUM_LIVE_DEFAULT);
+        const char   *archive_path = clip_get_options()->archive;
+        struct output o            = {
+                       .info    = &out,
+                       .err     = &err,
+                       .records = NULL,
+                       .format  = record_format(clip_get_options()->format),
+                       .errors  = &errors,
+                       .metrics = NULL,
+        };
+        if (RECORD_TEXT != o.format)
+        {
+                o.records = &out;
+                o.info    = NULL;
+        }
+        else if (NULL != archive_path && 0 == strcmp(archive_path, "-"))
+        {
+                o.info = &err;
+        }
+        if (clip_get_options()->quiet)
+        {
+                o.info = NULL;
+        }
+        struct metrics metrics;
+        const char    *metrics_path = clip_get_options()->metrics;
+        if (NULL != metrics_path)
+        {
+                const size_t interval = clip_get_options()->metrics_interval;
+                int          m_error  = METRICS_OK;
+                if (-1 == metrics_open(&m_error, &metrics, metrics_path,
+                                       0 == interval
+                                           ? METRICS_INTERVAL_DEFAULT
+                                           : (unsigned) interval))
+                {
+                        fprintf(stderr, "Не удалось включить метрики: %s\n",
+                                metrics_path);
+                        reporter_free(&err);
+                        reporter_free(&out);
+                        errsum_free(&errors);
+                        strset_free(&dir_cache);
+                        scan_free(&scan);
+                        watch_close(watcher);
+                        profile_close(profile);
+                        free_commands(commands);
+                        return EXIT_FAILURE;
+                }
+                o.metrics = &metrics;
+        }
+        // строка прогресса заменяет строки об успехе: те всё равно
+        // сдвигали бы её; при выводе не в терминал прогресс выключается
+        struct progress  prog;
+        struct progress *progress = NULL;
+        if (clip_get_options()->progress)
+        {
+                uint64_t total = 0;
+                for (const struct command **cmd = commands; cmd && *cmd; ++cmd)
+                {
+                        total += scan_count_matches(&scan, *cmd);
+                }
+                int prog_error = PROGRESS_OK;
+                if (0 == progress_start(&prog_error, &prog, STDOUT_FILENO,
+                                        STDERR_FILENO, total))
+                {
+                        progress = &prog;
+                        o.info   = NULL;
+                }
+        }
+        struct archive ar;
+        if (NULL != archive_path)
+        {
+                int ar_error = ARCHIVE_OK;
+                if (-1 == archive_open(&ar_error, &ar, archive_path))
+                {
+                        fprintf(stderr, "Не удалось открыть архив: %s\n",
+                                archive_path);
+                        int m_error = METRICS_OK;
+                        progress_stop(progress);
+                        metrics_close(&m_error, o.metrics);
+                        reporter_free(&err);
+                        reporter_free(&out);
+                        errsum_free(&errors);
+                        strset_free(&dir_cache);
+                        scan_free(&scan);
+                        watch_close(watcher);
+                        profile_close(profile);
+                        free_commands(commands);
+                        return EXIT_FAILURE;
+                }
+        }
+        struct stable_gate gate;
+        stable_init(&gate, (unsigned) clip_get_options()->settle);
+        struct dir_scan deferred;
+        memset(&deferred, 0, sizeof(deferred));
+        struct dir_scan parked;
+        memset(&parked, 0, sizeof(parked));
+        struct dir_scan busy;
+        memset(&busy, 0, sizeof(busy));
+        // без памяти под фильтр наблюдение работает, просто без него
+        struct seenset rejected;
+        const int      filtered =
+            NULL != watcher &&
+            0 == seenset_init(&rejected, WATCH_REJECTED_KEYS,
+                              WATCH_REJECTED_AGE_S * 1000000000ULL);
+        struct run run = {
+            .o        = &o,
+            .exec     = &exec_opts,
+            .ar       = NULL != archive_path ? &ar : NULL,
+            .profile  = profile,
+            .progress = progress,
+            .gate     = 0 != clip_get_options()->settle ? &gate : NULL,
+            .deferred = NULL != watcher ? &deferred : NULL,
+            .busy     = NULL != watcher ? &busy : NULL,
+            .rejected = filtered ? &rejected : NULL,
+            .parked   = filtered ? &parked : NULL,
+            .claimer  = claiming ? &claimer : NULL,
+        };
+        record_begin(o.records, o.format);
+        process_scan(&run, &scan, commands, 1);
+        int status = EXIT_SUCCESS;
+        if (NULL != watcher && -1 == watch_loop(&run, watcher, commands))
+        {
+                status = EXIT_FAILURE;
+        }
+        if (NULL != stamp_path && -1 == stamp_dir(stamp_path, commands))
+        {
+                reporter_printf(&err, "Не удалось сохранить кеш каталогов: "
+                                      "%s\n",
+                                stamp_path);
+                status = EXIT_FAILURE;
+        }
+        if (NULL != archive_path)
         {
-                struct target **targets = find_target(*cmd);
+                int ar_error = ARCHIVE_OK;
+                if (-1 == archive_close(&ar_error, &ar))
+                {
+                        reporter_printf(&err,
+                                        "Ошибка при завершении архива: %s\n",
+                                        archive_path);
+                        status = EXIT_FAILURE;
+                }
+        }
+        progress_stop(progress);
+        int m_error = METRICS_OK;
+        if (-1 == metrics_close(&m_error, o.metrics))
+        {
+                reporter_printf(&err, "Не удалось записать метрики: %s\n",
+                                metrics_path);
+                status = EXIT_FAILURE;
+        }
+        errsum_print(&errors, &err);
+        errsum_free(&errors);
+        reporter_free(&out);
+        reporter_free(&err);
+        copy_cache_free(&copy_cache);
+        strset_free(&dir_cache);
+        scan_free(&deferred);
+        scan_free(&parked);
+        scan_free(&busy);
+        if (filtered)
+        {
+                seenset_free(&rejected);
+        }
+        scan_free(&scan);
+        free_commands(commands);
+        print_stats();
+        if (NULL != profile)
+        {
+                profile_print(profile, stderr);
+                profile_close(profile);
+        }
+        if (-1 == save_trace())
+        {
+                status = EXIT_FAILURE;
+        }
+        watch_close(watcher);
+        return status;
+}
 
+/// Сопоставляет снимок (или пачку имён из `--watch`) со всеми правилами
+/// и раскладывает совпавшие файлы.
+/// \param report_empty Сообщать о правилах без подходящих файлов
+void
+process_scan(const struct run *run, const struct dir_scan *scan,
+             const struct command **commands, const int report_empty)
+{
+        for (const struct command **cmd = commands; cmd && *cmd; ++cmd)
+        {
+                profile_begin(run->profile, PROFILE_MATCH);
+                const uint64_t  span    = trace_begin();
+                struct target **targets = match_targets(scan, *cmd);
+                trace_end("match", "rule", span, (*cmd)->ext);
+                profile_end(run->profile);
                 if (targets == NULL)
                 {
-                        fprintf(stderr,
-                                "Нет подходящих файлов с расширением: '%s'\n",
-                                (*cmd)->ext);
+                        if (report_empty)
+                        {
+                                reporter_printf(run->o->err,
+                                                "Нет подходящих файлов с "
+                                                "расширением: '%s'\n",
+                                                (*cmd)->ext);
+                        }
+                        continue;
+                }
+                if (0 == drop_rejected(run, targets))
+                {
+                        free_targets(targets);
+                        continue;
+                }
+                profile_begin(run->profile, PROFILE_EXECUTE);
+                hold_unstable(run, targets);
+                if (0 == claim_targets(run, targets))
+                {
+                        profile_end(run->profile);
+                        free_targets(targets);
                         continue;
                 }
+                const int dedupe      = clip_get_options()->dedupe;
+                int       dedup_error = DEDUP_OK;
+                if (CLIP_DEDUPE_OFF != dedupe &&
+                    -1 == dedup(&dedup_error, targets,
+                                clip_get_options()->threads))
+                {
+                        reporter_printf(run->o->err,
+                                        "Ошибка поиска дубликатов, "
+                                        "файлы будут перемещены как есть\n");
+                }
+                // оригиналы раскладываются одной пачкой до дубликатов:
+                // `--dedupe=link` ссылается на уже перемещённый оригинал
+                struct execute_result *placed =
+                    NULL == run->ar ? place_originals(run, targets) : NULL;
+                size_t next = 0;
                 for (struct target **t = targets; *t; ++t)
                 {
-                        int exec_error = EXECUTOR_OK;
-                        if (execute(&exec_error, *t) == -1)
+                        uint64_t start   = monotonic_ns();
+                        int      error   = 0;
+                        int      outcome = RECORD_FAILED;
+                        int      domain  = RECORD_DOMAIN_EXECUTE;
+                        if (NULL != (*t)->dup_of)
+                        {
+                                domain  = RECORD_DOMAIN_DEDUP;
+                                outcome = handle_duplicate(run->o, *t, dedupe,
+                                                           &error);
+                        }
+                        else if (NULL != run->ar)
+                        {
+                                domain = RECORD_DOMAIN_ARCHIVE;
+                                outcome =
+                                    archive_target(run->o, run->ar, *t, &error);
+                        }
+                        else if (NULL != placed)
                         {
-                                switch (exec_error)
-                                {
-                                case EXECUTOR_ERR_BAD_ARG:
-                                        fprintf(stderr,
-                                                "Некорректные аргументы\n");
-                                        break;
-                                case EXECUTOR_ERR_CREATE_PATH:
-                                        fprintf(stderr, "Ошибка при создании "
-                                                        "пути к файлу\n");
-                                        break;
-                                case EXECUTOR_ERR_FILE_EXISTS:
-                                        fprintf(stderr,
-                                                "Файл уже существует: %s/%s\n",
-                                                (*t)->cmd->dir, (*t)->name);
-                                        break;
-                                case EXECUTOR_ERR_MV:
-                                        fprintf(stderr,
-                                                "Ошибка при перемещении файла: "
-                                                "%s\n",
-                                                (*t)->name);
-                                        break;
-                                default:
-                                        fprintf(stderr, "Неизвестная ошибка\n");
-                                        break;
-                                }
+                                const struct execute_result *r =
+                                    &placed[next++];
+                                start   = monotonic_ns() - r->latency_ns;
+                                outcome = report_placed(run->o, *t, run->exec,
+                                                        r, &error);
                         }
                         else
                         {
-                                printf("Успешно: %s → %s/%s\n", (*t)->name,
-                                       (*t)->cmd->dir, (*t)->name);
+                                outcome = execute_target(run->o, *t, run->exec,
+                                                         &error);
                         }
+                        const struct record rec = {
+                            .source     = (*t)->name,
+                            .dir        = (*t)->cmd->dir,
+                            .name       = (*t)->name,
+                            .outcome    = outcome,
+                            .domain     = domain,
+                            .error      = error,
+                            .bytes      = (unsigned long long) (*t)->size,
+                            .latency_ns = monotonic_ns() - start,
+                        };
+                        note_outcome(run, &rec);
+                        note_rejected(run, *t, &rec);
+                        release_claim(run, *t, outcome);
                 }
-                for (struct target **t = targets; *t; ++t)
+                profile_end(run->profile);
+                free(placed);
+                free_targets(targets);
+        }
+}
+
+/// Раскладывает все файлы списка, кроме дубликатов, одним вызовом
+/// `execute_batch`.
+/// \return Итоги по порядку оригиналов или NULL при нехватке памяти —
+///         тогда файлы раскладываются по одному
+struct execute_result *
+place_originals(const struct run *run, struct target **targets)
+{
+        size_t count = 0;
+        for (struct target **t = targets; *t; ++t)
+        {
+                count += NULL == (*t)->dup_of;
+        }
+        const struct target  **batch   = malloc((count + 1) * sizeof(*batch));
+        struct execute_result *results = malloc((count + 1) * sizeof(*results));
+        if (NULL == batch || NULL == results)
+        {
+                free((void *) batch);
+                free(results);
+                return NULL;
+        }
+        size_t n = 0;
+        for (struct target **t = targets; *t; ++t)
+        {
+                if (NULL == (*t)->dup_of)
                 {
-                        free((void *) (*t)->name);
-                        free(
-                            (void *) (*t)
-                                ->cmd); // предполагается, что copy_command() возвращает malloc'нутый cmd
-                        free(*t);
+                        batch[n++] = *t;
                 }
-                free(targets);
         }
+        int error = EXECUTOR_OK;
+        execute_batch(&error, batch, count, run->exec, results);
+        free((void *) batch);
+        return results;
+}
+
+/// Учитывает итог файла во всех включённых отчётах.
+void
+note_outcome(const struct run *run, const struct record *rec)
+{
+        record_write(run->o->records, run->o->format, rec);
+        metrics_file(run->o->metrics, rec->outcome, rec->bytes,
+                     rec->latency_ns);
+        progress_add(run->progress, rec->bytes);
+        if (NULL != run->counts)
+        {
+                ++run->counts[rec->outcome];
+        }
+}
+
+/// `--settle`: убирает из списка файлы, которые ещё пишутся, и
+/// сообщает о них как о занятых. В режиме `--watch` их имена
+/// откладываются до следующей пачки; о файле, занятом и при повторной
+/// проверке, второй раз не сообщается.
+void
+hold_unstable(const struct run *run, struct target **targets)
+{
+        if (NULL == run->gate)
+        {
+                return;
+        }
+        struct target **kept = targets;
+        for (struct target **t = targets; *t; ++t)
+        {
+                const int state = stable_check(run->gate, *t);
+                if (STABLE_OK == state)
+                {
+                        *kept++ = *t;
+                        continue;
+                }
+                if (STABLE_GONE != state &&
+                    0 != scan_contains(run->busy, (*t)->name))
+                {
+                        scan_push(run->deferred, (*t)->name);
+                }
+                else if (STABLE_GONE != state)
+                {
+                        reporter_printf(run->o->err, "Файл занят (%s): %s\n",
+                                        stable_state_text(state), (*t)->name);
+                        const struct record rec = {
+                            .source  = (*t)->name,
+                            .dir     = (*t)->cmd->dir,
+                            .name    = (*t)->name,
+                            .outcome = RECORD_BUSY,
+                            .bytes   = (unsigned long long) (*t)->size,
+                        };
+                        note_outcome(run, &rec);
+                        if (NULL != run->deferred)
+                        {
+                                scan_push(run->deferred, (*t)->name);
+                        }
+                }
+                free_target(*t);
+        }
+        *kept = NULL;
+}
+
+/// `--watch`: убирает из списка файлы, уже отклонённые в этом состоянии,
+/// чтобы повторные события и перечитывания каталога не повторяли
+/// проверки занятости, поиск дубликатов и пробы коллизий. Попадание
+/// фильтра подтверждается (`rejected_check`); что подтвердить нельзя,
+/// откладывается до смены поколения фильтра, а не теряется.
+/// \return 0, если список опустел
+int
+drop_rejected(const struct run *run, struct target **targets)
+{
+        struct target **kept = targets;
+        for (struct target **t = targets; *t; ++t)
+        {
+                const int state = rejected_check(run->rejected, *t);
+                if (REJECTED_NEW == state)
+                {
+                        *kept++ = *t;
+                        continue;
+                }
+                if (REJECTED_PARKED == state && NULL != run->parked)
+                {
+                        park_name(run->parked, (*t)->name);
+                }
+                free_target(*t);
+        }
+        *kept = NULL;
+        return kept != targets;
+}
+
+/// `--watch`: запоминает файлы, которые останутся на месте и при
+/// повторной попытке: имя в каталоге назначения занято или дубликат
+/// пропущен `--dedupe=skip`. Прочие ошибки могут быть временными и
+/// в фильтр не попадают.
+void
+note_rejected(const struct run *run, const struct target *t,
+              const struct record *rec)
+{
+        if (RECORD_SKIPPED == rec->outcome)
+        {
+                rejected_note_skipped(run->rejected, t);
+        }
+        else if (RECORD_FAILED == rec->outcome &&
+                 RECORD_DOMAIN_EXECUTE == rec->domain &&
+                 EXECUTOR_ERR_FILE_EXISTS == rec->error)
+        {
+                rejected_note_taken(run->rejected, t);
+        }
+}
+
+/// `--claim`: захватывает файлы списка. Файлы, которые уже забрал
+/// другой экземпляр, молча убираются из списка.
+/// \return 0, если список опустел
+int
+claim_targets(const struct run *run, struct target **targets)
+{
+        if (NULL == run->claimer)
+        {
+                return NULL != *targets;
+        }
+        struct target **kept = targets;
+        for (struct target **t = targets; *t; ++t)
+        {
+                int       error = CLAIM_OK;
+                const int rc    = claim_target(&error, run->claimer, *t);
+                if (1 == rc)
+                {
+                        *kept++ = *t;
+                        continue;
+                }
+                if (-1 == rc)
+                {
+                        reporter_printf(run->o->err,
+                                        "Не удалось захватить файл: %s "
+                                        "(%s)\n",
+                                        (*t)->name, strerror(errno));
+                }
+                free_target(*t);
+        }
+        *kept = NULL;
+        return kept != targets;
+}
+
+/// `--claim`: возвращает исходное имя файлу, который остался на месте.
+/// Перемещённый файл унёс захват с собой: с него снимается только
+/// атрибут захвата по хешу.
+void
+release_claim(const struct run *run, struct target *t, const int outcome)
+{
+        int error = CLAIM_OK;
+        if (NULL != run->claimer && RECORD_MOVED == outcome)
+        {
+                claim_moved(t);
+        }
+        if (NULL == run->claimer || RECORD_MOVED == outcome ||
+            RECORD_DEDUPED == outcome || -1 != claim_release(&error, t))
+        {
+                return;
+        }
+        reporter_printf(run->o->err,
+                        "Имя занято, файл оставлен под именем захвата: %s\n",
+                        t->claim);
+}
+
+/// \return 1, если имя есть в списке, иначе 0 (и для NULL)
+int
+scan_contains(const struct dir_scan *scan, const char *name)
+{
+        for (size_t i = 0; NULL != scan && i < scan->count; ++i)
+        {
+                if (0 == strcmp(name, scan->names + scan->offsets[i]))
+                {
+                        return 1;
+                }
+        }
+        return 0;
+}
+
+/// Откладывает имя до смены поколения фильтра, если его там ещё нет.
+void
+park_name(struct dir_scan *parked, const char *name)
+{
+        if (0 == scan_contains(parked, name))
+        {
+                scan_push(parked, name);
+        }
+}
+
+/// Срок ожидания событий `--watch`: период тишины для файлов,
+/// отложенных `--settle`, до смены поколения фильтра — для отложенных
+/// фильтром, и `due_ns`.
+/// \param due_ns Ещё один срок по `monotonic_ns` или `UINT64_MAX`
+/// \return Миллисекунды для `watch_read`, -1 — без срока
+int
+watch_timeout(const struct run *run, uint64_t due_ns)
+{
+        int timeout = 0 != run->deferred->count
+                          ? (int) (clip_get_options()->settle * 1000)
+                          : -1;
+        const uint64_t aged = NULL != run->parked && 0 != run->parked->count
+                                  ? seenset_due_ns(run->rejected)
+                                  : UINT64_MAX;
+        const uint64_t due  = aged < due_ns ? aged : due_ns;
+        if (UINT64_MAX != due)
+        {
+                const uint64_t now  = monotonic_ns();
+                const int      wait = due > now
+                                          ? (int) ((due - now + 999999) / 1000000)
+                                          : 0;
+                timeout = -1 == timeout || wait < timeout ? wait : timeout;
+        }
+        return timeout;
+}
+
+/// Добавляет в пачку отложенные имена, которых в ней ещё нет.
+void
+merge_deferred(struct dir_scan *batch, struct dir_scan *deferred)
+{
+        const size_t own = batch->count;
+        for (size_t i = 0; i < deferred->count; ++i)
+        {
+                const char *name = deferred->names + deferred->offsets[i];
+                size_t      j    = 0;
+                while (j < own &&
+                       0 != strcmp(name, batch->names + batch->offsets[j]))
+                {
+                        ++j;
+                }
+                if (j == own)
+                {
+                        scan_push(batch, name);
+                }
+        }
+        scan_clear(deferred);
+}
+
+/// Запоминает отложенные `--settle` имена как уже объявленные занятыми:
+/// повторная проверка молча откладывает их снова. Имена, которые
+/// стали стабильными или исчезли, выпадают из списка сами.
+void
+remember_busy(struct dir_scan *busy, const struct dir_scan *deferred)
+{
+        scan_clear(busy);
+        for (size_t i = 0; i < deferred->count; ++i)
+        {
+                scan_push(busy, deferred->names + deferred->offsets[i]);
+        }
+}
+
+/// Режим `--watch`: после начального прогона обрабатывает файлы по мере
+/// появления, пачками из событий inotify, до `SIGINT`/`SIGTERM`.
+/// При переполнении очереди событий каталог перечитывается целиком.
+/// Файлы, отложенные `--settle`, проверяются снова с каждой пачкой или,
+/// если событий нет, через период тишины; отложенные фильтром
+/// отклонённых — после смены его поколения. Сводка ошибок печатается
+/// и начинается заново раз в `WATCH_ERRSUM_S`.
+/// \return 0 при штатной остановке, -1 при ошибке наблюдения
+int
+watch_loop(const struct run *run, struct watcher *w,
+           const struct command **commands)
+{
+        struct dir_scan batch;
+        memset(&batch, 0, sizeof(batch));
+        const struct shard shard  = shard_option();
+        int                status = 0;
+        // смена поколения фильтра возвращает отложенные им имена
+        uint64_t epoch = NULL != run->rejected ? run->rejected->epoch : 0;
+        uint64_t summary_ns =
+            monotonic_ns() + WATCH_ERRSUM_S * 1000000000ULL;
+        for (;;)
+        {
+                int       w_error  = WATCH_OK;
+                int       overflow = 0;
+                const int rc       = watch_read(
+                    &w_error, w, &batch, &overflow,
+                    watch_timeout(run, NULL != run->o->errors &&
+                                               0 != run->o->errors->total
+                                           ? summary_ns
+                                           : UINT64_MAX));
+                if (1 != rc)
+                {
+                        if (-1 == rc)
+                        {
+                                reporter_printf(run->o->err,
+                                                "Ошибка наблюдения за "
+                                                "каталогом\n");
+                                status = -1;
+                        }
+                        break;
+                }
+                seenset_tick(run->rejected, monotonic_ns());
+                // поколение сменилось: отложенные фильтром проверяются
+                // заново
+                const int retry = NULL != run->rejected &&
+                                  epoch != run->rejected->epoch;
+                if (retry)
+                {
+                        epoch = run->rejected->epoch;
+                }
+                remember_busy(run->busy, run->deferred);
+                if (overflow)
+                {
+                        scan_clear(run->deferred);
+                        if (retry)
+                        {
+                                scan_clear(run->parked);
+                        }
+                        struct dir_scan full;
+                        if (0 == scan_dir(&full))
+                        {
+                                scan_shard(&full, &shard);
+                                process_scan(run, &full, commands, 0);
+                                scan_free(&full);
+                        }
+                }
+                else
+                {
+                        // отложенные имена уже прошли отбор по доле
+                        scan_shard(&batch, &shard);
+                        merge_deferred(&batch, run->deferred);
+                        if (retry)
+                        {
+                                merge_deferred(&batch, run->parked);
+                        }
+                        process_scan(run, &batch, commands, 0);
+                }
+                // в режиме наблюдения отчёт не должен ждать конца прогона
+                const uint64_t now = monotonic_ns();
+                if (now >= summary_ns)
+                {
+                        errsum_print(run->o->errors, run->o->err);
+                        errsum_reset(run->o->errors);
+                        summary_ns = now + WATCH_ERRSUM_S * 1000000000ULL;
+                }
+                reporter_flush(run->o->info);
+                reporter_flush(run->o->records);
+                reporter_flush(run->o->err);
+        }
+        scan_free(&batch);
+        return status;
+}
+
+/// Доля `--shard` из параметров; без `--shard` — весь каталог.
+struct shard
+shard_option(void)
+{
+        const struct clip_options *opts  = clip_get_options();
+        const struct shard         shard = {
+                    .index = 0 == opts->shards ? 0 : opts->shard - 1,
+                    .count = opts->shards,
+        };
+        return shard;
+}
+
+/// Отпечаток правил для `--dir-cache`. Штамп, снятый для одной доли
+/// `--shard`, не годится для другой.
+uint64_t
+stamp_rules(const struct command **commands)
+{
+        const struct shard shard   = shard_option();
+        const uint64_t     part[2] = {shard.index, shard.count};
+        return dirstamp_rules(commands) +
+               (shard.count < 2 ? 0 : hash_bytes(part, sizeof(part)));
+}
+
+/// `--dir-cache`: не менялся ли текущий каталог с прогона, после
+/// которого в нём не осталось файлов для правил. Нечитаемый кеш —
+/// повод прочитать каталог, а не ошибка.
+int
+dir_unchanged(const char *path, const struct command **commands)
+{
+        struct dirstamp c;
+        struct stat     st;
+        int             error = DIRSTAMP_OK;
+        const int       fresh = 0 == dirstamp_load(&error, &c, path) &&
+                          0 == stat(".", &st) &&
+                          dirstamp_fresh(&c, &st, stamp_rules(commands));
+        dirstamp_free(&c);
+        return fresh;
+}
+
+/// `--dir-cache`: запоминает штамп текущего каталога, если в нём не
+/// осталось файлов для правил. Штамп снимается до проверочного чтения,
+/// а слишком свежий не запоминается (`DIRSTAMP_RACY_NS`): файл,
+/// появившийся после него, изменит `mtime` каталога даже при грубых
+/// отметках времени, и следующий прогон прочитает каталог.
+/// \return 0 при успехе или если штамп не нужен, -1 при ошибке кеша
+int
+stamp_dir(const char *path, const struct command **commands)
+{
+        struct stat     st;
+        struct dir_scan scan;
+        if (-1 == stat(".", &st) || -1 == scan_dir(&scan))
+        {
+                return 0;
+        }
+        const struct shard shard = shard_option();
+        scan_shard(&scan, &shard);
+        size_t left = 0;
+        for (const struct command **cmd = commands; cmd && *cmd; ++cmd)
+        {
+                left += scan_count_matches(&scan, *cmd);
+        }
+        scan_free(&scan);
+        if (0 != left)
+        {
+                return 0;
+        }
+        struct dirstamp c;
+        int             error  = DIRSTAMP_OK;
+        int             status = dirstamp_load(&error, &c, path);
+        if (0 == status)
+        {
+                status = dirstamp_update(&error, &c, &st,
+                                         stamp_rules(commands));
+        }
+        // 0 — штамп слишком свежий и не запомнен, сохранять нечего
+        if (1 == status)
+        {
+                status = dirstamp_save(&error, &c);
+        }
+        dirstamp_free(&c);
+        return status;
+}
+
+/// Режим `tn daemon`: принимает задания через `--socket`, пока не
+/// придёт `SIGINT`/`SIGTERM`. Правила из `-e`/`-d`/`-m` действуют для
+/// заданий без карты; `--threads` задаёт число одновременных заданий.
+/// \return `EXIT_SUCCESS` или `EXIT_FAILURE`
+int
+run_daemon(const struct command **commands)
+{
+        const size_t workers = 0 == clip_get_options()->threads
+                                   ? DAEMON_WORKERS
+                                   : clip_get_options()->threads;
+        struct reporter err;
+        int             report_error = REPORT_OK;
+        if (-1 == reporter_init(&report_error, &err, STDERR_FILENO, 0))
+        {
+                fprintf(stderr, "Недостаточно памяти\n");
+                return EXIT_FAILURE;
+        }
+        struct stable_gate  gate;
+        struct daemon_state state = {
+            .err     = &err,
+            .metrics = NULL,
+            .gate    = NULL,
+            .locals  = calloc(workers, sizeof(struct daemon_local)),
+        };
+        if (0 != clip_get_options()->settle)
+        {
+                stable_init(&gate, (unsigned) clip_get_options()->settle);
+                state.gate = &gate;
+        }
+        size_t ready = 0;
+        while (NULL != state.locals && ready < workers &&
+               0 == strset_init(&state.locals[ready].dir_cache, 0))
+        {
+                ++ready;
+        }
+        struct metrics metrics;
+        const char    *metrics_path = clip_get_options()->metrics;
+        int            status       = EXIT_FAILURE;
+        if (ready < workers)
+        {
+                fprintf(stderr, "Недостаточно памяти\n");
+                goto cleanup;
+        }
+        if (NULL != metrics_path)
+        {
+                const size_t interval = clip_get_options()->metrics_interval;
+                int          m_error  = METRICS_OK;
+                if (-1 == metrics_open(&m_error, &metrics, metrics_path,
+                                       0 == interval
+                                           ? METRICS_INTERVAL_DEFAULT
+                                           : (unsigned) interval))
+                {
+                        fprintf(stderr, "Не удалось включить метрики: %s\n",
+                                metrics_path);
+                        goto cleanup;
+                }
+                state.metrics = &metrics;
+        }
+        const char   *socket_path = clip_get_options()->socket;
+        struct daemon d;
+        int           d_error = DAEMON_OK;
+        if (-1 == daemon_open(&d_error, &d, socket_path, workers, commands,
+                              daemon_job, &state))
+        {
+                fprintf(stderr, "Не удалось открыть сокет %s: %s\n",
+                        socket_path, strerror(errno));
+        }
+        else
+        {
+                fprintf(stderr, "Ожидание заданий: %s\n", socket_path);
+                status = -1 == daemon_run(&d_error, &d) ? EXIT_FAILURE
+                                                        : EXIT_SUCCESS;
+                daemon_close(&d);
+        }
+        int m_error = METRICS_OK;
+        if (-1 == metrics_close(&m_error, state.metrics))
+        {
+                reporter_printf(&err, "Не удалось записать метрики: %s\n",
+                                metrics_path);
+                status = EXIT_FAILURE;
+        }
+cleanup:
+        for (size_t i = 0; i < ready; ++i)
+        {
+                strset_free(&state.locals[i].dir_cache);
+                copy_cache_free(&state.locals[i].copy_cache);
+        }
+        free(state.locals);
+        reporter_free(&err);
+        print_stats();
+        if (-1 == save_trace())
+        {
+                status = EXIT_FAILURE;
+        }
+        return status;
+}
+
+/// Одно задание `tn daemon`: раскладывает текущий каталог потока по
+/// правилам задания. Ответ — число файлов по итогам, например
+/// `files=3 moved=2 failed=1`.
+/// \return 0 при успехе, -1 если каталог не удалось прочитать
+int
+daemon_job(void *ctx, const struct daemon_job *job, char *reply,
+           const size_t cap)
+{
+        struct daemon_state *s = ctx;
+        struct daemon_local *l = &s->locals[job->worker];
+        // созданные каталоги относительны каталогу задания
+        if (l->dev != job->dev || l->ino != job->ino)
+        {
+                strset_clear(&l->dir_cache);
+                l->dev = job->dev;
+                l->ino = job->ino;
+        }
+        struct dir_scan scan;
+        if (-1 == scan_dir(&scan))
+        {
+                snprintf(reply, cap, "не удалось прочитать каталог");
+                return -1;
+        }
+        const struct shard shard = shard_option();
+        scan_shard(&scan, &shard);
+        struct errsum errors;
+        errsum_init(&errors, ERRSUM_LIVE_DEFAULT);
+        const struct output o = {
+            .info    = NULL,
+            .err     = s->err,
+            .records = NULL,
+            .format  = RECORD_TEXT,
+            .errors  = &errors,
+            .metrics = s->metrics,
+        };
+        const struct execute_options exec = {
+            .mode       = execute_mode(clip_get_options()),
+            .dir_cache  = &l->dir_cache,
+            .copy_cache = &l->copy_cache,
+        };
+        uint64_t   counts[RECORD_OUTCOMES] = {0};
+        struct run run                     = {
+                                .o      = &o,
+                                .exec   = &exec,
+                                .gate   = s->gate,
+                                .counts = counts,
+        };
+        process_scan(&run, &scan, job->commands, 0);
+        scan_free(&scan);
+        errsum_print(&errors, s->err);
+        errsum_free(&errors);
+        reporter_flush(s->err);
+        uint64_t files = 0;
+        for (int i = 0; i < RECORD_OUTCOMES; ++i)
+        {
+                files += counts[i];
+        }
+        int len = snprintf(reply, cap, "files=%llu", (unsigned long long) files);
+        for (int i = 0; i < RECORD_OUTCOMES; ++i)
+        {
+                if (0 != counts[i] && 0 < len && (size_t) len < cap)
+                {
+                        len += snprintf(reply + len, cap - (size_t) len,
+                                        " %s=%llu", record_outcome_name(i),
+                                        (unsigned long long) counts[i]);
+                }
+        }
+        return 0;
+}
+
+/// Сохраняет трассу `--trace`, если она включена, и освобождает буферы.
+/// Вызывается после завершения всех рабочих потоков.
+/// \return 0 при успехе или выключенной трассе, -1 при ошибке записи
+int
+save_trace(void)
+{
+        const char *path = clip_get_options()->trace;
+        if (NULL == path)
+        {
+                return 0;
+        }
+        const int status = trace_write(path);
+        if (-1 == status)
+        {
+                fprintf(stderr, "Не удалось записать трассу: %s\n", path);
+        }
+        trace_free();
+        return status;
+}
+
+/// Переносит файл исполнителем и сообщает об итоге.
+/// \return Значение `enum record_outcome`; код ошибки — в `error`
+int
+execute_target(const struct output *o, const struct target *t,
+               const struct execute_options *opts, int *error)
+{
+        struct execute_result r = {.error = EXECUTOR_OK};
+        if (-1 == execute_opt(&r.error, t, opts))
+        {
+                r.err_no = errno;
+        }
+        return report_placed(o, t, opts, &r, error);
+}
+
+/// Сообщает об итоге раскладки одного файла исполнителем.
+/// \return Значение `enum record_outcome`; код ошибки — в `error`
+int
+report_placed(const struct output *o, const struct target *t,
+              const struct execute_options *opts,
+              const struct execute_result *r, int *error)
+{
+        *error = r->error;
+        if (EXECUTOR_OK != r->error)
+        {
+                metrics_error(o->metrics, r->error);
+                report_failure(o, t, exec_error_text(r->error), r->error,
+                               r->err_no);
+                return RECORD_FAILED;
+        }
+        switch (opts->mode)
+        {
+        case EXECUTE_COPY:
+                reporter_printf(o->info, "Скопировано: %s → %s/%s\n", t->name,
+                                t->cmd->dir, t->name);
+                return RECORD_COPIED;
+        case EXECUTE_LINK_HARD:
+        case EXECUTE_LINK_SYM:
+                reporter_printf(o->info, "Ссылка: %s → %s/%s\n", t->name,
+                                t->cmd->dir, t->name);
+                return RECORD_LINKED;
+        default:
+                reporter_printf(o->info, "Успешно: %s → %s/%s\n", t->name,
+                                t->cmd->dir, t->name);
+                return RECORD_MOVED;
+        }
+}
+
+/// Дописывает файл в tar-поток; исходный файл остаётся на месте.
+/// \return Значение `enum record_outcome`; код ошибки — в `error`
+int
+archive_target(const struct output *o, struct archive *ar,
+               const struct target *t, int *error)
+{
+        if (-1 == archive_add(error, ar, t))
+        {
+                if (ARCHIVE_ERR_SELF == *error)
+                {
+                        reporter_printf(o->err, "Архив пропущен: %s\n",
+                                        t->name);
+                        return RECORD_SKIPPED;
+                }
+                report_failure(o, t, archive_error_text(*error), *error,
+                               ARCHIVE_ERR_CHANGED == *error ? 0 : errno);
+                return RECORD_FAILED;
+        }
+        reporter_printf(o->info, "В архив: %s → %s/%s\n", t->name,
+                        t->cmd->dir, t->name);
+        return RECORD_ARCHIVED;
+}
+
+/// Учитывает отказ в сводке и, если он среди первых, сразу сообщает
+/// о нём.
+void
+report_failure(const struct output *o, const struct target *t,
+               const char *what, const int code, const int err_no)
+{
+        errsum_note(o->errors, o->err, what, code, err_no, t->cmd->dir,
+                    t->name);
+}
+
+/// Описание ошибки исполнителя. Строки статические: по указателю
+/// ошибки группируются в сводке.
+const char *
+exec_error_text(const int error)
+{
+        switch (error)
+        {
+        case EXECUTOR_ERR_BAD_ARG:
+                return "Некорректные аргументы";
+        case EXECUTOR_ERR_CREATE_PATH:
+                return "Ошибка при создании пути к файлу";
+        case EXECUTOR_ERR_FILE_EXISTS:
+                return "Файл уже существует";
+        case EXECUTOR_ERR_MV:
+                return "Ошибка при перемещении файла";
+        case EXECUTOR_ERR_COPY:
+                return "Ошибка при копировании файла";
+        case EXECUTOR_ERR_LINK:
+                return "Ошибка при создании ссылки";
+        default:
+                return "Неизвестная ошибка";
+        }
+}
+
+const char *
+archive_error_text(const int error)
+{
+        switch (error)
+        {
+        case ARCHIVE_ERR_READ:
+                return "Ошибка при чтении файла";
+        case ARCHIVE_ERR_WRITE:
+                return "Ошибка при записи архива";
+        case ARCHIVE_ERR_CHANGED:
+                return "Файл изменился во время архивации";
+        case ARCHIVE_ERR_NAME_TOO_LONG:
+                return "Путь слишком длинный для архива";
+        default:
+                return "Неизвестная ошибка";
+        }
+}
+
+const char *
+dedup_error_text(const int error)
+{
+        switch (error)
+        {
+        case DEDUP_ERR_NOT_MOVED:
+                return "Дубликат оставлен на месте, оригинал не перемещён";
+        case DEDUP_ERR_LINK:
+                return "Ошибка при создании ссылки";
+        case DEDUP_ERR_UNLINK:
+                return "Ошибка при удалении дубликата";
+        default:
+                return "Неизвестная ошибка";
+        }
+}
+
+/// Печатает таблицу `--stats` в stderr, если статистика включена.
+/// Вызывается после сброса отчётов, чтобы таблица шла последней.
+void
+print_stats(void)
+{
+        if (stats_on)
+        {
+                stats_print(stderr);
+        }
+}
+
+/// Переводит `--format` в формат потока записей.
+int
+record_format(const int format)
+{
+        switch (format)
+        {
+        case CLIP_FORMAT_NDJSON:
+                return RECORD_NDJSON;
+        case CLIP_FORMAT_BIN:
+                return RECORD_BIN;
+        default:
+                return RECORD_TEXT;
+        }
+}
+
+/// Переводит `--link`/`--copy` в режим исполнителя.
+int
+execute_mode(const struct clip_options *opts)
+{
+        if (opts->copy)
+        {
+                return EXECUTE_COPY;
+        }
+        switch (opts->link)
+        {
+        case CLIP_LINK_HARD:
+                return EXECUTE_LINK_HARD;
+        case CLIP_LINK_SYM:
+                return EXECUTE_LINK_SYM;
+        default:
+                return EXECUTE_MOVE;
+        }
+}
+
+/// Обрабатывает файл, содержимое которого совпало с уже обработанным:
+/// оставляет его на месте либо заменяет перемещение жёсткой ссылкой.
+/// \return Значение `enum record_outcome`; код ошибки — в `error`
+int
+handle_duplicate(const struct output *o, const struct target *t,
+                 const int mode, int *error)
+{
+        if (CLIP_DEDUPE_SKIP == mode)
+        {
+                reporter_printf(o->info,
+                                "Дубликат пропущен: %s (совпадает с %s)\n",
+                                t->name, t->dup_of->name);
+                return RECORD_SKIPPED;
+        }
+        if (-1 == dedup_link(error, t))
+        {
+                // оригинал не перемещён — не системная ошибка, errno случаен
+                report_failure(o, t, dedup_error_text(*error), *error,
+                               DEDUP_ERR_NOT_MOVED == *error ? 0 : errno);
+                return RECORD_FAILED;
+        }
+        reporter_printf(o->info, "Дубликат: %s → %s/%s (ссылка на %s)\n",
+                        t->name, t->cmd->dir, t->name, t->dup_of->name);
+        return RECORD_DEDUPED;
+}
+
+/// Холостой прогон: полное сканирование и сопоставление правил
+/// без `mkdir`/`rename`, с отчётом и оценкой длительности.
+int
+dry_run(const struct command **commands)
+{
+        int         error = PLAN_OK;
+        struct plan plan;
+        if (-1 == plan_init(&error, &plan))
+        {
+                fprintf(stderr, "Недостаточно памяти\n");
+                return EXIT_FAILURE;
+        }
+        // как и настоящий прогон, каталог читается один раз
+        struct dir_scan scan;
+        const uint64_t  begin = monotonic_ns();
+        if (-1 == scan_dir(&scan))
+        {
+                fprintf(stderr, "Не удалось прочитать текущий каталог\n");
+                plan_free(&plan);
+                return EXIT_FAILURE;
+        }
+        plan_scan(&plan, monotonic_ns() - begin, scan.count);
+        const struct shard shard = shard_option();
+        scan_shard(&scan, &shard);
+        for (const struct command **cmd = commands; cmd && *cmd; ++cmd)
+        {
+                const uint64_t  start   = monotonic_ns();
+                struct target **targets = match_targets(&scan, *cmd);
+                size_t          found   = 0;
+                for (struct target **t = targets; t && *t; ++t)
+                {
+                        ++found;
+                }
+                plan_match(&plan, monotonic_ns() - start, found);
+                for (struct target **t = targets; t && *t; ++t)
+                {
+                        if (-1 == plan_add(&error, &plan, *t))
+                        {
+                                fprintf(stderr, "Недостаточно памяти\n");
+                                free_targets(targets);
+                                scan_free(&scan);
+                                plan_free(&plan);
+                                return EXIT_FAILURE;
+                        }
+                }
+                free_targets(targets);
+        }
+        scan_free(&scan);
+        plan_print(&plan, stdout);
+        plan_free(&plan);
+        return EXIT_SUCCESS;
+}
+
+void
+free_commands(const struct command **commands)
+{
         for (const struct command **c = commands; *c; ++c)
         {
                 free((void *) (*c)->ext);
                 free((void *) (*c)->dir);
                 free((void *) *c);
         }
-        free(commands);
-        return EXIT_SUCCESS;
+        free((void *) commands);
 }
 
 void
@@ -104,5 +1555,49 @@ usage(const char *prog_name)
         printf("  -d <директория>    Каталог назначения\n");
         printf("  -m <карта>         Карта расширений и директорий (пример: "
                "\"jpg=images;mp4=videos\")\n");
+        printf("  --dry-run          Только сканирование и оценка, без "
+               "изменений на диске\n");
+        printf("  --dedupe=skip|link Дубликаты по содержимому: оставить на "
+               "месте или связать\n");
+        printf("  --link=hard|sym    Раскладка ссылками, оригиналы остаются "
+               "на месте\n");
+        printf("  --copy             Копировать (reflink, где возможно), "
+               "оригиналы остаются на месте\n");
+        printf("  --archive=<файл|-> Записать tar-архив (в stdout при '-'), "
+               "оригиналы остаются на месте\n");
+        printf("  --format=ndjson|bin Поток записей о каждом файле в stdout "
+               "вместо текста\n");
+        printf("  --quiet            Не выводить строки об успешно "
+               "обработанных файлах\n");
+        printf("  --stats            Время по фазам и счётчики вызовов в "
+               "конце прогона\n");
+        printf("  --profile          Счётчики процессора (perf) и время по "
+               "фазам в конце прогона\n");
+        printf("  --trace=<файл>     Трасса Chrome/Perfetto: фазы и каждый "
+               "файл по потокам\n");
+        printf("  --metrics=<файл>   Счётчики для textfile collector "
+               "Prometheus\n");
+        printf("  --metrics-interval=N Период записи метрик, с (по "
+               "умолчанию 15)\n");
+        printf("  --progress         Строка прогресса (файлы/с, МБ/с, "
+               "осталось) вместо строк об успехе\n");
+        printf("  --watch[=inotify|fanotify] После прогона раскладывать новые "
+               "файлы по мере появления (до Ctrl+C)\n");
+        printf("  --batch-window=MS  Сколько --watch ждёт новых событий, "
+               "прежде чем разложить пачку (по умолчанию 20)\n");
+        printf("  --batch-size=N     Предел файлов в пачке --watch (по "
+               "умолчанию 4096)\n");
+        printf("  --settle=N         Пропускать файлы, которые ещё пишутся; "
+               "без аренды — менее N с после изменения\n");
+        printf("  --dir-cache=<файл> Не читать каталог, если он не менялся "
+               "после прогона без остатка\n");
+        printf("  --claim            Захватывать файлы перед раскладкой: "
+               "несколько экземпляров на один каталог\n");
+        printf("  --shard=i/N        Обрабатывать только i-ю из N долей "
+               "каталога (по хешу имени)\n");
+        printf("  daemon --socket=<путь> Принимать задания \"<каталог>\\t<карта>\" "
+               "через Unix-сокет\n");
+        printf("  --threads=N        Число потоков (по умолчанию — по числу "
+               "процессоров)\n");
         printf("  -h                 Показать это сообщение и выйти\n");
 }
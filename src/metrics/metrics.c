@@ -0,0 +1,281 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "metrics.h"
+
+#include "common.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static const char *const error_names[EXECUTOR_ERRORS] = {
+    [EXECUTOR_OK]              = "ok",
+    [EXECUTOR_ERR_BAD_ARG]     = "bad_arg",
+    [EXECUTOR_ERR_MKDIR]       = "mkdir",
+    [EXECUTOR_ERR_FILE_EXISTS] = "file_exists",
+    [EXECUTOR_ERR_MV]          = "move",
+    [EXECUTOR_ERR_CREATE_PATH] = "create_path",
+    [EXECUTOR_ERR_LINK]        = "link",
+    [EXECUTOR_ERR_COPY]        = "copy",
+};
+
+/// Номер корзины для задержки: первая граница 2^k мкс, не меньшая её.
+/// Микросекунды округляются вверх, иначе 1,5 мкс попали бы в `le=1e-06`.
+static size_t
+bucket_of(const uint64_t latency_ns)
+{
+        const uint64_t us = (latency_ns + 999) / 1000;
+        if (1 >= us)
+        {
+                return 0;
+        }
+        const size_t k = (size_t) (64 - __builtin_clzll(us - 1));
+        return k < METRICS_BUCKETS ? k : METRICS_BUCKETS;
+}
+
+/// Учитывает обработанный файл. Вызывается из горячего пути, в том
+/// числе из нескольких потоков; `NULL` — метрики выключены.
+void
+metrics_file(struct metrics *m, const int outcome, const uint64_t bytes,
+             const uint64_t latency_ns)
+{
+        if (NULL == m || 0 > outcome || RECORD_OUTCOMES <= outcome)
+        {
+                return;
+        }
+        atomic_fetch_add_explicit(&m->files[outcome], 1, memory_order_relaxed);
+        if (RECORD_FAILED != outcome && RECORD_SKIPPED != outcome &&
+            RECORD_BUSY != outcome)
+        {
+                atomic_fetch_add_explicit(&m->bytes, bytes,
+                                          memory_order_relaxed);
+        }
+        atomic_fetch_add_explicit(&m->latency[bucket_of(latency_ns)], 1,
+                                  memory_order_relaxed);
+        atomic_fetch_add_explicit(&m->latency_sum_ns, latency_ns,
+                                  memory_order_relaxed);
+}
+
+/// Учитывает отказ исполнителя с кодом из `enum execute_error`.
+void
+metrics_error(struct metrics *m, const int code)
+{
+        if (NULL == m || EXECUTOR_OK >= code || EXECUTOR_ERRORS <= code)
+        {
+                return;
+        }
+        atomic_fetch_add_explicit(&m->errors[code], 1, memory_order_relaxed);
+}
+
+static uint64_t
+load(_Atomic uint64_t *v)
+{
+        return atomic_load_explicit(v, memory_order_relaxed);
+}
+
+/// Текст в формате экспозиции Prometheus. Счётчики снимаются по одному,
+/// поэтому между ними возможен сдвиг в несколько файлов — для
+/// монотонных счётчиков это допустимо.
+static void
+print_metrics(struct metrics *m, FILE *out)
+{
+        fputs("# HELP tn_files_total Files processed, by outcome.\n"
+              "# TYPE tn_files_total counter\n",
+              out);
+        for (int i = 0; i < RECORD_OUTCOMES; ++i)
+        {
+                fprintf(out, "tn_files_total{outcome=\"%s\"} %llu\n",
+                        record_outcome_name(i),
+                        (unsigned long long) load(&m->files[i]));
+        }
+        fprintf(out,
+                "# HELP tn_bytes_total Bytes of files placed or archived.\n"
+                "# TYPE tn_bytes_total counter\n"
+                "tn_bytes_total %llu\n",
+                (unsigned long long) load(&m->bytes));
+        fputs("# HELP tn_execute_errors_total Executor failures, by error.\n"
+              "# TYPE tn_execute_errors_total counter\n",
+              out);
+        for (int i = EXECUTOR_OK + 1; i < EXECUTOR_ERRORS; ++i)
+        {
+                fprintf(out, "tn_execute_errors_total{error=\"%s\"} %llu\n",
+                        error_names[i],
+                        (unsigned long long) load(&m->errors[i]));
+        }
+        fputs("# HELP tn_file_latency_seconds Time to process one file.\n"
+              "# TYPE tn_file_latency_seconds histogram\n",
+              out);
+        uint64_t count = 0;
+        for (size_t k = 0; k < METRICS_BUCKETS; ++k)
+        {
+                count += load(&m->latency[k]);
+                fprintf(out,
+                        "tn_file_latency_seconds_bucket{le=\"%.7g\"} %llu\n",
+                        (double) (1ULL << k) * 1e-6,
+                        (unsigned long long) count);
+        }
+        count += load(&m->latency[METRICS_BUCKETS]);
+        fprintf(out,
+                "tn_file_latency_seconds_bucket{le=\"+Inf\"} %llu\n"
+                "tn_file_latency_seconds_sum %.9f\n"
+                "tn_file_latency_seconds_count %llu\n",
+                (unsigned long long) count,
+                (double) load(&m->latency_sum_ns) / 1e9,
+                (unsigned long long) count);
+}
+
+/// Атомарно заменяет файл метрик: пишет `<path>.tmp` и переименовывает
+/// его поверх `path`, так что collector никогда не видит файл наполовину.
+///
+/// @return 0 при успехе, -1 при ошибке (`METRICS_ERR_WRITE`, `errno`
+///         сохранён; временный файл удаляется).
+int
+metrics_write(int *error, struct metrics *m)
+{
+        if (NULL == m)
+        {
+                *error = METRICS_ERR_BAD_ARG;
+                return -1;
+        }
+        *error       = METRICS_OK;
+        const int fd = open(m->tmp_path, O_WRONLY | O_CREAT | O_TRUNC |
+                                             O_CLOEXEC, 0644);
+        FILE *out = -1 == fd ? NULL : fdopen(fd, "w");
+        if (NULL == out)
+        {
+                const int saved = errno;
+                if (-1 != fd)
+                {
+                        close(fd);
+                        unlink(m->tmp_path);
+                }
+                errno  = saved;
+                *error = METRICS_ERR_WRITE;
+                return -1;
+        }
+        print_metrics(m, out);
+        const int failed = ferror(out);
+        if (0 != fclose(out) || failed || -1 == rename(m->tmp_path, m->path))
+        {
+                const int saved = errno;
+                unlink(m->tmp_path);
+                errno  = saved;
+                *error = METRICS_ERR_WRITE;
+                return -1;
+        }
+        return 0;
+}
+
+/// Поток периодической записи. Ошибки записи не прерывают прогон:
+/// следующая попытка будет через интервал, итог — в `metrics_close`.
+static void *
+metrics_worker(void *arg)
+{
+        struct metrics *m = arg;
+        pthread_mutex_lock(&m->lock);
+        while (!m->stop)
+        {
+                struct timespec deadline;
+                clock_gettime(CLOCK_MONOTONIC, &deadline);
+                deadline.tv_sec += (time_t) m->interval;
+                int rc = 0;
+                while (!m->stop && ETIMEDOUT != rc)
+                {
+                        rc = pthread_cond_timedwait(&m->wake, &m->lock,
+                                                    &deadline);
+                }
+                if (m->stop)
+                {
+                        break;
+                }
+                pthread_mutex_unlock(&m->lock);
+                int err = METRICS_OK;
+                metrics_write(&err, m);
+                pthread_mutex_lock(&m->lock);
+        }
+        pthread_mutex_unlock(&m->lock);
+        return NULL;
+}
+
+/// Готовит метрики к записи в `path` и, если `interval` не 0, запускает
+/// поток, который переписывает файл раз в `interval` секунд.
+///
+/// @return 0 при успехе, -1 при ошибке (код в `*error`).
+int
+metrics_open(int *error, struct metrics *m, const char *path,
+             const unsigned interval)
+{
+        if (NULL == m || NULL == path || '\0' == *path)
+        {
+                *error = METRICS_ERR_BAD_ARG;
+                return -1;
+        }
+        *error = METRICS_OK;
+        memset(m, 0, sizeof(*m));
+        m->interval = interval;
+        m->path     = strcopy(path);
+        m->tmp_path = concat(path, ".tmp", NULL);
+        if (NULL == m->path || NULL == m->tmp_path)
+        {
+                free(m->path);
+                free(m->tmp_path);
+                *error = METRICS_ERR_MEMORY;
+                return -1;
+        }
+        if (0 == interval)
+        {
+                return 0;
+        }
+        pthread_condattr_t attr;
+        pthread_condattr_init(&attr);
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        pthread_mutex_init(&m->lock, NULL);
+        pthread_cond_init(&m->wake, &attr);
+        pthread_condattr_destroy(&attr);
+        if (0 != pthread_create(&m->thread, NULL, metrics_worker, m))
+        {
+                pthread_cond_destroy(&m->wake);
+                pthread_mutex_destroy(&m->lock);
+                free(m->path);
+                free(m->tmp_path);
+                *error = METRICS_ERR_THREAD;
+                return -1;
+        }
+        m->running = 1;
+        return 0;
+}
+
+/// Останавливает периодическую запись, пишет итоговый файл и
+/// освобождает ресурсы. `NULL` — ничего не делает.
+///
+/// @return 0 при успехе, -1 если итоговая запись не удалась.
+int
+metrics_close(int *error, struct metrics *m)
+{
+        *error = METRICS_OK;
+        if (NULL == m)
+        {
+                return 0;
+        }
+        if (m->running)
+        {
+                pthread_mutex_lock(&m->lock);
+                m->stop = 1;
+                pthread_cond_signal(&m->wake);
+                pthread_mutex_unlock(&m->lock);
+                pthread_join(m->thread, NULL);
+                pthread_cond_destroy(&m->wake);
+                pthread_mutex_destroy(&m->lock);
+                m->running = 0;
+        }
+        const int status = metrics_write(error, m);
+        free(m->path);
+        free(m->tmp_path);
+        m->path     = NULL;
+        m->tmp_path = NULL;
+        return status;
+}
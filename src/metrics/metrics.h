@@ -0,0 +1,61 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "executer.h"
+#include "record.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+enum metrics_error
+{
+        METRICS_OK,
+        METRICS_ERR_BAD_ARG,
+        METRICS_ERR_MEMORY,
+        METRICS_ERR_THREAD, /// Не удалось запустить периодическую запись
+        METRICS_ERR_WRITE,  /// Не удалось записать или переименовать файл
+};
+
+/// Интервал периодической записи по умолчанию, секунды.
+#define METRICS_INTERVAL_DEFAULT 15
+/// Корзины гистограммы задержки: верхние границы 2^k мкс, k = 0..N-1
+/// (от 1 мкс до ~8 с); всё, что дольше, попадает только в `+Inf`.
+#define METRICS_BUCKETS 24
+
+/// Счётчики для textfile collector Prometheus.
+///
+/// Горячий путь только увеличивает атомарные счётчики (relaxed, без
+/// блокировок); поток записи раз в `interval` секунд снимает их и
+/// атомарно заменяет файл: пишет во временный рядом и делает `rename`.
+struct metrics
+{
+        _Atomic uint64_t files[RECORD_OUTCOMES];
+        _Atomic uint64_t bytes;
+        _Atomic uint64_t errors[EXECUTOR_ERRORS];
+        _Atomic uint64_t latency[METRICS_BUCKETS + 1]; /// Последняя — `+Inf`
+        _Atomic uint64_t latency_sum_ns;
+        char            *path;
+        char            *tmp_path;
+        unsigned         interval; /// 0 — только запись при закрытии
+        int              running;  /// Поток записи запущен
+        int              stop;
+        pthread_t        thread;
+        pthread_mutex_t  lock;
+        pthread_cond_t   wake;
+};
+
+int
+metrics_open(int *error, struct metrics *m, const char *path,
+             unsigned interval);
+void
+metrics_file(struct metrics *m, int outcome, uint64_t bytes,
+             uint64_t latency_ns);
+void
+metrics_error(struct metrics *m, int code);
+int
+metrics_write(int *error, struct metrics *m);
+int
+metrics_close(int *error, struct metrics *m);
+
+#endif //METRICS_H
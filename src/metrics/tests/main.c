@@ -0,0 +1,23 @@
+#include "test_metrics.h"
+
+#include "unity.h"
+
+void
+setUp(void)
+{ /* инициализация, если нужна */
+}
+void
+tearDown(void)
+{ /* очистка, если нужна */
+}
+
+int
+main(void)
+{
+        UNITY_BEGIN();
+        RUN_TEST(test_metrics_null_args);
+        RUN_TEST(test_metrics_write_counters);
+        RUN_TEST(test_metrics_latency_buckets);
+        RUN_TEST(test_metrics_periodic_write);
+        return UNITY_END();
+}
@@ -0,0 +1,132 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "test_metrics.h"
+
+#include "metrics.h"
+#include "unity.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static char dir[] = "/tmp/tn_metrics_XXXXXX";
+static char path[64];
+
+static const char *
+read_metrics(void)
+{
+        static char buf[8192];
+        FILE       *f = fopen(path, "r");
+        if (NULL == f)
+        {
+                return NULL;
+        }
+        const size_t n = fread(buf, 1, sizeof(buf) - 1, f);
+        fclose(f);
+        buf[n] = '\0';
+        return buf;
+}
+
+static void
+make_dir(void)
+{
+        strcpy(dir, "/tmp/tn_metrics_XXXXXX");
+        TEST_ASSERT_NOT_NULL(mkdtemp(dir));
+        snprintf(path, sizeof(path), "%s/tn.prom", dir);
+}
+
+static void
+remove_dir(void)
+{
+        unlink(path);
+        rmdir(dir);
+}
+
+void
+test_metrics_null_args(void)
+{
+        int err = METRICS_OK;
+        TEST_ASSERT_EQUAL_INT(-1, metrics_open(&err, NULL, "x", 0));
+        TEST_ASSERT_EQUAL_INT(METRICS_ERR_BAD_ARG, err);
+        struct metrics m;
+        TEST_ASSERT_EQUAL_INT(-1, metrics_open(&err, &m, "", 0));
+        TEST_ASSERT_EQUAL_INT(METRICS_ERR_BAD_ARG, err);
+        metrics_file(NULL, RECORD_MOVED, 1, 1);
+        metrics_error(NULL, EXECUTOR_ERR_MV);
+        TEST_ASSERT_EQUAL_INT(0, metrics_close(&err, NULL));
+}
+
+void
+test_metrics_write_counters(void)
+{
+        make_dir();
+        int            err = METRICS_OK;
+        struct metrics m;
+        TEST_ASSERT_EQUAL_INT(0, metrics_open(&err, &m, path, 0));
+        metrics_file(&m, RECORD_MOVED, 100, 1000);
+        metrics_file(&m, RECORD_MOVED, 50, 1000);
+        metrics_file(&m, RECORD_FAILED, 7, 1000);
+        metrics_error(&m, EXECUTOR_ERR_FILE_EXISTS);
+        TEST_ASSERT_EQUAL_INT(0, metrics_close(&err, &m));
+        const char *text = read_metrics();
+        TEST_ASSERT_NOT_NULL(text);
+        TEST_ASSERT_NOT_NULL(strstr(text, "tn_files_total{outcome=\"moved\"} 2\n"));
+        TEST_ASSERT_NOT_NULL(strstr(text, "tn_files_total{outcome=\"failed\"} 1\n"));
+        TEST_ASSERT_NOT_NULL(strstr(text, "tn_bytes_total 150\n"));
+        TEST_ASSERT_NOT_NULL(strstr(
+            text, "tn_execute_errors_total{error=\"file_exists\"} 1\n"));
+        TEST_ASSERT_NOT_NULL(strstr(text, "tn_file_latency_seconds_count 3\n"));
+        // временный файл переименован, а не оставлен рядом
+        char tmp[80];
+        snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+        TEST_ASSERT_NOT_EQUAL(0, access(tmp, F_OK));
+        remove_dir();
+}
+
+void
+test_metrics_latency_buckets(void)
+{
+        make_dir();
+        int            err = METRICS_OK;
+        struct metrics m;
+        TEST_ASSERT_EQUAL_INT(0, metrics_open(&err, &m, path, 0));
+        metrics_file(&m, RECORD_COPIED, 0, 500);            // < 1 мкс
+        metrics_file(&m, RECORD_COPIED, 0, 1500);           // 1,5 мкс → 2e-06
+        metrics_file(&m, RECORD_COPIED, 0, 3000);           // 3 мкс → 4e-06
+        metrics_file(&m, RECORD_COPIED, 0, 60000000000ULL); // 60 с → +Inf
+        TEST_ASSERT_EQUAL_INT(0, metrics_close(&err, &m));
+        const char *text = read_metrics();
+        TEST_ASSERT_NOT_NULL(text);
+        TEST_ASSERT_NOT_NULL(strstr(
+            text, "tn_file_latency_seconds_bucket{le=\"1e-06\"} 1\n"));
+        TEST_ASSERT_NOT_NULL(strstr(
+            text, "tn_file_latency_seconds_bucket{le=\"2e-06\"} 2\n"));
+        TEST_ASSERT_NOT_NULL(strstr(
+            text, "tn_file_latency_seconds_bucket{le=\"4e-06\"} 3\n"));
+        TEST_ASSERT_NOT_NULL(strstr(
+            text, "tn_file_latency_seconds_bucket{le=\"+Inf\"} 4\n"));
+        remove_dir();
+}
+
+void
+test_metrics_periodic_write(void)
+{
+        make_dir();
+        int            err = METRICS_OK;
+        struct metrics m;
+        TEST_ASSERT_EQUAL_INT(0, metrics_open(&err, &m, path, 1));
+        metrics_file(&m, RECORD_LINKED, 1, 1);
+        // поток записи должен обновить файл без вызова metrics_write
+        const struct timespec step = {0, 50000000};
+        for (int i = 0; i < 60 && 0 != access(path, F_OK); ++i)
+        {
+                nanosleep(&step, NULL);
+        }
+        const char *text = read_metrics();
+        TEST_ASSERT_NOT_NULL(text);
+        TEST_ASSERT_NOT_NULL(strstr(text, "tn_files_total{outcome=\"linked\"} 1\n"));
+        TEST_ASSERT_EQUAL_INT(0, metrics_close(&err, &m));
+        remove_dir();
+}
@@ -0,0 +1,13 @@
+#ifndef TEST_METRICS_H
+#define TEST_METRICS_H
+
+void
+test_metrics_null_args(void);
+void
+test_metrics_write_counters(void);
+void
+test_metrics_latency_buckets(void);
+void
+test_metrics_periodic_write(void);
+
+#endif //TEST_METRICS_H
@@ -0,0 +1,220 @@
+#define _GNU_SOURCE
+
+#include "profile.h"
+
+#include "common.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+
+struct profile_event_desc
+{
+        uint32_t    type;
+        uint64_t    config;
+        const char *name;
+};
+
+static const struct profile_event_desc events[PROFILE_EVENTS] = {
+    [PROFILE_CYCLES]           = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES,
+                                  "cycles"},
+    [PROFILE_INSTRUCTIONS]     = {PERF_TYPE_HARDWARE,
+                                  PERF_COUNT_HW_INSTRUCTIONS, "instructions"},
+    [PROFILE_CACHE_MISSES]     = {PERF_TYPE_HARDWARE,
+                                  PERF_COUNT_HW_CACHE_MISSES, "cache-misses"},
+    [PROFILE_CONTEXT_SWITCHES] = {PERF_TYPE_SOFTWARE,
+                                  PERF_COUNT_SW_CONTEXT_SWITCHES, "ctx-switches"},
+    [PROFILE_PAGE_FAULTS]      = {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS,
+                                  "page-faults"},
+};
+
+static const char *const phase_names[PROFILE_PHASES] = {
+    [PROFILE_SCAN]    = "scan",
+    [PROFILE_MATCH]   = "match",
+    [PROFILE_EXECUTE] = "execute",
+};
+
+/// Открывает счётчик для текущего процесса и его будущих потоков.
+///
+/// Сначала просит события и ядра, и пространства пользователя; если
+/// `perf_event_paranoid` этого не разрешает (`EACCES`), повторяет только
+/// для пользовательского кода.
+static int
+open_event(const struct profile_event_desc *desc)
+{
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size        = sizeof(attr);
+        attr.type        = desc->type;
+        attr.config      = desc->config;
+        attr.inherit     = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                           PERF_FORMAT_TOTAL_TIME_RUNNING;
+        for (int user_only = 0; user_only < 2; ++user_only)
+        {
+                if (user_only)
+                {
+                        attr.exclude_kernel = 1;
+                        attr.exclude_hv     = 1;
+                }
+                const long fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1,
+                                        PERF_FLAG_FD_CLOEXEC);
+                if (0 <= fd)
+                {
+                        return (int) fd;
+                }
+                if (EACCES != errno && EPERM != errno)
+                {
+                        break;
+                }
+        }
+        return -1;
+}
+
+static void
+read_event(const int fd, struct profile_reading *r)
+{
+        uint64_t buf[3] = {0, 0, 0};
+        if ((ssize_t) sizeof(buf) != read(fd, buf, sizeof(buf)))
+        {
+                memset(r, 0, sizeof(*r));
+                return;
+        }
+        r->value   = buf[0];
+        r->enabled = buf[1];
+        r->running = buf[2];
+}
+
+/// Открывает все счётчики, какие позволяет система.
+///
+/// Аппаратные события часто недоступны в виртуальных машинах и
+/// контейнерах; программные (переключения контекста, ошибки страниц)
+/// открываются почти всегда. Недоступные счётчики пропускаются.
+///
+/// @return 0, если открыт хотя бы один счётчик, иначе -1 и
+///         `PROFILE_ERR_UNAVAILABLE` (время по фазам считается и тогда).
+int
+profile_open(int *error, struct profile *p)
+{
+        if (NULL == p)
+        {
+                *error = PROFILE_ERR_BAD_ARG;
+                return -1;
+        }
+        memset(p, 0, sizeof(*p));
+        p->phase   = -1;
+        int opened = 0;
+        for (int i = 0; i < PROFILE_EVENTS; ++i)
+        {
+                p->fds[i] = open_event(&events[i]);
+                opened += -1 != p->fds[i];
+        }
+        *error = 0 == opened ? PROFILE_ERR_UNAVAILABLE : PROFILE_OK;
+        return 0 == opened ? -1 : 0;
+}
+
+/// Начинает фазу: снимает показания всех счётчиков. Счётчики всё время
+/// включены, фаза — это разность двух снимков, так что на границу
+/// приходится по одному `read` на счётчик и никаких `ioctl`.
+void
+profile_begin(struct profile *p, const int phase)
+{
+        if (NULL == p)
+        {
+                return;
+        }
+        p->phase = phase;
+        for (int i = 0; i < PROFILE_EVENTS; ++i)
+        {
+                if (-1 != p->fds[i])
+                {
+                        read_event(p->fds[i], &p->start[i]);
+                }
+        }
+        p->start_ns = monotonic_ns();
+}
+
+/// Завершает текущую фазу и добавляет разность к её итогам.
+void
+profile_end(struct profile *p)
+{
+        if (NULL == p || 0 > p->phase)
+        {
+                return;
+        }
+        p->wall_ns[p->phase] += monotonic_ns() - p->start_ns;
+        for (int i = 0; i < PROFILE_EVENTS; ++i)
+        {
+                if (-1 == p->fds[i])
+                {
+                        continue;
+                }
+                struct profile_reading now;
+                read_event(p->fds[i], &now);
+                struct profile_reading *t = &p->totals[p->phase][i];
+                t->value += now.value - p->start[i].value;
+                t->enabled += now.enabled - p->start[i].enabled;
+                t->running += now.running - p->start[i].running;
+        }
+        p->phase = -1;
+}
+
+/// Значение счётчика за фазу с поправкой на мультиплексирование.
+uint64_t
+profile_value(const struct profile *p, const int phase, const int event)
+{
+        const struct profile_reading *t = &p->totals[phase][event];
+        if (0 == t->running)
+        {
+                return t->value;
+        }
+        return (uint64_t) ((double) t->value * (double) t->enabled /
+                           (double) t->running);
+}
+
+/// Печатает таблицу: фазы по строкам, время и события по столбцам.
+void
+profile_print(const struct profile *p, FILE *out)
+{
+        fprintf(out, "%-8s %12s", "phase", "wall, ms");
+        for (int i = 0; i < PROFILE_EVENTS; ++i)
+        {
+                fprintf(out, " %14s", events[i].name);
+        }
+        fputc('\n', out);
+        for (int ph = 0; ph < PROFILE_PHASES; ++ph)
+        {
+                fprintf(out, "%-8s %12.3f", phase_names[ph],
+                        (double) p->wall_ns[ph] / 1e6);
+                for (int i = 0; i < PROFILE_EVENTS; ++i)
+                {
+                        if (-1 == p->fds[i])
+                        {
+                                fprintf(out, " %14s", "n/a");
+                                continue;
+                        }
+                        fprintf(out, " %14llu",
+                                (unsigned long long) profile_value(p, ph, i));
+                }
+                fputc('\n', out);
+        }
+}
+
+void
+profile_close(struct profile *p)
+{
+        if (NULL == p)
+        {
+                return;
+        }
+        for (int i = 0; i < PROFILE_EVENTS; ++i)
+        {
+                if (-1 != p->fds[i])
+                {
+                        close(p->fds[i]);
+                        p->fds[i] = -1;
+                }
+        }
+}
@@ -0,0 +1,67 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+enum profile_error
+{
+        PROFILE_OK,
+        PROFILE_ERR_BAD_ARG,
+        PROFILE_ERR_UNAVAILABLE, /// Ни один счётчик не открылся
+};
+
+/// Фазы прогона, между которыми делятся показания счётчиков.
+enum profile_phase
+{
+        PROFILE_SCAN,    /// Чтение каталога
+        PROFILE_MATCH,   /// Сопоставление с правилами и `stat`
+        PROFILE_EXECUTE, /// Поиск дубликатов и раскладка файлов
+        PROFILE_PHASES,
+};
+
+enum profile_event
+{
+        PROFILE_CYCLES,
+        PROFILE_INSTRUCTIONS,
+        PROFILE_CACHE_MISSES,
+        PROFILE_CONTEXT_SWITCHES,
+        PROFILE_PAGE_FAULTS,
+        PROFILE_EVENTS,
+};
+
+/// Показания одного счётчика: значение и время, в течение которого
+/// счётчик был включён и реально считал (при мультиплексировании
+/// значение масштабируется на их отношение).
+struct profile_reading
+{
+        uint64_t value;
+        uint64_t enabled;
+        uint64_t running;
+};
+
+/// Самонаблюдение через `perf_event_open`.
+struct profile
+{
+        int                    fds[PROFILE_EVENTS]; /// -1 — счётчик недоступен
+        int                    phase;               /// Текущая фаза или -1
+        uint64_t               start_ns;
+        struct profile_reading start[PROFILE_EVENTS];
+        struct profile_reading totals[PROFILE_PHASES][PROFILE_EVENTS];
+        uint64_t               wall_ns[PROFILE_PHASES];
+};
+
+int
+profile_open(int *error, struct profile *p);
+void
+profile_begin(struct profile *p, int phase);
+void
+profile_end(struct profile *p);
+uint64_t
+profile_value(const struct profile *p, int phase, int event);
+void
+profile_print(const struct profile *p, FILE *out);
+void
+profile_close(struct profile *p);
+
+#endif //PROFILE_H
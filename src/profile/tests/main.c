@@ -0,0 +1,23 @@
+#include "test_profile.h"
+
+#include "unity.h"
+
+void
+setUp(void)
+{ /* инициализация, если нужна */
+}
+void
+tearDown(void)
+{ /* очистка, если нужна */
+}
+
+int
+main(void)
+{
+        UNITY_BEGIN();
+        RUN_TEST(test_profile_null_args);
+        RUN_TEST(test_profile_phases);
+        RUN_TEST(test_profile_value_scaled);
+        RUN_TEST(test_profile_print);
+        return UNITY_END();
+}
@@ -0,0 +1,85 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "test_profile.h"
+
+#include "profile.h"
+#include "unity.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+void
+test_profile_null_args(void)
+{
+        int err = PROFILE_OK;
+        TEST_ASSERT_EQUAL_INT(-1, profile_open(&err, NULL));
+        TEST_ASSERT_EQUAL_INT(PROFILE_ERR_BAD_ARG, err);
+        profile_begin(NULL, PROFILE_SCAN);
+        profile_end(NULL);
+        profile_close(NULL);
+}
+
+void
+test_profile_phases(void)
+{
+        int            err = PROFILE_OK;
+        struct profile p;
+        // счётчики могут быть недоступны (контейнер, perf_event_paranoid),
+        // время по фазам считается в любом случае
+        const int rc = profile_open(&err, &p);
+        TEST_ASSERT_TRUE(0 == rc || PROFILE_ERR_UNAVAILABLE == err);
+        profile_begin(&p, PROFILE_MATCH);
+        volatile unsigned sink = 0;
+        for (unsigned i = 0; i < 100000; ++i)
+        {
+                sink += i;
+        }
+        profile_end(&p);
+        profile_end(&p);
+        TEST_ASSERT_TRUE(0 < p.wall_ns[PROFILE_MATCH]);
+        TEST_ASSERT_EQUAL_UINT64(0, p.wall_ns[PROFILE_SCAN]);
+        if (-1 != p.fds[PROFILE_INSTRUCTIONS])
+        {
+                TEST_ASSERT_TRUE(
+                    0 < profile_value(&p, PROFILE_MATCH, PROFILE_INSTRUCTIONS));
+        }
+        profile_close(&p);
+}
+
+void
+test_profile_value_scaled(void)
+{
+        struct profile p;
+        memset(&p, 0, sizeof(p));
+        // счётчик работал половину времени — значение удваивается
+        p.totals[PROFILE_SCAN][PROFILE_CYCLES].value   = 1000;
+        p.totals[PROFILE_SCAN][PROFILE_CYCLES].enabled = 200;
+        p.totals[PROFILE_SCAN][PROFILE_CYCLES].running = 100;
+        TEST_ASSERT_EQUAL_UINT64(
+            2000, profile_value(&p, PROFILE_SCAN, PROFILE_CYCLES));
+        TEST_ASSERT_EQUAL_UINT64(
+            0, profile_value(&p, PROFILE_EXECUTE, PROFILE_CYCLES));
+}
+
+void
+test_profile_print(void)
+{
+        struct profile p;
+        memset(&p, 0, sizeof(p));
+        for (int i = 0; i < PROFILE_EVENTS; ++i)
+        {
+                p.fds[i] = -1;
+        }
+        p.fds[PROFILE_PAGE_FAULTS]                           = 99;
+        p.totals[PROFILE_EXECUTE][PROFILE_PAGE_FAULTS].value = 42;
+        char  *buf = NULL;
+        size_t len = 0;
+        FILE  *out = open_memstream(&buf, &len);
+        TEST_ASSERT_NOT_NULL(out);
+        profile_print(&p, out);
+        fclose(out);
+        TEST_ASSERT_NOT_NULL(strstr(buf, "page-faults"));
+        TEST_ASSERT_NOT_NULL(strstr(buf, "n/a"));
+        TEST_ASSERT_NOT_NULL(strstr(strstr(buf, "execute"), "42"));
+        free(buf);
+}
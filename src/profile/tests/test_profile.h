@@ -0,0 +1,13 @@
+#ifndef TEST_PROFILE_H
+#define TEST_PROFILE_H
+
+void
+test_profile_null_args(void);
+void
+test_profile_phases(void);
+void
+test_profile_value_scaled(void);
+void
+test_profile_print(void);
+
+#endif //TEST_PROFILE_H
@@ -0,0 +1,261 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "errsum.h"
+
+#include "common.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ERRSUM_MIN_CAPACITY 16
+
+static uint64_t
+group_hash(const char *what, const int code, const int err_no,
+           const char *dir)
+{
+        const int ints[2] = {code, err_no};
+        return hash_bytes(&what, sizeof(what)) ^
+               hash_bytes(ints, sizeof(ints)) * 31 ^
+               hash_bytes(dir, strlen(dir));
+}
+
+/// Ищет группу; при отсутствии возвращает слот индекса, куда её вставить.
+static size_t
+group_slot(const struct errsum *sum, const char *what, const int code,
+           const int err_no, const char *dir)
+{
+        const size_t mask = sum->index_capacity - 1;
+        size_t       i    = (size_t) group_hash(what, code, err_no, dir) & mask;
+        while (0 != sum->index[i])
+        {
+                const struct errsum_group *g = &sum->groups[sum->index[i] - 1];
+                if (g->what == what && g->code == code &&
+                    g->err_no == err_no && 0 == strcmp(g->dir, dir))
+                {
+                        break;
+                }
+                i = (i + 1) & mask;
+        }
+        return i;
+}
+
+/// Увеличивает индекс вдвое, сохраняя заполнение не выше 1/2.
+static int
+grow_index(struct errsum *sum)
+{
+        const size_t capacity = 0 == sum->index_capacity
+                                    ? ERRSUM_MIN_CAPACITY
+                                    : sum->index_capacity * 2;
+        size_t      *index    = calloc(capacity, sizeof(*index));
+        if (NULL == index)
+        {
+                return -1;
+        }
+        free(sum->index);
+        sum->index          = index;
+        sum->index_capacity = capacity;
+        for (size_t n = 0; n < sum->groups_count; ++n)
+        {
+                const struct errsum_group *g = &sum->groups[n];
+                sum->index[group_slot(sum, g->what, g->code, g->err_no,
+                                      g->dir)] = n + 1;
+        }
+        return 0;
+}
+
+static struct errsum_group *
+new_group(struct errsum *sum, const size_t slot, const char *what,
+          const int code, const int err_no, const char *dir)
+{
+        if (sum->groups_count == sum->groups_capacity)
+        {
+                const size_t capacity = 0 == sum->groups_capacity
+                                            ? ERRSUM_MIN_CAPACITY
+                                            : sum->groups_capacity * 2;
+                struct errsum_group *groups =
+                    realloc(sum->groups, capacity * sizeof(*groups));
+                if (NULL == groups)
+                {
+                        return NULL;
+                }
+                sum->groups          = groups;
+                sum->groups_capacity = capacity;
+        }
+        struct errsum_group *g = &sum->groups[sum->groups_count];
+        memset(g, 0, sizeof(*g));
+        if (NULL == (g->dir = strdup(dir)))
+        {
+                return NULL;
+        }
+        g->what           = what;
+        g->code           = code;
+        g->err_no         = err_no;
+        sum->index[slot]  = ++sum->groups_count;
+        return g;
+}
+
+/// Инициализирует пустую сводку.
+/// \param live Сколько первых ошибок выводить сразу
+void
+errsum_init(struct errsum *sum, const size_t live)
+{
+        memset(sum, 0, sizeof(*sum));
+        sum->live = live;
+}
+
+/// Учитывает ошибку в своей группе.
+///
+/// \param what Статическая строка: группы сравниваются по указателю
+/// \return 1, если ошибку нужно вывести сразу (среди первых `live`
+///         или если учесть её не хватило памяти), иначе 0
+int
+errsum_add(struct errsum *sum, const char *what, const int code,
+           const int err_no, const char *dir, const char *name)
+{
+        if (NULL == sum)
+        {
+                return 1;
+        }
+        const int live = sum->total++ < sum->live;
+        if (NULL == dir)
+        {
+                dir = "";
+        }
+        if (sum->groups_count * 2 >= sum->index_capacity &&
+            -1 == grow_index(sum))
+        {
+                return 1;
+        }
+        const size_t         slot = group_slot(sum, what, code, err_no, dir);
+        struct errsum_group *g =
+            0 != sum->index[slot]
+                ? &sum->groups[sum->index[slot] - 1]
+                : new_group(sum, slot, what, code, err_no, dir);
+        if (NULL == g)
+        {
+                return 1;
+        }
+        ++g->count;
+        if (ERRSUM_SAMPLES > g->samples_count && NULL != name &&
+            NULL != (g->samples[g->samples_count] = strdup(name)))
+        {
+                ++g->samples_count;
+        }
+        return live;
+}
+
+/// Учитывает ошибку и, если она среди первых `live`, сразу выводит её
+/// строкой в `r` и сбрасывает буфер отчёта: первые ошибки видны по мере
+/// появления, а не рядом со сводкой в конце прогона. Таких строк не
+/// больше `live`, так что сброс не стоит заметного числа `write`.
+/// \return 1, если строка выведена, иначе 0
+int
+errsum_note(struct errsum *sum, struct reporter *r, const char *what,
+            const int code, const int err_no, const char *dir,
+            const char *name)
+{
+        if (0 == errsum_add(sum, what, code, err_no, dir, name))
+        {
+                return 0;
+        }
+        reporter_printf(r, "%s: %s → %s/%s%s%s%s\n", what, name, dir, name,
+                        0 == err_no ? "" : " (",
+                        0 == err_no ? "" : strerror(err_no),
+                        0 == err_no ? "" : ")");
+        reporter_flush(r);
+        return 1;
+}
+
+static int
+by_count_desc(const void *a, const void *b)
+{
+        const struct errsum_group *ga = *(const struct errsum_group *const *) a;
+        const struct errsum_group *gb = *(const struct errsum_group *const *) b;
+        return (ga->count < gb->count) - (ga->count > gb->count);
+}
+
+/// Печатает группы по убыванию числа ошибок: описание, каталог,
+/// `errno`, число и несколько имён файлов.
+/// \return 0 при успехе, -1 при ошибке выделения памяти или записи
+int
+errsum_print(const struct errsum *sum, struct reporter *r)
+{
+        if (NULL == sum || 0 == sum->total)
+        {
+                return 0;
+        }
+        const struct errsum_group **order =
+            malloc(sum->groups_count * sizeof(*order));
+        if (NULL == order && 0 != sum->groups_count)
+        {
+                return -1;
+        }
+        for (size_t n = 0; n < sum->groups_count; ++n)
+        {
+                order[n] = &sum->groups[n];
+        }
+        qsort((void *) order, sum->groups_count, sizeof(*order),
+              by_count_desc);
+        int rc = reporter_printf(r, "Ошибок: %zu", sum->total);
+        if (sum->total > sum->live)
+        {
+                rc |= reporter_printf(r, " (показаны первые %zu)", sum->live);
+        }
+        rc |= reporter_puts(r, "\n");
+        for (size_t n = 0; n < sum->groups_count; ++n)
+        {
+                const struct errsum_group *g = order[n];
+                rc |= reporter_printf(r, "  %zu × %s → %s/ (код %d", g->count,
+                                      g->what, g->dir, g->code);
+                if (0 != g->err_no)
+                {
+                        rc |= reporter_printf(r, ", %s", strerror(g->err_no));
+                }
+                rc |= reporter_puts(r, "):");
+                for (size_t i = 0; i < g->samples_count; ++i)
+                {
+                        rc |= reporter_printf(r, "%s %s", 0 == i ? "" : ",",
+                                              g->samples[i]);
+                }
+                rc |= reporter_puts(r, g->count > g->samples_count ? " …\n"
+                                                                   : "\n");
+        }
+        free((void *) order);
+        return 0 == rc ? 0 : -1;
+}
+
+/// Начинает сводку заново с тем же пределом `live`: `--watch` печатает
+/// сводку периодически, и после неё первые ошибки снова выводятся
+/// сразу.
+void
+errsum_reset(struct errsum *sum)
+{
+        if (NULL == sum)
+        {
+                return;
+        }
+        const size_t live = sum->live;
+        errsum_free(sum);
+        sum->live = live;
+}
+
+void
+errsum_free(struct errsum *sum)
+{
+        if (NULL == sum)
+        {
+                return;
+        }
+        for (size_t n = 0; n < sum->groups_count; ++n)
+        {
+                free(sum->groups[n].dir);
+                for (size_t i = 0; i < sum->groups[n].samples_count; ++i)
+                {
+                        free(sum->groups[n].samples[i]);
+                }
+        }
+        free(sum->groups);
+        free(sum->index);
+        memset(sum, 0, sizeof(*sum));
+}
@@ -0,0 +1,53 @@
+#ifndef ERRSUM_H
+#define ERRSUM_H
+
+#include "report.h"
+
+#include <stddef.h>
+
+/// Сколько ошибок выводится сразу, по мере появления.
+#define ERRSUM_LIVE_DEFAULT 10
+/// Сколько имён файлов сохраняется как пример для каждой группы.
+#define ERRSUM_SAMPLES 3
+
+/// Группа одинаковых ошибок: одна операция, один код, один каталог
+/// назначения, одно значение `errno`.
+struct errsum_group
+{
+        const char *what; /// Статическая строка с описанием операции
+        int         code; /// Код ошибки модуля, выполнявшего операцию
+        int         err_no;
+        char       *dir;
+        size_t      count;
+        char       *samples[ERRSUM_SAMPLES];
+        size_t      samples_count;
+};
+
+/// Сводка ошибок прогона.
+struct errsum
+{
+        struct errsum_group *groups;
+        size_t               groups_count;
+        size_t               groups_capacity;
+        size_t              *index; /// Открытая адресация: номер группы + 1
+        size_t               index_capacity;
+        size_t               total;
+        size_t               live; /// Предел ошибок, выводимых сразу
+};
+
+void
+errsum_init(struct errsum *sum, size_t live);
+int
+errsum_add(struct errsum *sum, const char *what, int code, int err_no,
+           const char *dir, const char *name);
+int
+errsum_note(struct errsum *sum, struct reporter *r, const char *what,
+            int code, int err_no, const char *dir, const char *name);
+int
+errsum_print(const struct errsum *sum, struct reporter *r);
+void
+errsum_reset(struct errsum *sum);
+void
+errsum_free(struct errsum *sum);
+
+#endif //ERRSUM_H
@@ -0,0 +1,169 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "progress.h"
+
+#include "common.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/// Учитывает обработанный файл. Два `relaxed`-инкремента, без блокировок.
+void
+progress_add(struct progress *p, const uint64_t bytes)
+{
+        if (NULL == p)
+        {
+                return;
+        }
+        atomic_fetch_add_explicit(&p->files, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&p->bytes, bytes, memory_order_relaxed);
+}
+
+/// Формирует строку прогресса на момент `now_ns`: файлы, файлы/с, МБ/с
+/// и оставшееся время по средней скорости с начала прогона.
+///
+/// @return Длина строки (без завершающего нуля, не больше `len - 1`).
+size_t
+progress_format(const struct progress *p, char *buf, const size_t len,
+                const uint64_t now_ns)
+{
+        const uint64_t files =
+            atomic_load_explicit(&p->files, memory_order_relaxed);
+        const uint64_t bytes =
+            atomic_load_explicit(&p->bytes, memory_order_relaxed);
+        const double   secs =
+            now_ns > p->start_ns ? (double) (now_ns - p->start_ns) / 1e9 : 0;
+        const double   rate  = secs > 0 ? (double) files / secs : 0;
+        const double   mbps  = secs > 0 ? (double) bytes / 1e6 / secs : 0;
+        char           eta[32] = "--:--";
+        if (rate > 0 && p->total > files)
+        {
+                const unsigned long long left =
+                    (unsigned long long) ((double) (p->total - files) / rate);
+                snprintf(eta, sizeof(eta), "%llu:%02llu", left / 60, left % 60);
+        }
+        const int n = snprintf(buf, len,
+                               "%llu/%llu файлов  %.0f файл/с  %.1f МБ/с  "
+                               "осталось %s",
+                               (unsigned long long) files,
+                               (unsigned long long) p->total, rate, mbps, eta);
+        if (0 > n)
+        {
+                return 0;
+        }
+        return (size_t) n < len ? (size_t) n : len - 1;
+}
+
+/// Перерисовывает строку: возврат каретки, очистка до конца строки и
+/// новый текст одним `write`, чтобы не рвать строку другим выводом.
+static void
+draw(const struct progress *p, const char *end)
+{
+        char         line[256];
+        const size_t head = 4; // "\r\033[K"
+        memcpy(line, "\r\033[K", head);
+        size_t n = head + progress_format(p, line + head, sizeof(line) - head,
+                                          monotonic_ns());
+        const size_t tail = strlen(end);
+        if (n + tail < sizeof(line))
+        {
+                memcpy(line + n, end, tail);
+                n += tail;
+        }
+        // строка прогресса необязательна: ошибку записи не сообщаем
+        const ssize_t w = write(p->fd, line, n);
+        (void) w;
+}
+
+static void *
+progress_worker(void *arg)
+{
+        struct progress *p = arg;
+        pthread_mutex_lock(&p->lock);
+        while (!p->stop)
+        {
+                struct timespec deadline;
+                clock_gettime(CLOCK_MONOTONIC, &deadline);
+                deadline.tv_nsec += PROGRESS_INTERVAL_MS * 1000000L;
+                if (deadline.tv_nsec >= 1000000000L)
+                {
+                        deadline.tv_sec += 1;
+                        deadline.tv_nsec -= 1000000000L;
+                }
+                int rc = 0;
+                while (!p->stop && ETIMEDOUT != rc)
+                {
+                        rc = pthread_cond_timedwait(&p->wake, &p->lock,
+                                                    &deadline);
+                }
+                if (!p->stop)
+                {
+                        draw(p, "");
+                }
+        }
+        pthread_mutex_unlock(&p->lock);
+        return NULL;
+}
+
+/// Запускает перерисовку прогресса в `draw_fd`, если и `out_fd`
+/// (основной вывод), и `draw_fd` — терминалы. При выводе в файл или
+/// канал строки с `\r` только засоряли бы его.
+///
+/// @return 0 при успехе, -1 если прогресс не запущен (код в `*error`).
+int
+progress_start(int *error, struct progress *p, const int out_fd,
+               const int draw_fd, const uint64_t total)
+{
+        if (NULL == p)
+        {
+                *error = PROGRESS_ERR_BAD_ARG;
+                return -1;
+        }
+        if (!isatty(out_fd) || !isatty(draw_fd))
+        {
+                *error = PROGRESS_ERR_NOT_TTY;
+                return -1;
+        }
+        *error = PROGRESS_OK;
+        atomic_init(&p->files, 0);
+        atomic_init(&p->bytes, 0);
+        p->total    = total;
+        p->start_ns = monotonic_ns();
+        p->fd       = draw_fd;
+        p->stop     = 0;
+        pthread_condattr_t attr;
+        pthread_condattr_init(&attr);
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        pthread_mutex_init(&p->lock, NULL);
+        pthread_cond_init(&p->wake, &attr);
+        pthread_condattr_destroy(&attr);
+        if (0 != pthread_create(&p->thread, NULL, progress_worker, p))
+        {
+                pthread_cond_destroy(&p->wake);
+                pthread_mutex_destroy(&p->lock);
+                *error = PROGRESS_ERR_THREAD;
+                return -1;
+        }
+        return 0;
+}
+
+/// Останавливает перерисовку и оставляет на экране итоговую строку.
+void
+progress_stop(struct progress *p)
+{
+        if (NULL == p)
+        {
+                return;
+        }
+        pthread_mutex_lock(&p->lock);
+        p->stop = 1;
+        pthread_cond_signal(&p->wake);
+        pthread_mutex_unlock(&p->lock);
+        pthread_join(p->thread, NULL);
+        pthread_cond_destroy(&p->wake);
+        pthread_mutex_destroy(&p->lock);
+        draw(p, "\n");
+}
@@ -0,0 +1,50 @@
+#ifndef PROGRESS_H
+#define PROGRESS_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// Период перерисовки строки прогресса, мс (не чаще 4 раз в секунду).
+#define PROGRESS_INTERVAL_MS 250
+
+enum progress_error
+{
+        PROGRESS_OK,
+        PROGRESS_ERR_BAD_ARG,
+        PROGRESS_ERR_NOT_TTY, /// Вывод не терминал — прогресс выключен
+        PROGRESS_ERR_THREAD,
+};
+
+/// Строка прогресса для долгих прогонов.
+///
+/// Горячий путь только увеличивает два атомарных счётчика
+/// (`progress_add`); строку раз в `PROGRESS_INTERVAL_MS` перерисовывает
+/// отдельный поток одним `write`. Указатель `NULL` допустим везде и
+/// означает «прогресс выключен».
+struct progress
+{
+        _Atomic uint64_t files;
+        _Atomic uint64_t bytes;
+        uint64_t         total;    /// Ожидаемое число файлов (по снимку)
+        uint64_t         start_ns;
+        int              fd;       /// Куда рисовать (терминал)
+        int              stop;
+        pthread_t        thread;
+        pthread_mutex_t  lock;
+        pthread_cond_t   wake;
+};
+
+int
+progress_start(int *error, struct progress *p, int out_fd, int draw_fd,
+               uint64_t total);
+void
+progress_add(struct progress *p, uint64_t bytes);
+size_t
+progress_format(const struct progress *p, char *buf, size_t len,
+                uint64_t now_ns);
+void
+progress_stop(struct progress *p);
+
+#endif //PROGRESS_H
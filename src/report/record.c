@@ -0,0 +1,272 @@
+#include "record.h"
+
+#include "common.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// Размер записи, до которого кодирование идёт в буфер на стеке.
+#define RECORD_STACK_BUF 4096
+/// Двоичная запись без строк: длина, outcome, резерв, error, bytes,
+/// latency_ns, длины src и dst.
+#define RECORD_BIN_FIXED (4 + 1 + 1 + 2 + 8 + 8 + 2 + 2)
+/// NDJSON без строк: ключи, кавычки, имена итога и домена, три числа
+/// по 20 цифр и ключи полей `*_hex`.
+#define RECORD_JSON_FIXED 224
+
+static const char *const outcome_names[] = {
+    [RECORD_MOVED] = "moved",       [RECORD_LINKED] = "linked",
+    [RECORD_COPIED] = "copied",     [RECORD_ARCHIVED] = "archived",
+    [RECORD_DEDUPED] = "deduped",   [RECORD_SKIPPED] = "skipped",
+    [RECORD_FAILED] = "failed",     [RECORD_BUSY] = "busy",
+};
+
+const char *
+record_outcome_name(const int outcome)
+{
+        if (0 > outcome ||
+            (size_t) outcome >= sizeof(outcome_names) / sizeof(*outcome_names))
+        {
+                return "unknown";
+        }
+        return outcome_names[outcome];
+}
+
+static const char *const domain_names[] = {
+    [RECORD_DOMAIN_NONE] = "none",
+    [RECORD_DOMAIN_EXECUTE] = "execute",
+    [RECORD_DOMAIN_ARCHIVE] = "archive",
+    [RECORD_DOMAIN_DEDUP] = "dedup",
+};
+
+const char *
+record_domain_name(const int domain)
+{
+        if (0 > domain ||
+            (size_t) domain >= sizeof(domain_names) / sizeof(*domain_names))
+        {
+                return "unknown";
+        }
+        return domain_names[domain];
+}
+
+static char *
+put_raw(char *p, const char *s, const size_t len)
+{
+        memcpy(p, s, len);
+        return p + len;
+}
+
+/// Десятичная запись без `printf`: цифры собираются с конца.
+static char *
+put_u64(char *p, unsigned long long v)
+{
+        char  digits[20];
+        char *d = digits + sizeof(digits);
+        do
+        {
+                *--d = (char) ('0' + v % 10);
+                v /= 10;
+        } while (0 != v);
+        return put_raw(p, d, (size_t) (digits + sizeof(digits) - d));
+}
+
+static const char hex[] = "0123456789abcdef";
+
+/// \return 1, если вся строка — корректный UTF-8
+static int
+utf8_valid(const char *s)
+{
+        const unsigned char *u = (const unsigned char *) s;
+        for (size_t len = 0; *u; u += len)
+        {
+                if (0 == (len = utf8_len(u)))
+                {
+                        return 0;
+                }
+        }
+        return 1;
+}
+
+/// Содержимое строки JSON без кавычек. Имена файлов в Linux —
+/// произвольные байты: корректный UTF-8 передаётся как есть, а каждый
+/// байт вне его — как `\u00XX`. Такая замена неоднозначна, поэтому
+/// для этих строк `encode_ndjson` добавляет исходные байты в hex.
+static char *
+put_json_chars(char *p, const char *s)
+{
+        const unsigned char *u = (const unsigned char *) s;
+        while (*u)
+        {
+                const unsigned char c   = *u;
+                const size_t        len = utf8_len(u);
+                if ('"' == c || '\\' == c)
+                {
+                        *p++ = '\\';
+                        *p++ = (char) c;
+                }
+                else if (0x20 > c || 0 == len)
+                {
+                        p    = put_raw(p, "\\u00", 4);
+                        *p++ = hex[c >> 4];
+                        *p++ = hex[c & 0xf];
+                }
+                else
+                {
+                        p = put_raw(p, (const char *) u, len);
+                        u += len;
+                        continue;
+                }
+                ++u;
+        }
+        return p;
+}
+
+/// Байты строки шестнадцатеричными цифрами.
+static char *
+put_hex(char *p, const char *s)
+{
+        for (const unsigned char *u = (const unsigned char *) s; *u; ++u)
+        {
+                *p++ = hex[*u >> 4];
+                *p++ = hex[*u & 0xf];
+        }
+        return p;
+}
+
+/// Целое в порядке байтов little-endian независимо от платформы.
+static char *
+put_le(char *p, unsigned long long v, const size_t width)
+{
+        for (size_t i = 0; i < width; ++i)
+        {
+                *p++ = (char) (v & 0xff);
+                v >>= 8;
+        }
+        return p;
+}
+
+static char *
+encode_ndjson(char *p, const struct record *rec)
+{
+        const char *outcome = record_outcome_name(rec->outcome);
+        const char *domain  = record_domain_name(rec->domain);
+        p                   = put_raw(p, "{\"src\":\"", 8);
+        p                   = put_json_chars(p, rec->source);
+        p                   = put_raw(p, "\",\"dst\":\"", 9);
+        p                   = put_json_chars(p, rec->dir);
+        *p++                = '/';
+        p                   = put_json_chars(p, rec->name);
+        p                   = put_raw(p, "\",\"outcome\":\"", 13);
+        p                   = put_raw(p, outcome, strlen(outcome));
+        p                   = put_raw(p, "\",\"domain\":\"", 12);
+        p                   = put_raw(p, domain, strlen(domain));
+        p                   = put_raw(p, "\",\"error\":", 10);
+        p                   = put_u64(p, (unsigned long long) rec->error);
+        p                   = put_raw(p, ",\"bytes\":", 9);
+        p                   = put_u64(p, rec->bytes);
+        p                   = put_raw(p, ",\"latency_ns\":", 14);
+        p                   = put_u64(p, rec->latency_ns);
+        if (!utf8_valid(rec->source))
+        {
+                p    = put_raw(p, ",\"src_hex\":\"", 12);
+                p    = put_hex(p, rec->source);
+                *p++ = '"';
+        }
+        if (!utf8_valid(rec->dir) || !utf8_valid(rec->name))
+        {
+                p    = put_raw(p, ",\"dst_hex\":\"", 12);
+                p    = put_hex(p, rec->dir);
+                p    = put_hex(p, "/");
+                p    = put_hex(p, rec->name);
+                *p++ = '"';
+        }
+        return put_raw(p, "}\n", 2);
+}
+
+static char *
+encode_bin(char *p, const struct record *rec, const size_t src_len,
+           const size_t dir_len, const size_t name_len)
+{
+        const size_t dst_len = dir_len + 1 + name_len;
+        p = put_le(p, RECORD_BIN_FIXED - 4 + src_len + dst_len, 4);
+        p = put_le(p, (unsigned long long) rec->outcome, 1);
+        p = put_le(p, (unsigned long long) rec->domain, 1);
+        p = put_le(p, (unsigned long long) rec->error, 2);
+        p = put_le(p, rec->bytes, 8);
+        p = put_le(p, rec->latency_ns, 8);
+        p = put_le(p, src_len, 2);
+        p = put_le(p, dst_len, 2);
+        p = put_raw(p, rec->source, src_len);
+        p = put_raw(p, rec->dir, dir_len);
+        *p++ = '/';
+        return put_raw(p, rec->name, name_len);
+}
+
+/// Открывает поток: для двоичного формата пишет сигнатуру и версию,
+/// для остальных ничего не делает.
+int
+record_begin(struct reporter *r, const int format)
+{
+        if (RECORD_BIN != format)
+        {
+                return 0;
+        }
+        char header[sizeof(RECORD_BIN_MAGIC)];
+        memcpy(header, RECORD_BIN_MAGIC, sizeof(header) - 1);
+        header[sizeof(header) - 1] = RECORD_BIN_VERSION;
+        return reporter_write(r, header, sizeof(header));
+}
+
+/// Кодирует одну запись и отдаёт её отчёту одним блоком.
+///
+/// NDJSON: `{"src":…,"dst":…,"outcome":…,"domain":…,"error":…,
+/// "bytes":…,"latency_ns":…}` и перевод строки. Если `src` или `dst`
+/// не являются корректным UTF-8, добавляются `"src_hex"`/`"dst_hex"`
+/// с исходными байтами.
+///
+/// Двоичная запись, все целые little-endian:
+///   u32 длина остатка записи, u8 outcome, u8 domain, u16 error,
+///   u64 bytes, u64 latency_ns, u16 длина src, u16 длина dst,
+///   затем байты src и dst без завершающих нулей.
+///
+/// \return 0 при успехе, -1 при ошибке записи или нехватке памяти
+int
+record_write(struct reporter *r, const int format, const struct record *rec)
+{
+        if (NULL == r || RECORD_TEXT == format)
+        {
+                return 0;
+        }
+        const size_t src_len  = strlen(rec->source);
+        const size_t dir_len  = strlen(rec->dir);
+        const size_t name_len = strlen(rec->name);
+        if (RECORD_BIN == format &&
+            (UINT16_MAX < src_len || UINT16_MAX < dir_len + 1 + name_len))
+        {
+                return -1;
+        }
+        // экранирование \u00XX — до 6 байт на входной байт и ещё 2
+        // на его копию в `*_hex`
+        const size_t bound = RECORD_BIN == format
+                                 ? RECORD_BIN_FIXED + src_len + dir_len +
+                                       1 + name_len
+                                 : RECORD_JSON_FIXED +
+                                       8 * (src_len + dir_len + 1 + name_len);
+        char         stack_buf[RECORD_STACK_BUF];
+        char        *buf = stack_buf;
+        if (bound > sizeof(stack_buf) && NULL == (buf = malloc(bound)))
+        {
+                return -1;
+        }
+        const char *end = RECORD_BIN == format
+                              ? encode_bin(buf, rec, src_len, dir_len, name_len)
+                              : encode_ndjson(buf, rec);
+        const int   rc  = reporter_write(r, buf, (size_t) (end - buf));
+        if (buf != stack_buf)
+        {
+                free(buf);
+        }
+        return rc;
+}
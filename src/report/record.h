@@ -0,0 +1,65 @@
+#ifndef RECORD_H
+#define RECORD_H
+
+#include "report.h"
+
+/// Формат потока результатов.
+enum record_format
+{
+        RECORD_TEXT,   /// Человекочитаемые строки (записи не выводятся)
+        RECORD_NDJSON, /// Одна JSON-запись на строку
+        RECORD_BIN,    /// Компактные двоичные записи, см. `record_write`
+};
+
+/// Итог обработки одного файла.
+enum record_outcome
+{
+        RECORD_MOVED,
+        RECORD_LINKED,
+        RECORD_COPIED,
+        RECORD_ARCHIVED,
+        RECORD_DEDUPED, /// Дубликат заменён ссылкой на оригинал
+        RECORD_SKIPPED, /// Дубликат оставлен на месте
+        RECORD_FAILED,
+        RECORD_BUSY, /// Файл ещё пишется, оставлен на месте
+        RECORD_OUTCOMES,
+};
+
+/// Модуль, к перечислению ошибок которого относится `record.error`.
+enum record_domain
+{
+        RECORD_DOMAIN_NONE,    /// Операции не было: файл занят
+        RECORD_DOMAIN_EXECUTE, /// `enum executor_error`
+        RECORD_DOMAIN_ARCHIVE, /// `enum archive_error`
+        RECORD_DOMAIN_DEDUP,   /// `enum dedup_error`
+        RECORD_DOMAINS,
+};
+
+/// Заголовок двоичного потока: сигнатура и версия формата.
+/// Версия 2: бывший резервный байт хранит `enum record_domain`.
+#define RECORD_BIN_MAGIC   "TNR"
+#define RECORD_BIN_VERSION 2
+
+/// Результат обработки одного файла. Назначение — `dir/name`.
+struct record
+{
+        const char        *source;
+        const char        *dir;
+        const char        *name;
+        int                outcome; /// Значение из `enum record_outcome`
+        int                domain;  /// Значение из `enum record_domain`
+        int                error;   /// Код ошибки операции, 0 при успехе
+        unsigned long long bytes;
+        unsigned long long latency_ns;
+};
+
+const char *
+record_outcome_name(int outcome);
+const char *
+record_domain_name(int domain);
+int
+record_begin(struct reporter *r, int format);
+int
+record_write(struct reporter *r, int format, const struct record *rec);
+
+#endif //RECORD_H
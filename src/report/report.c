@@ -0,0 +1,300 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "report.h"
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/// Пишет блок целиком, дожимая частичные записи и `EINTR`.
+static int
+write_all(const int fd, const char *data, size_t len)
+{
+        while (0 < len)
+        {
+                const ssize_t n = write(fd, data, len);
+                if (-1 == n)
+                {
+                        if (EINTR == errno)
+                        {
+                                continue;
+                        }
+                        return -1;
+                }
+                data += n;
+                len -= (size_t) n;
+        }
+        return 0;
+}
+
+/// Сбрасывает собственный буфер корневого отчёта; мьютекс уже захвачен.
+static int
+drain_locked(struct reporter *r)
+{
+        if (0 == r->len)
+        {
+                return 0;
+        }
+        if (!r->failed && -1 == write_all(r->fd, r->buf, r->len))
+        {
+                r->failed = 1;
+        }
+        r->len = 0;
+        return r->failed ? -1 : 0;
+}
+
+/// Добавляет блок в корневой отчёт: в буфер, если помещается, иначе
+/// сбрасывает буфер и пишет блок напрямую одним вызовом.
+static int
+append_locked(struct reporter *r, const char *data, const size_t len)
+{
+        if (len <= r->cap - r->len)
+        {
+                memcpy(r->buf + r->len, data, len);
+                r->len += len;
+                return 0;
+        }
+        if (-1 == drain_locked(r))
+        {
+                return -1;
+        }
+        if (len <= r->cap)
+        {
+                memcpy(r->buf, data, len);
+                r->len = len;
+                return 0;
+        }
+        if (-1 == write_all(r->fd, data, len))
+        {
+                r->failed = 1;
+                return -1;
+        }
+        return 0;
+}
+
+/// Передаёт накопленное потоковым отчётом корневому.
+static int
+hand_over(struct reporter *child)
+{
+        if (0 == child->len)
+        {
+                return 0;
+        }
+        struct reporter *root = child->parent;
+        pthread_mutex_lock(&root->lock);
+        const int rc = append_locked(root, child->buf, child->len);
+        pthread_mutex_unlock(&root->lock);
+        child->len = 0;
+        return rc;
+}
+
+static int
+alloc_buffer(int *error, struct reporter *r, const size_t cap)
+{
+        r->cap = 0 == cap ? REPORT_BUFSIZE : cap;
+        r->buf = malloc(r->cap);
+        if (NULL == r->buf)
+        {
+                *error = REPORT_ERR_MEM;
+                return -1;
+        }
+        return 0;
+}
+
+/// Создаёт корневой отчёт поверх дескриптора `fd`.
+/// \param cap Размер буфера; 0 — `REPORT_BUFSIZE`
+int
+reporter_init(int *error, struct reporter *r, const int fd, const size_t cap)
+{
+        if (NULL == r || 0 > fd)
+        {
+                *error = REPORT_ERR_BAD_ARG;
+                return -1;
+        }
+        memset(r, 0, sizeof(*r));
+        r->fd = fd;
+        if (-1 == alloc_buffer(error, r, cap))
+        {
+                return -1;
+        }
+        if (0 != pthread_mutex_init(&r->lock, NULL))
+        {
+                free(r->buf);
+                *error = REPORT_ERR_MEM;
+                return -1;
+        }
+        *error = REPORT_OK;
+        return 0;
+}
+
+/// Создаёт потоковый отчёт для одного рабочего потока.
+/// Корневой отчёт должен пережить потоковый.
+int
+reporter_child(int *error, struct reporter *child, struct reporter *parent,
+               const size_t cap)
+{
+        if (NULL == child || NULL == parent || NULL != parent->parent)
+        {
+                *error = REPORT_ERR_BAD_ARG;
+                return -1;
+        }
+        memset(child, 0, sizeof(*child));
+        child->fd     = parent->fd;
+        child->parent = parent;
+        if (-1 == alloc_buffer(error, child, cap))
+        {
+                return -1;
+        }
+        *error = REPORT_OK;
+        return 0;
+}
+
+/// Отдаёт блок длиннее буфера потокового отчёта сразу корневому.
+static int
+child_write_through(struct reporter *child, const char *data, const size_t len)
+{
+        if (-1 == hand_over(child))
+        {
+                return -1;
+        }
+        pthread_mutex_lock(&child->parent->lock);
+        const int rc = append_locked(child->parent, data, len);
+        pthread_mutex_unlock(&child->parent->lock);
+        return rc;
+}
+
+int
+reporter_write(struct reporter *r, const char *data, const size_t len)
+{
+        if (NULL == r)
+        {
+                return 0;
+        }
+        if (NULL == r->parent)
+        {
+                pthread_mutex_lock(&r->lock);
+                const int rc = append_locked(r, data, len);
+                pthread_mutex_unlock(&r->lock);
+                return rc;
+        }
+        if (len > r->cap)
+        {
+                return child_write_through(r, data, len);
+        }
+        if (len > r->cap - r->len && -1 == hand_over(r))
+        {
+                return -1;
+        }
+        memcpy(r->buf + r->len, data, len);
+        r->len += len;
+        return 0;
+}
+
+int
+reporter_puts(struct reporter *r, const char *s)
+{
+        return reporter_write(r, s, strlen(s));
+}
+
+/// Форматирует строку прямо в свободный хвост буфера; промежуточная
+/// копия нужна, только если строка длиннее всего буфера.
+/// Для корневого отчёта мьютекс уже захвачен.
+static int
+format_locked(struct reporter *r, const char *fmt, va_list ap)
+{
+        va_list copy;
+        va_copy(copy, ap);
+        int n = vsnprintf(r->buf + r->len, r->cap - r->len, fmt, copy);
+        va_end(copy);
+        if (0 > n)
+        {
+                return -1;
+        }
+        if ((size_t) n < r->cap - r->len)
+        {
+                r->len += (size_t) n;
+                return 0;
+        }
+        if ((size_t) n < r->cap)
+        {
+                if (-1 == (NULL == r->parent ? drain_locked(r) : hand_over(r)))
+                {
+                        return -1;
+                }
+                n      = vsnprintf(r->buf, r->cap, fmt, ap);
+                r->len = (size_t) n;
+                return 0;
+        }
+        char *line = malloc((size_t) n + 1);
+        if (NULL == line)
+        {
+                return -1;
+        }
+        vsnprintf(line, (size_t) n + 1, fmt, ap);
+        const int rc = NULL == r->parent
+                           ? append_locked(r, line, (size_t) n)
+                           : child_write_through(r, line, (size_t) n);
+        free(line);
+        return rc;
+}
+
+int
+reporter_printf(struct reporter *r, const char *fmt, ...)
+{
+        if (NULL == r)
+        {
+                return 0;
+        }
+        va_list ap;
+        va_start(ap, fmt);
+        if (NULL == r->parent)
+        {
+                pthread_mutex_lock(&r->lock);
+        }
+        const int rc = format_locked(r, fmt, ap);
+        if (NULL == r->parent)
+        {
+                pthread_mutex_unlock(&r->lock);
+        }
+        va_end(ap);
+        return rc;
+}
+
+/// Сбрасывает накопленное: потоковый отчёт — в корневой,
+/// корневой — в дескриптор.
+int
+reporter_flush(struct reporter *r)
+{
+        if (NULL == r)
+        {
+                return 0;
+        }
+        if (NULL != r->parent)
+        {
+                return hand_over(r);
+        }
+        pthread_mutex_lock(&r->lock);
+        const int rc = drain_locked(r);
+        pthread_mutex_unlock(&r->lock);
+        return rc;
+}
+
+/// Сбрасывает остаток и освобождает буфер. Дескриптор не закрывается.
+void
+reporter_free(struct reporter *r)
+{
+        if (NULL == r || NULL == r->buf)
+        {
+                return;
+        }
+        reporter_flush(r);
+        if (NULL == r->parent)
+        {
+                pthread_mutex_destroy(&r->lock);
+        }
+        free(r->buf);
+        r->buf = NULL;
+}
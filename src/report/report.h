@@ -0,0 +1,56 @@
+#ifndef REPORT_H
+#define REPORT_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+/// Размер буфера по умолчанию: отчёт уходит в дескриптор блоками такого
+/// размера, а не системным вызовом на каждую строку.
+#define REPORT_BUFSIZE (64 * 1024)
+
+enum report_error
+{
+        REPORT_OK,
+        REPORT_ERR_BAD_ARG,
+        REPORT_ERR_MEM,
+        REPORT_ERR_WRITE,
+};
+
+/// Буферизованный вывод отчёта в файловый дескриптор.
+///
+/// Корневой отчёт (`reporter_init`) владеет дескриптором и защищён
+/// мьютексом. Потоковый отчёт (`reporter_child`) копит строки в своём
+/// буфере без блокировок и сбрасывает их в корневой целиком, так что
+/// строки разных потоков не перемешиваются.
+///
+/// Указатель `NULL` вместо отчёта допустим везде и означает «молчать»
+/// (режим `--quiet`).
+struct reporter
+{
+        int              fd;
+        char            *buf;
+        size_t           len;
+        size_t           cap;
+        int              failed; /// Была ошибка записи; дальше вывод теряется
+        struct reporter *parent; /// Корневой отчёт или NULL
+        pthread_mutex_t  lock;   /// Используется только в корневом отчёте
+};
+
+int
+reporter_init(int *error, struct reporter *r, int fd, size_t cap);
+int
+reporter_child(int *error, struct reporter *child, struct reporter *parent,
+               size_t cap);
+int
+reporter_write(struct reporter *r, const char *data, size_t len);
+int
+reporter_puts(struct reporter *r, const char *s);
+int
+reporter_printf(struct reporter *r, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+int
+reporter_flush(struct reporter *r);
+void
+reporter_free(struct reporter *r);
+
+#endif //REPORT_H
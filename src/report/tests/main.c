@@ -0,0 +1,37 @@
+#include "test_errsum.h"
+#include "test_progress.h"
+#include "test_record.h"
+#include "test_report.h"
+
+#include "unity.h"
+
+void
+setUp(void)
+{ /* инициализация, если нужна */
+}
+void
+tearDown(void)
+{ /* очистка, если нужна */
+}
+
+int
+main(void)
+{
+        UNITY_BEGIN();
+        RUN_TEST(test_reporter_null_args);
+        RUN_TEST(test_reporter_buffers_until_flush);
+        RUN_TEST(test_reporter_overflow);
+        RUN_TEST(test_reporter_printf);
+        RUN_TEST(test_reporter_children_keep_lines);
+        RUN_TEST(test_record_ndjson);
+        RUN_TEST(test_record_ndjson_escape);
+        RUN_TEST(test_record_ndjson_utf8);
+        RUN_TEST(test_record_bin);
+        RUN_TEST(test_errsum_groups);
+        RUN_TEST(test_errsum_live_limit);
+        RUN_TEST(test_errsum_print);
+        RUN_TEST(test_errsum_note_flushes);
+        RUN_TEST(test_progress_not_tty);
+        RUN_TEST(test_progress_format);
+        return UNITY_END();
+}
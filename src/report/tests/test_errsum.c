@@ -0,0 +1,112 @@
+#include "test_errsum.h"
+
+#include "errsum.h"
+#include "unity.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+static const char move_failed[] = "Ошибка при перемещении файла";
+static const char copy_failed[] = "Ошибка при копировании файла";
+
+void
+test_errsum_groups(void)
+{
+        struct errsum sum;
+        errsum_init(&sum, 0);
+        char name[32];
+        for (int i = 0; i < 1000; ++i)
+        {
+                snprintf(name, sizeof(name), "f%d", i);
+                errsum_add(&sum, move_failed, 4, EACCES, "ro", name);
+        }
+        errsum_add(&sum, move_failed, 4, EACCES, "other", "x");
+        errsum_add(&sum, move_failed, 4, EXDEV, "ro", "y");
+        errsum_add(&sum, copy_failed, 7, EACCES, "ro", "z");
+        TEST_ASSERT_EQUAL_UINT(1003, sum.total);
+        TEST_ASSERT_EQUAL_UINT(4, sum.groups_count);
+        TEST_ASSERT_EQUAL_UINT(1000, sum.groups[0].count);
+        TEST_ASSERT_EQUAL_UINT(ERRSUM_SAMPLES, sum.groups[0].samples_count);
+        TEST_ASSERT_EQUAL_STRING("f0", sum.groups[0].samples[0]);
+        errsum_free(&sum);
+}
+
+void
+test_errsum_live_limit(void)
+{
+        struct errsum sum;
+        errsum_init(&sum, 2);
+        TEST_ASSERT_EQUAL_INT(1, errsum_add(&sum, move_failed, 4, 0, "d", "a"));
+        TEST_ASSERT_EQUAL_INT(1, errsum_add(&sum, move_failed, 4, 0, "d", "b"));
+        TEST_ASSERT_EQUAL_INT(0, errsum_add(&sum, move_failed, 4, 0, "d", "c"));
+        TEST_ASSERT_EQUAL_INT(1, errsum_add(NULL, move_failed, 4, 0, "d", "c"));
+        errsum_free(&sum);
+}
+
+void
+test_errsum_print(void)
+{
+        struct errsum sum;
+        errsum_init(&sum, 1);
+        errsum_add(&sum, copy_failed, 7, 0, "c", "one");
+        errsum_add(&sum, move_failed, 4, EACCES, "ro", "a");
+        errsum_add(&sum, move_failed, 4, EACCES, "ro", "b");
+        int fds[2];
+        TEST_ASSERT_EQUAL_INT(0, pipe(fds));
+        int             err = REPORT_OK;
+        struct reporter r;
+        TEST_ASSERT_EQUAL_INT(0, reporter_init(&err, &r, fds[1], 0));
+        TEST_ASSERT_EQUAL_INT(0, errsum_print(&sum, &r));
+        reporter_free(&r);
+        close(fds[1]);
+        char          buf[1024];
+        const ssize_t n = read(fds[0], buf, sizeof(buf) - 1);
+        close(fds[0]);
+        TEST_ASSERT_GREATER_THAN(0, n);
+        buf[n] = '\0';
+        TEST_ASSERT_NOT_NULL(strstr(buf, "Ошибок: 3 (показаны первые 1)\n"));
+        // большая группа печатается первой
+        char *move = strstr(buf, "2 × Ошибка при перемещении файла → ro/");
+        char *copy = strstr(buf, "1 × Ошибка при копировании файла → c/");
+        TEST_ASSERT_NOT_NULL(move);
+        TEST_ASSERT_NOT_NULL(copy);
+        TEST_ASSERT_TRUE(move < copy);
+        TEST_ASSERT_NOT_NULL(strstr(move, strerror(EACCES)));
+        TEST_ASSERT_NOT_NULL(strstr(move, ": a, b\n"));
+        errsum_free(&sum);
+}
+
+void
+test_errsum_note_flushes(void)
+{
+        struct errsum sum;
+        errsum_init(&sum, 1);
+        int fds[2];
+        TEST_ASSERT_EQUAL_INT(0, pipe(fds));
+        int             err = REPORT_OK;
+        struct reporter r;
+        TEST_ASSERT_EQUAL_INT(0, reporter_init(&err, &r, fds[1], 65536));
+        TEST_ASSERT_EQUAL_INT(
+            1, errsum_note(&sum, &r, move_failed, 4, EACCES, "ro", "a"));
+        TEST_ASSERT_EQUAL_INT(
+            0, errsum_note(&sum, &r, move_failed, 4, EACCES, "ro", "b"));
+        // строка уже в канале, хотя отчёт не освобождён
+        char          buf[1024];
+        const ssize_t n = read(fds[0], buf, sizeof(buf) - 1);
+        TEST_ASSERT_GREATER_THAN(0, n);
+        buf[n] = '\0';
+        TEST_ASSERT_NOT_NULL(
+            strstr(buf, "Ошибка при перемещении файла: a → ro/a ("));
+        TEST_ASSERT_NULL(strstr(buf, "ro/b"));
+        // после сброса сводки первая ошибка снова выводится сразу
+        errsum_reset(&sum);
+        TEST_ASSERT_EQUAL_UINT(0, sum.total);
+        TEST_ASSERT_EQUAL_INT(
+            1, errsum_note(&sum, &r, move_failed, 4, EACCES, "ro", "c"));
+        reporter_free(&r);
+        close(fds[1]);
+        close(fds[0]);
+        errsum_free(&sum);
+}
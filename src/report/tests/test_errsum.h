@@ -0,0 +1,13 @@
+#ifndef TEST_ERRSUM_H
+#define TEST_ERRSUM_H
+
+void
+test_errsum_groups(void);
+void
+test_errsum_live_limit(void);
+void
+test_errsum_print(void);
+void
+test_errsum_note_flushes(void);
+
+#endif //TEST_ERRSUM_H
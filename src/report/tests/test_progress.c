@@ -0,0 +1,53 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "test_progress.h"
+
+#include "progress.h"
+#include "unity.h"
+
+#include <string.h>
+#include <unistd.h>
+
+void
+test_progress_not_tty(void)
+{
+        int fds[2];
+        TEST_ASSERT_EQUAL_INT(0, pipe(fds));
+        int             err = PROGRESS_OK;
+        struct progress p;
+        TEST_ASSERT_EQUAL_INT(-1, progress_start(&err, &p, fds[1], fds[1], 10));
+        TEST_ASSERT_EQUAL_INT(PROGRESS_ERR_NOT_TTY, err);
+        TEST_ASSERT_EQUAL_INT(-1, progress_start(&err, NULL, fds[1], fds[1], 1));
+        TEST_ASSERT_EQUAL_INT(PROGRESS_ERR_BAD_ARG, err);
+        progress_add(NULL, 1);
+        progress_stop(NULL);
+        close(fds[0]);
+        close(fds[1]);
+}
+
+void
+test_progress_format(void)
+{
+        struct progress p;
+        memset(&p, 0, sizeof(p));
+        p.total    = 100;
+        p.start_ns = 1000000000ULL;
+        char buf[256];
+        progress_format(&p, buf, sizeof(buf), p.start_ns);
+        TEST_ASSERT_NOT_NULL(strstr(buf, "0/100"));
+        TEST_ASSERT_NOT_NULL(strstr(buf, "--:--"));
+
+        for (int i = 0; i < 25; ++i)
+        {
+                progress_add(&p, 2000000);
+        }
+        // 25 файлов и 50 МБ за 10 с: 75 оставшихся займут 30 с
+        progress_format(&p, buf, sizeof(buf), p.start_ns + 10000000000ULL);
+        TEST_ASSERT_NOT_NULL(strstr(buf, "25/100"));
+        TEST_ASSERT_NOT_NULL(strstr(buf, "5.0 МБ/с"));
+        TEST_ASSERT_NOT_NULL(strstr(buf, "0:30"));
+
+        char small[8];
+        TEST_ASSERT_EQUAL_size_t(7, progress_format(&p, small, sizeof(small),
+                                                    p.start_ns + 1));
+}
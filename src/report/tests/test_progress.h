@@ -0,0 +1,9 @@
+#ifndef TEST_PROGRESS_H
+#define TEST_PROGRESS_H
+
+void
+test_progress_not_tty(void);
+void
+test_progress_format(void);
+
+#endif //TEST_PROGRESS_H
@@ -0,0 +1,125 @@
+#include "test_record.h"
+
+#include "record.h"
+#include "unity.h"
+
+#include <string.h>
+#include <unistd.h>
+
+/// Пишет запись в канал и читает результат обратно.
+static size_t
+capture(const int format, const struct record *rec, char *buf,
+        const size_t cap)
+{
+        int fds[2];
+        TEST_ASSERT_EQUAL_INT(0, pipe(fds));
+        int             err = REPORT_OK;
+        struct reporter r;
+        TEST_ASSERT_EQUAL_INT(0, reporter_init(&err, &r, fds[1], 0));
+        TEST_ASSERT_EQUAL_INT(0, record_begin(&r, format));
+        TEST_ASSERT_EQUAL_INT(0, record_write(&r, format, rec));
+        reporter_free(&r);
+        close(fds[1]);
+        size_t  got = 0;
+        ssize_t n   = 0;
+        while (got < cap && 0 < (n = read(fds[0], buf + got, cap - got)))
+        {
+                got += (size_t) n;
+        }
+        close(fds[0]);
+        return got;
+}
+
+void
+test_record_ndjson(void)
+{
+        const struct record rec = {.source     = "a.jpg",
+                                   .dir        = "img",
+                                   .name       = "a.jpg",
+                                   .outcome    = RECORD_MOVED,
+                                   .domain     = RECORD_DOMAIN_EXECUTE,
+                                   .error      = 0,
+                                   .bytes      = 1234,
+                                   .latency_ns = 18446744073709551615ULL};
+        char                buf[256];
+        const size_t        got =
+            capture(RECORD_NDJSON, &rec, buf, sizeof(buf));
+        const char         *expected =
+            "{\"src\":\"a.jpg\",\"dst\":\"img/a.jpg\",\"outcome\":\"moved\","
+            "\"domain\":\"execute\",\"error\":0,\"bytes\":1234,"
+            "\"latency_ns\":18446744073709551615}\n";
+        TEST_ASSERT_EQUAL_UINT(strlen(expected), got);
+        TEST_ASSERT_EQUAL_MEMORY(expected, buf, got);
+}
+
+void
+test_record_ndjson_escape(void)
+{
+        const struct record rec = {.source  = "q\"b\\\n",
+                                   .dir     = "d",
+                                   .name    = "n",
+                                   .outcome = RECORD_FAILED,
+                                   .domain  = RECORD_DOMAIN_ARCHIVE,
+                                   .error   = 4};
+        char                buf[256];
+        const size_t        got =
+            capture(RECORD_NDJSON, &rec, buf, sizeof(buf));
+        buf[got]                = '\0';
+        TEST_ASSERT_NOT_NULL(strstr(buf, "\"src\":\"q\\\"b\\\\\\u000a\""));
+        TEST_ASSERT_NOT_NULL(strstr(
+            buf, "\"outcome\":\"failed\",\"domain\":\"archive\",\"error\":4"));
+        TEST_ASSERT_NULL(strstr(buf, "_hex"));
+}
+
+void
+test_record_ndjson_utf8(void)
+{
+        // "é" в UTF-8 проходит как есть, одиночный 0xe9 (Latin-1) и
+        // обрезанная последовательность экранируются и дублируются в hex
+        const struct record rec = {.source  = "\xc3\xa9",
+                                   .dir     = "d",
+                                   .name    = "\xe9\xe2\x82",
+                                   .outcome = RECORD_MOVED};
+        char                buf[256];
+        const size_t        got =
+            capture(RECORD_NDJSON, &rec, buf, sizeof(buf));
+        buf[got]                = '\0';
+        TEST_ASSERT_NOT_NULL(strstr(buf, "\"src\":\"\xc3\xa9\""));
+        TEST_ASSERT_NOT_NULL(
+            strstr(buf, "\"dst\":\"d/\\u00e9\\u00e2\\u0082\""));
+        TEST_ASSERT_NULL(strstr(buf, "\"src_hex\""));
+        TEST_ASSERT_NOT_NULL(strstr(buf, ",\"dst_hex\":\"642fe9e282\"}"));
+}
+
+void
+test_record_bin(void)
+{
+        const struct record rec = {.source     = "ab",
+                                   .dir        = "d",
+                                   .name       = "ab",
+                                   .outcome    = RECORD_COPIED,
+                                   .domain     = RECORD_DOMAIN_DEDUP,
+                                   .error      = 0x0102,
+                                   .bytes      = 0x1122334455667788ULL,
+                                   .latency_ns = 7};
+        unsigned char       buf[128];
+        const size_t        got =
+            capture(RECORD_BIN, &rec, (char *) buf, sizeof(buf));
+        // сигнатура + 28 байт полей + "ab" + "d/ab"
+        TEST_ASSERT_EQUAL_UINT(4 + 28 + 2 + 4, got);
+        TEST_ASSERT_EQUAL_MEMORY("TNR", buf, 3);
+        TEST_ASSERT_EQUAL_UINT8(RECORD_BIN_VERSION, buf[3]);
+        const unsigned char *p = buf + 4;
+        TEST_ASSERT_EQUAL_UINT8(got - 8, p[0]);
+        TEST_ASSERT_EQUAL_UINT8(0, p[1] | p[2] | p[3]);
+        TEST_ASSERT_EQUAL_UINT8(RECORD_COPIED, p[4]);
+        TEST_ASSERT_EQUAL_UINT8(RECORD_DOMAIN_DEDUP, p[5]);
+        TEST_ASSERT_EQUAL_UINT8(0x02, p[6]);
+        TEST_ASSERT_EQUAL_UINT8(0x01, p[7]);
+        TEST_ASSERT_EQUAL_UINT8(0x88, p[8]);
+        TEST_ASSERT_EQUAL_UINT8(0x11, p[15]);
+        TEST_ASSERT_EQUAL_UINT8(7, p[16]);
+        TEST_ASSERT_EQUAL_UINT8(2, p[24]);
+        TEST_ASSERT_EQUAL_UINT8(4, p[26]);
+        TEST_ASSERT_EQUAL_MEMORY("abd/ab", p + 28, 6);
+}
@@ -0,0 +1,13 @@
+#ifndef TEST_RECORD_H
+#define TEST_RECORD_H
+
+void
+test_record_ndjson(void);
+void
+test_record_ndjson_escape(void);
+void
+test_record_ndjson_utf8(void);
+void
+test_record_bin(void);
+
+#endif //TEST_RECORD_H
@@ -0,0 +1,162 @@
+#define _GNU_SOURCE
+
+#include "test_report.h"
+
+#include "report.h"
+#include "unity.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define LINES_PER_THREAD 500
+
+static int fds[2];
+
+/// Открывает неблокирующий канал, чтобы проверять, что ещё не записано.
+static void
+open_pipe(void)
+{
+        TEST_ASSERT_EQUAL_INT(0, pipe2(fds, O_NONBLOCK));
+        fcntl(fds[0], F_SETPIPE_SZ, 1 << 20);
+}
+
+static size_t
+drain_pipe(char *buf, const size_t cap)
+{
+        size_t  got = 0;
+        ssize_t n   = 0;
+        while (got < cap && 0 < (n = read(fds[0], buf + got, cap - got)))
+        {
+                got += (size_t) n;
+        }
+        return got;
+}
+
+static void
+close_pipe(void)
+{
+        close(fds[0]);
+        close(fds[1]);
+}
+
+void
+test_reporter_null_args(void)
+{
+        int             err = REPORT_OK;
+        struct reporter r;
+        TEST_ASSERT_EQUAL_INT(-1, reporter_init(&err, NULL, 1, 0));
+        TEST_ASSERT_EQUAL_INT(REPORT_ERR_BAD_ARG, err);
+        TEST_ASSERT_EQUAL_INT(-1, reporter_init(&err, &r, -1, 0));
+        TEST_ASSERT_EQUAL_INT(-1, reporter_child(&err, &r, NULL, 0));
+        // NULL — молчаливый отчёт
+        TEST_ASSERT_EQUAL_INT(0, reporter_puts(NULL, "x"));
+        TEST_ASSERT_EQUAL_INT(0, reporter_printf(NULL, "%d", 1));
+        TEST_ASSERT_EQUAL_INT(0, reporter_flush(NULL));
+        reporter_free(NULL);
+}
+
+void
+test_reporter_buffers_until_flush(void)
+{
+        open_pipe();
+        int             err = REPORT_OK;
+        struct reporter r;
+        TEST_ASSERT_EQUAL_INT(0, reporter_init(&err, &r, fds[1], 0));
+        TEST_ASSERT_EQUAL_INT(REPORT_BUFSIZE, r.cap);
+        TEST_ASSERT_EQUAL_INT(0, reporter_puts(&r, "one\n"));
+        TEST_ASSERT_EQUAL_INT(0, reporter_puts(&r, "two\n"));
+        char buf[64];
+        TEST_ASSERT_EQUAL_UINT(0, drain_pipe(buf, sizeof(buf)));
+        TEST_ASSERT_EQUAL_INT(0, reporter_flush(&r));
+        TEST_ASSERT_EQUAL_UINT(8, drain_pipe(buf, sizeof(buf)));
+        TEST_ASSERT_EQUAL_MEMORY("one\ntwo\n", buf, 8);
+        reporter_free(&r);
+        close_pipe();
+}
+
+void
+test_reporter_overflow(void)
+{
+        open_pipe();
+        int             err = REPORT_OK;
+        struct reporter r;
+        TEST_ASSERT_EQUAL_INT(0, reporter_init(&err, &r, fds[1], 8));
+        TEST_ASSERT_EQUAL_INT(0, reporter_puts(&r, "abcd\n"));
+        // не помещается в остаток — уходит накопленное, строка не рвётся
+        TEST_ASSERT_EQUAL_INT(0, reporter_puts(&r, "efgh\n"));
+        char buf[64];
+        TEST_ASSERT_EQUAL_UINT(5, drain_pipe(buf, sizeof(buf)));
+        TEST_ASSERT_EQUAL_MEMORY("abcd\n", buf, 5);
+        // длиннее буфера — пишется напрямую после накопленного
+        TEST_ASSERT_EQUAL_INT(0, reporter_puts(&r, "0123456789\n"));
+        TEST_ASSERT_EQUAL_UINT(16, drain_pipe(buf, sizeof(buf)));
+        TEST_ASSERT_EQUAL_MEMORY("efgh\n0123456789\n", buf, 16);
+        reporter_free(&r);
+        close_pipe();
+}
+
+void
+test_reporter_printf(void)
+{
+        open_pipe();
+        int             err = REPORT_OK;
+        struct reporter r;
+        TEST_ASSERT_EQUAL_INT(0, reporter_init(&err, &r, fds[1], 16));
+        TEST_ASSERT_EQUAL_INT(0, reporter_printf(&r, "%s=%d\n", "a", 1));
+        TEST_ASSERT_EQUAL_INT(0, reporter_printf(&r, "%s=%d\n", "bbbb", 22));
+        TEST_ASSERT_EQUAL_INT(0, reporter_printf(&r, "%s\n",
+                                                 "longer than sixteen"));
+        reporter_free(&r);
+        char buf[64];
+        const size_t got = drain_pipe(buf, sizeof(buf));
+        TEST_ASSERT_EQUAL_UINT(32, got);
+        TEST_ASSERT_EQUAL_MEMORY("a=1\nbbbb=22\nlonger than sixteen\n", buf,
+                                 got);
+        close_pipe();
+}
+
+static void *
+child_worker(void *arg)
+{
+        struct reporter *child = arg;
+        for (int i = 0; i < LINES_PER_THREAD; ++i)
+        {
+                reporter_printf(child, "thread-line-%04d\n", i);
+        }
+        reporter_free(child);
+        return NULL;
+}
+
+void
+test_reporter_children_keep_lines(void)
+{
+        open_pipe();
+        int             err = REPORT_OK;
+        struct reporter root;
+        struct reporter child[2];
+        TEST_ASSERT_EQUAL_INT(0, reporter_init(&err, &root, fds[1], 256));
+        pthread_t th[2];
+        for (int i = 0; i < 2; ++i)
+        {
+                TEST_ASSERT_EQUAL_INT(
+                    0, reporter_child(&err, &child[i], &root, 64));
+                pthread_create(&th[i], NULL, child_worker, &child[i]);
+        }
+        for (int i = 0; i < 2; ++i)
+        {
+                pthread_join(th[i], NULL);
+        }
+        reporter_free(&root);
+        static char  buf[2 * LINES_PER_THREAD * 17 + 1];
+        const size_t got = drain_pipe(buf, sizeof(buf) - 1);
+        TEST_ASSERT_EQUAL_UINT(2 * LINES_PER_THREAD * 17, got);
+        // каждая строка цела: 17 байт, начинается с префикса
+        for (size_t off = 0; off < got; off += 17)
+        {
+                TEST_ASSERT_EQUAL_MEMORY("thread-line-", buf + off, 12);
+                TEST_ASSERT_EQUAL_CHAR('\n', buf[off + 16]);
+        }
+        close_pipe();
+}
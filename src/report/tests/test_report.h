@@ -0,0 +1,15 @@
+#ifndef TEST_REPORT_H
+#define TEST_REPORT_H
+
+void
+test_reporter_null_args(void);
+void
+test_reporter_buffers_until_flush(void);
+void
+test_reporter_overflow(void);
+void
+test_reporter_printf(void);
+void
+test_reporter_children_keep_lines(void);
+
+#endif //TEST_REPORT_H
@@ -0,0 +1,25 @@
+#include "test_watch.h"
+
+#include "unity.h"
+
+void
+setUp(void)
+{ /* инициализация, если нужна */
+}
+void
+tearDown(void)
+{ /* очистка, если нужна */
+}
+
+int
+main(void)
+{
+        UNITY_BEGIN();
+        RUN_TEST(test_watch_null_args);
+        RUN_TEST(test_watch_new_files);
+        RUN_TEST(test_watch_fanotify_or_fallback);
+        RUN_TEST(test_watch_signal_stops);
+        RUN_TEST(test_watch_batch_dedup);
+        RUN_TEST(test_watch_timeout_not_extended);
+        return UNITY_END();
+}
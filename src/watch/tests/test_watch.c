@@ -0,0 +1,198 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "test_watch.h"
+
+#include "common.h"
+#include "unity.h"
+#include "watch.h"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+static char dir[] = "/tmp/tn_watch_XXXXXX";
+
+static void
+touch(const char *name)
+{
+        char path[128];
+        snprintf(path, sizeof(path), "%s/%s", dir, name);
+        const int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        TEST_ASSERT_TRUE(0 <= fd);
+        TEST_ASSERT_EQUAL_INT(1, (int) write(fd, "x", 1));
+        close(fd);
+}
+
+void
+test_watch_null_args(void)
+{
+        int err = WATCH_OK;
+        TEST_ASSERT_EQUAL_INT(-1, watch_open(&err, NULL, ".", WATCH_INOTIFY));
+        TEST_ASSERT_EQUAL_INT(WATCH_ERR_BAD_ARG, err);
+        struct watcher w;
+        TEST_ASSERT_EQUAL_INT(-1, watch_open(&err, &w, "/nonexistent/dir", WATCH_FANOTIFY));
+        TEST_ASSERT_EQUAL_INT(WATCH_ERR_INIT, err);
+        watch_close(NULL);
+}
+
+static void
+check_new_files(const int backend)
+{
+        strcpy(dir, "/tmp/tn_watch_XXXXXX");
+        TEST_ASSERT_NOT_NULL(mkdtemp(dir));
+        char outside[] = "/tmp/tn_watch_src_XXXXXX";
+        const int fd = mkstemp(outside);
+        TEST_ASSERT_TRUE(0 <= fd);
+        close(fd);
+
+        int            err = WATCH_OK;
+        struct watcher w;
+        TEST_ASSERT_EQUAL_INT(0, watch_open(&err, &w, dir, backend));
+        touch("a.jpg");
+        char moved[128];
+        snprintf(moved, sizeof(moved), "%s/b.jpg", dir);
+        TEST_ASSERT_EQUAL_INT(0, rename(outside, moved));
+        char sub[128];
+        snprintf(sub, sizeof(sub), "%s/sub", dir);
+        TEST_ASSERT_EQUAL_INT(0, mkdir(sub, 0755));
+
+        struct dir_scan batch;
+        memset(&batch, 0, sizeof(batch));
+        int overflow = 1;
+        TEST_ASSERT_EQUAL_INT(1, watch_read(&err, &w, &batch, &overflow, -1));
+        TEST_ASSERT_EQUAL_INT(0, overflow);
+        // каталог не попадает в пачку: о нём нет ни MOVED_TO, ни CLOSE_WRITE
+        TEST_ASSERT_EQUAL_size_t(2, batch.count);
+        TEST_ASSERT_EQUAL_STRING("a.jpg", batch.names + batch.offsets[0]);
+        TEST_ASSERT_EQUAL_STRING("b.jpg", batch.names + batch.offsets[1]);
+        scan_free(&batch);
+        watch_close(&w);
+
+        unlink(moved);
+        char a[128];
+        snprintf(a, sizeof(a), "%s/a.jpg", dir);
+        unlink(a);
+        rmdir(sub);
+        rmdir(dir);
+}
+
+void
+test_watch_new_files(void)
+{
+        check_new_files(WATCH_INOTIFY);
+}
+
+void
+test_watch_fanotify_or_fallback(void)
+{
+        // без CAP_SYS_ADMIN или поддержки FID наблюдение уходит на
+        // inotify, результат должен быть тем же
+        check_new_files(WATCH_FANOTIFY);
+}
+
+void
+test_watch_signal_stops(void)
+{
+        strcpy(dir, "/tmp/tn_watch_XXXXXX");
+        TEST_ASSERT_NOT_NULL(mkdtemp(dir));
+        int            err = WATCH_OK;
+        struct watcher w;
+        TEST_ASSERT_EQUAL_INT(0, watch_open(&err, &w, dir, WATCH_INOTIFY));
+        struct dir_scan batch;
+        memset(&batch, 0, sizeof(batch));
+        int overflow = 0;
+        // без событий таймаут возвращает пустую пачку
+        TEST_ASSERT_EQUAL_INT(1, watch_read(&err, &w, &batch, &overflow, 10));
+        TEST_ASSERT_EQUAL_size_t(0, batch.count);
+        // сигнал заблокирован и ждёт в signalfd, процесс не завершается
+        TEST_ASSERT_EQUAL_INT(0, raise(SIGTERM));
+        TEST_ASSERT_EQUAL_INT(0, watch_read(&err, &w, &batch, &overflow, -1));
+        scan_free(&batch);
+        watch_close(&w);
+        rmdir(dir);
+}
+
+void
+test_watch_batch_dedup(void)
+{
+        strcpy(dir, "/tmp/tn_watch_XXXXXX");
+        TEST_ASSERT_NOT_NULL(mkdtemp(dir));
+        int            err = WATCH_OK;
+        struct watcher w;
+        TEST_ASSERT_EQUAL_INT(0, watch_open(&err, &w, dir, WATCH_INOTIFY));
+        w.window_ms = 0;
+        // файл, дописанный дважды, попадает в пачку один раз
+        touch("a.jpg");
+        touch("b.jpg");
+        touch("a.jpg");
+        struct dir_scan batch;
+        memset(&batch, 0, sizeof(batch));
+        int overflow = 0;
+        TEST_ASSERT_EQUAL_INT(1, watch_read(&err, &w, &batch, &overflow, -1));
+        TEST_ASSERT_EQUAL_size_t(2, batch.count);
+        TEST_ASSERT_EQUAL_STRING("a.jpg", batch.names + batch.offsets[0]);
+        TEST_ASSERT_EQUAL_STRING("b.jpg", batch.names + batch.offsets[1]);
+        // в следующей пачке то же имя снова допустимо
+        touch("a.jpg");
+        TEST_ASSERT_EQUAL_INT(1, watch_read(&err, &w, &batch, &overflow, -1));
+        TEST_ASSERT_EQUAL_size_t(1, batch.count);
+        scan_free(&batch);
+        watch_close(&w);
+
+        char path[128];
+        snprintf(path, sizeof(path), "%s/a.jpg", dir);
+        unlink(path);
+        snprintf(path, sizeof(path), "%s/b.jpg", dir);
+        unlink(path);
+        rmdir(dir);
+}
+
+void
+test_watch_timeout_not_extended(void)
+{
+        strcpy(dir, "/tmp/tn_watch_XXXXXX");
+        TEST_ASSERT_NOT_NULL(mkdtemp(dir));
+        char inside[128];
+        char outside[128];
+        snprintf(inside, sizeof(inside), "%s/sub", dir);
+        snprintf(outside, sizeof(outside), "%s.sub", dir);
+        TEST_ASSERT_EQUAL_INT(0, mkdir(outside, 0755));
+        int            err = WATCH_OK;
+        struct watcher w;
+        TEST_ASSERT_EQUAL_INT(0, watch_open(&err, &w, dir, WATCH_INOTIFY));
+        // каталог, заносимый в наблюдаемый, будит poll, но имён не даёт
+        const pid_t pid = fork();
+        TEST_ASSERT_TRUE(-1 != pid);
+        if (0 == pid)
+        {
+                for (int i = 0; i < 100; ++i)
+                {
+                        (void) (0 == i % 2 ? rename(outside, inside)
+                                           : rename(inside, outside));
+                        const struct timespec pause = {.tv_nsec = 10000000};
+                        nanosleep(&pause, NULL);
+                }
+                _exit(0);
+        }
+        struct dir_scan batch;
+        memset(&batch, 0, sizeof(batch));
+        int            overflow = 0;
+        const uint64_t start    = monotonic_ns();
+        TEST_ASSERT_EQUAL_INT(1, watch_read(&err, &w, &batch, &overflow, 100));
+        const uint64_t spent = monotonic_ns() - start;
+        TEST_ASSERT_EQUAL_size_t(0, batch.count);
+        TEST_ASSERT_TRUE(spent < 500000000u);
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+        scan_free(&batch);
+        watch_close(&w);
+        rmdir(inside);
+        rmdir(outside);
+        rmdir(dir);
+}
@@ -0,0 +1,17 @@
+#ifndef TEST_WATCH_H
+#define TEST_WATCH_H
+
+void
+test_watch_null_args(void);
+void
+test_watch_new_files(void);
+void
+test_watch_fanotify_or_fallback(void);
+void
+test_watch_signal_stops(void);
+void
+test_watch_batch_dedup(void);
+void
+test_watch_timeout_not_extended(void);
+
+#endif //TEST_WATCH_H
@@ -0,0 +1,390 @@
+#define _GNU_SOURCE
+
+#include "watch.h"
+
+#include "common.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/fanotify.h>
+#include <sys/inotify.h>
+#include <sys/signalfd.h>
+
+/// События, на которые реагирует наблюдение.
+#define WATCH_IN_MASK  (IN_MOVED_TO | IN_CLOSE_WRITE | IN_ONLYDIR)
+#define WATCH_FAN_MASK (FAN_MOVED_TO | FAN_CLOSE_WRITE)
+
+/// Метка fanotify на всю файловую систему, где лежит `dir`.
+///
+/// Нужны `CAP_SYS_ADMIN` и ядро с `FAN_REPORT_DFID_NAME` (5.9+), а
+/// файловая система должна уметь выдавать дескрипторы файлов.
+/// @return 0 при успехе, -1 при ошибке (`errno` сохранён).
+static int
+open_fanotify(struct watcher *w, const char *dir)
+{
+        struct file_handle *fh = malloc(sizeof(*fh) + MAX_HANDLE_SZ);
+        if (NULL == fh)
+        {
+                return -1;
+        }
+        fh->handle_bytes = MAX_HANDLE_SZ;
+        int mount_id     = 0;
+        w->dir_handle    = fh;
+        if (-1 == name_to_handle_at(AT_FDCWD, dir, fh, &mount_id, 0))
+        {
+                return -1;
+        }
+        w->fd = fanotify_init(FAN_CLASS_NOTIF | FAN_REPORT_DFID_NAME |
+                                  FAN_CLOEXEC | FAN_NONBLOCK,
+                              O_RDONLY);
+        if (-1 == w->fd)
+        {
+                return -1;
+        }
+        return fanotify_mark(w->fd, FAN_MARK_ADD | FAN_MARK_FILESYSTEM,
+                             WATCH_FAN_MASK, AT_FDCWD, dir);
+}
+
+/// Освобождает то, что успела создать неудачная `open_fanotify`.
+static void
+drop_fanotify(struct watcher *w)
+{
+        if (-1 != w->fd)
+        {
+                close(w->fd);
+                w->fd = -1;
+        }
+        free(w->dir_handle);
+        w->dir_handle = NULL;
+}
+
+/// Начинает наблюдение за каталогом `dir`.
+///
+/// Вызывается до первого сканирования каталога: файлы, появившиеся
+/// между сканированием и началом наблюдения, иначе были бы пропущены.
+/// Блокирует `SIGINT`/`SIGTERM` в вызывающем потоке (и в потоках,
+/// созданных после), поэтому вызывать лучше до запуска рабочих потоков.
+///
+/// При `WATCH_FANOTIFY` без нужных прав или поддержки ядра и файловой
+/// системы молча переходит на inotify; выбранный источник — в
+/// `w->backend`.
+///
+/// @return 0 при успехе, -1 при ошибке (код в `*error`, `errno` сохранён).
+int
+watch_open(int *error, struct watcher *w, const char *dir, const int backend)
+{
+        if (NULL == w || NULL == dir)
+        {
+                *error = WATCH_ERR_BAD_ARG;
+                return -1;
+        }
+        *error        = WATCH_OK;
+        w->backend    = WATCH_INOTIFY;
+        w->fd         = -1;
+        w->sig_fd     = -1;
+        w->wd         = -1;
+        w->dir_handle = NULL;
+        w->window_ms  = WATCH_WINDOW_MS;
+        w->batch_max  = WATCH_BATCH_MAX;
+        memset(&w->seen, 0, sizeof(w->seen));
+        w->buf        = malloc(WATCH_BUFSIZE);
+        if (NULL == w->buf || -1 == strset_init(&w->seen, WATCH_BATCH_MAX))
+        {
+                free(w->buf);
+                strset_free(&w->seen);
+                w->buf = NULL;
+                *error = WATCH_ERR_MEM;
+                return -1;
+        }
+        sigset_t mask;
+        sigemptyset(&mask);
+        sigaddset(&mask, SIGINT);
+        sigaddset(&mask, SIGTERM);
+        pthread_sigmask(SIG_BLOCK, &mask, &w->old_mask);
+        w->sig_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+        if (WATCH_FANOTIFY == backend)
+        {
+                if (0 == open_fanotify(w, dir))
+                {
+                        w->backend = WATCH_FANOTIFY;
+                }
+                else
+                {
+                        drop_fanotify(w);
+                }
+        }
+        if (WATCH_INOTIFY == w->backend)
+        {
+                w->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+                w->wd = -1 == w->fd
+                            ? -1
+                            : inotify_add_watch(w->fd, dir, WATCH_IN_MASK);
+        }
+        if (-1 == w->fd || -1 == w->sig_fd ||
+            (WATCH_INOTIFY == w->backend && -1 == w->wd))
+        {
+                const int saved = errno;
+                watch_close(w);
+                errno  = saved;
+                *error = WATCH_ERR_INIT;
+                return -1;
+        }
+        return 0;
+}
+
+/// Добавляет имя в пачку, если его там ещё нет: файл, который
+/// перенесли и тут же дописали, или несколько раз закрыли после записи,
+/// обрабатывается один раз.
+/// @return 0 при успехе, -1 при нехватке памяти.
+static int
+batch_add(struct watcher *w, struct dir_scan *batch, const char *name)
+{
+        const int added = strset_add(&w->seen, name);
+        if (1 != added)
+        {
+                return added;
+        }
+        return scan_push(batch, name);
+}
+
+/// Разбирает события inotify одного `read` и добавляет имена файлов
+/// в пачку.
+/// @return 0 при успехе, -1 при нехватке памяти.
+static int
+parse_inotify(struct watcher *w, const char *buf, const size_t len,
+              struct dir_scan *batch, int *overflow)
+{
+        size_t off = 0;
+        while (off + sizeof(struct inotify_event) <= len)
+        {
+                const struct inotify_event *ev =
+                    (const struct inotify_event *) (const void *) (buf + off);
+                off += sizeof(*ev) + ev->len;
+                if (ev->mask & IN_Q_OVERFLOW)
+                {
+                        *overflow = 1;
+                        continue;
+                }
+                if (0 == ev->len || (ev->mask & IN_ISDIR))
+                {
+                        continue;
+                }
+                if (-1 == batch_add(w, batch, ev->name))
+                {
+                        return -1;
+                }
+        }
+        return 0;
+}
+
+/// Тот же ли это каталог, что и наблюдаемый.
+static int
+same_dir(const struct watcher *w, const struct file_handle *fh)
+{
+        const struct file_handle *dir = w->dir_handle;
+        return fh->handle_type == dir->handle_type &&
+               fh->handle_bytes == dir->handle_bytes &&
+               0 == memcmp(fh->f_handle, dir->f_handle, fh->handle_bytes);
+}
+
+/// Разбирает события fanotify одного `read`: берёт имена файлов, чей
+/// родительский каталог — наблюдаемый, остальные события файловой
+/// системы отбрасывает.
+/// @return 0 при успехе, -1 при нехватке памяти.
+static int
+parse_fanotify(struct watcher *w, const char *buf, const size_t len,
+               struct dir_scan *batch, int *overflow)
+{
+        size_t off = 0;
+        while (off + sizeof(struct fanotify_event_metadata) <= len)
+        {
+                const struct fanotify_event_metadata *md =
+                    (const void *) (buf + off);
+                if (md->event_len < sizeof(*md) || off + md->event_len > len)
+                {
+                        break;
+                }
+                off += md->event_len;
+                if (FANOTIFY_METADATA_VERSION != md->vers)
+                {
+                        continue;
+                }
+                if (md->mask & FAN_Q_OVERFLOW)
+                {
+                        *overflow = 1;
+                        continue;
+                }
+                if (md->mask & FAN_ONDIR)
+                {
+                        continue;
+                }
+                size_t info = md->metadata_len;
+                while (info + sizeof(struct fanotify_event_info_header) <=
+                       md->event_len)
+                {
+                        const struct fanotify_event_info_header *hdr =
+                            (const void *) ((const char *) md + info);
+                        if (0 == hdr->len)
+                        {
+                                break;
+                        }
+                        info += hdr->len;
+                        if (FAN_EVENT_INFO_TYPE_DFID_NAME != hdr->info_type)
+                        {
+                                continue;
+                        }
+                        const struct fanotify_event_info_fid *fid =
+                            (const void *) hdr;
+                        const struct file_handle *fh =
+                            (const void *) fid->handle;
+                        const char *name =
+                            (const char *) fh->f_handle + fh->handle_bytes;
+                        if (same_dir(w, fh) && 0 != strcmp(name, ".") &&
+                            -1 == batch_add(w, batch, name))
+                        {
+                                return -1;
+                        }
+                }
+        }
+        return 0;
+}
+
+/// Ждёт новых файлов и складывает их имена в `batch` (пачка очищается).
+///
+/// После первого события ждёт догоняющие ещё `w->window_ms` или пока в
+/// пачке не наберётся `w->batch_max` имён (размер проверяется между
+/// `read`, так что пачка может превысить его на один буфер событий).
+/// Одинаковые имена в пачке не повторяются.
+/// При переполнении очереди ядра (`IN_Q_OVERFLOW`) события потеряны —
+/// выставляется `*overflow`, и вызывающий должен перечитать каталог.
+///
+/// Через `timeout_ms` (-1 — без ограничения) от входа возвращает 1,
+/// даже если пачка пуста, — например, чтобы повторить отложенные файлы.
+/// События, не давшие имён, срок не продлевают. Сигнал, пришедший во время сбора пачки, не теряется: пачка
+/// возвращается, а остановка — при следующем вызове.
+///
+/// @return 1 — есть работа или истёк таймаут, 0 — получен
+///         `SIGINT`/`SIGTERM`, -1 — ошибка (код в `*error`).
+int
+watch_read(int *error, struct watcher *w, struct dir_scan *batch,
+           int *overflow, const int timeout_ms)
+{
+        *error    = WATCH_OK;
+        *overflow = 0;
+        scan_clear(batch);
+        strset_clear(&w->seen);
+        // срок всего вызова отсчитывается один раз: пробуждения без имён
+        // для этого каталога (у fanotify — события всей ФС) его не
+        // продлевают
+        const uint64_t limit =
+            timeout_ms < 0
+                ? UINT64_MAX
+                : monotonic_ns() + (uint64_t) timeout_ms * 1000000u;
+        uint64_t deadline = 0;
+        for (;;)
+        {
+                const uint64_t end =
+                    0 != batch->count && deadline < limit ? deadline : limit;
+                int wait = -1;
+                if (UINT64_MAX != end)
+                {
+                        const uint64_t now = monotonic_ns();
+                        if (now >= end)
+                        {
+                                return 1;
+                        }
+                        wait = (int) ((end - now + 999999) / 1000000);
+                }
+                struct pollfd fds[2] = {
+                    {.fd = w->sig_fd, .events = POLLIN},
+                    {.fd = w->fd, .events = POLLIN},
+                };
+                const int ready = poll(fds, 2, wait);
+                if (0 == ready)
+                {
+                        return 1;
+                }
+                if (-1 == ready)
+                {
+                        if (EINTR == errno)
+                        {
+                                continue;
+                        }
+                        *error = WATCH_ERR_READ;
+                        return -1;
+                }
+                if (fds[0].revents & POLLIN)
+                {
+                        if (0 != batch->count)
+                        {
+                                return 1;
+                        }
+                        // сигнал вычитывается, иначе он сработает при
+                        // восстановлении маски в `watch_close`
+                        struct signalfd_siginfo info;
+                        const ssize_t r = read(w->sig_fd, &info, sizeof(info));
+                        (void) r;
+                        return 0;
+                }
+                ssize_t n = 0;
+                while (batch->count < w->batch_max &&
+                       0 < (n = read(w->fd, w->buf, WATCH_BUFSIZE)))
+                {
+                        const int parsed =
+                            WATCH_FANOTIFY == w->backend
+                                ? parse_fanotify(w, w->buf, (size_t) n, batch,
+                                                 overflow)
+                                : parse_inotify(w, w->buf, (size_t) n, batch,
+                                                overflow);
+                        if (-1 == parsed)
+                        {
+                                *error = WATCH_ERR_MEM;
+                                return -1;
+                        }
+                }
+                if (-1 == n && EAGAIN != errno && EINTR != errno)
+                {
+                        *error = WATCH_ERR_READ;
+                        return -1;
+                }
+                if (*overflow || batch->count >= w->batch_max)
+                {
+                        return 1;
+                }
+                if (0 != batch->count && 0 == deadline)
+                {
+                        deadline = monotonic_ns() +
+                                   (uint64_t) w->window_ms * 1000000u;
+                }
+        }
+}
+
+/// Прекращает наблюдение и восстанавливает маску сигналов.
+void
+watch_close(struct watcher *w)
+{
+        if (NULL == w)
+        {
+                return;
+        }
+        if (-1 != w->fd)
+        {
+                close(w->fd);
+        }
+        if (-1 != w->sig_fd)
+        {
+                close(w->sig_fd);
+        }
+        free(w->buf);
+        free(w->dir_handle);
+        strset_free(&w->seen);
+        w->fd         = -1;
+        w->sig_fd     = -1;
+        w->buf        = NULL;
+        w->dir_handle = NULL;
+        pthread_sigmask(SIG_SETMASK, &w->old_mask, NULL);
+}
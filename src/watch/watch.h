@@ -0,0 +1,71 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+#include "fs.h"
+#include "strset.h"
+
+#include <signal.h>
+
+enum watch_error
+{
+        WATCH_OK,
+        WATCH_ERR_BAD_ARG,
+        WATCH_ERR_INIT, /// Не удалось создать inotify, signalfd или watch
+        WATCH_ERR_READ,
+        WATCH_ERR_MEM,
+};
+
+/// Источник событий.
+enum watch_backend
+{
+        WATCH_INOTIFY,  /// Один watch на каталог
+        WATCH_FANOTIFY, /// Одна метка на всю файловую систему
+};
+
+/// Размер буфера для событий одного `read`.
+#define WATCH_BUFSIZE (64 * 1024)
+/// Сколько по умолчанию ждать догоняющих событий после первого, мс.
+#define WATCH_WINDOW_MS 20
+/// Сколько имён по умолчанию набирать в пачку, не дожидаясь окна.
+#define WATCH_BATCH_MAX 4096
+
+/// Наблюдение за каталогом через inotify или fanotify.
+///
+/// Реагирует на перенос файла в каталог (`IN_MOVED_TO`/`FAN_MOVED_TO`)
+/// и на закрытие дописанного файла (`IN_CLOSE_WRITE`/`FAN_CLOSE_WRITE`),
+/// так что работа растёт с числом новых файлов, а не с размером
+/// каталога. fanotify (`FAN_REPORT_DFID_NAME`) ставит одну метку на всю
+/// файловую систему вместо watch на каждый каталог; события приходят с
+/// дескриптором родительского каталога и отбираются сравнением его с
+/// дескриптором наблюдаемого.
+///
+/// События собираются в пачки: после первого `watch_read` ждёт ещё
+/// `window_ms` или пока не наберётся `batch_max` имён, так что поток
+/// из тысяч файлов раскладывается несколькими крупными пачками, а не
+/// по файлу на пробуждение. Повторные события об одном имени внутри
+/// пачки схлопываются. `SIGINT` и `SIGTERM`
+/// блокируются и принимаются через `signalfd`: ожидание событий
+/// прерывается без гонки между проверкой флага и `poll`.
+struct watcher
+{
+        int      backend; /// Значение из `enum watch_backend`
+        int      fd;      /// inotify или fanotify
+        int      sig_fd; /// signalfd для `SIGINT`/`SIGTERM`
+        int      wd;
+        sigset_t old_mask;
+        char    *buf;
+        void    *dir_handle; /// `struct file_handle` каталога (fanotify)
+        unsigned window_ms; /// Окно сбора пачки, мс; 0 — не ждать
+        size_t   batch_max; /// Предел размера пачки
+        struct strset seen; /// Имена текущей пачки
+};
+
+int
+watch_open(int *error, struct watcher *w, const char *dir, int backend);
+int
+watch_read(int *error, struct watcher *w, struct dir_scan *batch,
+           int *overflow, int timeout_ms);
+void
+watch_close(struct watcher *w);
+
+#endif //WATCH_H